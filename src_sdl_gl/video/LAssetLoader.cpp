@@ -0,0 +1,229 @@
+// Background image decoding from memory-mapped files
+#include "LAssetLoader.h"
+
+LAssetLoader::LAssetLoader()
+{
+    mPending = 0;
+    mQuit = false;
+    mLock = SDL_CreateMutex();
+    mQueued = SDL_CreateCond();
+    mDecoded = SDL_CreateCond();
+}
+
+LAssetLoader::~LAssetLoader()
+{
+    freeLoader();
+
+    SDL_DestroyCond( mDecoded );
+    SDL_DestroyCond( mQueued );
+    SDL_DestroyMutex( mLock );
+}
+
+bool LAssetLoader::init( int threads )
+{
+    freeLoader();
+
+    if( threads <= 0 )
+    {
+        threads = SDL_GetCPUCount() - 1;
+    }
+    if( threads < 1 )
+    {
+        threads = 1;
+    }
+    if( threads > LASSET_MAX_THREADS )
+    {
+        threads = LASSET_MAX_THREADS;
+    }
+
+    mQuit = false;
+    for( int i = 0; i < threads; ++i )
+    {
+        SDL_Thread* thread = SDL_CreateThread( workerMain, "asset", this );
+        if( thread == NULL )
+        {
+            printf( "Unable to create asset thread! SDL Error: %s\n", SDL_GetError() );
+            break;
+        }
+        mThreads.push_back( thread );
+    }
+
+    return !mThreads.empty();
+}
+
+void LAssetLoader::freeLoader()
+{
+    //Threads finish the file they are on, queued ones are dropped
+    SDL_LockMutex( mLock );
+    mQuit = true;
+    SDL_CondBroadcast( mQueued );
+    SDL_UnlockMutex( mLock );
+
+    for( size_t i = 0; i < mThreads.size(); ++i )
+    {
+        SDL_WaitThread( mThreads[ i ], NULL );
+    }
+    mThreads.clear();
+
+    for( size_t i = 0; i < mAssets.size(); ++i )
+    {
+        delete mAssets[ i ].texture;
+    }
+    mAssets.clear();
+    mQueue.clear();
+    mPending = 0;
+}
+
+int LAssetLoader::threadCount()
+{
+    return (int)mThreads.size();
+}
+
+int LAssetLoader::request( const std::string& path )
+{
+    SDL_LockMutex( mLock );
+    for( size_t i = 0; i < mAssets.size(); ++i )
+    {
+        if( mAssets[ i ].path == path )
+        {
+            SDL_UnlockMutex( mLock );
+            return (int)i;
+        }
+    }
+
+    int id = (int)mAssets.size();
+    LAsset asset;
+    asset.path = path;
+    asset.state = LASSET_QUEUED;
+    asset.image.width = 0;
+    asset.image.height = 0;
+    asset.texture = NULL;
+    mAssets.push_back( asset );
+    mPending++;
+
+    bool async = !mThreads.empty();
+    if( async )
+    {
+        mQueue.push_back( id );
+        SDL_CondSignal( mQueued );
+    }
+    SDL_UnlockMutex( mLock );
+
+    if( !async )
+    {
+        decode( id );
+    }
+
+    return id;
+}
+
+int LAssetLoader::state( int id )
+{
+    SDL_LockMutex( mLock );
+    int state = id >= 0 && id < (int)mAssets.size() ? mAssets[ id ].state : LASSET_FAILED;
+    SDL_UnlockMutex( mLock );
+
+    return state;
+}
+
+int LAssetLoader::pending()
+{
+    SDL_LockMutex( mLock );
+    int pending = mPending;
+    SDL_UnlockMutex( mLock );
+
+    return pending;
+}
+
+LImage* LAssetLoader::image( int id )
+{
+    return state( id ) == LASSET_READY ? &mAssets[ id ].image : NULL;
+}
+
+LImage* LAssetLoader::wait( int id )
+{
+    if( id < 0 )
+    {
+        return NULL;
+    }
+
+    SDL_LockMutex( mLock );
+    while( id < (int)mAssets.size() && mAssets[ id ].state == LASSET_QUEUED && !mQuit )
+    {
+        SDL_CondWait( mDecoded, mLock );
+    }
+    SDL_UnlockMutex( mLock );
+
+    return image( id );
+}
+
+LTexture* LAssetLoader::texture( int id )
+{
+    LImage* decoded = image( id );
+    if( decoded == NULL )
+    {
+        return NULL;
+    }
+
+    LAsset& asset = mAssets[ id ];
+    if( asset.texture == NULL )
+    {
+        asset.texture = new LTexture();
+        if( !asset.texture->loadTextureFromPixels32( &decoded->pixels[ 0 ], decoded->width, decoded->height ) )
+        {
+            printf( "Unable to create texture of %s\n", asset.path.c_str() );
+        }
+    }
+
+    return asset.texture;
+}
+
+int LAssetLoader::workerMain( void* data )
+{
+    LAssetLoader* loader = (LAssetLoader*)data;
+
+    SDL_LockMutex( loader->mLock );
+    while( true )
+    {
+        while( loader->mQueue.empty() && !loader->mQuit )
+        {
+            SDL_CondWait( loader->mQueued, loader->mLock );
+        }
+        if( loader->mQuit )
+        {
+            break;
+        }
+
+        int id = loader->mQueue.front();
+        loader->mQueue.pop_front();
+        SDL_UnlockMutex( loader->mLock );
+
+        loader->decode( id );
+
+        SDL_LockMutex( loader->mLock );
+    }
+    SDL_UnlockMutex( loader->mLock );
+
+    return 0;
+}
+
+void LAssetLoader::decode( int id )
+{
+    //Path never changes once queued
+    SDL_LockMutex( mLock );
+    std::string path = mAssets[ id ].path;
+    SDL_UnlockMutex( mLock );
+
+    LImage decoded;
+    bool loaded = LBitmap::load( path, decoded );
+
+    SDL_LockMutex( mLock );
+    LAsset& asset = mAssets[ id ];
+    asset.image.width = decoded.width;
+    asset.image.height = decoded.height;
+    asset.image.pixels.swap( decoded.pixels );
+    asset.state = loaded ? LASSET_READY : LASSET_FAILED;
+    mPending--;
+    SDL_CondBroadcast( mDecoded );
+    SDL_UnlockMutex( mLock );
+}
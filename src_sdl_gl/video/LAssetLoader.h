@@ -0,0 +1,80 @@
+// Background image decoding from memory-mapped files
+#ifndef LASSET_LOADER_H
+#define LASSET_LOADER_H
+
+#include "LTexture.h"
+#include "LImage.h"
+#include <stdio.h>
+#include <string>
+#include <deque>
+#include <vector>
+#include <SDL.h>
+
+//Upper bound of decode threads
+#define LASSET_MAX_THREADS 8
+
+//Asset states
+#define LASSET_QUEUED 0
+#define LASSET_READY  1
+#define LASSET_FAILED 2
+
+struct LAsset
+{
+    std::string path;
+    int state;
+    LImage image;
+
+    //Created from the image on first use
+    LTexture* texture;
+};
+
+class LAssetLoader
+{
+    public:
+        LAssetLoader();
+        ~LAssetLoader();
+
+        //0 threads picks one per spare CPU. Without threads request()
+        //decodes on the calling thread.
+        bool init( int threads );
+        void freeLoader();
+        int threadCount();
+
+        //Queues a file for decoding and returns its id, the same path
+        //always gives the same id
+        int request( const std::string& path );
+
+        //LASSET_QUEUED until a thread has decoded the file
+        int state( int id );
+        int pending();
+
+        //Decoded image, NULL while queued or if decoding failed
+        LImage* image( int id );
+
+        //Blocks until the file is decoded, NULL if that failed
+        LImage* wait( int id );
+
+        //Texture of the image, created by the first call once decoded.
+        //NULL before that. GL thread only.
+        LTexture* texture( int id );
+
+    private:
+        static int workerMain( void* data );
+        void decode( int id );
+
+        std::vector<SDL_Thread*> mThreads;
+
+        //By id; a deque so entries stay put while threads decode into them
+        std::deque<LAsset> mAssets;
+
+        //Ids not yet taken by a thread
+        std::deque<int> mQueue;
+        int mPending;
+        bool mQuit;
+
+        SDL_mutex* mLock;
+        SDL_cond* mQueued;
+        SDL_cond* mDecoded;
+};
+
+#endif
@@ -0,0 +1,237 @@
+// Asset bundle: atlas pages of pre-converted pixels with a directory index
+#include "LBundle.h"
+#include "LTexture.h"
+#include <string.h>
+
+LBundle::LBundle()
+{
+    mHeader = NULL;
+    mPages = NULL;
+    mEntries = NULL;
+    mNames = NULL;
+}
+
+LBundle::~LBundle()
+{
+    close();
+}
+
+bool LBundle::open( const std::string& path )
+{
+    close();
+
+    if( !mFile.map( path ) )
+    {
+        printf( "Unable to open bundle %s\n", path.c_str() );
+        return false;
+    }
+
+    //Every table must lie inside the file before anything is read from it
+    const Uint8* data = mFile.data();
+    Uint64 size = mFile.size();
+    const LBundleHeader* header = (const LBundleHeader*)data;
+    bool valid = size >= sizeof( LBundleHeader ) && memcmp( header->magic, LBUNDLE_MAGIC, 4 ) == 0 && header->version == LBUNDLE_VERSION;
+    valid = valid && header->pageOffset % 8 == 0 && header->entryOffset % 4 == 0;
+    valid = valid && header->pageOffset + (Uint64)header->pageCount * sizeof( LBundlePage ) <= size;
+    valid = valid && header->entryOffset + (Uint64)header->entryCount * sizeof( LBundleEntry ) <= size;
+    valid = valid && header->nameSize > 0 && header->nameOffset + (Uint64)header->nameSize <= size;
+
+    const LBundlePage* pages = (const LBundlePage*)( data + ( valid ? header->pageOffset : 0 ) );
+    for( Uint32 i = 0; valid && i < header->pageCount; ++i )
+    {
+        const LBundlePage& page = pages[ i ];
+        Uint64 bytes = (Uint64)page.width * page.height * ( page.format == LBUNDLE_RGBA ? 4 : 1 );
+        valid = page.format <= LBUNDLE_INDEXED && page.width > 0 && page.height > 0 && page.width <= LIMAGE_MAX_SIZE && page.height <= LIMAGE_MAX_SIZE;
+        valid = valid && page.dataSize == bytes && page.dataOffset % LBUNDLE_ALIGN == 0 && page.dataOffset <= size && bytes <= size - page.dataOffset;
+    }
+
+    const LBundleEntry* entries = (const LBundleEntry*)( data + ( valid ? header->entryOffset : 0 ) );
+    for( Uint32 i = 0; valid && i < header->entryCount; ++i )
+    {
+        const LBundleEntry& entry = entries[ i ];
+        valid = entry.page < header->pageCount && (Uint64)entry.nameOffset + entry.nameLength < header->nameSize;
+        valid = valid && (Uint64)entry.x + entry.width <= pages[ entry.page ].width && (Uint64)entry.y + entry.height <= pages[ entry.page ].height;
+    }
+
+    if( !valid )
+    {
+        printf( "Bundle %s is damaged or of another version\n", path.c_str() );
+        mFile.unmap();
+        return false;
+    }
+
+    mHeader = header;
+    mPages = pages;
+    mEntries = entries;
+    mNames = (const char*)( data + header->nameOffset );
+    mTextures.assign( header->pageCount, (LTexture*)NULL );
+
+    return true;
+}
+
+void LBundle::close()
+{
+    for( size_t i = 0; i < mTextures.size(); ++i )
+    {
+        delete mTextures[ i ];
+    }
+    mTextures.clear();
+
+    mHeader = NULL;
+    mPages = NULL;
+    mEntries = NULL;
+    mNames = NULL;
+    mFile.unmap();
+}
+
+bool LBundle::isOpen()
+{
+    return mHeader != NULL;
+}
+
+int LBundle::find( const std::string& name )
+{
+    //Entries are sorted by name bytes, shorter names first on a tie
+    int low = 0;
+    int high = entryCount() - 1;
+    while( low <= high )
+    {
+        int middle = ( low + high ) / 2;
+        const LBundleEntry& entry = mEntries[ middle ];
+        size_t common = entry.nameLength < name.size() ? entry.nameLength : name.size();
+        int order = memcmp( mNames + entry.nameOffset, name.data(), common );
+        if( order == 0 )
+        {
+            order = entry.nameLength < name.size() ? -1 : ( entry.nameLength > name.size() ? 1 : 0 );
+        }
+
+        if( order == 0 )
+        {
+            return middle;
+        }
+        if( order < 0 )
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle - 1;
+        }
+    }
+
+    return -1;
+}
+
+int LBundle::entryCount()
+{
+    return mHeader != NULL ? (int)mHeader->entryCount : 0;
+}
+
+const LBundleEntry* LBundle::entry( int index )
+{
+    return index >= 0 && index < entryCount() ? &mEntries[ index ] : NULL;
+}
+
+std::string LBundle::entryName( int index )
+{
+    const LBundleEntry* found = entry( index );
+    return found != NULL ? std::string( mNames + found->nameOffset, found->nameLength ) : std::string();
+}
+
+int LBundle::pageCount()
+{
+    return mHeader != NULL ? (int)mHeader->pageCount : 0;
+}
+
+const LBundlePage* LBundle::page( int index )
+{
+    return index >= 0 && index < pageCount() ? &mPages[ index ] : NULL;
+}
+
+const Uint8* LBundle::pagePixels( int index )
+{
+    return index >= 0 && index < pageCount() ? mFile.data() + mPages[ index ].dataOffset : NULL;
+}
+
+bool LBundle::entryPixels32( int index, Uint32* pixels )
+{
+    const LBundleEntry* found = entry( index );
+    if( found == NULL || mPages[ found->page ].format != LBUNDLE_RGBA )
+    {
+        return false;
+    }
+
+    const Uint32* src = (const Uint32*)pagePixels( found->page );
+    Uint32 pitch = mPages[ found->page ].width;
+    for( Uint32 y = 0; y < found->height; ++y )
+    {
+        memcpy( pixels + y * found->width, src + ( found->y + y ) * pitch + found->x, found->width * sizeof( Uint32 ) );
+    }
+
+    return true;
+}
+
+bool LBundle::entryPixels8( int index, Uint8* pixels )
+{
+    const LBundleEntry* found = entry( index );
+    if( found == NULL || mPages[ found->page ].format != LBUNDLE_INDEXED )
+    {
+        return false;
+    }
+
+    const Uint8* src = pagePixels( found->page );
+    Uint32 pitch = mPages[ found->page ].width;
+    for( Uint32 y = 0; y < found->height; ++y )
+    {
+        memcpy( pixels + y * found->width, src + ( found->y + y ) * pitch + found->x, found->width );
+    }
+
+    return true;
+}
+
+LTexture* LBundle::pageTexture( int index )
+{
+    if( index < 0 || index >= pageCount() )
+    {
+        return NULL;
+    }
+
+    if( mTextures[ index ] == NULL )
+    {
+        //One upload of the whole page straight from the mapping
+        const LBundlePage& page = mPages[ index ];
+        LTexture* texture = new LTexture();
+        bool loaded;
+        if( page.format == LBUNDLE_RGBA )
+        {
+            loaded = texture->loadTextureFromPixels32( (GLuint*)pagePixels( index ), page.width, page.height );
+        }
+        else
+        {
+            loaded = texture->loadTextureFromPixels8( (GLubyte*)pagePixels( index ), page.width, page.height );
+        }
+        if( !loaded )
+        {
+            printf( "Unable to create texture of bundle page %d\n", index );
+        }
+        mTextures[ index ] = texture;
+    }
+
+    return mTextures[ index ];
+}
+
+void LBundle::entryTexCoords( int index, float* coords )
+{
+    const LBundleEntry* found = entry( index );
+    if( found == NULL )
+    {
+        coords[ 0 ] = coords[ 1 ] = coords[ 2 ] = coords[ 3 ] = 0.0f;
+        return;
+    }
+
+    const LBundlePage& page = mPages[ found->page ];
+    coords[ 0 ] = (GLfloat)found->x / page.width;
+    coords[ 1 ] = (GLfloat)found->y / page.height;
+    coords[ 2 ] = (GLfloat)( found->x + found->width ) / page.width;
+    coords[ 3 ] = (GLfloat)( found->y + found->height ) / page.height;
+}
@@ -0,0 +1,111 @@
+// Asset bundle: atlas pages of pre-converted pixels with a directory index
+#ifndef LBUNDLE_H
+#define LBUNDLE_H
+
+#include "LImage.h"
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <SDL.h>
+
+//The packer shares this header without GL
+class LTexture;
+
+//File layout, little endian and read in place from the mapping:
+//header, page table, entry table sorted by name, name table, then the
+//pixels of every page, each starting on an LBUNDLE_ALIGN boundary
+#define LBUNDLE_MAGIC   "SWAB"
+#define LBUNDLE_VERSION 1
+#define LBUNDLE_ALIGN   64
+
+//Page pixel formats
+#define LBUNDLE_RGBA    0   //Uint32 per pixel, LPixelOps layout
+#define LBUNDLE_INDEXED 1   //Uint8 per pixel, 3-3-2 palette index
+
+//Gutter around every atlas entry, filled with its edge pixels so linear
+//filtering never reads a neighbour
+#define LBUNDLE_GUTTER 1
+
+struct LBundleHeader
+{
+    char magic[ 4 ];
+    Uint32 version;
+    Uint32 pageCount;
+    Uint32 entryCount;
+    Uint32 pageOffset;
+    Uint32 entryOffset;
+    Uint32 nameOffset;
+    Uint32 nameSize;
+};
+
+struct LBundlePage
+{
+    Uint32 format;
+    Uint32 width;
+    Uint32 height;
+    Uint32 reserved;
+    Uint64 dataOffset;
+    Uint64 dataSize;
+};
+
+struct LBundleEntry
+{
+    //Name in the name table, NUL terminated there
+    Uint32 nameOffset;
+    Uint32 nameLength;
+
+    //Rectangle on its page
+    Uint32 page;
+    Uint32 x;
+    Uint32 y;
+    Uint32 width;
+    Uint32 height;
+    Uint32 reserved;
+};
+
+class LBundle
+{
+    public:
+        LBundle();
+        ~LBundle();
+
+        //Maps the file and checks its tables, pixels stay in the mapping
+        bool open( const std::string& path );
+        void close();
+        bool isOpen();
+
+        //Entry index by name, binary search of the directory. -1 if absent.
+        int find( const std::string& name );
+
+        int entryCount();
+        const LBundleEntry* entry( int index );
+        std::string entryName( int index );
+
+        int pageCount();
+        const LBundlePage* page( int index );
+        const Uint8* pagePixels( int index );
+
+        //Copies an entry's rectangle out of an RGBA or indexed page,
+        //false for the other format
+        bool entryPixels32( int index, Uint32* pixels );
+        bool entryPixels8( int index, Uint8* pixels );
+
+        //Texture of a whole page, uploaded from the mapping by the first
+        //call. GL thread only.
+        LTexture* pageTexture( int index );
+
+        //Texture coordinates s0, t0, s1, t1 of an entry on its page
+        void entryTexCoords( int index, float* coords );
+
+    private:
+        LMappedFile mFile;
+        const LBundleHeader* mHeader;
+        const LBundlePage* mPages;
+        const LBundleEntry* mEntries;
+        const char* mNames;
+
+        //Created on first use, one per page
+        std::vector<LTexture*> mTextures;
+};
+
+#endif
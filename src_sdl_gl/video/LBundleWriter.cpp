@@ -0,0 +1,290 @@
+// Packs images into an asset bundle, see LBundle.h for the layout
+#include "LBundleWriter.h"
+#include <string.h>
+#include <algorithm>
+
+//Taller images first, so each shelf wastes little height
+struct LBundleItemTaller
+{
+    const std::vector<LBundleItem>* items;
+    bool operator()( int a, int b ) const
+    {
+        const LImage& imageA = ( *items )[ a ].image;
+        const LImage& imageB = ( *items )[ b ].image;
+        if( imageA.height != imageB.height )
+        {
+            return imageA.height > imageB.height;
+        }
+        return imageA.width > imageB.width;
+    }
+};
+
+//Directory order the reader's binary search expects
+struct LBundleItemName
+{
+    const std::vector<LBundleItem>* items;
+    bool operator()( int a, int b ) const
+    {
+        const std::string& nameA = ( *items )[ a ].name;
+        const std::string& nameB = ( *items )[ b ].name;
+        size_t common = nameA.size() < nameB.size() ? nameA.size() : nameB.size();
+        int order = memcmp( nameA.data(), nameB.data(), common );
+        return order != 0 ? order < 0 : nameA.size() < nameB.size();
+    }
+};
+
+static bool writePadding( FILE* file, Uint64 bytes )
+{
+    static const Uint8 zeros[ LBUNDLE_ALIGN ] = { 0 };
+    return bytes == 0 || fwrite( zeros, 1, (size_t)bytes, file ) == bytes;
+}
+
+static Uint64 alignUp( Uint64 offset, Uint64 align )
+{
+    return ( offset + align - 1 ) / align * align;
+}
+
+LBundleWriter::LBundleWriter()
+{
+}
+
+bool LBundleWriter::add( const std::string& name, const LImage& image, int format )
+{
+    if( name.empty() || image.width == 0 || image.height == 0 || ( format != LBUNDLE_RGBA && format != LBUNDLE_INDEXED ) )
+    {
+        printf( "Cannot bundle %s\n", name.c_str() );
+        return false;
+    }
+
+    for( size_t i = 0; i < mItems.size(); ++i )
+    {
+        if( mItems[ i ].name == name )
+        {
+            printf( "%s is already in the bundle\n", name.c_str() );
+            return false;
+        }
+    }
+
+    LBundleItem item;
+    item.name = name;
+    item.format = format;
+    item.image = image;
+    item.page = 0;
+    item.x = 0;
+    item.y = 0;
+    mItems.push_back( item );
+
+    return true;
+}
+
+int LBundleWriter::entryCount()
+{
+    return (int)mItems.size();
+}
+
+int LBundleWriter::pageCount()
+{
+    return (int)mPages.size();
+}
+
+Uint8 LBundleWriter::quantize( Uint32 pixel )
+{
+    Uint8 r = pixel & 0xFF;
+    Uint8 g = ( pixel >> 8 ) & 0xFF;
+    Uint8 b = ( pixel >> 16 ) & 0xFF;
+    return ( r & 0xE0 ) | ( ( g >> 3 ) & 0x1C ) | ( b >> 6 );
+}
+
+void LBundleWriter::layout( Uint32 pageSize )
+{
+    mPages.clear();
+
+    std::vector<int> order;
+    for( size_t i = 0; i < mItems.size(); ++i )
+    {
+        order.push_back( (int)i );
+    }
+    LBundleItemTaller taller = { &mItems };
+    std::stable_sort( order.begin(), order.end(), taller );
+
+    //Shelf packing, one open page per format
+    int openPage[ 2 ] = { -1, -1 };
+    Uint32 shelfX[ 2 ] = { 0, 0 };
+    Uint32 shelfY[ 2 ] = { 0, 0 };
+    Uint32 shelfHeight[ 2 ] = { 0, 0 };
+
+    for( size_t i = 0; i < order.size(); ++i )
+    {
+        LBundleItem& item = mItems[ order[ i ] ];
+        int format = item.format;
+        Uint32 width = item.image.width + 2 * LBUNDLE_GUTTER;
+        Uint32 height = item.image.height + 2 * LBUNDLE_GUTTER;
+
+        LBundlePage newPage;
+        memset( &newPage, 0, sizeof( newPage ) );
+        newPage.format = format;
+
+        if( width > pageSize || height > pageSize )
+        {
+            //Too large to share, the page is just this image
+            item.page = (Uint32)mPages.size();
+            item.x = 0;
+            item.y = 0;
+            newPage.width = width;
+            newPage.height = height;
+            mPages.push_back( newPage );
+            continue;
+        }
+
+        if( openPage[ format ] >= 0 && shelfX[ format ] + width > pageSize )
+        {
+            shelfY[ format ] += shelfHeight[ format ];
+            shelfX[ format ] = 0;
+            shelfHeight[ format ] = 0;
+        }
+        if( openPage[ format ] < 0 || shelfY[ format ] + height > pageSize )
+        {
+            openPage[ format ] = (int)mPages.size();
+            shelfX[ format ] = 0;
+            shelfY[ format ] = 0;
+            shelfHeight[ format ] = 0;
+            mPages.push_back( newPage );
+        }
+
+        item.page = openPage[ format ];
+        item.x = shelfX[ format ];
+        item.y = shelfY[ format ];
+        shelfX[ format ] += width;
+        shelfHeight[ format ] = std::max( shelfHeight[ format ], height );
+
+        //Pages end at the last used row and column
+        LBundlePage& page = mPages[ item.page ];
+        page.width = std::max( page.width, item.x + width );
+        page.height = std::max( page.height, item.y + height );
+    }
+}
+
+void LBundleWriter::blit( const LBundleItem& item, Uint8* pixels, Uint32 pitch )
+{
+    const LImage& image = item.image;
+    int width = (int)image.width;
+    int height = (int)image.height;
+
+    //The gutter repeats the nearest edge pixel
+    for( int y = -LBUNDLE_GUTTER; y < height + LBUNDLE_GUTTER; ++y )
+    {
+        int srcY = std::min( std::max( y, 0 ), height - 1 );
+        Uint32 dstY = item.y + LBUNDLE_GUTTER + y;
+        for( int x = -LBUNDLE_GUTTER; x < width + LBUNDLE_GUTTER; ++x )
+        {
+            int srcX = std::min( std::max( x, 0 ), width - 1 );
+            Uint32 dstX = item.x + LBUNDLE_GUTTER + x;
+            Uint32 pixel = image.pixels[ srcY * width + srcX ];
+            if( item.format == LBUNDLE_RGBA )
+            {
+                ( (Uint32*)pixels )[ dstY * pitch + dstX ] = pixel;
+            }
+            else
+            {
+                pixels[ dstY * pitch + dstX ] = quantize( pixel );
+            }
+        }
+    }
+}
+
+bool LBundleWriter::write( const std::string& path, Uint32 pageSize )
+{
+    layout( pageSize );
+
+    std::vector<int> order;
+    for( size_t i = 0; i < mItems.size(); ++i )
+    {
+        order.push_back( (int)i );
+    }
+    LBundleItemName byName = { &mItems };
+    std::sort( order.begin(), order.end(), byName );
+
+    //Tables follow the header back to back, pixels start aligned
+    LBundleHeader header;
+    memset( &header, 0, sizeof( header ) );
+    memcpy( header.magic, LBUNDLE_MAGIC, 4 );
+    header.version = LBUNDLE_VERSION;
+    header.pageCount = (Uint32)mPages.size();
+    header.entryCount = (Uint32)mItems.size();
+    header.pageOffset = sizeof( LBundleHeader );
+    header.entryOffset = header.pageOffset + header.pageCount * sizeof( LBundlePage );
+    header.nameOffset = header.entryOffset + header.entryCount * sizeof( LBundleEntry );
+
+    std::string names;
+    std::vector<LBundleEntry> entries( mItems.size() );
+    for( size_t i = 0; i < order.size(); ++i )
+    {
+        const LBundleItem& item = mItems[ order[ i ] ];
+        LBundleEntry& entry = entries[ i ];
+        memset( &entry, 0, sizeof( entry ) );
+        entry.nameOffset = (Uint32)names.size();
+        entry.nameLength = (Uint32)item.name.size();
+        entry.page = item.page;
+        entry.x = item.x + LBUNDLE_GUTTER;
+        entry.y = item.y + LBUNDLE_GUTTER;
+        entry.width = item.image.width;
+        entry.height = item.image.height;
+        names += item.name;
+        names += '\0';
+    }
+    if( names.empty() )
+    {
+        names += '\0';
+    }
+    header.nameSize = (Uint32)names.size();
+
+    Uint64 offset = alignUp( (Uint64)header.nameOffset + header.nameSize, LBUNDLE_ALIGN );
+    for( size_t i = 0; i < mPages.size(); ++i )
+    {
+        LBundlePage& page = mPages[ i ];
+        page.dataOffset = offset;
+        page.dataSize = (Uint64)page.width * page.height * ( page.format == LBUNDLE_RGBA ? 4 : 1 );
+        offset = alignUp( offset + page.dataSize, LBUNDLE_ALIGN );
+    }
+
+    FILE* file = fopen( path.c_str(), "wb" );
+    if( file == NULL )
+    {
+        printf( "Unable to create bundle %s\n", path.c_str() );
+        return false;
+    }
+
+    bool written = fwrite( &header, sizeof( header ), 1, file ) == 1;
+    written = written && ( mPages.empty() || fwrite( &mPages[ 0 ], sizeof( LBundlePage ), mPages.size(), file ) == mPages.size() );
+    written = written && ( entries.empty() || fwrite( &entries[ 0 ], sizeof( LBundleEntry ), entries.size(), file ) == entries.size() );
+    written = written && fwrite( names.data(), 1, names.size(), file ) == names.size();
+    Uint64 position = (Uint64)header.nameOffset + header.nameSize;
+
+    //Pages are composed one at a time
+    std::vector<Uint8> pixels;
+    for( size_t i = 0; written && i < mPages.size(); ++i )
+    {
+        const LBundlePage& page = mPages[ i ];
+        written = writePadding( file, page.dataOffset - position );
+
+        pixels.assign( (size_t)page.dataSize, 0 );
+        for( size_t j = 0; j < mItems.size(); ++j )
+        {
+            if( mItems[ j ].page == i )
+            {
+                blit( mItems[ j ], &pixels[ 0 ], page.width );
+            }
+        }
+
+        written = written && fwrite( &pixels[ 0 ], 1, pixels.size(), file ) == pixels.size();
+        position = page.dataOffset + page.dataSize;
+    }
+
+    written = fclose( file ) == 0 && written;
+    if( !written )
+    {
+        printf( "Unable to write bundle %s\n", path.c_str() );
+    }
+
+    return written;
+}
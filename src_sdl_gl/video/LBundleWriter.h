@@ -0,0 +1,53 @@
+// Packs images into an asset bundle, see LBundle.h for the layout
+#ifndef LBUNDLE_WRITER_H
+#define LBUNDLE_WRITER_H
+
+#include "LBundle.h"
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <SDL.h>
+
+//Default largest page side, within every GL 3 implementation's limit
+#define LBUNDLE_PAGE_SIZE 2048
+
+struct LBundleItem
+{
+    std::string name;
+    int format;
+    LImage image;
+
+    //Placement, top left of the gutter
+    Uint32 page;
+    Uint32 x;
+    Uint32 y;
+};
+
+class LBundleWriter
+{
+    public:
+        LBundleWriter();
+
+        //Adds an image as LBUNDLE_RGBA or LBUNDLE_INDEXED pixels, false if
+        //the name is taken
+        bool add( const std::string& name, const LImage& image, int format );
+
+        //Lays the images out on pages of at most 'pageSize' per side, larger
+        //images get a page of their own, and writes the bundle
+        bool write( const std::string& path, Uint32 pageSize );
+
+        int entryCount();
+        int pageCount();
+
+        //Index of the 3-3-2 palette the indexed renderer uses
+        static Uint8 quantize( Uint32 pixel );
+
+    private:
+        void layout( Uint32 pageSize );
+        void blit( const LBundleItem& item, Uint8* pixels, Uint32 pitch );
+
+        std::vector<LBundleItem> mItems;
+        std::vector<LBundlePage> mPages;
+};
+
+#endif
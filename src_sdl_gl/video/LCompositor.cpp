@@ -0,0 +1,205 @@
+// CPU composition of the background and menu layers for SWOS 2020 rendering engine
+#include "LCompositor.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Logical window size
+int kVgaWidth = 480;
+int kVgaHeight = 270;
+
+// Workers of the CPU compositor
+LThreadPool m_threadPool;
+
+bool gMenuNoise = false;
+
+Uint32 setRGBA(Uint8 r, Uint8 g, Uint8 b, Uint8 a)
+{
+    return (a << 24) + (b << 16) + (g << 8) + r;
+}
+
+void getRGBA(Uint32 color, Uint8 *r, Uint8 *g, Uint8 *b, Uint8 *a)
+{
+    *a = (color >> 24) & 255;
+    *b = (color >> 16) & 255;
+    *g = (color >>  8) & 255;
+    *r = (color      ) & 255;
+}
+
+// Work of one compositor call, cut into bands of at most BAND_ROWS rows
+namespace {
+struct ComposeJob
+{
+    Uint32 *src1, *src2, *tar;
+    Uint8 *src8, *menu8, *tar8;
+    Uint32 color;
+    Uint32 seed;
+    int opacity;
+    std::vector<LDirtyRect> bands;
+};
+}
+
+static void splitBands(const std::vector<LDirtyRect> &rects, std::vector<LDirtyRect> &bands)
+{
+    bands.clear();
+    for (size_t i = 0; i < rects.size(); i++) {
+        for (Uint32 y = rects[i].y; y < rects[i].y + rects[i].h; y += BAND_ROWS) {
+            LDirtyRect band = rects[i];
+            band.y = y;
+            band.h = y + BAND_ROWS < rects[i].y + rects[i].h ? BAND_ROWS : rects[i].y + rects[i].h - y;
+            bands.push_back(band);
+        }
+    }
+}
+
+static void splitFrame(std::vector<LDirtyRect> &bands)
+{
+    LDirtyRect frame = { 0, 0, (Uint32)kVgaWidth, (Uint32)kVgaHeight };
+    splitBands(std::vector<LDirtyRect>(1, frame), bands);
+}
+
+// Bands are disjoint, so the output is the same whichever thread runs what
+static void runBands(ComposeJob &job, LTaskFunc func)
+{
+    m_threadPool.parallelFor(job.bands.size(), 1, func, &job);
+}
+
+static void clearBands(void *data, int begin, int end)
+{
+    ComposeJob *job = (ComposeJob*)data;
+    for (int i = begin; i < end; i++) {
+        const LDirtyRect &r = job->bands[i];
+        pxFillRect(job->tar, kVgaWidth, r.x, r.y, r.w, r.h, job->color);
+    }
+}
+
+static void blendBands(void *data, int begin, int end)
+{
+    ComposeJob *job = (ComposeJob*)data;
+    for (int i = begin; i < end; i++) {
+        const LDirtyRect &r = job->bands[i];
+        pxAlphaBlendRect(job->src1, job->src2, job->tar, kVgaWidth, r.x, r.y, r.w, r.h, job->opacity);
+    }
+}
+
+// Per-pixel hash instead of rand(), same picture for any thread count
+static void noiseBands(void *data, int begin, int end)
+{
+    ComposeJob *job = (ComposeJob*)data;
+    for (int i = begin; i < end; i++) {
+        const LDirtyRect &r = job->bands[i];
+        for (Uint32 y = r.y; y < r.y + r.h; y++) {
+            for (Uint32 x = r.x; x < r.x + r.w; x++) {
+                Uint32 h = (y * kVgaWidth + x) * 2654435761u ^ job->seed;
+                h ^= h >> 15;
+                h *= 2246822519u;
+                h ^= h >> 13;
+                job->tar[y * kVgaWidth + x] = setRGBA(1 + (h & 255) % 255, 1 + ((h >> 8) & 255) % 255, 1 + ((h >> 16) & 255) % 255, 255);
+            }
+        }
+    }
+}
+
+void fillPixels(Uint32 *pixels, Uint32 color)
+{
+    ComposeJob job;
+    job.tar = pixels;
+    job.color = color;
+    splitFrame(job.bands);
+    runBands(job, clearBands);
+}
+
+void initMenuPixels(Uint32 *pixels)
+{
+    fillPixels(pixels, setRGBA(0, 0, 0, 0));
+}
+
+// Only touches the menu box, changed areas are reported to 'layer' if given
+void updateTestMenuPixels(Uint32 *pixels, LTexture *layer, int frame)
+{
+    if (!gMenuNoise)
+        return;
+
+    LDirtyRect box = { 150/2, 200/2, (Uint32)kVgaWidth - 150 + 1, (Uint32)kVgaHeight - 200 + 1 };
+    if (layer)
+        layer->invalidateRect(box.x, box.y, box.w, box.h);
+
+    ComposeJob job;
+    job.tar = pixels;
+    job.seed = frame * 0x9E3779B9u;
+    splitBands(std::vector<LDirtyRect>(1, box), job.bands);
+    runBands(job, noiseBands);
+}
+
+// Blend only the given rectangles, the rest of 'tar' is still current
+void alphablendPixels(Uint32 *src1, Uint32 *src2, Uint32 *tar, int opacity, const std::vector<LDirtyRect> &rects)
+{
+    ComposeJob job;
+    job.src1 = src1;
+    job.src2 = src2;
+    job.tar = tar;
+    job.opacity = opacity;
+    splitBands(rects, job.bands);
+    runBands(job, blendBands);
+}
+
+// 3-3-2 bit RGB palette, index = rrrgggbb
+void initPalette(Uint32 *palette, int brightness)
+{
+    for (int i = 0; i < 256; i++) {
+        int r = ((i >> 5) & 7) * 255 / 7;
+        int g = ((i >> 2) & 7) * 255 / 7;
+        int b = ( i       & 3) * 255 / 3;
+        palette[i] = setRGBA(r * brightness / 255, g * brightness / 255, b * brightness / 255, 255);
+    }
+}
+
+void quantizePixels(Uint32 *src, Uint8 *dst, int count)
+{
+    for (int i = 0; i < count; i++) {
+        Uint8 r, g, b, a;
+        getRGBA(src[i], &r, &g, &b, &a);
+        dst[i] = (r & 0xE0) | ((g >> 3) & 0x1C) | (b >> 6);
+    }
+}
+
+void updateTestMenuPixels8(Uint8 *pixels, LTexture *layer)
+{
+    if (!gMenuNoise)
+        return;
+
+    LDirtyRect box = { 150/2, 200/2, (Uint32)kVgaWidth - 150 + 1, (Uint32)kVgaHeight - 200 + 1 };
+    if (layer)
+        layer->invalidateRect(box.x, box.y, box.w, box.h);
+    pxFillRect8(pixels, kVgaWidth, box.x, box.y, box.w, box.h, 1 + (rand() % 255));
+}
+
+static void composeBands8(void *data, int begin, int end)
+{
+    ComposeJob *job = (ComposeJob*)data;
+    for (int i = begin; i < end; i++) {
+        const LDirtyRect &r = job->bands[i];
+        for (Uint32 y = r.y; y < r.y + r.h; y++) {
+            memcpy(job->tar8 + y * kVgaWidth + r.x, job->src8 + y * kVgaWidth + r.x, r.w);
+        }
+        pxCopyKeyRect8(job->menu8, job->tar8, kVgaWidth, r.x, r.y, r.w, r.h, INDEX_TRANSPARENT);
+    }
+}
+
+void composePixels8(Uint8 *background, Uint8 *menu, Uint8 *tar, const std::vector<LDirtyRect> &rects)
+{
+    ComposeJob job;
+    job.src8 = background;
+    job.menu8 = menu;
+    job.tar8 = tar;
+    splitBands(rects, job.bands);
+    runBands(job, composeBands8);
+}
+
+void clearPixels(Uint32 *pixels)
+{
+#if (1)
+    fillPixels(pixels, setRGBA(0, 0, 0, 255));
+#else
+    fillPixels(pixels, setRGBA(112, 144, 0, 255));
+#endif
+}
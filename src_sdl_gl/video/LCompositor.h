@@ -0,0 +1,44 @@
+// CPU composition of the background and menu layers for SWOS 2020 rendering engine
+#ifndef LCOMPOSITOR_H
+#define LCOMPOSITOR_H
+
+#include <vector>
+#include <SDL.h>
+#include "LTexture.h"
+#include "LPixelOps.h"
+#include "LThreadPool.h"
+
+// Menu pixels with this index let the background through
+#define INDEX_TRANSPARENT 0
+
+// Rows per compositor task, a band of every layer stays in L2 cache
+#define BAND_ROWS 16
+
+// Logical size of every layer, layers are kVgaWidth pixels apart per row
+extern int kVgaWidth;
+extern int kVgaHeight;
+
+// Workers of the CPU compositor, one band of rows per task
+extern LThreadPool m_threadPool;
+
+// Test menu box redrawn with noise every frame (--menu-noise). Off, the
+// menu stays see-through and the updateTestMenuPixels calls change nothing.
+extern bool gMenuNoise;
+
+Uint32 setRGBA(Uint8 r, Uint8 g, Uint8 b, Uint8 a);
+void getRGBA(Uint32 color, Uint8 *r, Uint8 *g, Uint8 *b, Uint8 *a);
+
+// Whole-layer kernels
+void fillPixels(Uint32 *pixels, Uint32 color);
+void clearPixels(Uint32 *pixels);
+void initMenuPixels(Uint32 *pixels);
+void updateTestMenuPixels(Uint32 *pixels, LTexture *layer, int frame);
+void alphablendPixels(Uint32 *src1, Uint32 *src2, Uint32 *tar, int opacity, const std::vector<LDirtyRect> &rects);
+
+// 3-3-2 palette index layers
+void initPalette(Uint32 *palette, int brightness);
+void quantizePixels(Uint32 *src, Uint8 *dst, int count);
+void updateTestMenuPixels8(Uint8 *pixels, LTexture *layer);
+void composePixels8(Uint8 *background, Uint8 *menu, Uint8 *tar, const std::vector<LDirtyRect> &rects);
+
+#endif // LCOMPOSITOR_H
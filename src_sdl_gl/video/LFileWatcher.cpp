@@ -0,0 +1,176 @@
+// Change notification for a set of files
+#include "LFileWatcher.h"
+#include <sys/stat.h>
+#include <algorithm>
+
+#ifdef LWATCH_INOTIFY
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#endif
+
+LFileWatcher::LFileWatcher()
+{
+#ifdef LWATCH_INOTIFY
+    mFd = -1;
+#else
+    mLastPoll = 0;
+#endif
+}
+
+LFileWatcher::~LFileWatcher()
+{
+    freeWatcher();
+}
+
+bool LFileWatcher::init()
+{
+    freeWatcher();
+
+#ifdef LWATCH_INOTIFY
+    mFd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+    if( mFd < 0 )
+    {
+        printf( "Unable to create file watcher: %s\n", strerror( errno ) );
+        return false;
+    }
+#endif
+
+    return true;
+}
+
+void LFileWatcher::freeWatcher()
+{
+#ifdef LWATCH_INOTIFY
+    if( mFd >= 0 )
+    {
+        close( mFd );
+        mFd = -1;
+    }
+    mDirectories.clear();
+#else
+    mTimes.clear();
+#endif
+    mFiles.clear();
+}
+
+std::string LFileWatcher::directoryOf( const std::string& path )
+{
+    size_t slash = path.find_last_of( "/\\" );
+    return slash == std::string::npos ? "." : path.substr( 0, slash );
+}
+
+std::string LFileWatcher::fileOf( const std::string& path )
+{
+    size_t slash = path.find_last_of( "/\\" );
+    return slash == std::string::npos ? path : path.substr( slash + 1 );
+}
+
+Sint64 LFileWatcher::modificationTime( const std::string& path )
+{
+    struct stat info;
+    return stat( path.c_str(), &info ) == 0 ? (Sint64)info.st_mtime : -1;
+}
+
+bool LFileWatcher::watch( const std::string& path )
+{
+    std::string directory = directoryOf( path );
+
+#ifdef LWATCH_INOTIFY
+    if( mFd < 0 )
+    {
+        return false;
+    }
+
+    if( mFiles.find( directory ) == mFiles.end() )
+    {
+        //Writes in place and files renamed over the old one
+        int wd = inotify_add_watch( mFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO );
+        if( wd < 0 )
+        {
+            printf( "Unable to watch %s: %s\n", directory.c_str(), strerror( errno ) );
+            return false;
+        }
+        mDirectories[ wd ] = directory;
+    }
+#else
+    mTimes[ path ] = modificationTime( path );
+#endif
+
+    mFiles[ directory ][ fileOf( path ) ] = path;
+
+    return true;
+}
+
+void LFileWatcher::clear()
+{
+    for( std::map<std::string, std::map<std::string, std::string> >::iterator it = mFiles.begin(); it != mFiles.end(); ++it )
+    {
+        it->second.clear();
+    }
+#ifndef LWATCH_INOTIFY
+    mTimes.clear();
+#endif
+}
+
+bool LFileWatcher::poll( std::vector<std::string>& changed )
+{
+    changed.clear();
+
+#ifdef LWATCH_INOTIFY
+    if( mFd < 0 )
+    {
+        return false;
+    }
+
+    //Events are whole records, a buffer never ends inside one
+    char buffer[ 4096 ] __attribute__(( aligned( __alignof__( struct inotify_event ) ) ));
+    for( ;; )
+    {
+        ssize_t length = read( mFd, buffer, sizeof( buffer ) );
+        if( length <= 0 )
+        {
+            break;
+        }
+
+        for( char* at = buffer; at < buffer + length; )
+        {
+            const struct inotify_event* event = (const struct inotify_event*)at;
+            at += sizeof( struct inotify_event ) + event->len;
+
+            std::map<int, std::string>::iterator directory = mDirectories.find( event->wd );
+            if( event->len == 0 || directory == mDirectories.end() )
+            {
+                continue;
+            }
+
+            std::map<std::string, std::string>& files = mFiles[ directory->second ];
+            std::map<std::string, std::string>::iterator file = files.find( event->name );
+            if( file != files.end() && std::find( changed.begin(), changed.end(), file->second ) == changed.end() )
+            {
+                changed.push_back( file->second );
+            }
+        }
+    }
+#else
+    Uint32 now = SDL_GetTicks();
+    if( now - mLastPoll < LWATCH_POLL_MS )
+    {
+        return false;
+    }
+    mLastPoll = now;
+
+    for( std::map<std::string, Sint64>::iterator it = mTimes.begin(); it != mTimes.end(); ++it )
+    {
+        Sint64 time = modificationTime( it->first );
+        if( time != it->second )
+        {
+            it->second = time;
+            changed.push_back( it->first );
+        }
+    }
+#endif
+
+    return !changed.empty();
+}
@@ -0,0 +1,55 @@
+// Change notification for a set of files
+#ifndef LFILE_WATCHER_H
+#define LFILE_WATCHER_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <SDL.h>
+
+//inotify on Linux, modification times polled everywhere else
+#if defined(__linux__)
+#define LWATCH_INOTIFY 1
+#endif
+
+//Milliseconds between modification time checks without inotify
+#define LWATCH_POLL_MS 250
+
+class LFileWatcher
+{
+    public:
+        LFileWatcher();
+        ~LFileWatcher();
+
+        bool init();
+        void freeWatcher();
+
+        //Reports writes to 'path'. Its directory is watched rather than the
+        //file, so editors that save by replacing the file are seen too.
+        bool watch( const std::string& path );
+
+        //Forgets every file, directories stay watched
+        void clear();
+
+        //Files changed since the last call, each once, without blocking
+        bool poll( std::vector<std::string>& changed );
+
+    private:
+        static std::string directoryOf( const std::string& path );
+        static std::string fileOf( const std::string& path );
+        static Sint64 modificationTime( const std::string& path );
+
+        //Watched path by directory and file name
+        std::map<std::string, std::map<std::string, std::string> > mFiles;
+
+#ifdef LWATCH_INOTIFY
+        int mFd;
+        std::map<int, std::string> mDirectories;
+#else
+        std::map<std::string, Sint64> mTimes;
+        Uint32 mLastPoll;
+#endif
+};
+
+#endif
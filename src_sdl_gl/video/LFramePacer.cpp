@@ -0,0 +1,252 @@
+// Frame pacing: swap interval, frame rate limit and latency-aware scheduling
+#include "LFramePacer.h"
+#include <algorithm>
+
+LFramePacer::LFramePacer()
+{
+    mMode = LPACE_UNCAPPED;
+    mRate = 60.0;
+    mLatencyTarget = 0.0;
+    mFrequency = 1;
+    mPeriod = 1;
+    mDeadline = 0;
+    mFrameStart = 0;
+    mSwapStart = 0;
+    mLastSwap = 0;
+    mWorkCount = 0;
+    mWorkIndex = 0;
+    mFrames = 0;
+    mMissed = 0;
+    mWaitedMs = 0.0;
+}
+
+bool LFramePacer::init( int mode, double rate, double refresh )
+{
+    if( refresh <= 0.0 )
+    {
+        refresh = 60.0;
+    }
+
+    mMode = mode;
+    mRate = mode == LPACE_FIXED && rate > 0.0 ? rate : refresh;
+    bool success = true;
+
+    //Without a GL context the caller asks its renderer for vsync
+    if( SDL_GL_GetCurrentContext() != NULL )
+    {
+        int interval = mMode == LPACE_VSYNC ? 1 : ( mMode == LPACE_ADAPTIVE ? -1 : 0 );
+        success = SDL_GL_SetSwapInterval( interval ) == 0;
+        if( !success && mMode == LPACE_ADAPTIVE )
+        {
+            printf( "Adaptive vsync not supported, using vsync. SDL Error: %s\n", SDL_GetError() );
+            mMode = LPACE_VSYNC;
+            success = SDL_GL_SetSwapInterval( 1 ) == 0;
+        }
+
+        if( !success && mMode == LPACE_VSYNC )
+        {
+            //Still keep the loop from spinning
+            printf( "Vsync not available, pacing at %g Hz instead. SDL Error: %s\n", refresh, SDL_GetError() );
+            mMode = LPACE_FIXED;
+            SDL_GL_SetSwapInterval( 0 );
+        }
+    }
+
+    mFrequency = SDL_GetPerformanceFrequency();
+    mPeriod = (Uint64)( mFrequency / mRate );
+    mDeadline = 0;
+    mLastSwap = 0;
+    mWorkCount = 0;
+    mWorkIndex = 0;
+    mFrames = 0;
+    mMissed = 0;
+    mWaitedMs = 0.0;
+
+    return success;
+}
+
+int LFramePacer::mode()
+{
+    return mMode;
+}
+
+const char* LFramePacer::modeName()
+{
+    switch( mMode )
+    {
+        case LPACE_VSYNC:
+            return "vsync";
+        case LPACE_ADAPTIVE:
+            return "adaptive vsync";
+        case LPACE_FIXED:
+            return "fixed rate";
+    }
+    return "uncapped";
+}
+
+double LFramePacer::rate()
+{
+    return mRate;
+}
+
+void LFramePacer::setLatencyTarget( double ms )
+{
+    mLatencyTarget = ms > 0.0 ? ms : 0.0;
+}
+
+Uint64 LFramePacer::toTicks( double ms )
+{
+    return (Uint64)( ms * mFrequency / 1000.0 );
+}
+
+double LFramePacer::toMs( Uint64 ticks )
+{
+    return ticks * 1000.0 / mFrequency;
+}
+
+void LFramePacer::sleepUntil( Uint64 target )
+{
+    for( ;; )
+    {
+        Uint64 now = SDL_GetPerformanceCounter();
+        if( now >= target )
+        {
+            return;
+        }
+
+        double left = toMs( target - now );
+        if( left > LPACE_SPIN_MS )
+        {
+            SDL_Delay( (Uint32)( left - LPACE_SPIN_MS ) );
+        }
+    }
+}
+
+void LFramePacer::waitForFrame()
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+
+    //Start late enough that input and composition are as fresh as they
+    //can be, early enough that the frame still makes its deadline
+    if( mMode != LPACE_UNCAPPED && mDeadline != 0 )
+    {
+        double lead = std::max( mLatencyTarget, workTime() + LPACE_SLACK_MS );
+        Uint64 leadTicks = toTicks( lead );
+        if( mDeadline > now + leadTicks )
+        {
+            //Work is timed from the planned start, an oversleep counts
+            //against the frame and the next one starts that much earlier
+            Uint64 start = mDeadline - leadTicks;
+            sleepUntil( start );
+            mWaitedMs += toMs( start - now );
+            now = start;
+        }
+    }
+
+    mFrameStart = now;
+}
+
+void LFramePacer::beginSwap()
+{
+    mSwapStart = SDL_GetPerformanceCounter();
+
+    mWork[ mWorkIndex ] = (float)toMs( mSwapStart - mFrameStart );
+    mWorkIndex = ( mWorkIndex + 1 ) % LPACE_HISTORY;
+    if( mWorkCount < LPACE_HISTORY )
+    {
+        mWorkCount++;
+    }
+}
+
+void LFramePacer::endSwap()
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    mFrames++;
+
+    if( mMode == LPACE_UNCAPPED )
+    {
+        mLastSwap = now;
+        return;
+    }
+
+    if( mDeadline == 0 )
+    {
+        mDeadline = now + mPeriod;
+    }
+    else if( mMode == LPACE_FIXED )
+    {
+        if( now > mDeadline )
+        {
+            mMissed++;
+        }
+
+        //Keep the cadence, unless a stall put the schedule in the past
+        mDeadline += mPeriod;
+        if( mDeadline <= now )
+        {
+            mDeadline = now + mPeriod;
+        }
+    }
+    else
+    {
+        //A blocking swap returns at the vblank. The prediction follows its
+        //phase slowly, so one late wake-up does not move the schedule, and
+        //jumps back onto it after a frame that caught a later vblank.
+        Sint64 error = (Sint64)( now - mDeadline );
+        Sint64 half = (Sint64)( mPeriod / 2 );
+        if( error > half )
+        {
+            mMissed++;
+        }
+
+        if( error > -half && error < half )
+        {
+            mDeadline += error / 8 + mPeriod;
+        }
+        else
+        {
+            mDeadline = now + mPeriod;
+        }
+    }
+
+    mLastSwap = now;
+}
+
+double LFramePacer::workTime()
+{
+    if( mWorkCount == 0 )
+    {
+        return 0.0;
+    }
+
+    float sorted[ LPACE_HISTORY ];
+    std::copy( mWork, mWork + mWorkCount, sorted );
+    int index = ( mWorkCount - 1 ) * LPACE_WORK_PERCENTILE / 100;
+    std::nth_element( sorted, sorted + index, sorted + mWorkCount );
+    return sorted[ index ];
+}
+
+Uint64 LFramePacer::frames()
+{
+    return mFrames;
+}
+
+Uint64 LFramePacer::missed()
+{
+    return mMissed;
+}
+
+void LFramePacer::report()
+{
+    if( mFrames == 0 )
+    {
+        return;
+    }
+
+    printf( "Frame pacing: %s at %.2f Hz, %llu frames", modeName(), mRate, (unsigned long long)mFrames );
+    if( mMode != LPACE_UNCAPPED )
+    {
+        printf( ", %llu missed deadlines, %.2f ms waited per frame", (unsigned long long)mMissed, mWaitedMs / mFrames );
+    }
+    printf( ", work p%d %.2f ms\n", LPACE_WORK_PERCENTILE, workTime() );
+}
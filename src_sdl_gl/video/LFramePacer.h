@@ -0,0 +1,89 @@
+// Frame pacing: swap interval, frame rate limit and latency-aware scheduling
+#ifndef LFRAME_PACER_H
+#define LFRAME_PACER_H
+
+#include <stdio.h>
+#include <string>
+#include <SDL.h>
+
+//Pacing modes
+#define LPACE_VSYNC    0   //Swap interval 1
+#define LPACE_ADAPTIVE 1   //Swap interval -1, late frames tear instead of waiting
+#define LPACE_FIXED    2   //Swap interval 0, frames released at a set rate
+#define LPACE_UNCAPPED 3   //Swap interval 0, no waiting
+
+//Frames of work times the schedule is estimated from
+#define LPACE_HISTORY 120
+
+//Percentile of recent work times a frame is budgeted for
+#define LPACE_WORK_PERCENTILE 95
+
+//Milliseconds kept spare between the budgeted end of a frame and its deadline
+#define LPACE_SLACK_MS 1.0
+
+//Last stretch of a wait spent polling the counter, SDL_Delay() oversleeps
+#define LPACE_SPIN_MS 1.5
+
+class LFramePacer
+{
+    public:
+        LFramePacer();
+
+        //Sets the swap interval of the current GL context, if there is one.
+        //'rate' is the LPACE_FIXED frame rate, 'refresh' the display's, 0 if
+        //unknown. Vsync modes the driver refuses fall back to fixed rate.
+        bool init( int mode, double rate, double refresh );
+        int mode();
+        const char* modeName();
+        double rate();
+
+        //Lead time the scheduler keeps at least between the start of a
+        //frame and its deadline, in milliseconds. 0 leaves it to the
+        //measured work time alone.
+        void setLatencyTarget( double ms );
+
+        //Sleeps until the next frame should start, so that it finishes just
+        //before the predicted vblank or fixed rate deadline
+        void waitForFrame();
+
+        //Around the swap or present call; the time in between is not work
+        void beginSwap();
+        void endSwap();
+
+        //Milliseconds from the start of a frame to its swap, percentile over
+        //the recent history
+        double workTime();
+
+        Uint64 frames();
+        Uint64 missed();
+        void report();
+
+    private:
+        Uint64 toTicks( double ms );
+        double toMs( Uint64 ticks );
+        void sleepUntil( Uint64 target );
+
+        int mMode;
+        double mRate;
+        double mLatencyTarget;
+
+        Uint64 mFrequency;
+        Uint64 mPeriod;
+
+        //Predicted time of the next vblank or release, 0 until the first swap
+        Uint64 mDeadline;
+        Uint64 mFrameStart;
+        Uint64 mSwapStart;
+        Uint64 mLastSwap;
+
+        //Ring of work times in ms
+        float mWork[ LPACE_HISTORY ];
+        int mWorkCount;
+        int mWorkIndex;
+
+        Uint64 mFrames;
+        Uint64 mMissed;
+        double mWaitedMs;
+};
+
+#endif
@@ -0,0 +1,159 @@
+// Ring of CPU frame buffers passed from a compositor thread to the GL thread
+#include "LFrameQueue.h"
+
+LFrameQueue::LFrameQueue()
+{
+    mWriteIndex = 0;
+    mReadIndex = 0;
+    mStopped = false;
+    mLock = NULL;
+    mChanged = NULL;
+}
+
+LFrameQueue::~LFrameQueue()
+{
+    //Free buffers if they exist
+    freeQueue();
+}
+
+bool LFrameQueue::init( int depth, GLuint width, GLuint height, GLuint bytesPerPixel )
+{
+    freeQueue();
+
+    if( depth < 1 || depth > LFRAME_QUEUE_MAX_DEPTH )
+    {
+        printf( "Frame queue depth %d out of range 1..%d\n", depth, LFRAME_QUEUE_MAX_DEPTH );
+        return false;
+    }
+
+    mLock = SDL_CreateMutex();
+    mChanged = SDL_CreateCond();
+    mStopped = false;
+    mWriteIndex = 0;
+    mReadIndex = 0;
+
+    //Every buffer starts out entirely stale
+    LDirtyRect frame;
+    frame.x = 0;
+    frame.y = 0;
+    frame.w = width;
+    frame.h = height;
+
+    mSlots.resize( depth );
+    for( int i = 0; i < depth; ++i )
+    {
+        mSlots[ i ].pixels = new GLubyte[ width * height * bytesPerPixel ];
+        mSlots[ i ].state = LFRAME_FREE;
+        mSlots[ i ].pending.assign( 1, frame );
+        mSlots[ i ].changed.clear();
+    }
+
+    printf( "Frame queue: %d buffers of %dx%d\n", depth, width, height );
+
+    return true;
+}
+
+void LFrameQueue::freeQueue()
+{
+    if( mLock == NULL )
+    {
+        return;
+    }
+
+    stop();
+
+    for( size_t i = 0; i < mSlots.size(); ++i )
+    {
+        delete[] mSlots[ i ].pixels;
+    }
+    mSlots.clear();
+
+    SDL_DestroyCond( mChanged );
+    SDL_DestroyMutex( mLock );
+    mChanged = NULL;
+    mLock = NULL;
+}
+
+int LFrameQueue::depth()
+{
+    return (int)mSlots.size();
+}
+
+LFrameSlot* LFrameQueue::acquireFree()
+{
+    SDL_LockMutex( mLock );
+    while( !mStopped && mSlots[ mWriteIndex ].state != LFRAME_FREE )
+    {
+        SDL_CondWait( mChanged, mLock );
+    }
+
+    LFrameSlot* slot = NULL;
+    if( !mStopped )
+    {
+        slot = &mSlots[ mWriteIndex ];
+        slot->state = LFRAME_COMPOSING;
+        mWriteIndex = ( mWriteIndex + 1 ) % mSlots.size();
+    }
+    SDL_UnlockMutex( mLock );
+
+    return slot;
+}
+
+void LFrameQueue::invalidate( const std::vector<LDirtyRect>& rects )
+{
+    //Pending lists are only touched by the producer
+    for( size_t i = 0; i < mSlots.size(); ++i )
+    {
+        mSlots[ i ].pending.insert( mSlots[ i ].pending.end(), rects.begin(), rects.end() );
+    }
+}
+
+void LFrameQueue::submit( LFrameSlot* slot, const std::vector<LDirtyRect>& changed )
+{
+    SDL_LockMutex( mLock );
+    slot->changed = changed;
+    slot->state = LFRAME_READY;
+    SDL_CondBroadcast( mChanged );
+    SDL_UnlockMutex( mLock );
+}
+
+LFrameSlot* LFrameQueue::acquireReady()
+{
+    SDL_LockMutex( mLock );
+    while( !mStopped && mSlots[ mReadIndex ].state != LFRAME_READY )
+    {
+        SDL_CondWait( mChanged, mLock );
+    }
+
+    LFrameSlot* slot = NULL;
+    if( !mStopped )
+    {
+        slot = &mSlots[ mReadIndex ];
+        slot->state = LFRAME_READING;
+        mReadIndex = ( mReadIndex + 1 ) % mSlots.size();
+    }
+    SDL_UnlockMutex( mLock );
+
+    return slot;
+}
+
+void LFrameQueue::release( LFrameSlot* slot )
+{
+    SDL_LockMutex( mLock );
+    slot->state = LFRAME_FREE;
+    SDL_CondBroadcast( mChanged );
+    SDL_UnlockMutex( mLock );
+}
+
+void LFrameQueue::stop()
+{
+    if( mLock == NULL )
+    {
+        return;
+    }
+
+    SDL_LockMutex( mLock );
+    mStopped = true;
+    SDL_CondBroadcast( mChanged );
+    SDL_UnlockMutex( mLock );
+}
@@ -0,0 +1,65 @@
+// Ring of CPU frame buffers passed from a compositor thread to the GL thread
+#ifndef LFRAME_QUEUE_H
+#define LFRAME_QUEUE_H
+
+#include "LTexture.h"
+#include <stdio.h>
+#include <vector>
+#include <SDL.h>
+
+//Most frames in flight between compositor and GL thread
+#define LFRAME_QUEUE_MAX_DEPTH 4
+
+//Slot states
+#define LFRAME_FREE      0
+#define LFRAME_COMPOSING 1
+#define LFRAME_READY     2
+#define LFRAME_READING   3
+
+struct LFrameSlot
+{
+    GLubyte* pixels;
+    int state;
+
+    //Areas changed since this buffer was last composed, producer only
+    std::vector<LDirtyRect> pending;
+
+    //Areas that differ from the previous frame, to be uploaded
+    std::vector<LDirtyRect> changed;
+};
+
+class LFrameQueue
+{
+    public:
+        LFrameQueue();
+        ~LFrameQueue();
+
+        //'depth' buffers of width x height pixels, 2 double, 3 triple buffered
+        bool init( int depth, GLuint width, GLuint height, GLuint bytesPerPixel );
+        void freeQueue();
+        int depth();
+
+        //Producer: next buffer to compose, NULL once stopped
+        LFrameSlot* acquireFree();
+        //Producer: mark an area changed in every buffer
+        void invalidate( const std::vector<LDirtyRect>& rects );
+        void submit( LFrameSlot* slot, const std::vector<LDirtyRect>& changed );
+
+        //Consumer: oldest composed buffer, NULL once stopped
+        LFrameSlot* acquireReady();
+        void release( LFrameSlot* slot );
+
+        //Wakes both sides, acquire calls return NULL from now on
+        void stop();
+
+    private:
+        std::vector<LFrameSlot> mSlots;
+        int mWriteIndex;
+        int mReadIndex;
+        bool mStopped;
+
+        SDL_mutex* mLock;
+        SDL_cond* mChanged;
+};
+
+#endif
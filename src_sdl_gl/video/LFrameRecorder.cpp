@@ -0,0 +1,670 @@
+// Frame capture streamed to disk by a writer thread
+#include "LFrameRecorder.h"
+#include <string.h>
+#include <math.h>
+
+LFrameRecorder::LFrameRecorder()
+{
+    mFormat = LRECORD_RAW;
+    mWidth = 0;
+    mHeight = 0;
+    mStart = 0;
+    mCapture = 0;
+    mCollect = 0;
+    mWrite = 0;
+    mReady = NULL;
+    SDL_AtomicSet( &mQuit, 0 );
+    mWriter = NULL;
+    mFile = NULL;
+    mWritten = 0;
+    mBytes = 0;
+    mWriteMs = 0.0;
+    mFailed = false;
+    mDropped = 0;
+    mCaptured = 0;
+}
+
+LFrameRecorder::~LFrameRecorder()
+{
+    stop();
+}
+
+bool LFrameRecorder::start( const std::string& path, GLint width, GLint height, double rate, int slots )
+{
+    stop();
+
+    if( width <= 0 || height <= 0 || slots < 2 )
+    {
+        return false;
+    }
+
+    mFormat = path.size() > 4 && path.substr( path.size() - 4 ) == ".y4m" ? LRECORD_Y4M : LRECORD_RAW;
+    mFile = fopen( path.c_str(), "wb" );
+    if( mFile == NULL )
+    {
+        printf( "Unable to open %s for recording!\n", path.c_str() );
+        return false;
+    }
+
+    //Whole frame rates are kept exact, others to a thousandth
+    Uint32 numerator = (Uint32)rate;
+    Uint32 denominator = 1;
+    if( rate <= 0.0 )
+    {
+        numerator = 60;
+    }
+    else if( numerator != rate )
+    {
+        numerator = (Uint32)floor( rate * 1000.0 + 0.5 );
+        denominator = 1000;
+    }
+
+    bool written;
+    if( mFormat == LRECORD_Y4M )
+    {
+        written = fprintf( mFile, "YUV4MPEG2 W%d H%d F%u:%u Ip A1:1 C444\n", width, height, numerator, denominator ) > 0;
+    }
+    else
+    {
+        LRecordHeader header;
+        memset( &header, 0, sizeof( header ) );
+        memcpy( header.magic, LRECORD_MAGIC, 4 );
+        header.version = LRECORD_VERSION;
+        header.width = width;
+        header.height = height;
+        header.rateNumerator = numerator;
+        header.rateDenominator = denominator;
+        written = fwrite( &header, sizeof( header ), 1, mFile ) == 1;
+    }
+    if( !written )
+    {
+        printf( "Unable to write %s!\n", path.c_str() );
+        fclose( mFile );
+        mFile = NULL;
+        return false;
+    }
+
+    mPath = path;
+    mWidth = width;
+    mHeight = height;
+    mWritten = 0;
+    mBytes = 0;
+    mWriteMs = 0.0;
+    mFailed = false;
+    mDropped = 0;
+    mCaptured = 0;
+
+    //Buffers are made by the first capture that needs them
+    mSlots.resize( slots );
+    for( int i = 0; i < slots; ++i )
+    {
+        LRecordSlot& slot = mSlots[ i ];
+        SDL_AtomicSet( &slot.state, LRECORD_FREE );
+        slot.pbo = 0;
+        slot.fence = 0;
+        slot.mapped = NULL;
+        slot.pixels = NULL;
+        slot.bottomUp = false;
+        slot.time = 0;
+    }
+    mCapture = 0;
+    mCollect = 0;
+    mWrite = 0;
+
+    mPrevious.assign( width * height, 0 );
+    mEncoded.resize( 2 * width * height + 2 );
+    if( mFormat == LRECORD_Y4M )
+    {
+        mPlanes.resize( 3 * width * height );
+    }
+
+    mReady = SDL_CreateSemaphore( 0 );
+    SDL_AtomicSet( &mQuit, 0 );
+    mWriter = SDL_CreateThread( writerMain, "frame recorder", this );
+    if( mWriter == NULL )
+    {
+        printf( "Unable to create frame recorder thread! SDL Error: %s\n", SDL_GetError() );
+        stop();
+        return false;
+    }
+
+    mStart = SDL_GetPerformanceCounter();
+    printf( "Recording %dx%d frames to %s\n", width, height, path.c_str() );
+
+    return true;
+}
+
+void LFrameRecorder::stop()
+{
+    if( mWriter != NULL )
+    {
+        //Everything captured so far reaches the file
+        collect( true );
+
+        //Posted after every frame, the writer has taken them all when it
+        //finds no ready slot
+        SDL_AtomicSet( &mQuit, 1 );
+        SDL_SemPost( mReady );
+        SDL_WaitThread( mWriter, NULL );
+        mWriter = NULL;
+    }
+
+    releaseSlots();
+
+    if( mReady != NULL )
+    {
+        SDL_DestroySemaphore( mReady );
+        mReady = NULL;
+    }
+
+    if( mFile != NULL )
+    {
+        if( fclose( mFile ) != 0 )
+        {
+            mFailed = true;
+        }
+        mFile = NULL;
+    }
+
+    mPrevious.clear();
+    mEncoded.clear();
+    mPlanes.clear();
+}
+
+void LFrameRecorder::releaseSlots()
+{
+    //Only frame buffer captures made GL objects, CPU ones need no context
+    bool buffers = false;
+    for( size_t i = 0; i < mSlots.size(); ++i )
+    {
+        LRecordSlot& slot = mSlots[ i ];
+        if( slot.fence != 0 )
+        {
+            glDeleteSync( slot.fence );
+            slot.fence = 0;
+        }
+        if( slot.pbo != 0 )
+        {
+            buffers = true;
+            if( slot.mapped != NULL )
+            {
+                glBindBuffer( GL_PIXEL_PACK_BUFFER, slot.pbo );
+                glUnmapBuffer( GL_PIXEL_PACK_BUFFER );
+                slot.mapped = NULL;
+            }
+            glDeleteBuffers( 1, &slot.pbo );
+            slot.pbo = 0;
+        }
+    }
+    if( buffers )
+    {
+        glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+    }
+    mSlots.clear();
+}
+
+bool LFrameRecorder::recording()
+{
+    return mWriter != NULL;
+}
+
+GLint LFrameRecorder::width()
+{
+    return mWidth;
+}
+
+GLint LFrameRecorder::height()
+{
+    return mHeight;
+}
+
+Uint64 LFrameRecorder::written()
+{
+    return mWritten;
+}
+
+Uint64 LFrameRecorder::dropped()
+{
+    return mDropped;
+}
+
+LRecordSlot* LFrameRecorder::acquire()
+{
+    //The writer is behind, the frame is lost rather than waited for
+    LRecordSlot* slot = &mSlots[ mCapture ];
+    if( SDL_AtomicGet( &slot->state ) != LRECORD_FREE )
+    {
+        ++mDropped;
+        return NULL;
+    }
+
+    mCapture = ( mCapture + 1 ) % (int)mSlots.size();
+    ++mCaptured;
+    slot->time = (Uint64)( ( SDL_GetPerformanceCounter() - mStart ) * 1000000.0 / SDL_GetPerformanceFrequency() );
+
+    return slot;
+}
+
+bool LFrameRecorder::captureFramebuffer( GLuint framebufferID )
+{
+    if( mWriter == NULL )
+    {
+        return false;
+    }
+
+    collect();
+    LRecordSlot* slot = acquire();
+    if( slot == NULL )
+    {
+        return false;
+    }
+
+    GLsizeiptr bytes = mWidth * mHeight * 4;
+    if( slot->pbo == 0 )
+    {
+        //Persistent mapping needs ARB_buffer_storage, the writer reads
+        //straight from it; otherwise each frame is mapped and copied
+        glGenBuffers( 1, &slot->pbo );
+        glBindBuffer( GL_PIXEL_PACK_BUFFER, slot->pbo );
+        if( GLEW_ARB_buffer_storage )
+        {
+            GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage( GL_PIXEL_PACK_BUFFER, bytes, NULL, flags );
+            slot->mapped = glMapBufferRange( GL_PIXEL_PACK_BUFFER, 0, bytes, flags );
+        }
+        else
+        {
+            glBufferData( GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_READ );
+        }
+    }
+
+    GLint readFramebuffer = 0;
+    glGetIntegerv( GL_READ_FRAMEBUFFER_BINDING, &readFramebuffer );
+    glBindFramebuffer( GL_READ_FRAMEBUFFER, framebufferID );
+    glReadBuffer( framebufferID == 0 ? GL_BACK : GL_COLOR_ATTACHMENT0 );
+
+    //Returns once the copy is queued, the fence tells when it is done
+    glBindBuffer( GL_PIXEL_PACK_BUFFER, slot->pbo );
+    glReadPixels( 0, 0, mWidth, mHeight, GL_RGBA, GL_UNSIGNED_BYTE, NULL );
+    slot->fence = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+    glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+
+    glBindFramebuffer( GL_READ_FRAMEBUFFER, readFramebuffer );
+
+    slot->pixels = (const Uint32*)slot->mapped;
+    slot->bottomUp = true;
+    SDL_AtomicSet( &slot->state, LRECORD_PENDING );
+
+    return true;
+}
+
+bool LFrameRecorder::capturePixels32( const Uint32* pixels )
+{
+    if( mWriter == NULL )
+    {
+        return false;
+    }
+
+    collect();
+    LRecordSlot* slot = acquire();
+    if( slot == NULL )
+    {
+        return false;
+    }
+
+    slot->copy.assign( pixels, pixels + mWidth * mHeight );
+    slot->pixels = &slot->copy[ 0 ];
+    slot->bottomUp = false;
+    SDL_AtomicSet( &slot->state, LRECORD_PENDING );
+
+    //Nothing to wait for unless frames before it are
+    collect();
+
+    return true;
+}
+
+bool LFrameRecorder::capturePixels8( const Uint8* indices, const Uint32* palette )
+{
+    if( mWriter == NULL )
+    {
+        return false;
+    }
+
+    collect();
+    LRecordSlot* slot = acquire();
+    if( slot == NULL )
+    {
+        return false;
+    }
+
+    int count = mWidth * mHeight;
+    slot->copy.resize( count );
+    for( int i = 0; i < count; ++i )
+    {
+        slot->copy[ i ] = palette[ indices[ i ] ];
+    }
+    slot->pixels = &slot->copy[ 0 ];
+    slot->bottomUp = false;
+    SDL_AtomicSet( &slot->state, LRECORD_PENDING );
+
+    collect();
+
+    return true;
+}
+
+void LFrameRecorder::collect( bool wait )
+{
+    if( mWriter == NULL )
+    {
+        return;
+    }
+
+    //In capture order, a copy still in flight holds back those after it
+    for( ;; )
+    {
+        LRecordSlot& slot = mSlots[ mCollect ];
+        if( SDL_AtomicGet( &slot.state ) != LRECORD_PENDING )
+        {
+            break;
+        }
+
+        if( slot.fence != 0 )
+        {
+            GLenum result = glClientWaitSync( slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? GL_TIMEOUT_IGNORED : 0 );
+            if( result == GL_TIMEOUT_EXPIRED )
+            {
+                break;
+            }
+            glDeleteSync( slot.fence );
+            slot.fence = 0;
+
+            if( slot.mapped == NULL )
+            {
+                GLsizeiptr bytes = mWidth * mHeight * 4;
+                glBindBuffer( GL_PIXEL_PACK_BUFFER, slot.pbo );
+                const void* mapped = glMapBufferRange( GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT );
+                if( mapped != NULL )
+                {
+                    slot.copy.resize( mWidth * mHeight );
+                    memcpy( &slot.copy[ 0 ], mapped, bytes );
+                    glUnmapBuffer( GL_PIXEL_PACK_BUFFER );
+                }
+                else
+                {
+                    slot.copy.assign( mWidth * mHeight, 0 );
+                }
+                glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+                slot.pixels = &slot.copy[ 0 ];
+            }
+        }
+
+        SDL_AtomicSet( &slot.state, LRECORD_READY );
+        SDL_SemPost( mReady );
+        mCollect = ( mCollect + 1 ) % (int)mSlots.size();
+    }
+}
+
+int LFrameRecorder::writerMain( void* data )
+{
+    LFrameRecorder* recorder = (LFrameRecorder*)data;
+
+    for( ;; )
+    {
+        SDL_SemWait( recorder->mReady );
+
+        LRecordSlot& slot = recorder->mSlots[ recorder->mWrite ];
+        if( SDL_AtomicGet( &slot.state ) != LRECORD_READY )
+        {
+            if( SDL_AtomicGet( &recorder->mQuit ) != 0 )
+            {
+                break;
+            }
+            continue;
+        }
+
+        Uint64 start = SDL_GetPerformanceCounter();
+        recorder->writeFrame( slot );
+        recorder->mWriteMs += ( SDL_GetPerformanceCounter() - start ) * 1000.0 / SDL_GetPerformanceFrequency();
+
+        SDL_AtomicSet( &slot.state, LRECORD_FREE );
+        recorder->mWrite = ( recorder->mWrite + 1 ) % (int)recorder->mSlots.size();
+    }
+
+    return 0;
+}
+
+void LFrameRecorder::writeFrame( const LRecordSlot& slot )
+{
+    //A full disk ends the recording, frames are still taken off the ring
+    if( mFailed )
+    {
+        return;
+    }
+
+    if( mFormat == LRECORD_Y4M )
+    {
+        writeY4M( slot );
+    }
+    else
+    {
+        writeRaw( slot );
+    }
+
+    if( ferror( mFile ) )
+    {
+        printf( "Unable to write %s, recording stopped!\n", mPath.c_str() );
+        mFailed = true;
+        return;
+    }
+    ++mWritten;
+}
+
+void LFrameRecorder::writeRaw( const LRecordSlot& slot )
+{
+    LRecordFrame frame;
+    frame.type = mWritten % LRECORD_KEY_INTERVAL == 0 ? LRECORD_KEY : LRECORD_DELTA;
+    frame.time = slot.time;
+    if( frame.type == LRECORD_KEY )
+    {
+        memset( &mPrevious[ 0 ], 0, mPrevious.size() * sizeof( Uint32 ) );
+    }
+
+    //Every run of literals is preceded by at least one unchanged pixel
+    //except the first, so a frame never takes more than twice its words
+    Uint32* out = &mEncoded[ 0 ];
+    Uint32* run = out;
+    run[ 0 ] = 0;
+    run[ 1 ] = 0;
+    out += 2;
+
+    Uint32* previous = &mPrevious[ 0 ];
+    for( GLint y = 0; y < mHeight; ++y )
+    {
+        const Uint32* row = slot.pixels + ( slot.bottomUp ? mHeight - 1 - y : y ) * mWidth;
+        for( GLint x = 0; x < mWidth; ++x )
+        {
+            Uint32 delta = row[ x ] ^ *previous;
+            *previous++ = row[ x ];
+
+            if( delta == 0 )
+            {
+                if( run[ 1 ] != 0 )
+                {
+                    run = out;
+                    run[ 0 ] = 0;
+                    run[ 1 ] = 0;
+                    out += 2;
+                }
+                ++run[ 0 ];
+            }
+            else
+            {
+                *out++ = delta;
+                ++run[ 1 ];
+            }
+        }
+    }
+
+    frame.words = (Uint32)( out - &mEncoded[ 0 ] );
+    fwrite( &frame, sizeof( frame ), 1, mFile );
+    fwrite( &mEncoded[ 0 ], sizeof( Uint32 ), frame.words, mFile );
+    mBytes += sizeof( frame ) + frame.words * sizeof( Uint32 );
+}
+
+void LFrameRecorder::writeY4M( const LRecordSlot& slot )
+{
+    //BT.601 studio range, the colour space Y4M readers assume
+    int count = mWidth * mHeight;
+    for( GLint y = 0; y < mHeight; ++y )
+    {
+        const Uint32* row = slot.pixels + ( slot.bottomUp ? mHeight - 1 - y : y ) * mWidth;
+        Uint8* planeY = &mPlanes[ y * mWidth ];
+        Uint8* planeU = planeY + count;
+        Uint8* planeV = planeU + count;
+        for( GLint x = 0; x < mWidth; ++x )
+        {
+            Uint32 pixel = row[ x ];
+            int r = pixel & 255;
+            int g = ( pixel >> 8 ) & 255;
+            int b = ( pixel >> 16 ) & 255;
+            planeY[ x ] = (Uint8)( ( ( 66 * r + 129 * g + 25 * b + 128 ) >> 8 ) + 16 );
+            planeU[ x ] = (Uint8)( ( ( -38 * r - 74 * g + 112 * b + 128 ) >> 8 ) + 128 );
+            planeV[ x ] = (Uint8)( ( ( 112 * r - 94 * g - 18 * b + 128 ) >> 8 ) + 128 );
+        }
+    }
+
+    fputs( "FRAME\n", mFile );
+    fwrite( &mPlanes[ 0 ], 1, mPlanes.size(), mFile );
+    mBytes += 6 + mPlanes.size();
+}
+
+void LFrameRecorder::report()
+{
+    if( mCaptured == 0 && mDropped == 0 )
+    {
+        return;
+    }
+
+    printf( "Recorded %llu frames to %s, %llu dropped", (unsigned long long)mWritten, mPath.c_str(), (unsigned long long)mDropped );
+    if( mWritten > 0 )
+    {
+        double raw = (double)mWritten * mWidth * mHeight * 4;
+        printf( ", %.1f MB (%.2f:1), %.2f ms written per frame", mBytes / 1048576.0, raw / mBytes, mWriteMs / mWritten );
+    }
+    printf( "\n" );
+}
+
+LRecordReader::LRecordReader()
+{
+    mFile = NULL;
+    memset( &mHeader, 0, sizeof( mHeader ) );
+}
+
+LRecordReader::~LRecordReader()
+{
+    close();
+}
+
+bool LRecordReader::open( const std::string& path )
+{
+    close();
+
+    mFile = fopen( path.c_str(), "rb" );
+    if( mFile == NULL )
+    {
+        printf( "Unable to open recording %s!\n", path.c_str() );
+        return false;
+    }
+
+    if( fread( &mHeader, sizeof( mHeader ), 1, mFile ) != 1 ||
+        memcmp( mHeader.magic, LRECORD_MAGIC, 4 ) != 0 ||
+        mHeader.version != LRECORD_VERSION ||
+        mHeader.width == 0 || mHeader.height == 0 )
+    {
+        printf( "%s is not a recording of this version!\n", path.c_str() );
+        close();
+        return false;
+    }
+
+    mFrame.assign( mHeader.width * mHeader.height, 0 );
+    return true;
+}
+
+void LRecordReader::close()
+{
+    if( mFile != NULL )
+    {
+        fclose( mFile );
+        mFile = NULL;
+    }
+    memset( &mHeader, 0, sizeof( mHeader ) );
+    mFrame.clear();
+    mPayload.clear();
+}
+
+GLint LRecordReader::width()
+{
+    return mHeader.width;
+}
+
+GLint LRecordReader::height()
+{
+    return mHeader.height;
+}
+
+double LRecordReader::rate()
+{
+    return mHeader.rateDenominator == 0 ? 0.0 : (double)mHeader.rateNumerator / mHeader.rateDenominator;
+}
+
+bool LRecordReader::next( Uint32* pixels, Uint64* time )
+{
+    LRecordFrame frame;
+    if( mFile == NULL || fread( &frame, sizeof( frame ), 1, mFile ) != 1 )
+    {
+        return false;
+    }
+
+    size_t count = mFrame.size();
+    if( frame.words > 2 * count + 2 )
+    {
+        printf( "Damaged recording frame!\n" );
+        return false;
+    }
+    mPayload.resize( frame.words );
+    if( frame.words > 0 && fread( &mPayload[ 0 ], sizeof( Uint32 ), frame.words, mFile ) != frame.words )
+    {
+        return false;
+    }
+
+    if( frame.type == LRECORD_KEY )
+    {
+        memset( &mFrame[ 0 ], 0, count * sizeof( Uint32 ) );
+    }
+
+    size_t at = 0;
+    for( size_t i = 0; i + 2 <= mPayload.size(); )
+    {
+        size_t skip = mPayload[ i ];
+        size_t literals = mPayload[ i + 1 ];
+        i += 2;
+        at += skip;
+        if( at + literals > count || i + literals > mPayload.size() )
+        {
+            printf( "Damaged recording frame!\n" );
+            return false;
+        }
+        for( size_t n = 0; n < literals; ++n )
+        {
+            mFrame[ at++ ] ^= mPayload[ i++ ];
+        }
+    }
+
+    memcpy( pixels, &mFrame[ 0 ], count * sizeof( Uint32 ) );
+    if( time != NULL )
+    {
+        *time = frame.time;
+    }
+
+    return true;
+}
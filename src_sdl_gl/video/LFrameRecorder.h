@@ -0,0 +1,174 @@
+// Frame capture streamed to disk by a writer thread
+#ifndef LFRAME_RECORDER_H
+#define LFRAME_RECORDER_H
+
+#include "LOpenGL.h"
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <SDL.h>
+
+//Container formats, picked by file extension. Y4M is BT.601 4:4:4 for
+//other tools and rounds colours, the raw container keeps them exact.
+#define LRECORD_RAW 0
+#define LRECORD_Y4M 1
+
+//Frames read back or waiting for the writer, 1080p RGBA is 8 MB each
+#define LRECORD_SLOTS 6
+
+//Every this many frames one is stored whole, a damaged file recovers there
+#define LRECORD_KEY_INTERVAL 300
+
+//Raw container: an LRecordHeader, then per frame an LRecordFrame and its
+//payload. Payloads are runs over the RGBA words XORed with the previous
+//frame, top row first: a word of unchanged pixels to skip, a word of
+//literals and that many XORed words. Key frames XOR with black.
+#define LRECORD_MAGIC "SWRC"
+#define LRECORD_VERSION 1
+
+#define LRECORD_KEY   0
+#define LRECORD_DELTA 1
+
+struct LRecordHeader
+{
+    char magic[ 4 ];
+    Uint32 version;
+    Uint32 width;
+    Uint32 height;
+    Uint32 rateNumerator;
+    Uint32 rateDenominator;
+    Uint32 reserved[ 2 ];
+};
+
+struct LRecordFrame
+{
+    Uint32 type;
+    Uint32 words;
+
+    //Microseconds since recording started
+    Uint64 time;
+};
+
+//Slot states, a slot goes round FREE -> PENDING -> READY -> FREE
+#define LRECORD_FREE    0
+#define LRECORD_PENDING 1
+#define LRECORD_READY   2
+
+struct LRecordSlot
+{
+    //Only the GL thread moves a slot out of FREE, only the writer back in
+    SDL_atomic_t state;
+
+    //Read back target, persistently mapped where ARB_buffer_storage is
+    GLuint pbo;
+    GLsync fence;
+    void* mapped;
+
+    //Copies of CPU frames and of unmapped buffers
+    std::vector<Uint32> copy;
+
+    const Uint32* pixels;
+    bool bottomUp;
+    Uint64 time;
+};
+
+class LFrameRecorder
+{
+    public:
+        LFrameRecorder();
+        ~LFrameRecorder();
+
+        //Streams width x height frames to 'path', Y4M for a .y4m name and
+        //the raw container for anything else. 'rate' frames per second
+        //goes in the header. GL thread only, like every capture call.
+        bool start( const std::string& path, GLint width, GLint height, double rate, int slots = LRECORD_SLOTS );
+
+        //Waits for frames read back so far, lets the writer finish them
+        //and closes the file
+        void stop();
+        bool recording();
+        GLint width();
+        GLint height();
+
+        //Reads the colour buffer of 'framebufferID' into the next free
+        //buffer. Nothing waits for the copy, the writer gets it once its
+        //fence has signalled on a later call.
+        bool captureFramebuffer( GLuint framebufferID );
+
+        //Copies a frame already on the CPU, top row first
+        bool capturePixels32( const Uint32* pixels );
+        bool capturePixels8( const Uint8* indices, const Uint32* palette );
+
+        //Hands read back frames to the writer in capture order. Only
+        //waits for copies in flight if 'wait', the capture calls do this
+        //themselves without.
+        void collect( bool wait = false );
+
+        Uint64 written();
+        Uint64 dropped();
+        void report();
+
+    private:
+        static int writerMain( void* data );
+        LRecordSlot* acquire();
+        void releaseSlots();
+        void writeFrame( const LRecordSlot& slot );
+        void writeRaw( const LRecordSlot& slot );
+        void writeY4M( const LRecordSlot& slot );
+
+        std::string mPath;
+        int mFormat;
+        GLint mWidth;
+        GLint mHeight;
+        Uint64 mStart;
+
+        //Ring shared with the writer; the GL thread fills slots at
+        //mCapture and passes them on at mCollect, the writer takes them
+        //at mWrite. mReady counts slots passed on.
+        std::vector<LRecordSlot> mSlots;
+        int mCapture;
+        int mCollect;
+        int mWrite;
+        SDL_sem* mReady;
+        SDL_atomic_t mQuit;
+        SDL_Thread* mWriter;
+
+        //Writer thread only
+        FILE* mFile;
+        std::vector<Uint32> mPrevious;
+        std::vector<Uint32> mEncoded;
+        std::vector<Uint8> mPlanes;
+        Uint64 mWritten;
+        Uint64 mBytes;
+        double mWriteMs;
+        bool mFailed;
+
+        Uint64 mDropped;
+        Uint64 mCaptured;
+};
+
+//Decodes the raw container, for tools and checks
+class LRecordReader
+{
+    public:
+        LRecordReader();
+        ~LRecordReader();
+
+        bool open( const std::string& path );
+        void close();
+
+        GLint width();
+        GLint height();
+        double rate();
+
+        //Next frame as RGBA, width * height words, top row first
+        bool next( Uint32* pixels, Uint64* time = NULL );
+
+    private:
+        FILE* mFile;
+        LRecordHeader mHeader;
+        std::vector<Uint32> mFrame;
+        std::vector<Uint32> mPayload;
+};
+
+#endif
@@ -0,0 +1,330 @@
+// Separable gaussian blur, GLSL tap tables and CPU filter
+#include "LGaussian.h"
+#include <math.h>
+#include <string.h>
+
+LGaussian::LGaussian()
+{
+    mPool = NULL;
+    mWidth = 0;
+    mHeight = 0;
+    mSigma = 0.0f;
+    mDownscale = 0;
+    mBlurWidth = 0;
+    mBlurHeight = 0;
+    mRadius = 0;
+    mSrc = NULL;
+    mDst = NULL;
+    mPercent = 0;
+}
+
+LGaussian::~LGaussian()
+{
+    freeBuffers();
+}
+
+int LGaussian::weights( float sigma, std::vector<float>& weights )
+{
+    int radius = sigma > 0.0f ? (int)ceilf( LGAUSSIAN_RADIUS_SIGMAS * sigma ) : 0;
+    if( radius > LGAUSSIAN_MAX_RADIUS )
+    {
+        radius = LGAUSSIAN_MAX_RADIUS;
+    }
+
+    weights.resize( radius + 1 );
+    weights[ 0 ] = 1.0f;
+    float sum = 1.0f;
+    for( int i = 1; i <= radius; ++i )
+    {
+        weights[ i ] = expf( -(float)( i * i ) / ( 2.0f * sigma * sigma ) );
+        sum += 2.0f * weights[ i ];
+    }
+
+    //Both sides and the centre add up to one
+    for( int i = 0; i <= radius; ++i )
+    {
+        weights[ i ] /= sum;
+    }
+
+    return radius;
+}
+
+int LGaussian::linearTaps( float sigma, std::vector<float>& offsets, std::vector<float>& weights )
+{
+    std::vector<float> kernel;
+    int radius = LGaussian::weights( sigma, kernel );
+
+    offsets.clear();
+    weights.clear();
+    offsets.push_back( 0.0f );
+    weights.push_back( kernel[ 0 ] );
+
+    //A linear fetch between texels i and i + 1 returns both in the ratio
+    //of their weights, a last unpaired tap is fetched at its own texel
+    for( int i = 1; i <= radius; i += 2 )
+    {
+        float a = kernel[ i ];
+        float b = i + 1 <= radius ? kernel[ i + 1 ] : 0.0f;
+        offsets.push_back( ( i * a + ( i + 1 ) * b ) / ( a + b ) );
+        weights.push_back( a + b );
+    }
+
+    return (int)offsets.size();
+}
+
+std::string LGaussian::defineBlock( float sigma )
+{
+    std::vector<float> offsets;
+    std::vector<float> weights;
+    int taps = linearTaps( sigma, offsets, weights );
+
+    char number[ 32 ];
+    sprintf( number, "%d", taps );
+    std::string count = number;
+    std::string offsetList;
+    std::string weightList;
+    for( int i = 0; i < taps; ++i )
+    {
+        const char* separator = i > 0 ? ", " : "";
+        sprintf( number, "%s%.7f", separator, offsets[ i ] );
+        offsetList += number;
+        sprintf( number, "%s%.7f", separator, weights[ i ] );
+        weightList += number;
+    }
+
+    return "#define BLUR_TAPS " + count + "\n"
+        "#define BLUR_OFFSETS float[" + count + "](" + offsetList + ")\n"
+        "#define BLUR_WEIGHTS float[" + count + "](" + weightList + ")\n";
+}
+
+void LGaussian::setThreadPool( LThreadPool* pool )
+{
+    mPool = pool;
+}
+
+void LGaussian::halation( const Uint32* src, Uint32* dst, int width, int height, float sigma, int downscale, int percent )
+{
+    if( width <= 0 || height <= 0 )
+    {
+        return;
+    }
+    if( percent <= 0 )
+    {
+        if( dst != src )
+        {
+            memcpy( dst, src, (size_t)width * height * sizeof( Uint32 ) );
+        }
+        return;
+    }
+
+    //The upsample weights are exact in 1/256 steps for these factors
+    downscale = downscale >= 4 ? 4 : ( downscale >= 2 ? 2 : 1 );
+    if( width != mWidth || height != mHeight || sigma != mSigma || downscale != mDownscale )
+    {
+        setup( width, height, sigma, downscale );
+    }
+
+    mSrc = src;
+    mDst = dst;
+    mPercent = percent > 100 ? 100 : percent;
+
+    //Every pass reads rows of other bands from the one before
+    run( mBlurHeight, downsampleRows );
+    run( mBlurHeight, horizontalRows );
+    run( mBlurHeight, verticalRows );
+    run( mHeight, mixRows );
+
+    mSrc = NULL;
+    mDst = NULL;
+}
+
+void LGaussian::freeBuffers()
+{
+    std::vector<Uint32>().swap( mPadded );
+    std::vector<Uint32>().swap( mHorizontal );
+    std::vector<Uint32>().swap( mBlurred );
+    std::vector<int>().swap( mTapOffsets );
+    std::vector<Uint16>().swap( mTapWeights );
+    mWidth = 0;
+    mHeight = 0;
+}
+
+void LGaussian::setup( int width, int height, float sigma, int downscale )
+{
+    mWidth = width;
+    mHeight = height;
+    mSigma = sigma;
+    mDownscale = downscale;
+    mBlurWidth = width / downscale > 0 ? width / downscale : 1;
+    mBlurHeight = height / downscale > 0 ? height / downscale : 1;
+
+    //Full kernel in 1/256 steps; the CPU has no bilinear fetch to merge taps
+    std::vector<float> kernel;
+    int radius = weights( sigma / downscale, kernel );
+    std::vector<int> quantized( 2 * radius + 1 );
+    int sum = 0;
+    for( int i = -radius; i <= radius; ++i )
+    {
+        quantized[ i + radius ] = (int)( kernel[ i < 0 ? -i : i ] * 256.0f + 0.5f );
+        sum += quantized[ i + radius ];
+    }
+    quantized[ radius ] += 256 - sum;
+
+    mTapOffsets.clear();
+    mTapWeights.clear();
+    mRadius = 0;
+    for( int i = -radius; i <= radius; ++i )
+    {
+        if( quantized[ i + radius ] > 0 )
+        {
+            mTapOffsets.push_back( i );
+            mTapWeights.push_back( (Uint16)quantized[ i + radius ] );
+            mRadius = i < 0 ? -i : i;
+        }
+    }
+
+    mPadded.resize( (size_t)( mBlurWidth + 2 * mRadius ) * mBlurHeight );
+    mHorizontal.resize( (size_t)mBlurWidth * mBlurHeight );
+    mBlurred.resize( (size_t)mBlurWidth * mBlurHeight );
+}
+
+void LGaussian::run( int count, LTaskFunc func )
+{
+    if( mPool != NULL )
+    {
+        mPool->parallelFor( count, LGAUSSIAN_BAND_ROWS, func, this );
+    }
+    else
+    {
+        func( this, 0, count );
+    }
+}
+
+void LGaussian::downsampleRows( void* data, int begin, int end )
+{
+    LGaussian* blur = (LGaussian*)data;
+    int scale = blur->mDownscale;
+    int area = scale * scale;
+    int stride = blur->mBlurWidth + 2 * blur->mRadius;
+
+    for( int y = begin; y < end; ++y )
+    {
+        Uint32* row = &blur->mPadded[ (size_t)y * stride ];
+        for( int x = 0; x < blur->mBlurWidth; ++x )
+        {
+            //Box average of the block, rows and columns past the frame clamped
+            Uint32 r = 0, g = 0, b = 0;
+            for( int j = 0; j < scale; ++j )
+            {
+                int sy = y * scale + j < blur->mHeight ? y * scale + j : blur->mHeight - 1;
+                const Uint32* line = blur->mSrc + (size_t)sy * blur->mWidth;
+                for( int i = 0; i < scale; ++i )
+                {
+                    int sx = x * scale + i < blur->mWidth ? x * scale + i : blur->mWidth - 1;
+                    Uint32 p = line[ sx ];
+                    r += p & 255;
+                    g += ( p >> 8 ) & 255;
+                    b += ( p >> 16 ) & 255;
+                }
+            }
+            r = ( r + area / 2 ) / area;
+            g = ( g + area / 2 ) / area;
+            b = ( b + area / 2 ) / area;
+            row[ blur->mRadius + x ] = 0xFF000000u + ( b << 16 ) + ( g << 8 ) + r;
+        }
+
+        //Repeat the edge pixels so horizontal taps never leave the row
+        for( int i = 0; i < blur->mRadius; ++i )
+        {
+            row[ i ] = row[ blur->mRadius ];
+            row[ blur->mRadius + blur->mBlurWidth + i ] = row[ blur->mRadius + blur->mBlurWidth - 1 ];
+        }
+    }
+}
+
+void LGaussian::horizontalRows( void* data, int begin, int end )
+{
+    LGaussian* blur = (LGaussian*)data;
+    int taps = (int)blur->mTapOffsets.size();
+    int stride = blur->mBlurWidth + 2 * blur->mRadius;
+
+    const Uint32* srcs[ PX_MAX_TAPS ];
+    for( int y = begin; y < end; ++y )
+    {
+        const Uint32* row = &blur->mPadded[ (size_t)y * stride + blur->mRadius ];
+        for( int k = 0; k < taps; ++k )
+        {
+            srcs[ k ] = row + blur->mTapOffsets[ k ];
+        }
+        pxWeightedSum( srcs, &blur->mTapWeights[ 0 ], taps, &blur->mHorizontal[ (size_t)y * blur->mBlurWidth ], blur->mBlurWidth );
+    }
+}
+
+void LGaussian::verticalRows( void* data, int begin, int end )
+{
+    LGaussian* blur = (LGaussian*)data;
+    int taps = (int)blur->mTapOffsets.size();
+
+    const Uint32* srcs[ PX_MAX_TAPS ];
+    for( int y = begin; y < end; ++y )
+    {
+        for( int k = 0; k < taps; ++k )
+        {
+            int sy = y + blur->mTapOffsets[ k ];
+            sy = sy < 0 ? 0 : ( sy >= blur->mBlurHeight ? blur->mBlurHeight - 1 : sy );
+            srcs[ k ] = &blur->mHorizontal[ (size_t)sy * blur->mBlurWidth ];
+        }
+        pxWeightedSum( srcs, &blur->mTapWeights[ 0 ], taps, &blur->mBlurred[ (size_t)y * blur->mBlurWidth ], blur->mBlurWidth );
+    }
+}
+
+void LGaussian::mixRows( void* data, int begin, int end )
+{
+    LGaussian* blur = (LGaussian*)data;
+    int scale = blur->mDownscale;
+    int width = blur->mWidth;
+    std::vector<Uint32> line( scale > 1 ? width : 0 );
+
+    for( int y = begin; y < end; ++y )
+    {
+        const Uint32* up;
+        if( scale == 1 )
+        {
+            up = &blur->mBlurred[ (size_t)y * width ];
+        }
+        else
+        {
+            //Bilinear upsample, positions in 1/256 of a blur pixel from the
+            //centre of the first one
+            int fy = ( 2 * y + 1 ) * 128 / scale - 128;
+            int y0 = fy < 0 ? 0 : fy >> 8;
+            int wy = fy < 0 ? 0 : fy & 255;
+            int y1 = y0 + 1 < blur->mBlurHeight ? y0 + 1 : blur->mBlurHeight - 1;
+            y0 = y0 < blur->mBlurHeight ? y0 : blur->mBlurHeight - 1;
+            const Uint32* top = &blur->mBlurred[ (size_t)y0 * blur->mBlurWidth ];
+            const Uint32* bottom = &blur->mBlurred[ (size_t)y1 * blur->mBlurWidth ];
+
+            for( int x = 0; x < width; ++x )
+            {
+                int fx = ( 2 * x + 1 ) * 128 / scale - 128;
+                int x0 = fx < 0 ? 0 : fx >> 8;
+                int wx = fx < 0 ? 0 : fx & 255;
+                int x1 = x0 + 1 < blur->mBlurWidth ? x0 + 1 : blur->mBlurWidth - 1;
+                x0 = x0 < blur->mBlurWidth ? x0 : blur->mBlurWidth - 1;
+
+                Uint32 p = 0xFF000000u;
+                for( int shift = 0; shift < 24; shift += 8 )
+                {
+                    int a = ( ( top[ x0 ] >> shift ) & 255 ) * ( 256 - wx ) + ( ( top[ x1 ] >> shift ) & 255 ) * wx;
+                    int b = ( ( bottom[ x0 ] >> shift ) & 255 ) * ( 256 - wx ) + ( ( bottom[ x1 ] >> shift ) & 255 ) * wx;
+                    p += (Uint32)( ( a * ( 256 - wy ) + b * wy + 32768 ) >> 16 ) << shift;
+                }
+                line[ x ] = p;
+            }
+            up = &line[ 0 ];
+        }
+
+        size_t offset = (size_t)y * width;
+        pxAlphaBlend( blur->mSrc + offset, up, blur->mDst + offset, width, blur->mPercent );
+    }
+}
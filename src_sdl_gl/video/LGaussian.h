@@ -0,0 +1,85 @@
+// Separable gaussian blur, GLSL tap tables and CPU filter
+#ifndef LGAUSSIAN_H
+#define LGAUSSIAN_H
+
+#include "LPixelOps.h"
+#include "LThreadPool.h"
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <SDL.h>
+
+//Kernel radius in sigmas, and its cap in taps per side
+#define LGAUSSIAN_RADIUS_SIGMAS 3.0f
+#define LGAUSSIAN_MAX_RADIUS    31
+
+//Rows per pool task
+#define LGAUSSIAN_BAND_ROWS 8
+
+class LGaussian
+{
+    public:
+        LGaussian();
+        ~LGaussian();
+
+        //Normalized kernel for taps 0..radius of one side, returns the radius
+        static int weights( float sigma, std::vector<float>& weights );
+
+        //The kernel with neighbouring taps merged into one bilinear fetch at
+        //their weighted centre, tap 0 first and unpaired. A pass fetches tap
+        //0 once and every other tap at +offset and -offset; returns the taps.
+        static int linearTaps( float sigma, std::vector<float>& offsets, std::vector<float>& weights );
+
+        //BLUR_TAPS, BLUR_OFFSETS and BLUR_WEIGHTS #define lines for
+        //gaussian-horiz.fs and gaussian-vert.fs, offsets in source texels
+        static std::string defineBlock( float sigma );
+
+        //Pool to run on, NULL for the calling thread
+        void setThreadPool( LThreadPool* pool );
+
+        //Mixes 'percent' of a blurred copy of an RGBA frame into 'dst', which
+        //may be 'src'. The blur runs at 1/downscale size (1, 2 or 4) with
+        //'sigma' in full size pixels, then is scaled back up bilinearly.
+        void halation( const Uint32* src, Uint32* dst, int width, int height, float sigma, int downscale, int percent );
+
+        void freeBuffers();
+
+    private:
+        void setup( int width, int height, float sigma, int downscale );
+        void run( int count, LTaskFunc func );
+
+        static void downsampleRows( void* data, int begin, int end );
+        static void horizontalRows( void* data, int begin, int end );
+        static void verticalRows( void* data, int begin, int end );
+        static void mixRows( void* data, int begin, int end );
+
+        LThreadPool* mPool;
+
+        //Sizes the buffers and kernel below were set up for
+        int mWidth;
+        int mHeight;
+        float mSigma;
+        int mDownscale;
+
+        //Blur resolution
+        int mBlurWidth;
+        int mBlurHeight;
+
+        //Kernel quantized for pxWeightedSum, zero taps dropped
+        std::vector<int> mTapOffsets;
+        std::vector<Uint16> mTapWeights;
+        int mRadius;
+
+        //Downsampled frame with edge pixels repeated 'radius' times on both
+        //sides of every row, horizontal result, vertical result
+        std::vector<Uint32> mPadded;
+        std::vector<Uint32> mHorizontal;
+        std::vector<Uint32> mBlurred;
+
+        //Frame being filtered
+        const Uint32* mSrc;
+        Uint32* mDst;
+        int mPercent;
+};
+
+#endif
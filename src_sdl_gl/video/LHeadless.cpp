@@ -0,0 +1,313 @@
+// Offscreen OpenGL context and framebuffer for runs without a display
+#include "LHeadless.h"
+#include <string.h>
+
+#ifdef LHEADLESS_EGL
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+#endif
+
+LHeadless::LHeadless()
+{
+    mTarget = NULL;
+    mWidth = 0;
+    mHeight = 0;
+    mBackend = "none";
+
+    mWindow = NULL;
+    mContext = NULL;
+
+#ifdef LHEADLESS_EGL
+    mDisplay = EGL_NO_DISPLAY;
+    mEGLContext = EGL_NO_CONTEXT;
+#endif
+}
+
+LHeadless::~LHeadless()
+{
+    //Free context if it exists
+    freeHeadless();
+}
+
+bool LHeadless::init( GLint width, GLint height )
+{
+    freeHeadless();
+
+    if( !createContextEGL() && !createContextSDL() )
+    {
+        printf( "Unable to create headless OpenGL context!\n" );
+        return false;
+    }
+
+    if( !initGL() )
+    {
+        freeHeadless();
+        return false;
+    }
+
+    //Everything is drawn into this instead of a window
+    mTarget = mPool.acquire( width, height, GL_RGBA8 );
+    if( mTarget == NULL )
+    {
+        printf( "Unable to create headless framebuffer %dx%d!\n", width, height );
+        freeHeadless();
+        return false;
+    }
+    mWidth = width;
+    mHeight = height;
+
+    printf( "Headless %s context: %s, %s\n", mBackend, (const char*)glGetString( GL_RENDERER ), (const char*)glGetString( GL_VERSION ) );
+
+    return true;
+}
+
+bool LHeadless::createContextEGL()
+{
+#ifdef LHEADLESS_EGL
+    //Surfaceless platform needs no display server at all
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress( "eglGetPlatformDisplayEXT" );
+    if( getPlatformDisplay != NULL )
+    {
+        mDisplay = getPlatformDisplay( EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL );
+    }
+    if( mDisplay == EGL_NO_DISPLAY )
+    {
+        mDisplay = eglGetDisplay( EGL_DEFAULT_DISPLAY );
+    }
+
+    EGLint major, minor;
+    if( mDisplay == EGL_NO_DISPLAY || !eglInitialize( mDisplay, &major, &minor ) )
+    {
+        printf( "EGL display not available\n" );
+        mDisplay = EGL_NO_DISPLAY;
+        return false;
+    }
+
+    const char* extensions = eglQueryString( mDisplay, EGL_EXTENSIONS );
+    if( extensions == NULL || strstr( extensions, "EGL_KHR_surfaceless_context" ) == NULL || !eglBindAPI( EGL_OPENGL_API ) )
+    {
+        printf( "EGL %d.%d has no surfaceless desktop OpenGL\n", major, minor );
+        eglTerminate( mDisplay );
+        mDisplay = EGL_NO_DISPLAY;
+        return false;
+    }
+
+    //Surface type defaults to windows, which surfaceless displays have none of
+    const EGLint configAttribs[] =
+    {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint configCount = 0;
+    eglChooseConfig( mDisplay, configAttribs, &config, 1, &configCount );
+
+    //Same context the windowed mode asks SDL for
+    const EGLint contextAttribs[] =
+    {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+        EGL_NONE
+    };
+    if( configCount > 0 )
+    {
+        mEGLContext = eglCreateContext( mDisplay, config, EGL_NO_CONTEXT, contextAttribs );
+    }
+
+    if( mEGLContext == EGL_NO_CONTEXT || !eglMakeCurrent( mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, mEGLContext ) )
+    {
+        printf( "EGL context could not be created! EGL Error: 0x%x\n", eglGetError() );
+        if( mEGLContext != EGL_NO_CONTEXT )
+        {
+            eglDestroyContext( mDisplay, mEGLContext );
+            mEGLContext = EGL_NO_CONTEXT;
+        }
+        eglTerminate( mDisplay );
+        mDisplay = EGL_NO_DISPLAY;
+        return false;
+    }
+
+    mBackend = "EGL";
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool LHeadless::createContextSDL()
+{
+    if( SDL_Init( SDL_INIT_VIDEO ) < 0 )
+    {
+        printf( "SDL could not initialize! SDL Error: %s\n", SDL_GetError() );
+        return false;
+    }
+
+    SDL_GL_SetAttribute( SDL_GL_CONTEXT_MAJOR_VERSION, 3 );
+    SDL_GL_SetAttribute( SDL_GL_CONTEXT_MINOR_VERSION, 3 );
+    SDL_GL_SetAttribute( SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_COMPATIBILITY );
+
+    //Never shown, only holds the context
+    mWindow = SDL_CreateWindow( "SWOS Rendering Engine Test - Headless", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 16, 16, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN );
+    if( mWindow == NULL )
+    {
+        printf( "Hidden window could not be created! SDL Error: %s\n", SDL_GetError() );
+        return false;
+    }
+
+    mContext = SDL_GL_CreateContext( mWindow );
+    if( mContext == NULL )
+    {
+        printf( "OpenGL context could not be created! SDL Error: %s\n", SDL_GetError() );
+        SDL_DestroyWindow( mWindow );
+        mWindow = NULL;
+        return false;
+    }
+
+    mBackend = "SDL";
+    return true;
+}
+
+bool LHeadless::initGL()
+{
+    //GLEW built for GLX reports an error without an X display, the core
+    //entry points are loaded regardless
+    glewExperimental = GL_TRUE;
+    GLenum glewError = glewInit();
+    if( glewError != GLEW_OK )
+    {
+        printf( "GLEW: %s\n", glewGetErrorString( glewError ) );
+    }
+    while( glGetError() != GL_NO_ERROR )
+    {
+    }
+
+    if( glGetString( GL_VERSION ) == NULL )
+    {
+        printf( "Headless context has no usable OpenGL!\n" );
+        return false;
+    }
+
+    return true;
+}
+
+void LHeadless::freeHeadless()
+{
+    mPool.freePool();
+    mTarget = NULL;
+    mWidth = 0;
+    mHeight = 0;
+
+#ifdef LHEADLESS_EGL
+    if( mDisplay != EGL_NO_DISPLAY )
+    {
+        eglMakeCurrent( mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT );
+        if( mEGLContext != EGL_NO_CONTEXT )
+        {
+            eglDestroyContext( mDisplay, mEGLContext );
+            mEGLContext = EGL_NO_CONTEXT;
+        }
+        eglTerminate( mDisplay );
+        mDisplay = EGL_NO_DISPLAY;
+    }
+#endif
+
+    if( mContext != NULL )
+    {
+        SDL_GL_DeleteContext( mContext );
+        mContext = NULL;
+    }
+    if( mWindow != NULL )
+    {
+        SDL_DestroyWindow( mWindow );
+        mWindow = NULL;
+    }
+
+    mBackend = "none";
+}
+
+GLuint LHeadless::framebufferID()
+{
+    return mTarget != NULL ? mTarget->framebufferID : 0;
+}
+
+GLint LHeadless::width()
+{
+    return mWidth;
+}
+
+GLint LHeadless::height()
+{
+    return mHeight;
+}
+
+const char* LHeadless::backendName()
+{
+    return mBackend;
+}
+
+bool LHeadless::saveFramePPM( std::string path )
+{
+    if( mTarget == NULL )
+    {
+        return false;
+    }
+
+    GLubyte* pixels = new GLubyte[ mWidth * mHeight * 3 ];
+    glBindFramebuffer( GL_FRAMEBUFFER, mTarget->framebufferID );
+    glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+    glReadPixels( 0, 0, mWidth, mHeight, GL_RGB, GL_UNSIGNED_BYTE, pixels );
+    glPixelStorei( GL_PACK_ALIGNMENT, 4 );
+    glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+
+    bool success = false;
+    FILE* file = fopen( path.c_str(), "wb" );
+    if( file != NULL )
+    {
+        fprintf( file, "P6\n%d %d\n255\n", mWidth, mHeight );
+
+        //OpenGL rows start at the bottom
+        success = true;
+        for( GLint y = mHeight - 1; y >= 0 && success; --y )
+        {
+            success = fwrite( pixels + y * mWidth * 3, mWidth * 3, 1, file ) == 1;
+        }
+        fclose( file );
+    }
+    delete[] pixels;
+
+    if( !success )
+    {
+        printf( "Unable to write %s\n", path.c_str() );
+    }
+
+    return success;
+}
+
+bool LHeadless::readFrame( GLuint* pixels )
+{
+    if( mTarget == NULL )
+    {
+        return false;
+    }
+
+    glBindFramebuffer( GL_FRAMEBUFFER, mTarget->framebufferID );
+    glReadPixels( 0, 0, mWidth, mHeight, GL_RGBA, GL_UNSIGNED_BYTE, pixels );
+    glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+
+    //OpenGL rows start at the bottom
+    GLuint* row = new GLuint[ mWidth ];
+    for( GLint y = 0; y < mHeight / 2; ++y )
+    {
+        GLuint* top = pixels + y * mWidth;
+        GLuint* bottom = pixels + ( mHeight - 1 - y ) * mWidth;
+        memcpy( row, top, mWidth * sizeof( GLuint ) );
+        memcpy( top, bottom, mWidth * sizeof( GLuint ) );
+        memcpy( bottom, row, mWidth * sizeof( GLuint ) );
+    }
+    delete[] row;
+
+    return true;
+}
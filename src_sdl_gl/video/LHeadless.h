@@ -0,0 +1,61 @@
+// Offscreen OpenGL context and framebuffer for runs without a display
+#ifndef LHEADLESS_H
+#define LHEADLESS_H
+
+#include "LOpenGL.h"
+#include "LRenderTarget.h"
+#include <stdio.h>
+#include <string>
+#include <SDL.h>
+
+//EGL surfaceless contexts (Mesa llvmpipe, GPU drivers) where available,
+//a hidden SDL window everywhere else
+#if defined(__linux__) && !defined(LHEADLESS_NO_EGL)
+#define LHEADLESS_EGL 1
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+class LHeadless
+{
+    public:
+        LHeadless();
+        ~LHeadless();
+
+        //Creates context and an RGBA8 framebuffer of the given size
+        bool init( GLint width, GLint height );
+        void freeHeadless();
+
+        GLuint framebufferID();
+        GLint width();
+        GLint height();
+        const char* backendName();
+
+        //Binary PPM of the framebuffer, top row first
+        bool saveFramePPM( std::string path );
+
+        //RGBA copy of the framebuffer, width * height pixels, top row first
+        bool readFrame( GLuint* pixels );
+
+    private:
+        bool createContextEGL();
+        bool createContextSDL();
+        bool initGL();
+
+        LRenderTargetPool mPool;
+        LRenderTarget* mTarget;
+        GLint mWidth;
+        GLint mHeight;
+        const char* mBackend;
+
+        //Fallback context
+        SDL_Window* mWindow;
+        SDL_GLContext mContext;
+
+#ifdef LHEADLESS_EGL
+        EGLDisplay mDisplay;
+        EGLContext mEGLContext;
+#endif
+};
+
+#endif
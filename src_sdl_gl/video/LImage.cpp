@@ -0,0 +1,249 @@
+// Decoded images and memory-mapped image files
+#include "LImage.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//Little endian fields of the file header
+static inline Uint32 readU16( const Uint8* p )
+{
+    return p[ 0 ] | ( p[ 1 ] << 8 );
+}
+
+static inline Uint32 readU32( const Uint8* p )
+{
+    return p[ 0 ] | ( p[ 1 ] << 8 ) | ( p[ 2 ] << 16 ) | ( (Uint32)p[ 3 ] << 24 );
+}
+
+LMappedFile::LMappedFile()
+{
+    mData = NULL;
+    mSize = 0;
+#ifdef _WIN32
+    mFile = INVALID_HANDLE_VALUE;
+    mMapping = NULL;
+#else
+    mFd = -1;
+#endif
+}
+
+LMappedFile::~LMappedFile()
+{
+    unmap();
+}
+
+bool LMappedFile::map( const std::string& path )
+{
+    unmap();
+#ifdef _WIN32
+    mFile = CreateFileA( path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+    if( mFile == INVALID_HANDLE_VALUE )
+    {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if( GetFileSizeEx( mFile, &size ) && size.QuadPart > 0 )
+    {
+        mMapping = CreateFileMappingA( mFile, NULL, PAGE_READONLY, 0, 0, NULL );
+    }
+    if( mMapping != NULL )
+    {
+        mData = (const Uint8*)MapViewOfFile( mMapping, FILE_MAP_READ, 0, 0, 0 );
+        mSize = (size_t)size.QuadPart;
+    }
+#else
+    mFd = open( path.c_str(), O_RDONLY );
+    if( mFd < 0 )
+    {
+        return false;
+    }
+
+    struct stat info;
+    if( fstat( mFd, &info ) == 0 && info.st_size > 0 )
+    {
+        void* data = mmap( NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, mFd, 0 );
+        if( data != MAP_FAILED )
+        {
+            //Files are mostly read once from front to back
+            madvise( data, (size_t)info.st_size, MADV_SEQUENTIAL );
+            mData = (const Uint8*)data;
+            mSize = (size_t)info.st_size;
+        }
+    }
+#endif
+
+    if( mData == NULL )
+    {
+        unmap();
+        return false;
+    }
+
+    return true;
+}
+
+void LMappedFile::unmap()
+{
+#ifdef _WIN32
+    if( mData != NULL )
+    {
+        UnmapViewOfFile( mData );
+    }
+    if( mMapping != NULL )
+    {
+        CloseHandle( mMapping );
+    }
+    if( mFile != INVALID_HANDLE_VALUE )
+    {
+        CloseHandle( mFile );
+    }
+    mFile = INVALID_HANDLE_VALUE;
+    mMapping = NULL;
+#else
+    if( mData != NULL )
+    {
+        munmap( (void*)mData, mSize );
+    }
+    if( mFd >= 0 )
+    {
+        close( mFd );
+    }
+    mFd = -1;
+#endif
+    mData = NULL;
+    mSize = 0;
+}
+
+const Uint8* LMappedFile::data()
+{
+    return mData;
+}
+
+size_t LMappedFile::size()
+{
+    return mSize;
+}
+
+bool LBitmap::load( const std::string& path, LImage& image )
+{
+    image.width = 0;
+    image.height = 0;
+    image.pixels.clear();
+
+    LMappedFile file;
+    if( !file.map( path ) )
+    {
+        printf( "Unable to open bitmap %s\n", path.c_str() );
+        return false;
+    }
+
+    bool decoded = decode( file.data(), file.size(), image );
+    file.unmap();
+    if( !decoded )
+    {
+        printf( "Unable to decode bitmap %s\n", path.c_str() );
+    }
+
+    return decoded;
+}
+
+bool LBitmap::decode( const Uint8* data, size_t size, LImage& image )
+{
+    //File header and at least a BITMAPINFOHEADER
+    if( size < 54 || data[ 0 ] != 'B' || data[ 1 ] != 'M' )
+    {
+        return false;
+    }
+
+    Uint32 pixelOffset = readU32( data + 10 );
+    Uint32 headerSize = readU32( data + 14 );
+    int width = (int)readU32( data + 18 );
+    int height = (int)readU32( data + 22 );
+    Uint32 bitsPerPixel = readU16( data + 28 );
+    Uint32 compression = readU32( data + 30 );
+    Uint32 colorsUsed = readU32( data + 46 );
+
+    //Negative height stores the top row first
+    bool bottomUp = height > 0;
+    height = bottomUp ? height : -height;
+    if( headerSize < 40 || headerSize > size - 14 || width <= 0 || height <= 0 || width > LIMAGE_MAX_SIZE || height > LIMAGE_MAX_SIZE )
+    {
+        return false;
+    }
+
+    //Only uncompressed pixels, and 32-bit ones in the usual BGRX masks
+    if( compression == 3 )
+    {
+        if( bitsPerPixel != 32 || size < 66 || readU32( data + 54 ) != 0x00FF0000 || readU32( data + 58 ) != 0x0000FF00 || readU32( data + 62 ) != 0x000000FF )
+        {
+            return false;
+        }
+    }
+    else if( compression != 0 )
+    {
+        return false;
+    }
+    if( bitsPerPixel != 8 && bitsPerPixel != 24 && bitsPerPixel != 32 )
+    {
+        return false;
+    }
+
+    //Rows are padded to whole 32-bit words
+    size_t pitch = ( ( (size_t)width * bitsPerPixel + 31 ) / 32 ) * 4;
+    if( pixelOffset > size || pitch * height > size - pixelOffset )
+    {
+        return false;
+    }
+
+    //Palette entries are BGRX after the info header
+    Uint32 palette[ 256 ];
+    if( bitsPerPixel == 8 )
+    {
+        Uint32 entries = colorsUsed == 0 || colorsUsed > 256 ? 256 : colorsUsed;
+        if( 14 + (Uint64)headerSize + (Uint64)entries * 4 > pixelOffset )
+        {
+            return false;
+        }
+        const Uint8* table = data + 14 + headerSize;
+        for( Uint32 i = 0; i < 256; ++i )
+        {
+            const Uint8* p = table + ( i < entries ? i : 0 ) * 4;
+            palette[ i ] = 0xFF000000u + ( p[ 0 ] << 16 ) + ( p[ 1 ] << 8 ) + p[ 2 ];
+        }
+    }
+
+    image.width = width;
+    image.height = height;
+    image.pixels.resize( (size_t)width * height );
+
+    for( int y = 0; y < height; ++y )
+    {
+        const Uint8* src = data + pixelOffset + pitch * ( bottomUp ? height - 1 - y : y );
+        Uint32* dst = &image.pixels[ (size_t)y * width ];
+
+        if( bitsPerPixel == 8 )
+        {
+            for( int x = 0; x < width; ++x )
+            {
+                dst[ x ] = palette[ src[ x ] ];
+            }
+        }
+        else
+        {
+            //BGR(X) bytes, alpha of 32-bit files is not trusted
+            Uint32 step = bitsPerPixel / 8;
+            for( int x = 0; x < width; ++x, src += step )
+            {
+                dst[ x ] = 0xFF000000u + ( src[ 0 ] << 16 ) + ( src[ 1 ] << 8 ) + src[ 2 ];
+            }
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,58 @@
+// Decoded images and memory-mapped image files
+#ifndef LIMAGE_H
+#define LIMAGE_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <SDL.h>
+
+//Largest image side accepted from a file header
+#define LIMAGE_MAX_SIZE 16384
+
+//Decoded image, RGBA in LPixelOps layout, top row first
+struct LImage
+{
+    Uint32 width;
+    Uint32 height;
+    std::vector<Uint32> pixels;
+};
+
+//Read-only view of a whole file
+class LMappedFile
+{
+    public:
+        LMappedFile();
+        ~LMappedFile();
+
+        bool map( const std::string& path );
+        void unmap();
+
+        //NULL while nothing is mapped
+        const Uint8* data();
+        size_t size();
+
+    private:
+        const Uint8* mData;
+        size_t mSize;
+#ifdef _WIN32
+        //File and mapping HANDLEs, windows.h stays out of the header
+        void* mFile;
+        void* mMapping;
+#else
+        int mFd;
+#endif
+};
+
+class LBitmap
+{
+    public:
+        //Maps a BMP file and decodes it straight from the mapping
+        static bool load( const std::string& path, LImage& image );
+
+        //BMP file bytes to 'image': 8-bit palette, 24 and 32-bit pixels,
+        //bottom-up or top-down rows, rows padded to 4 bytes
+        static bool decode( const Uint8* data, size_t size, LImage& image );
+};
+
+#endif
@@ -0,0 +1,273 @@
+// Lookup textures baked from shader parameters
+#include "LLookupTables.h"
+#include <math.h>
+
+LLookupTables::LLookupTables()
+{
+    mGammaTexture = 0;
+    mBeamTexture = 0;
+    mMaskTexture = 0;
+    mInputs = defaultInputs();
+}
+
+LLookupTables::~LLookupTables()
+{
+    //Free textures if they exist
+    freeTables();
+}
+
+LLutInputs LLookupTables::defaultInputs()
+{
+    //Initial values of the #pragma parameter declarations
+    LLutInputs inputs;
+    inputs.crtGamma = 2.4f;
+    inputs.monitorGamma = 2.2f;
+    inputs.srgbGamma = 2.4f;
+    inputs.mask = 1.0f;
+    inputs.maskIntensity = 0.5f;
+
+    return inputs;
+}
+
+bool LLookupTables::update( const LLutInputs& inputs )
+{
+    bool gammaChanged = inputs.crtGamma != mInputs.crtGamma || inputs.monitorGamma != mInputs.monitorGamma || inputs.srgbGamma != mInputs.srgbGamma;
+    bool maskChanged = inputs.mask != mInputs.mask || inputs.maskIntensity != mInputs.maskIntensity;
+    mInputs = inputs;
+
+    if( mGammaTexture == 0 || gammaChanged )
+    {
+        bakeGamma( inputs );
+    }
+    if( mBeamTexture == 0 )
+    {
+        bakeBeam();
+    }
+    if( mMaskTexture == 0 || maskChanged )
+    {
+        bakeMask( inputs );
+    }
+
+    return mGammaTexture != 0 && mBeamTexture != 0 && mMaskTexture != 0;
+}
+
+void LLookupTables::freeTables()
+{
+    GLuint textures[] = { mGammaTexture, mBeamTexture, mMaskTexture };
+    for( int i = 0; i < 3; ++i )
+    {
+        if( textures[ i ] != 0 )
+        {
+            glDeleteTextures( 1, &textures[ i ] );
+        }
+    }
+    mGammaTexture = 0;
+    mBeamTexture = 0;
+    mMaskTexture = 0;
+}
+
+GLuint LLookupTables::gammaTexture()
+{
+    return mGammaTexture;
+}
+
+GLuint LLookupTables::beamTexture()
+{
+    return mBeamTexture;
+}
+
+GLuint LLookupTables::maskTexture()
+{
+    return mMaskTexture;
+}
+
+std::string LLookupTables::defineBlock()
+{
+    char rows[ 256 ];
+    sprintf( rows,
+        "#define LUT_DISPLAY_DECODE %d.0\n"
+        "#define LUT_DISPLAY_ENCODE %d.0\n"
+        "#define LUT_CRT_DECODE %d.0\n"
+        "#define LUT_SRGB_DECODE %d.0\n"
+        "#define LUT_SRGB_ENCODE %d.0\n",
+        LLUT_ROW_DISPLAY_DECODE, LLUT_ROW_DISPLAY_ENCODE, LLUT_ROW_CRT_DECODE, LLUT_ROW_SRGB_DECODE, LLUT_ROW_SRGB_ENCODE );
+
+    //Texel centres span [0, 1], so the ends of the curve are exact;
+    //encoding rows expect sqrt(value)
+    return std::string( rows ) +
+        "#if __VERSION__ >= 130\n"
+        "uniform sampler2D " LLUT_GAMMA_SAMPLER ";\n"
+        "vec4 lutCurve(vec4 c, float row)\n"
+        "{\n"
+        "  vec2 size = vec2(textureSize(" LLUT_GAMMA_SAMPLER ", 0));\n"
+        "  vec3 x = c.rgb * ((size.x - 1.0) / size.x) + 0.5 / size.x;\n"
+        "  float y = (row + 0.5) / size.y;\n"
+        "  return vec4(texture(" LLUT_GAMMA_SAMPLER ", vec2(x.r, y)).r,\n"
+        "              texture(" LLUT_GAMMA_SAMPLER ", vec2(x.g, y)).r,\n"
+        "              texture(" LLUT_GAMMA_SAMPLER ", vec2(x.b, y)).r,\n"
+        "              c.a);\n"
+        "}\n"
+        "#endif\n";
+}
+
+float LLookupTables::gammaCurve( int row, float value, const LLutInputs& inputs )
+{
+    switch( row )
+    {
+        case LLUT_ROW_DISPLAY_DECODE:
+            return powf( value, inputs.monitorGamma );
+        case LLUT_ROW_DISPLAY_ENCODE:
+            return powf( value, 1.0f / inputs.monitorGamma );
+        case LLUT_ROW_CRT_DECODE:
+            return powf( value, inputs.crtGamma );
+        case LLUT_ROW_SRGB_DECODE:
+            return value <= 0.04045f ? value * ( 1.0f / 12.92f ) : powf( value * ( 1.0f / 1.055f ) + ( 0.055f / 1.055f ), inputs.srgbGamma );
+        default:
+            return value < 0.0031308f ? value * 12.92f : 1.055f * powf( value, 0.41666f ) - 0.055f;
+    }
+}
+
+float LLookupTables::beamWeight( float distance, float color, bool gaussian )
+{
+    //scanlineWeights() of crt-geom.fs for one channel
+    if( gaussian )
+    {
+        float wid = 0.3f + 0.1f * color * color * color;
+        float weight = distance / wid;
+        return 0.4f * expf( -weight * weight ) / wid;
+    }
+
+    float wid = 2.0f + 2.0f * color * color * color * color;
+    float weight = distance / 0.3f;
+    return 1.4f * expf( -powf( weight / sqrtf( 0.5f * wid ), wid ) ) / ( 0.6f + 0.2f * wid );
+}
+
+void LLookupTables::maskColor( int x, int y, float mask, float dark, float* rgb )
+{
+    //CrtsMask() of lottes.fs at the centre of pixel x, y
+    float posX = x + 0.5f;
+    float posY = y + 0.5f;
+    int type = (int)( mask + 0.5f );
+
+    if( type == 0 )
+    {
+        rgb[ 0 ] = rgb[ 1 ] = rgb[ 2 ] = 1.0f;
+        return;
+    }
+
+    float period = 3.0f;
+    if( type == 3 )
+    {
+        posX += posY * 2.9999f;
+        period = 6.0f;
+    }
+    float phase = posX / period - floorf( posX / period );
+    int lit = phase < ( 1.0f / 3.0f ) ? 0 : ( phase < ( 2.0f / 3.0f ) ? 1 : 2 );
+
+    //The aperture grille darkens the selected channel, the others light it
+    for( int i = 0; i < 3; ++i )
+    {
+        if( type == 1 )
+        {
+            rgb[ i ] = i == lit ? dark : 1.0f;
+        }
+        else
+        {
+            rgb[ i ] = i == lit ? 1.0f : dark;
+        }
+    }
+}
+
+GLuint LLookupTables::createTexture( GLenum format, GLsizei width, GLsizei height, GLenum dataFormat, const GLfloat* data, GLenum filter )
+{
+    GLuint textureID = 0;
+    glGenTextures( 1, &textureID );
+    glBindTexture( GL_TEXTURE_2D, textureID );
+    glTexImage2D( GL_TEXTURE_2D, 0, format, width, height, 0, dataFormat, GL_FLOAT, data );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+    glBindTexture( GL_TEXTURE_2D, 0 );
+
+    GLenum error = glGetError();
+    if( error != GL_NO_ERROR )
+    {
+        printf( "Error creating %dx%d lookup texture! %s\n", width, height, gluErrorString( error ) );
+        glDeleteTextures( 1, &textureID );
+        textureID = 0;
+    }
+
+    return textureID;
+}
+
+void LLookupTables::bakeGamma( const LLutInputs& inputs )
+{
+    std::vector<GLfloat> texels( LLUT_GAMMA_SIZE * LLUT_GAMMA_ROWS );
+    for( int row = 0; row < LLUT_GAMMA_ROWS; ++row )
+    {
+        bool encode = row == LLUT_ROW_DISPLAY_ENCODE || row == LLUT_ROW_SRGB_ENCODE;
+        for( int i = 0; i < LLUT_GAMMA_SIZE; ++i )
+        {
+            float value = (float)i / ( LLUT_GAMMA_SIZE - 1 );
+            texels[ row * LLUT_GAMMA_SIZE + i ] = gammaCurve( row, encode ? value * value : value, inputs );
+        }
+    }
+
+    if( mGammaTexture == 0 )
+    {
+        mGammaTexture = createTexture( GL_R16F, LLUT_GAMMA_SIZE, LLUT_GAMMA_ROWS, GL_RED, &texels[ 0 ], GL_LINEAR );
+    }
+    else
+    {
+        glBindTexture( GL_TEXTURE_2D, mGammaTexture );
+        glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, LLUT_GAMMA_SIZE, LLUT_GAMMA_ROWS, GL_RED, GL_FLOAT, &texels[ 0 ] );
+        glBindTexture( GL_TEXTURE_2D, 0 );
+    }
+}
+
+void LLookupTables::bakeBeam()
+{
+    //No parameters go into the profile, it is baked once
+    std::vector<GLfloat> texels( LLUT_BEAM_DISTANCES * LLUT_BEAM_COLORS * 2 );
+    for( int profile = 0; profile < 2; ++profile )
+    {
+        for( int c = 0; c < LLUT_BEAM_COLORS; ++c )
+        {
+            float color = (float)c / ( LLUT_BEAM_COLORS - 1 );
+            GLfloat* row = &texels[ ( profile * LLUT_BEAM_COLORS + c ) * LLUT_BEAM_DISTANCES ];
+            for( int i = 0; i < LLUT_BEAM_DISTANCES; ++i )
+            {
+                float distance = LLUT_BEAM_RANGE * i / ( LLUT_BEAM_DISTANCES - 1 );
+                row[ i ] = beamWeight( distance, color, profile == 0 );
+            }
+        }
+    }
+
+    mBeamTexture = createTexture( GL_R16F, LLUT_BEAM_DISTANCES, LLUT_BEAM_COLORS * 2, GL_RED, &texels[ 0 ], GL_LINEAR );
+}
+
+void LLookupTables::bakeMask( const LLutInputs& inputs )
+{
+    GLfloat texels[ LLUT_MASK_WIDTH * LLUT_MASK_HEIGHT * 4 ];
+    for( int y = 0; y < LLUT_MASK_HEIGHT; ++y )
+    {
+        for( int x = 0; x < LLUT_MASK_WIDTH; ++x )
+        {
+            GLfloat* texel = &texels[ ( y * LLUT_MASK_WIDTH + x ) * 4 ];
+            maskColor( x, y, inputs.mask, 1.0f - inputs.maskIntensity, texel );
+            texel[ 3 ] = 1.0f;
+        }
+    }
+
+    if( mMaskTexture == 0 )
+    {
+        mMaskTexture = createTexture( GL_RGBA16F, LLUT_MASK_WIDTH, LLUT_MASK_HEIGHT, GL_RGBA, texels, GL_NEAREST );
+    }
+    else
+    {
+        glBindTexture( GL_TEXTURE_2D, mMaskTexture );
+        glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, LLUT_MASK_WIDTH, LLUT_MASK_HEIGHT, GL_RGBA, GL_FLOAT, texels );
+        glBindTexture( GL_TEXTURE_2D, 0 );
+    }
+}
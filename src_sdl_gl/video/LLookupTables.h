@@ -0,0 +1,86 @@
+// Lookup textures baked from shader parameters
+#ifndef LLOOKUP_TABLES_H
+#define LLOOKUP_TABLES_H
+
+#include "LOpenGL.h"
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+//Sampler names of the tables, the gamma one is declared by defineBlock()
+#define LLUT_GAMMA_SAMPLER "gammaLUT"
+#define LLUT_BEAM_SAMPLER  "beamLUT"
+#define LLUT_MASK_SAMPLER  "maskLUT"
+
+//Transfer curves, one per row of the gamma texture. Encoding rows are
+//indexed by sqrt(value) so the steep start of the curve keeps its detail.
+#define LLUT_GAMMA_SIZE           1024
+#define LLUT_ROW_DISPLAY_DECODE   0   //value^monitorgamma
+#define LLUT_ROW_DISPLAY_ENCODE   1   //value^(1/monitorgamma)
+#define LLUT_ROW_CRT_DECODE       2   //value^CRTgamma
+#define LLUT_ROW_SRGB_DECODE      3   //lottes FromSrgb1, CRT_GAMMA
+#define LLUT_ROW_SRGB_ENCODE      4   //lottes ToSrgb1
+#define LLUT_GAMMA_ROWS           5
+
+//crt-geom beam profile: distance to the scanline across, beam colour down,
+//the power profile above the gaussian one
+#define LLUT_BEAM_DISTANCES 256
+#define LLUT_BEAM_RANGE     2.0f
+#define LLUT_BEAM_COLORS    64
+
+//lottes phosphor mask, one tile of every mask type repeats over 6x2 pixels
+#define LLUT_MASK_WIDTH  6
+#define LLUT_MASK_HEIGHT 2
+
+//Parameter values the tables are baked for
+struct LLutInputs
+{
+    GLfloat crtGamma;
+    GLfloat monitorGamma;
+    GLfloat srgbGamma;
+    GLfloat mask;
+    GLfloat maskIntensity;
+};
+
+class LLookupTables
+{
+    public:
+        LLookupTables();
+        ~LLookupTables();
+
+        //Shader defaults, used for parameters no pass declares
+        static LLutInputs defaultInputs();
+
+        //Bakes the tables whose inputs changed, the beam table only once
+        bool update( const LLutInputs& inputs );
+        void freeTables();
+
+        GLuint gammaTexture();
+        GLuint beamTexture();
+        GLuint maskTexture();
+
+        //LUT_* row numbers of the gamma texture and, from GLSL 1.30 on, its
+        //sampler and vec4 lutCurve( c, row ) mapping c.rgb through a row.
+        //LShaderPipeline puts it in front of every pass.
+        static std::string defineBlock();
+
+        //The functions the tables sample
+        static float gammaCurve( int row, float value, const LLutInputs& inputs );
+        static float beamWeight( float distance, float color, bool gaussian );
+        static void maskColor( int x, int y, float mask, float dark, float* rgb );
+
+    private:
+        static GLuint createTexture( GLenum format, GLsizei width, GLsizei height, GLenum dataFormat, const GLfloat* data, GLenum filter );
+        void bakeGamma( const LLutInputs& inputs );
+        void bakeBeam();
+        void bakeMask( const LLutInputs& inputs );
+
+        GLuint mGammaTexture;
+        GLuint mBeamTexture;
+        GLuint mMaskTexture;
+
+        //Inputs the current textures were baked for
+        LLutInputs mInputs;
+};
+
+#endif
@@ -0,0 +1,587 @@
+// Pixel compositing kernels for SWOS 2020 rendering engine
+#include "LPixelOps.h"
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define PX_X86 1
+#include <immintrin.h>
+#define PX_TARGET_SSE2 __attribute__((target("sse2")))
+#define PX_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PX_NEON 1
+#include <arm_neon.h>
+#endif
+
+// x / 100 for 0 <= x <= 25500, as (x * 41944) >> 22
+#define PX_DIV100_MUL   41944
+#define PX_DIV100_SHIFT 6
+
+#define PX_ALPHA_MASK 0xFF000000u
+
+typedef void (*PxClearFunc)(Uint32 *dst, size_t count, Uint32 color);
+typedef void (*PxCopyKeyFunc)(const Uint32 *src, Uint32 *dst, size_t count, Uint32 key);
+typedef void (*PxAlphaBlendFunc)(const Uint32 *src1, const Uint32 *src2, Uint32 *dst, size_t count, int opacity);
+typedef void (*PxWeightedSumFunc)(const Uint32 *const *srcs, const Uint16 *weights, int taps, Uint32 *dst, size_t count);
+typedef void (*PxCopyKey8Func)(const Uint8 *src, Uint8 *dst, size_t count, Uint8 key);
+
+struct PxKernels
+{
+    int impl;
+    const char *name;
+    PxClearFunc clear;
+    PxCopyKeyFunc copyKey;
+    PxAlphaBlendFunc alphaBlend;
+    PxWeightedSumFunc weightedSum;
+    PxCopyKey8Func copyKey8;
+};
+
+static PxKernels gPx;
+static bool gPxReady = false;
+
+// -- scalar reference
+
+static void clearScalar(Uint32 *dst, size_t count, Uint32 color)
+{
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = color;
+    }
+}
+
+static void copyKeyScalar(const Uint32 *src, Uint32 *dst, size_t count, Uint32 key)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (src[i] != key) {
+            dst[i] = src[i];
+        }
+    }
+}
+
+static inline Uint32 blendPixelScalar(Uint32 p1, Uint32 p2, int opacity)
+{
+    int w2 = (p2 & PX_ALPHA_MASK) ? opacity : 0;
+    int w1 = 100 - w2;
+
+    Uint32 r = (( p1        & 255) * w1 + ( p2        & 255) * w2) / 100;
+    Uint32 g = (((p1 >>  8) & 255) * w1 + ((p2 >>  8) & 255) * w2) / 100;
+    Uint32 b = (((p1 >> 16) & 255) * w1 + ((p2 >> 16) & 255) * w2) / 100;
+
+    return PX_ALPHA_MASK + (b << 16) + (g << 8) + r;
+}
+
+static void alphaBlendScalar(const Uint32 *src1, const Uint32 *src2, Uint32 *dst, size_t count, int opacity)
+{
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = blendPixelScalar(src1[i], src2[i], opacity);
+    }
+}
+
+// Pixels [begin, count), the SIMD kernels finish their rows with it
+static void weightedSumFrom(const Uint32 *const *srcs, const Uint16 *weights, int taps, Uint32 *dst, size_t begin, size_t count)
+{
+    for (size_t i = begin; i < count; i++) {
+        Uint32 r = 128, g = 128, b = 128;
+        for (int k = 0; k < taps; k++) {
+            Uint32 p = srcs[k][i];
+            r += ( p        & 255) * weights[k];
+            g += ((p >>  8) & 255) * weights[k];
+            b += ((p >> 16) & 255) * weights[k];
+        }
+        dst[i] = PX_ALPHA_MASK + ((b >> 8) << 16) + ((g >> 8) << 8) + (r >> 8);
+    }
+}
+
+static void weightedSumScalar(const Uint32 *const *srcs, const Uint16 *weights, int taps, Uint32 *dst, size_t count)
+{
+    weightedSumFrom(srcs, weights, taps, dst, 0, count);
+}
+
+static void copyKey8Scalar(const Uint8 *src, Uint8 *dst, size_t count, Uint8 key)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (src[i] != key) {
+            dst[i] = src[i];
+        }
+    }
+}
+
+#ifdef PX_X86
+// -- SSE2, 4 pixels per iteration (16 for 8-bit indices)
+
+PX_TARGET_SSE2
+static void clearSSE2(Uint32 *dst, size_t count, Uint32 color)
+{
+    __m128i c = _mm_set1_epi32((int)color);
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128((__m128i*)(dst + i), c);
+    }
+    clearScalar(dst + i, count - i, color);
+}
+
+PX_TARGET_SSE2
+static void copyKeySSE2(const Uint32 *src, Uint32 *dst, size_t count, Uint32 key)
+{
+    __m128i k = _mm_set1_epi32((int)key);
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i keep = _mm_cmpeq_epi32(s, k);
+        d = _mm_or_si128(_mm_and_si128(keep, d), _mm_andnot_si128(keep, s));
+        _mm_storeu_si128((__m128i*)(dst + i), d);
+    }
+    copyKeyScalar(src + i, dst + i, count - i, key);
+}
+
+PX_TARGET_SSE2
+static inline __m128i blendHalfSSE2(__m128i c1, __m128i c2, __m128i w1, __m128i w2, __m128i div)
+{
+    __m128i x = _mm_add_epi16(_mm_mullo_epi16(c1, w1), _mm_mullo_epi16(c2, w2));
+    return _mm_srli_epi16(_mm_mulhi_epu16(x, div), PX_DIV100_SHIFT);
+}
+
+PX_TARGET_SSE2
+static void alphaBlendSSE2(const Uint32 *src1, const Uint32 *src2, Uint32 *dst, size_t count, int opacity)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alpha = _mm_set1_epi32((int)PX_ALPHA_MASK);
+    const __m128i hundred = _mm_set1_epi16(100);
+    const __m128i div = _mm_set1_epi16((short)PX_DIV100_MUL);
+    // Opacity replicated into both 16-bit halves of each 32-bit lane
+    const __m128i op = _mm_set1_epi32(opacity | (opacity << 16));
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i p1 = _mm_loadu_si128((const __m128i*)(src1 + i));
+        __m128i p2 = _mm_loadu_si128((const __m128i*)(src2 + i));
+
+        // Zero opacity where src2 alpha is 0
+        __m128i transparent = _mm_cmpeq_epi32(_mm_and_si128(p2, alpha), zero);
+        __m128i w2 = _mm_andnot_si128(transparent, op);
+        __m128i w2lo = _mm_unpacklo_epi32(w2, w2);
+        __m128i w2hi = _mm_unpackhi_epi32(w2, w2);
+        __m128i w1lo = _mm_sub_epi16(hundred, w2lo);
+        __m128i w1hi = _mm_sub_epi16(hundred, w2hi);
+
+        __m128i lo = blendHalfSSE2(_mm_unpacklo_epi8(p1, zero), _mm_unpacklo_epi8(p2, zero), w1lo, w2lo, div);
+        __m128i hi = blendHalfSSE2(_mm_unpackhi_epi8(p1, zero), _mm_unpackhi_epi8(p2, zero), w1hi, w2hi, div);
+
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(_mm_packus_epi16(lo, hi), alpha));
+    }
+    alphaBlendScalar(src1 + i, src2 + i, dst + i, count - i, opacity);
+}
+
+PX_TARGET_SSE2
+static void weightedSumSSE2(const Uint32 *const *srcs, const Uint16 *weights, int taps, Uint32 *dst, size_t count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alpha = _mm_set1_epi32((int)PX_ALPHA_MASK);
+    const __m128i half = _mm_set1_epi16(128);
+    size_t i = 0;
+
+    // Weights sum to 256, so 16-bit sums of 8-bit channels cannot overflow
+    for (; i + 4 <= count; i += 4) {
+        __m128i lo = half;
+        __m128i hi = half;
+        for (int k = 0; k < taps; k++) {
+            __m128i p = _mm_loadu_si128((const __m128i*)(srcs[k] + i));
+            __m128i w = _mm_set1_epi16((short)weights[k]);
+            lo = _mm_add_epi16(lo, _mm_mullo_epi16(_mm_unpacklo_epi8(p, zero), w));
+            hi = _mm_add_epi16(hi, _mm_mullo_epi16(_mm_unpackhi_epi8(p, zero), w));
+        }
+        __m128i packed = _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(packed, alpha));
+    }
+    weightedSumFrom(srcs, weights, taps, dst, i, count);
+}
+
+PX_TARGET_SSE2
+static void copyKey8SSE2(const Uint8 *src, Uint8 *dst, size_t count, Uint8 key)
+{
+    __m128i k = _mm_set1_epi8((char)key);
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i keep = _mm_cmpeq_epi8(s, k);
+        d = _mm_or_si128(_mm_and_si128(keep, d), _mm_andnot_si128(keep, s));
+        _mm_storeu_si128((__m128i*)(dst + i), d);
+    }
+    copyKey8Scalar(src + i, dst + i, count - i, key);
+}
+
+// -- AVX2, 8 pixels per iteration (32 for 8-bit indices)
+
+PX_TARGET_AVX2
+static void clearAVX2(Uint32 *dst, size_t count, Uint32 color)
+{
+    __m256i c = _mm256_set1_epi32((int)color);
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_si256((__m256i*)(dst + i), c);
+    }
+    clearScalar(dst + i, count - i, color);
+}
+
+PX_TARGET_AVX2
+static void copyKeyAVX2(const Uint32 *src, Uint32 *dst, size_t count, Uint32 key)
+{
+    __m256i k = _mm256_set1_epi32((int)key);
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+        d = _mm256_blendv_epi8(s, d, _mm256_cmpeq_epi32(s, k));
+        _mm256_storeu_si256((__m256i*)(dst + i), d);
+    }
+    copyKeyScalar(src + i, dst + i, count - i, key);
+}
+
+PX_TARGET_AVX2
+static inline __m256i blendHalfAVX2(__m256i c1, __m256i c2, __m256i w1, __m256i w2, __m256i div)
+{
+    __m256i x = _mm256_add_epi16(_mm256_mullo_epi16(c1, w1), _mm256_mullo_epi16(c2, w2));
+    return _mm256_srli_epi16(_mm256_mulhi_epu16(x, div), PX_DIV100_SHIFT);
+}
+
+PX_TARGET_AVX2
+static void alphaBlendAVX2(const Uint32 *src1, const Uint32 *src2, Uint32 *dst, size_t count, int opacity)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i alpha = _mm256_set1_epi32((int)PX_ALPHA_MASK);
+    const __m256i hundred = _mm256_set1_epi16(100);
+    const __m256i div = _mm256_set1_epi16((short)PX_DIV100_MUL);
+    const __m256i op = _mm256_set1_epi32(opacity | (opacity << 16));
+    size_t i = 0;
+
+    // Unpack and pack work per 128-bit lane, so pixel order is preserved
+    for (; i + 8 <= count; i += 8) {
+        __m256i p1 = _mm256_loadu_si256((const __m256i*)(src1 + i));
+        __m256i p2 = _mm256_loadu_si256((const __m256i*)(src2 + i));
+
+        __m256i transparent = _mm256_cmpeq_epi32(_mm256_and_si256(p2, alpha), zero);
+        __m256i w2 = _mm256_andnot_si256(transparent, op);
+        __m256i w2lo = _mm256_unpacklo_epi32(w2, w2);
+        __m256i w2hi = _mm256_unpackhi_epi32(w2, w2);
+        __m256i w1lo = _mm256_sub_epi16(hundred, w2lo);
+        __m256i w1hi = _mm256_sub_epi16(hundred, w2hi);
+
+        __m256i lo = blendHalfAVX2(_mm256_unpacklo_epi8(p1, zero), _mm256_unpacklo_epi8(p2, zero), w1lo, w2lo, div);
+        __m256i hi = blendHalfAVX2(_mm256_unpackhi_epi8(p1, zero), _mm256_unpackhi_epi8(p2, zero), w1hi, w2hi, div);
+
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_or_si256(_mm256_packus_epi16(lo, hi), alpha));
+    }
+    alphaBlendSSE2(src1 + i, src2 + i, dst + i, count - i, opacity);
+}
+
+PX_TARGET_AVX2
+static void weightedSumAVX2(const Uint32 *const *srcs, const Uint16 *weights, int taps, Uint32 *dst, size_t count)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i alpha = _mm256_set1_epi32((int)PX_ALPHA_MASK);
+    const __m256i half = _mm256_set1_epi16(128);
+    size_t i = 0;
+
+    // Unpack and pack both work within 128-bit lanes, pixel order is kept
+    for (; i + 8 <= count; i += 8) {
+        __m256i lo = half;
+        __m256i hi = half;
+        for (int k = 0; k < taps; k++) {
+            __m256i p = _mm256_loadu_si256((const __m256i*)(srcs[k] + i));
+            __m256i w = _mm256_set1_epi16((short)weights[k]);
+            lo = _mm256_add_epi16(lo, _mm256_mullo_epi16(_mm256_unpacklo_epi8(p, zero), w));
+            hi = _mm256_add_epi16(hi, _mm256_mullo_epi16(_mm256_unpackhi_epi8(p, zero), w));
+        }
+        __m256i packed = _mm256_packus_epi16(_mm256_srli_epi16(lo, 8), _mm256_srli_epi16(hi, 8));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_or_si256(packed, alpha));
+    }
+    weightedSumFrom(srcs, weights, taps, dst, i, count);
+}
+
+PX_TARGET_AVX2
+static void copyKey8AVX2(const Uint8 *src, Uint8 *dst, size_t count, Uint8 key)
+{
+    __m256i k = _mm256_set1_epi8((char)key);
+    size_t i = 0;
+
+    for (; i + 32 <= count; i += 32) {
+        __m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+        d = _mm256_blendv_epi8(s, d, _mm256_cmpeq_epi8(s, k));
+        _mm256_storeu_si256((__m256i*)(dst + i), d);
+    }
+    copyKey8SSE2(src + i, dst + i, count - i, key);
+}
+#endif // PX_X86
+
+#ifdef PX_NEON
+// -- NEON, 4 pixels per iteration (16 for 8-bit indices)
+
+static void clearNEON(Uint32 *dst, size_t count, Uint32 color)
+{
+    uint32x4_t c = vdupq_n_u32(color);
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        vst1q_u32(dst + i, c);
+    }
+    clearScalar(dst + i, count - i, color);
+}
+
+static void copyKeyNEON(const Uint32 *src, Uint32 *dst, size_t count, Uint32 key)
+{
+    uint32x4_t k = vdupq_n_u32(key);
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        uint32x4_t s = vld1q_u32(src + i);
+        uint32x4_t d = vld1q_u32(dst + i);
+        vst1q_u32(dst + i, vbslq_u32(vceqq_u32(s, k), d, s));
+    }
+    copyKeyScalar(src + i, dst + i, count - i, key);
+}
+
+static inline uint8x8_t blendHalfNEON(uint8x8_t c1, uint8x8_t c2, uint8x8_t w1, uint8x8_t w2)
+{
+    uint16x8_t x = vmlal_u8(vmull_u8(c1, w1), c2, w2);
+    uint16x4_t lo = vshrn_n_u32(vmull_n_u16(vget_low_u16(x), PX_DIV100_MUL), 16);
+    uint16x4_t hi = vshrn_n_u32(vmull_n_u16(vget_high_u16(x), PX_DIV100_MUL), 16);
+    return vmovn_u16(vshrq_n_u16(vcombine_u16(lo, hi), PX_DIV100_SHIFT));
+}
+
+static void alphaBlendNEON(const Uint32 *src1, const Uint32 *src2, Uint32 *dst, size_t count, int opacity)
+{
+    const uint32x4_t alpha = vdupq_n_u32(PX_ALPHA_MASK);
+    const uint32x4_t op = vdupq_n_u32((Uint32)opacity * 0x01010101u);
+    const uint8x16_t hundred = vdupq_n_u8(100);
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        uint32x4_t p1 = vld1q_u32(src1 + i);
+        uint32x4_t p2 = vld1q_u32(src2 + i);
+
+        // Opacity in every byte of pixels whose src2 alpha is non-zero
+        uint8x16_t w2 = vreinterpretq_u8_u32(vandq_u32(vtstq_u32(p2, alpha), op));
+        uint8x16_t w1 = vsubq_u8(hundred, w2);
+        uint8x16_t c1 = vreinterpretq_u8_u32(p1);
+        uint8x16_t c2 = vreinterpretq_u8_u32(p2);
+
+        uint8x8_t lo = blendHalfNEON(vget_low_u8(c1), vget_low_u8(c2), vget_low_u8(w1), vget_low_u8(w2));
+        uint8x8_t hi = blendHalfNEON(vget_high_u8(c1), vget_high_u8(c2), vget_high_u8(w1), vget_high_u8(w2));
+
+        vst1q_u32(dst + i, vorrq_u32(vreinterpretq_u32_u8(vcombine_u8(lo, hi)), alpha));
+    }
+    alphaBlendScalar(src1 + i, src2 + i, dst + i, count - i, opacity);
+}
+
+static void weightedSumNEON(const Uint32 *const *srcs, const Uint16 *weights, int taps, Uint32 *dst, size_t count)
+{
+    const uint32x4_t alpha = vdupq_n_u32(PX_ALPHA_MASK);
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        uint16x8_t lo = vdupq_n_u16(128);
+        uint16x8_t hi = vdupq_n_u16(128);
+        for (int k = 0; k < taps; k++) {
+            uint8x16_t p = vreinterpretq_u8_u32(vld1q_u32(srcs[k] + i));
+            lo = vmlaq_n_u16(lo, vmovl_u8(vget_low_u8(p)), weights[k]);
+            hi = vmlaq_n_u16(hi, vmovl_u8(vget_high_u8(p)), weights[k]);
+        }
+        uint8x16_t packed = vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8));
+        vst1q_u32(dst + i, vorrq_u32(vreinterpretq_u32_u8(packed), alpha));
+    }
+    weightedSumFrom(srcs, weights, taps, dst, i, count);
+}
+
+static void copyKey8NEON(const Uint8 *src, Uint8 *dst, size_t count, Uint8 key)
+{
+    uint8x16_t k = vdupq_n_u8(key);
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        uint8x16_t s = vld1q_u8(src + i);
+        uint8x16_t d = vld1q_u8(dst + i);
+        vst1q_u8(dst + i, vbslq_u8(vceqq_u8(s, k), d, s));
+    }
+    copyKey8Scalar(src + i, dst + i, count - i, key);
+}
+#endif // PX_NEON
+
+static bool cpuSupports(int impl)
+{
+    switch (impl) {
+    case PX_IMPL_SCALAR:
+        return true;
+#ifdef PX_X86
+    case PX_IMPL_SSE2:
+        return SDL_HasSSE2() == SDL_TRUE;
+    case PX_IMPL_AVX2:
+        return SDL_HasAVX2() == SDL_TRUE;
+#endif
+#ifdef PX_NEON
+    case PX_IMPL_NEON:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+bool pxSetImplementation(int impl)
+{
+    if (!cpuSupports(impl))
+        return false;
+
+    switch (impl) {
+#ifdef PX_X86
+    case PX_IMPL_SSE2:
+        gPx.name = "SSE2";
+        gPx.clear = clearSSE2;
+        gPx.copyKey = copyKeySSE2;
+        gPx.alphaBlend = alphaBlendSSE2;
+        gPx.weightedSum = weightedSumSSE2;
+        gPx.copyKey8 = copyKey8SSE2;
+        break;
+    case PX_IMPL_AVX2:
+        gPx.name = "AVX2";
+        gPx.clear = clearAVX2;
+        gPx.copyKey = copyKeyAVX2;
+        gPx.alphaBlend = alphaBlendAVX2;
+        gPx.weightedSum = weightedSumAVX2;
+        gPx.copyKey8 = copyKey8AVX2;
+        break;
+#endif
+#ifdef PX_NEON
+    case PX_IMPL_NEON:
+        gPx.name = "NEON";
+        gPx.clear = clearNEON;
+        gPx.copyKey = copyKeyNEON;
+        gPx.alphaBlend = alphaBlendNEON;
+        gPx.weightedSum = weightedSumNEON;
+        gPx.copyKey8 = copyKey8NEON;
+        break;
+#endif
+    default:
+        gPx.name = "scalar";
+        gPx.clear = clearScalar;
+        gPx.copyKey = copyKeyScalar;
+        gPx.alphaBlend = alphaBlendScalar;
+        gPx.weightedSum = weightedSumScalar;
+        gPx.copyKey8 = copyKey8Scalar;
+        break;
+    }
+    gPx.impl = impl;
+    gPxReady = true;
+
+    return true;
+}
+
+void pxInit()
+{
+    const int preferred[] = { PX_IMPL_AVX2, PX_IMPL_SSE2, PX_IMPL_NEON };
+
+    for (int i = 0; i < 3; i++) {
+        if (pxSetImplementation(preferred[i]))
+            return;
+    }
+    pxSetImplementation(PX_IMPL_SCALAR);
+}
+
+static inline const PxKernels &kernels()
+{
+    if (!gPxReady)
+        pxInit();
+    return gPx;
+}
+
+int pxImplementation()
+{
+    return kernels().impl;
+}
+
+const char* pxImplementationName()
+{
+    return kernels().name;
+}
+
+void pxClear(Uint32 *dst, size_t count, Uint32 color)
+{
+    kernels().clear(dst, count, color);
+}
+
+void pxCopyKey(const Uint32 *src, Uint32 *dst, size_t count, Uint32 key)
+{
+    kernels().copyKey(src, dst, count, key);
+}
+
+void pxAlphaBlend(const Uint32 *src1, const Uint32 *src2, Uint32 *dst, size_t count, int opacity)
+{
+    kernels().alphaBlend(src1, src2, dst, count, opacity);
+}
+
+void pxWeightedSum(const Uint32 *const *srcs, const Uint16 *weights, int taps, Uint32 *dst, size_t count)
+{
+    kernels().weightedSum(srcs, weights, taps, dst, count);
+}
+
+void pxFillRect(Uint32 *dst, int pitch, int x, int y, int w, int h, Uint32 color)
+{
+    PxClearFunc clear = kernels().clear;
+
+    for (int row = y; row < y + h; row++) {
+        clear(dst + row * pitch + x, w, color);
+    }
+}
+
+void pxCopyKeyRect(const Uint32 *src, Uint32 *dst, int pitch, int x, int y, int w, int h, Uint32 key)
+{
+    PxCopyKeyFunc copyKey = kernels().copyKey;
+
+    for (int row = y; row < y + h; row++) {
+        copyKey(src + row * pitch + x, dst + row * pitch + x, w, key);
+    }
+}
+
+void pxAlphaBlendRect(const Uint32 *src1, const Uint32 *src2, Uint32 *dst, int pitch, int x, int y, int w, int h, int opacity)
+{
+    PxAlphaBlendFunc alphaBlend = kernels().alphaBlend;
+
+    for (int row = y; row < y + h; row++) {
+        int offset = row * pitch + x;
+        alphaBlend(src1 + offset, src2 + offset, dst + offset, w, opacity);
+    }
+}
+
+void pxClear8(Uint8 *dst, size_t count, Uint8 index)
+{
+    // memset is already vectorised by the C library
+    memset(dst, index, count);
+}
+
+void pxCopyKey8(const Uint8 *src, Uint8 *dst, size_t count, Uint8 key)
+{
+    kernels().copyKey8(src, dst, count, key);
+}
+
+void pxFillRect8(Uint8 *dst, int pitch, int x, int y, int w, int h, Uint8 index)
+{
+    for (int row = y; row < y + h; row++) {
+        memset(dst + row * pitch + x, index, w);
+    }
+}
+
+void pxCopyKeyRect8(const Uint8 *src, Uint8 *dst, int pitch, int x, int y, int w, int h, Uint8 key)
+{
+    PxCopyKey8Func copyKey8 = kernels().copyKey8;
+
+    for (int row = y; row < y + h; row++) {
+        copyKey8(src + row * pitch + x, dst + row * pitch + x, w, key);
+    }
+}
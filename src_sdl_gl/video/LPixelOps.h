@@ -0,0 +1,47 @@
+// Pixel compositing kernels for SWOS 2020 rendering engine
+#ifndef LPIXEL_OPS_H
+#define LPIXEL_OPS_H
+
+#include <stddef.h>
+#include <SDL.h>
+
+// Kernel implementations
+#define PX_IMPL_SCALAR 0
+#define PX_IMPL_SSE2   1
+#define PX_IMPL_AVX2   2
+#define PX_IMPL_NEON   3
+
+// Pixels are 32-bit RGBA packed as (a << 24) + (b << 16) + (g << 8) + r.
+// All kernels give bit-identical results whichever implementation is picked.
+
+// Select best implementation for this CPU (called lazily if omitted)
+void pxInit();
+// Force an implementation, returns false if the CPU cannot run it
+bool pxSetImplementation(int impl);
+int pxImplementation();
+const char* pxImplementationName();
+
+// Row kernels, 'count' pixels each
+void pxClear(Uint32 *dst, size_t count, Uint32 color);
+void pxCopyKey(const Uint32 *src, Uint32 *dst, size_t count, Uint32 key);
+// dst = src1 * (100 - opacity) / 100 + src2 * opacity / 100 per channel, alpha 255.
+// Pixels of src2 with alpha 0 leave src1 untouched. 'opacity' is 0..100.
+void pxAlphaBlend(const Uint32 *src1, const Uint32 *src2, Uint32 *dst, size_t count, int opacity);
+// dst = (sum of srcs[k] * weights[k] + 128) / 256 per channel, alpha 255, for
+// 1..PX_MAX_TAPS rows. Weights must sum to 256; rows may be shifted pointers
+// into the same row, which makes this a horizontal filter.
+#define PX_MAX_TAPS 64
+void pxWeightedSum(const Uint32 *const *srcs, const Uint16 *weights, int taps, Uint32 *dst, size_t count);
+
+// Rectangle helpers, 'pitch' in pixels
+void pxFillRect(Uint32 *dst, int pitch, int x, int y, int w, int h, Uint32 color);
+void pxCopyKeyRect(const Uint32 *src, Uint32 *dst, int pitch, int x, int y, int w, int h, Uint32 key);
+void pxAlphaBlendRect(const Uint32 *src1, const Uint32 *src2, Uint32 *dst, int pitch, int x, int y, int w, int h, int opacity);
+
+// 8-bit palette index kernels
+void pxClear8(Uint8 *dst, size_t count, Uint8 index);
+void pxCopyKey8(const Uint8 *src, Uint8 *dst, size_t count, Uint8 key);
+void pxFillRect8(Uint8 *dst, int pitch, int x, int y, int w, int h, Uint8 index);
+void pxCopyKeyRect8(const Uint8 *src, Uint8 *dst, int pitch, int x, int y, int w, int h, Uint8 key);
+
+#endif // LPIXEL_OPS_H
@@ -0,0 +1,332 @@
+// Frame stage timing with CPU clocks and GPU timer queries
+#include "LProfiler.h"
+#include <algorithm>
+
+LProfiler::LProfiler()
+{
+    mEnabled = false;
+    mGPUTiming = false;
+    mFrameStage = -1;
+    mFrame = 0;
+    mActiveQuery = -1;
+
+    mEpoch = SDL_GetPerformanceCounter();
+    mFrequency = (double)SDL_GetPerformanceFrequency();
+
+    mTraceFile = NULL;
+    mTraceFirst = true;
+}
+
+LProfiler::~LProfiler()
+{
+    //Close trace and release queries
+    freeProfiler();
+}
+
+void LProfiler::setEnabled( bool enabled )
+{
+    mEnabled = enabled;
+}
+
+bool LProfiler::enabled()
+{
+    return mEnabled;
+}
+
+void LProfiler::freeProfiler()
+{
+    stopTrace();
+
+    for( size_t i = 0; i < mStages.size(); ++i )
+    {
+        LProfileStage* stage = mStages[ i ];
+        if( stage->gpu && stage->queries[ 0 ] != 0 )
+        {
+            glDeleteQueries( LPROFILER_QUERY_FRAMES, stage->queries );
+        }
+        delete stage;
+    }
+    mStages.clear();
+
+    mFrameStage = -1;
+    mFrame = 0;
+    mActiveQuery = -1;
+}
+
+int LProfiler::addStage( std::string name, bool gpu )
+{
+    //Whole frame time is always the first stage
+    if( mFrameStage < 0 && name != "frame" )
+    {
+        mFrameStage = addStage( "frame", false );
+    }
+    else if( mFrameStage < 0 )
+    {
+        mFrameStage = 0;
+    }
+
+    //Registering again, e.g. after a shader reload, reuses the stage
+    for( size_t i = 0; i < mStages.size(); ++i )
+    {
+        if( mStages[ i ]->name == name )
+        {
+            return (int)i;
+        }
+    }
+
+    //Timer queries are core in 3.3, check anyway for older contexts
+    if( gpu && !GLEW_ARB_timer_query )
+    {
+        printf( "Timer queries not supported, GPU stage %s not timed\n", name.c_str() );
+    }
+
+    LProfileStage* stage = new LProfileStage();
+    stage->name = name;
+    stage->gpu = gpu && GLEW_ARB_timer_query;
+    stage->start = 0;
+    stage->historyCount = 0;
+    stage->historyIndex = 0;
+    stage->frameMs = 0.0;
+    stage->frameUsed = false;
+    for( int i = 0; i < LPROFILER_QUERY_FRAMES; ++i )
+    {
+        stage->queries[ i ] = 0;
+        stage->queryUsed[ i ] = false;
+        stage->queryStart[ i ] = 0;
+    }
+    if( stage->gpu )
+    {
+        glGenQueries( LPROFILER_QUERY_FRAMES, stage->queries );
+        mGPUTiming = true;
+    }
+    mStages.push_back( stage );
+
+    return (int)mStages.size() - 1;
+}
+
+int LProfiler::stageCount()
+{
+    return (int)mStages.size();
+}
+
+void LProfiler::beginFrame()
+{
+    if( !mEnabled || mStages.empty() )
+    {
+        return;
+    }
+
+    //Read back the slot about to be reused, its frame was queued
+    //LPROFILER_QUERY_FRAMES frames ago and is normally done by now
+    resolveQueries( (int)( mFrame % LPROFILER_QUERY_FRAMES ) );
+
+    for( size_t i = 0; i < mStages.size(); ++i )
+    {
+        mStages[ i ]->frameMs = 0.0;
+        mStages[ i ]->frameUsed = false;
+    }
+
+    begin( mFrameStage );
+}
+
+void LProfiler::endFrame()
+{
+    if( !mEnabled || mStages.empty() )
+    {
+        return;
+    }
+
+    end( mFrameStage );
+
+    //CPU stages are complete, GPU stages arrive with resolveQueries()
+    for( size_t i = 0; i < mStages.size(); ++i )
+    {
+        LProfileStage& stage = *mStages[ i ];
+        if( !stage.gpu && stage.frameUsed )
+        {
+            addSample( stage, stage.frameMs );
+        }
+    }
+
+    ++mFrame;
+}
+
+void LProfiler::begin( int stage )
+{
+    if( !mEnabled || stage < 0 || stage >= (int)mStages.size() )
+    {
+        return;
+    }
+
+    LProfileStage& s = *mStages[ stage ];
+    s.start = SDL_GetPerformanceCounter();
+
+    if( s.gpu )
+    {
+        //Only one GL_TIME_ELAPSED query can be active
+        if( mActiveQuery >= 0 )
+        {
+            printf( "GPU stage %s overlaps %s, not timed\n", s.name.c_str(), mStages[ mActiveQuery ]->name.c_str() );
+            return;
+        }
+
+        int slot = (int)( mFrame % LPROFILER_QUERY_FRAMES );
+        glBeginQuery( GL_TIME_ELAPSED, s.queries[ slot ] );
+        s.queryUsed[ slot ] = true;
+        s.queryStart[ slot ] = s.start;
+        mActiveQuery = stage;
+    }
+}
+
+void LProfiler::end( int stage )
+{
+    if( !mEnabled || stage < 0 || stage >= (int)mStages.size() )
+    {
+        return;
+    }
+
+    LProfileStage& s = *mStages[ stage ];
+    if( s.gpu )
+    {
+        if( mActiveQuery == stage )
+        {
+            glEndQuery( GL_TIME_ELAPSED );
+            mActiveQuery = -1;
+        }
+        return;
+    }
+
+    Uint64 now = SDL_GetPerformanceCounter();
+    double ms = ( now - s.start ) * 1000.0 / mFrequency;
+    s.frameMs += ms;
+    s.frameUsed = true;
+    traceEvent( s, s.start, ms );
+}
+
+void LProfiler::resolveQueries( int slot )
+{
+    if( !mGPUTiming )
+    {
+        return;
+    }
+
+    for( size_t i = 0; i < mStages.size(); ++i )
+    {
+        LProfileStage& stage = *mStages[ i ];
+        if( !stage.gpu || !stage.queryUsed[ slot ] )
+        {
+            continue;
+        }
+        stage.queryUsed[ slot ] = false;
+
+        //Never stall, a result still in flight is dropped
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv( stage.queries[ slot ], GL_QUERY_RESULT_AVAILABLE, &available );
+        if( available != GL_TRUE )
+        {
+            continue;
+        }
+
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v( stage.queries[ slot ], GL_QUERY_RESULT, &elapsed );
+        double ms = elapsed / 1000000.0;
+        addSample( stage, ms );
+
+        //Placed at submission time, the GPU runs it somewhat later
+        traceEvent( stage, stage.queryStart[ slot ], ms );
+    }
+}
+
+void LProfiler::addSample( LProfileStage& stage, double ms )
+{
+    stage.history[ stage.historyIndex ] = (float)ms;
+    stage.historyIndex = ( stage.historyIndex + 1 ) % LPROFILER_HISTORY;
+    if( stage.historyCount < LPROFILER_HISTORY )
+    {
+        ++stage.historyCount;
+    }
+}
+
+double LProfiler::percentile( int stage, double p )
+{
+    if( stage < 0 || stage >= (int)mStages.size() || mStages[ stage ]->historyCount == 0 )
+    {
+        return 0.0;
+    }
+
+    LProfileStage& s = *mStages[ stage ];
+    std::vector<float> samples( s.history, s.history + s.historyCount );
+
+    //Nearest rank
+    size_t rank = (size_t)( p / 100.0 * ( samples.size() - 1 ) + 0.5 );
+    std::nth_element( samples.begin(), samples.begin() + rank, samples.end() );
+
+    return samples[ rank ];
+}
+
+void LProfiler::report()
+{
+    if( mStages.empty() )
+    {
+        return;
+    }
+
+    printf( "%-24s %4s %9s %9s %9s %9s\n", "stage (ms)", "", "p50", "p95", "p99", "max" );
+    for( size_t i = 0; i < mStages.size(); ++i )
+    {
+        LProfileStage& s = *mStages[ i ];
+        if( s.historyCount == 0 )
+        {
+            continue;
+        }
+        printf( "%-24s %4s %9.3f %9.3f %9.3f %9.3f\n", s.name.c_str(), s.gpu ? "gpu" : "cpu",
+            percentile( i, 50.0 ), percentile( i, 95.0 ), percentile( i, 99.0 ), percentile( i, 100.0 ) );
+    }
+}
+
+bool LProfiler::startTrace( std::string path )
+{
+    stopTrace();
+
+    mTraceFile = fopen( path.c_str(), "w" );
+    if( mTraceFile == NULL )
+    {
+        printf( "Unable to open trace file %s\n", path.c_str() );
+        return false;
+    }
+
+    fprintf( mTraceFile, "{\"traceEvents\":[\n" );
+    fprintf( mTraceFile, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n" );
+    fprintf( mTraceFile, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}" );
+    mTraceFirst = false;
+
+    return true;
+}
+
+void LProfiler::stopTrace()
+{
+    if( mTraceFile != NULL )
+    {
+        fprintf( mTraceFile, "\n]}\n" );
+        fclose( mTraceFile );
+        mTraceFile = NULL;
+    }
+}
+
+double LProfiler::toMicroseconds( Uint64 ticks )
+{
+    return ( ticks - mEpoch ) * 1000000.0 / mFrequency;
+}
+
+void LProfiler::traceEvent( const LProfileStage& stage, Uint64 start, double ms )
+{
+    if( mTraceFile == NULL )
+    {
+        return;
+    }
+
+    //Complete event, GPU stages on their own track
+    fprintf( mTraceFile, "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+        mTraceFirst ? "" : ",", stage.name.c_str(), stage.gpu ? "gpu" : "cpu", stage.gpu ? 2 : 1, toMicroseconds( start ), ms * 1000.0 );
+    mTraceFirst = false;
+}
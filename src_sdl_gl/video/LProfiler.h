@@ -0,0 +1,90 @@
+// Frame stage timing with CPU clocks and GPU timer queries
+#ifndef LPROFILER_H
+#define LPROFILER_H
+
+#include "LOpenGL.h"
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <SDL.h>
+
+//Frames of samples kept for percentiles
+#define LPROFILER_HISTORY 512
+
+//Frames of GPU queries in flight before results are read back
+#define LPROFILER_QUERY_FRAMES 4
+
+//One timed part of a frame
+struct LProfileStage
+{
+    std::string name;
+    bool gpu;
+
+    //Start of the running measurement, counter ticks
+    Uint64 start;
+
+    //Milliseconds of the last LPROFILER_HISTORY frames
+    float history[ LPROFILER_HISTORY ];
+    int historyCount;
+    int historyIndex;
+
+    //Time accumulated in the current frame, a stage may run more than once
+    double frameMs;
+    bool frameUsed;
+
+    //GPU queries per frame slot
+    GLuint queries[ LPROFILER_QUERY_FRAMES ];
+    bool queryUsed[ LPROFILER_QUERY_FRAMES ];
+    Uint64 queryStart[ LPROFILER_QUERY_FRAMES ];
+};
+
+class LProfiler
+{
+    public:
+        LProfiler();
+        ~LProfiler();
+        void setEnabled( bool enabled );
+        bool enabled();
+        void freeProfiler();
+
+        //Register a stage, returns its id
+        int addStage( std::string name, bool gpu );
+        int stageCount();
+
+        void beginFrame();
+        void endFrame();
+
+        //CPU stages use the performance counter, GPU stages a
+        //GL_TIME_ELAPSED query; GPU stages must not overlap
+        void begin( int stage );
+        void end( int stage );
+
+        //Percentile 0..100 over the rolling history, in milliseconds
+        double percentile( int stage, double p );
+        void report();
+
+        //Chrome trace (chrome://tracing, Perfetto) of every frame until stopped
+        bool startTrace( std::string path );
+        void stopTrace();
+
+    private:
+        void resolveQueries( int slot );
+        void addSample( LProfileStage& stage, double ms );
+        void traceEvent( const LProfileStage& stage, Uint64 start, double ms );
+        double toMicroseconds( Uint64 ticks );
+
+        std::vector<LProfileStage*> mStages;
+        bool mEnabled;
+        bool mGPUTiming;
+        int mFrameStage;
+        Uint64 mFrame;
+        int mActiveQuery;
+
+        Uint64 mEpoch;
+        double mFrequency;
+
+        FILE* mTraceFile;
+        bool mTraceFirst;
+};
+
+#endif
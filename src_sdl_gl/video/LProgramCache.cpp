@@ -0,0 +1,196 @@
+// On-disk cache of linked shader program binaries
+#include "LProgramCache.h"
+#include <string.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+//Cache file layout: header followed by 'length' bytes of binary
+#define LPROGRAM_CACHE_MAGIC   0x42505350 //"PSPB"
+#define LPROGRAM_CACHE_VERSION 1
+
+struct LProgramCacheHeader
+{
+    Uint32 magic;
+    Uint32 version;
+    Uint64 key;
+    Uint32 format;
+    Uint32 length;
+};
+
+std::string LProgramCache::mDirectory;
+std::string LProgramCache::mDriverString;
+int LProgramCache::mSupported = -1;
+
+void LProgramCache::setDirectory( std::string directory )
+{
+    mDirectory = directory;
+    if( mDirectory.empty() )
+    {
+        return;
+    }
+
+#ifdef _WIN32
+    _mkdir( mDirectory.c_str() );
+#else
+    mkdir( mDirectory.c_str(), 0755 );
+#endif
+}
+
+bool LProgramCache::enabled()
+{
+    return !mDirectory.empty() && driverSupported();
+}
+
+bool LProgramCache::driverSupported()
+{
+    //Checked once a context exists
+    if( mSupported < 0 )
+    {
+        GLint formats = 0;
+        if( GLEW_ARB_get_program_binary )
+        {
+            glGetIntegerv( GL_NUM_PROGRAM_BINARY_FORMATS, &formats );
+        }
+        mSupported = formats > 0 ? 1 : 0;
+
+        //Binaries are only valid for the driver that produced them
+        const char* vendor = (const char*)glGetString( GL_VENDOR );
+        const char* renderer = (const char*)glGetString( GL_RENDERER );
+        const char* version = (const char*)glGetString( GL_VERSION );
+        mDriverString = std::string( vendor ? vendor : "" ) + "\n" + ( renderer ? renderer : "" ) + "\n" + ( version ? version : "" );
+
+        if( mSupported == 0 )
+        {
+            printf( "Program binaries not supported by driver, shader cache disabled\n" );
+        }
+    }
+
+    return mSupported == 1;
+}
+
+Uint64 LProgramCache::hashString( Uint64 hash, const std::string& text )
+{
+    //FNV-1a, including the terminator so concatenations do not collide
+    for( size_t i = 0; i <= text.size(); ++i )
+    {
+        hash ^= (unsigned char)text.c_str()[ i ];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+Uint64 LProgramCache::programKey( const std::string& vsSource, const std::string& fsSource )
+{
+    driverSupported();
+
+    //Defines are injected into the sources, so they are part of the key
+    Uint64 hash = 0xcbf29ce484222325ULL;
+    hash = hashString( hash, vsSource );
+    hash = hashString( hash, fsSource );
+    hash = hashString( hash, mDriverString );
+
+    return hash;
+}
+
+std::string LProgramCache::binaryPath( Uint64 key )
+{
+    char name[ 32 ];
+    sprintf( name, "%08x%08x.bin", (Uint32)( key >> 32 ), (Uint32)key );
+
+    return mDirectory + "/" + name;
+}
+
+bool LProgramCache::loadProgramBinary( GLuint programID, Uint64 key )
+{
+    if( !enabled() )
+    {
+        return false;
+    }
+
+    FILE* file = fopen( binaryPath( key ).c_str(), "rb" );
+    if( file == NULL )
+    {
+        return false;
+    }
+
+    LProgramCacheHeader header;
+    bool success = false;
+    if( fread( &header, sizeof( header ), 1, file ) == 1 &&
+        header.magic == LPROGRAM_CACHE_MAGIC && header.version == LPROGRAM_CACHE_VERSION &&
+        header.key == key && header.length > 0 )
+    {
+        char* binary = new char[ header.length ];
+        if( fread( binary, header.length, 1, file ) == 1 )
+        {
+            glProgramBinary( programID, header.format, binary, header.length );
+
+            //The driver may refuse binaries after an update
+            GLint programSuccess = GL_FALSE;
+            glGetProgramiv( programID, GL_LINK_STATUS, &programSuccess );
+            success = programSuccess == GL_TRUE;
+        }
+        delete[] binary;
+    }
+    fclose( file );
+
+    //Clear errors of a rejected binary
+    while( glGetError() != GL_NO_ERROR )
+    {
+    }
+
+    if( !success )
+    {
+        printf( "Cached program binary %s rejected, recompiling\n", binaryPath( key ).c_str() );
+    }
+
+    return success;
+}
+
+bool LProgramCache::saveProgramBinary( GLuint programID, Uint64 key )
+{
+    if( !enabled() )
+    {
+        return false;
+    }
+
+    GLint length = 0;
+    glGetProgramiv( programID, GL_PROGRAM_BINARY_LENGTH, &length );
+    if( length <= 0 )
+    {
+        return false;
+    }
+
+    char* binary = new char[ length ];
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary( programID, length, &written, &format, binary );
+
+    bool success = false;
+    std::string path = binaryPath( key );
+    FILE* file = written > 0 ? fopen( path.c_str(), "wb" ) : NULL;
+    if( file != NULL )
+    {
+        LProgramCacheHeader header;
+        memset( &header, 0, sizeof( header ) );
+        header.magic = LPROGRAM_CACHE_MAGIC;
+        header.version = LPROGRAM_CACHE_VERSION;
+        header.key = key;
+        header.format = format;
+        header.length = written;
+
+        success = fwrite( &header, sizeof( header ), 1, file ) == 1 && fwrite( binary, written, 1, file ) == 1;
+        fclose( file );
+
+        //Never leave a truncated binary behind
+        if( !success )
+        {
+            remove( path.c_str() );
+        }
+    }
+    delete[] binary;
+
+    return success;
+}
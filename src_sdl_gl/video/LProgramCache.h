@@ -0,0 +1,34 @@
+// On-disk cache of linked shader program binaries
+#ifndef LPROGRAM_CACHE_H
+#define LPROGRAM_CACHE_H
+
+#include "LOpenGL.h"
+#include <stdio.h>
+#include <string>
+#include <SDL.h>
+
+class LProgramCache
+{
+    public:
+        //Empty directory disables the cache
+        static void setDirectory( std::string directory );
+        static bool enabled();
+
+        //Key of a program built from the given sources on the current driver
+        static Uint64 programKey( const std::string& vsSource, const std::string& fsSource );
+
+        //Restore a program binary, false if missing or rejected by the driver
+        static bool loadProgramBinary( GLuint programID, Uint64 key );
+        static bool saveProgramBinary( GLuint programID, Uint64 key );
+
+    private:
+        static std::string binaryPath( Uint64 key );
+        static Uint64 hashString( Uint64 hash, const std::string& text );
+        static bool driverSupported();
+
+        static std::string mDirectory;
+        static std::string mDriverString;
+        static int mSupported;
+};
+
+#endif
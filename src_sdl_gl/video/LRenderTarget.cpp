@@ -0,0 +1,125 @@
+// Offscreen render targets for multi-pass shader pipelines
+#include "LRenderTarget.h"
+
+LRenderTargetPool::LRenderTargetPool()
+{
+}
+
+LRenderTargetPool::~LRenderTargetPool()
+{
+    //Free targets if they exist
+    freePool();
+}
+
+LRenderTarget* LRenderTargetPool::acquire( GLint width, GLint height, GLenum format )
+{
+    //Reuse an idle target of the same shape
+    for( size_t i = 0; i < mTargets.size(); ++i )
+    {
+        LRenderTarget* target = mTargets[ i ];
+        if( !target->inUse && target->width == width && target->height == height && target->format == format )
+        {
+            target->inUse = true;
+            return target;
+        }
+    }
+
+    LRenderTarget* target = createTarget( width, height, format );
+    if( target != NULL )
+    {
+        target->inUse = true;
+        mTargets.push_back( target );
+    }
+
+    return target;
+}
+
+void LRenderTargetPool::release( LRenderTarget* target )
+{
+    if( target != NULL )
+    {
+        target->inUse = false;
+    }
+}
+
+void LRenderTargetPool::trim()
+{
+    //Delete idle targets
+    size_t kept = 0;
+    for( size_t i = 0; i < mTargets.size(); ++i )
+    {
+        if( mTargets[ i ]->inUse )
+        {
+            mTargets[ kept++ ] = mTargets[ i ];
+        }
+        else
+        {
+            deleteTarget( mTargets[ i ] );
+        }
+    }
+    mTargets.resize( kept );
+}
+
+void LRenderTargetPool::freePool()
+{
+    for( size_t i = 0; i < mTargets.size(); ++i )
+    {
+        deleteTarget( mTargets[ i ] );
+    }
+    mTargets.clear();
+}
+
+int LRenderTargetPool::targetCount()
+{
+    return (int)mTargets.size();
+}
+
+LRenderTarget* LRenderTargetPool::createTarget( GLint width, GLint height, GLenum format )
+{
+    LRenderTarget* target = new LRenderTarget;
+    target->width = width;
+    target->height = height;
+    target->format = format;
+    target->inUse = false;
+
+    //Generate colour texture
+    glGenTextures( 1, &target->textureID );
+    glBindTexture( GL_TEXTURE_2D, target->textureID );
+    glTexImage2D( GL_TEXTURE_2D, 0, format, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+    glBindTexture( GL_TEXTURE_2D, 0 );
+
+    //Generate framebuffer
+    glGenFramebuffers( 1, &target->framebufferID );
+    glBindFramebuffer( GL_FRAMEBUFFER, target->framebufferID );
+    glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target->textureID, 0 );
+
+    GLenum status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
+    glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+
+    //Check for error
+    if( status != GL_FRAMEBUFFER_COMPLETE )
+    {
+        printf( "Unable to create %dx%d render target! Framebuffer status 0x%x\n", width, height, status );
+        deleteTarget( target );
+        return NULL;
+    }
+
+    return target;
+}
+
+void LRenderTargetPool::deleteTarget( LRenderTarget* target )
+{
+    if( target->framebufferID != 0 )
+    {
+        glDeleteFramebuffers( 1, &target->framebufferID );
+    }
+    if( target->textureID != 0 )
+    {
+        glDeleteTextures( 1, &target->textureID );
+    }
+    delete target;
+}
@@ -0,0 +1,39 @@
+// Offscreen render targets for multi-pass shader pipelines
+#ifndef LRENDER_TARGET_H
+#define LRENDER_TARGET_H
+
+#include "LOpenGL.h"
+#include <stdio.h>
+#include <vector>
+
+//Framebuffer object with a single colour texture
+struct LRenderTarget
+{
+    GLuint framebufferID;
+    GLuint textureID;
+    GLint width;
+    GLint height;
+    GLenum format;
+    bool inUse;
+};
+
+//Keeps render targets alive and hands them out again by size and format
+class LRenderTargetPool
+{
+    public:
+        LRenderTargetPool();
+        ~LRenderTargetPool();
+        LRenderTarget* acquire( GLint width, GLint height, GLenum format );
+        void release( LRenderTarget* target );
+        void trim();
+        void freePool();
+        int targetCount();
+
+    private:
+        LRenderTarget* createTarget( GLint width, GLint height, GLenum format );
+        void deleteTarget( LRenderTarget* target );
+
+        std::vector<LRenderTarget*> mTargets;
+};
+
+#endif
@@ -0,0 +1,295 @@
+// Recorded layer changes, played back frame by frame as a repeatable workload
+#include "LReplay.h"
+#include <string.h>
+
+LReplayWriter::LReplayWriter()
+{
+    mFile = NULL;
+    mWidth = 0;
+    mHeight = 0;
+    mBytesPerPixel = 0;
+    mChangeCount = 0;
+    mFrames = 0;
+}
+
+LReplayWriter::~LReplayWriter()
+{
+    close();
+}
+
+bool LReplayWriter::open( const std::string& path, GLuint width, GLuint height, GLuint bytesPerPixel, const void* background, const void* menu )
+{
+    close();
+
+    mFile = fopen( path.c_str(), "wb" );
+    if( mFile == NULL )
+    {
+        printf( "Unable to open %s for the replay!\n", path.c_str() );
+        return false;
+    }
+
+    LReplayHeader header;
+    memset( &header, 0, sizeof( header ) );
+    memcpy( header.magic, LREPLAY_MAGIC, 4 );
+    header.version = LREPLAY_VERSION;
+    header.width = width;
+    header.height = height;
+    header.bytesPerPixel = bytesPerPixel;
+
+    size_t bytes = (size_t)width * height * bytesPerPixel;
+    bool written = fwrite( &header, sizeof( header ), 1, mFile ) == 1;
+    written = written && fwrite( background, 1, bytes, mFile ) == bytes;
+    written = written && fwrite( menu, 1, bytes, mFile ) == bytes;
+    if( !written )
+    {
+        printf( "Unable to write %s!\n", path.c_str() );
+        close();
+        return false;
+    }
+
+    mPath = path;
+    mWidth = width;
+    mHeight = height;
+    mBytesPerPixel = bytesPerPixel;
+    mChanges.clear();
+    mChangeCount = 0;
+    mFrames = 0;
+
+    return true;
+}
+
+void LReplayWriter::close()
+{
+    if( mFile != NULL )
+    {
+        fclose( mFile );
+        mFile = NULL;
+    }
+    mChanges.clear();
+    mChangeCount = 0;
+}
+
+bool LReplayWriter::isOpen()
+{
+    return mFile != NULL;
+}
+
+int LReplayWriter::frameCount()
+{
+    return mFrames;
+}
+
+void LReplayWriter::addChange( int layer, const void* pixels, const LDirtyRect& rect )
+{
+    if( mFile == NULL || rect.w == 0 || rect.h == 0 || rect.x + rect.w > mWidth || rect.y + rect.h > mHeight )
+    {
+        return;
+    }
+
+    LReplayChange change;
+    change.layer = layer;
+    change.x = rect.x;
+    change.y = rect.y;
+    change.w = rect.w;
+    change.h = rect.h;
+
+    size_t pitch = rect.w * mBytesPerPixel;
+    size_t at = mChanges.size();
+    mChanges.resize( at + sizeof( change ) + pitch * rect.h );
+    memcpy( &mChanges[ at ], &change, sizeof( change ) );
+    at += sizeof( change );
+
+    const Uint8* source = (const Uint8*)pixels;
+    for( GLuint y = rect.y; y < rect.y + rect.h; ++y )
+    {
+        memcpy( &mChanges[ at ], source + ( (size_t)y * mWidth + rect.x ) * mBytesPerPixel, pitch );
+        at += pitch;
+    }
+    ++mChangeCount;
+}
+
+bool LReplayWriter::endFrame( Uint32 ticks )
+{
+    if( mFile == NULL )
+    {
+        return false;
+    }
+
+    LReplayFrame frame;
+    frame.ticks = ticks;
+    frame.changes = mChangeCount;
+
+    bool written = fwrite( &frame, sizeof( frame ), 1, mFile ) == 1;
+    written = written && ( mChanges.empty() || fwrite( &mChanges[ 0 ], 1, mChanges.size(), mFile ) == mChanges.size() );
+    mChanges.clear();
+    mChangeCount = 0;
+
+    if( !written )
+    {
+        printf( "Unable to write %s, replay stopped after %d frames!\n", mPath.c_str(), mFrames );
+        close();
+        return false;
+    }
+    ++mFrames;
+
+    return true;
+}
+
+LReplay::LReplay()
+{
+    memset( &mHeader, 0, sizeof( mHeader ) );
+}
+
+LReplay::~LReplay()
+{
+    close();
+}
+
+bool LReplay::open( const std::string& path )
+{
+    close();
+
+    if( !mFile.map( path ) )
+    {
+        printf( "Unable to open replay %s\n", path.c_str() );
+        return false;
+    }
+
+    const Uint8* data = mFile.data();
+    Uint64 size = mFile.size();
+    bool valid = size >= sizeof( LReplayHeader );
+    if( valid )
+    {
+        memcpy( &mHeader, data, sizeof( mHeader ) );
+        valid = memcmp( mHeader.magic, LREPLAY_MAGIC, 4 ) == 0 && mHeader.version == LREPLAY_VERSION;
+        valid = valid && ( mHeader.bytesPerPixel == 1 || mHeader.bytesPerPixel == 4 );
+        valid = valid && mHeader.width > 0 && mHeader.height > 0 && mHeader.width <= LIMAGE_MAX_SIZE && mHeader.height <= LIMAGE_MAX_SIZE;
+        valid = valid && sizeof( LReplayHeader ) + 2 * (Uint64)mHeader.width * mHeader.height * mHeader.bytesPerPixel <= size;
+    }
+    if( !valid )
+    {
+        printf( "Replay %s is damaged or of another version\n", path.c_str() );
+        close();
+        return false;
+    }
+
+    //Every change must fit its layer; the first frame that does not, or
+    //that the file ends inside, ends the replay
+    Uint64 at = sizeof( LReplayHeader ) + 2 * (Uint64)mHeader.width * mHeader.height * mHeader.bytesPerPixel;
+    while( at + sizeof( LReplayFrame ) <= size )
+    {
+        LReplayFrame frame;
+        memcpy( &frame, data + at, sizeof( frame ) );
+
+        Uint64 next = at + sizeof( frame );
+        bool complete = true;
+        for( Uint32 i = 0; complete && i < frame.changes; ++i )
+        {
+            LReplayChange change;
+            complete = next + sizeof( change ) <= size;
+            if( complete )
+            {
+                memcpy( &change, data + next, sizeof( change ) );
+                next += sizeof( change ) + (Uint64)change.w * change.h * mHeader.bytesPerPixel;
+                complete = change.layer < LREPLAY_LAYERS && next <= size;
+                complete = complete && (Uint64)change.x + change.w <= mHeader.width && (Uint64)change.y + change.h <= mHeader.height;
+            }
+        }
+        if( !complete )
+        {
+            printf( "Replay %s ends inside frame %d\n", path.c_str(), (int)mFrames.size() );
+            break;
+        }
+
+        mFrames.push_back( (size_t)at );
+        at = next;
+    }
+
+    return true;
+}
+
+void LReplay::close()
+{
+    mFile.unmap();
+    memset( &mHeader, 0, sizeof( mHeader ) );
+    mFrames.clear();
+}
+
+GLuint LReplay::width()
+{
+    return mHeader.width;
+}
+
+GLuint LReplay::height()
+{
+    return mHeader.height;
+}
+
+GLuint LReplay::bytesPerPixel()
+{
+    return mHeader.bytesPerPixel;
+}
+
+int LReplay::frameCount()
+{
+    return (int)mFrames.size();
+}
+
+const Uint8* LReplay::layer( int layer )
+{
+    if( mFile.data() == NULL || layer < 0 || layer >= LREPLAY_LAYERS )
+    {
+        return NULL;
+    }
+
+    size_t bytes = (size_t)mHeader.width * mHeader.height * mHeader.bytesPerPixel;
+    return mFile.data() + sizeof( LReplayHeader ) + layer * bytes;
+}
+
+Uint32 LReplay::ticks( int frame )
+{
+    if( frame < 0 || frame >= frameCount() )
+    {
+        return 0;
+    }
+
+    LReplayFrame header;
+    memcpy( &header, mFile.data() + mFrames[ frame ], sizeof( header ) );
+    return header.ticks;
+}
+
+bool LReplay::applyFrame( int frame, Uint8* background, Uint8* menu, std::vector<LDirtyRect>& changed )
+{
+    if( frame < 0 || frame >= frameCount() )
+    {
+        return false;
+    }
+
+    //Bounds were checked by open()
+    const Uint8* at = mFile.data() + mFrames[ frame ];
+    LReplayFrame header;
+    memcpy( &header, at, sizeof( header ) );
+    at += sizeof( header );
+
+    Uint8* layers[ LREPLAY_LAYERS ] = { background, menu };
+    GLuint bpp = mHeader.bytesPerPixel;
+    for( Uint32 i = 0; i < header.changes; ++i )
+    {
+        LReplayChange change;
+        memcpy( &change, at, sizeof( change ) );
+        at += sizeof( change );
+
+        size_t pitch = change.w * bpp;
+        Uint8* target = layers[ change.layer ];
+        for( Uint32 y = change.y; y < change.y + change.h; ++y )
+        {
+            memcpy( target + ( (size_t)y * mHeader.width + change.x ) * bpp, at, pitch );
+            at += pitch;
+        }
+
+        LDirtyRect rect = { change.x, change.y, change.w, change.h };
+        changed.push_back( rect );
+    }
+
+    return true;
+}
@@ -0,0 +1,115 @@
+// Recorded layer changes, played back frame by frame as a repeatable workload
+#ifndef LREPLAY_H
+#define LREPLAY_H
+
+#include "LTexture.h"
+#include "LImage.h"
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <SDL.h>
+
+//File layout, little endian and read in place from the mapping: header,
+//the background and menu layers whole, then per frame an LReplayFrame and
+//its changes, each an LReplayChange followed by the rectangle's rows.
+//Frames end where the file does, a recording cut short keeps every frame
+//written completely.
+#define LREPLAY_MAGIC   "SWRP"
+#define LREPLAY_VERSION 1
+
+//Layers
+#define LREPLAY_BACKGROUND 0
+#define LREPLAY_MENU       1
+#define LREPLAY_LAYERS     2
+
+struct LReplayHeader
+{
+    char magic[ 4 ];
+    Uint32 version;
+    Uint32 width;
+    Uint32 height;
+
+    //4 for RGBA layers, 1 for palette indices
+    Uint32 bytesPerPixel;
+    Uint32 reserved[ 3 ];
+};
+
+struct LReplayFrame
+{
+    //Milliseconds since start the frame was composed at
+    Uint32 ticks;
+    Uint32 changes;
+};
+
+struct LReplayChange
+{
+    Uint32 layer;
+    Uint32 x;
+    Uint32 y;
+    Uint32 w;
+    Uint32 h;
+};
+
+class LReplayWriter
+{
+    public:
+        LReplayWriter();
+        ~LReplayWriter();
+
+        //Starts a replay of width x height layers with their pixels now
+        bool open( const std::string& path, GLuint width, GLuint height, GLuint bytesPerPixel, const void* background, const void* menu );
+        void close();
+        bool isOpen();
+        int frameCount();
+
+        //Copies 'rect' of a whole layer into the frame being recorded
+        void addChange( int layer, const void* pixels, const LDirtyRect& rect );
+
+        //Writes the changes added since the last frame as one frame
+        bool endFrame( Uint32 ticks );
+
+    private:
+        FILE* mFile;
+        std::string mPath;
+        GLuint mWidth;
+        GLuint mHeight;
+        GLuint mBytesPerPixel;
+
+        //Changes of the frame being recorded
+        std::vector<Uint8> mChanges;
+        Uint32 mChangeCount;
+        int mFrames;
+};
+
+class LReplay
+{
+    public:
+        LReplay();
+        ~LReplay();
+
+        //Maps a replay and indexes its frames
+        bool open( const std::string& path );
+        void close();
+
+        GLuint width();
+        GLuint height();
+        GLuint bytesPerPixel();
+        int frameCount();
+
+        //Pixels of a layer before the first frame, NULL while closed
+        const Uint8* layer( int layer );
+        Uint32 ticks( int frame );
+
+        //Copies a frame's changes into whole layers of the replay's size
+        //and appends their rectangles to 'changed'
+        bool applyFrame( int frame, Uint8* background, Uint8* menu, std::vector<LDirtyRect>& changed );
+
+    private:
+        LMappedFile mFile;
+        LReplayHeader mHeader;
+
+        //Offset of each frame's LReplayFrame
+        std::vector<size_t> mFrames;
+};
+
+#endif
@@ -0,0 +1,301 @@
+// Shader program compilation on a worker thread with a shared GL context
+#include "LShaderCompiler.h"
+#include <algorithm>
+
+LShaderCompiler::LShaderCompiler()
+{
+    mWindow = NULL;
+    mContext = NULL;
+    mThread = NULL;
+    mQuit = false;
+    mLock = SDL_CreateMutex();
+    mQueued = SDL_CreateCond();
+}
+
+LShaderCompiler::~LShaderCompiler()
+{
+    freeCompiler();
+
+    SDL_DestroyCond( mQueued );
+    SDL_DestroyMutex( mLock );
+}
+
+bool LShaderCompiler::init()
+{
+    freeCompiler();
+
+    SDL_Window* window = SDL_GL_GetCurrentWindow();
+    SDL_GLContext current = SDL_GL_GetCurrentContext();
+    if( current == NULL )
+    {
+        printf( "Shader compiler needs a current SDL OpenGL context\n" );
+        return false;
+    }
+
+    //A context cannot be current on two threads, the worker gets its own
+    //and a hidden window to make it current with
+    mWindow = SDL_CreateWindow( "shader compiler", 0, 0, 1, 1, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN );
+    if( mWindow == NULL )
+    {
+        printf( "Unable to create shader compiler window! SDL Error: %s\n", SDL_GetError() );
+        return false;
+    }
+
+    SDL_GL_SetAttribute( SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1 );
+    mContext = SDL_GL_CreateContext( mWindow );
+    SDL_GL_SetAttribute( SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0 );
+
+    //Creating made the new context current here
+    SDL_GL_MakeCurrent( window, current );
+
+    if( mContext == NULL )
+    {
+        printf( "Unable to create shared shader compiler context! SDL Error: %s\n", SDL_GetError() );
+        freeCompiler();
+        return false;
+    }
+
+    mQuit = false;
+    mThread = SDL_CreateThread( workerMain, "shader compiler", this );
+    if( mThread == NULL )
+    {
+        printf( "Unable to create shader compiler thread! SDL Error: %s\n", SDL_GetError() );
+        freeCompiler();
+        return false;
+    }
+
+    return true;
+}
+
+void LShaderCompiler::freeCompiler()
+{
+    //The worker finishes the program it is on, queued ones are dropped
+    if( mThread != NULL )
+    {
+        SDL_LockMutex( mLock );
+        mQuit = true;
+        SDL_CondBroadcast( mQueued );
+        SDL_UnlockMutex( mLock );
+
+        SDL_WaitThread( mThread, NULL );
+        mThread = NULL;
+    }
+
+    for( size_t i = 0; i < mJobs.size(); ++i )
+    {
+        delete mJobs[ i ].program;
+        if( mJobs[ i ].fence != 0 )
+        {
+            glDeleteSync( mJobs[ i ].fence );
+        }
+    }
+    mJobs.clear();
+    mQueue.clear();
+
+    if( mContext != NULL )
+    {
+        SDL_GL_DeleteContext( mContext );
+        mContext = NULL;
+    }
+    if( mWindow != NULL )
+    {
+        SDL_DestroyWindow( mWindow );
+        mWindow = NULL;
+    }
+}
+
+bool LShaderCompiler::enabled()
+{
+    return mThread != NULL;
+}
+
+int LShaderCompiler::submit( const std::string& vsPath, const std::string& fsPath, const std::string& defines )
+{
+    LCompileJob job;
+    job.vsPath = vsPath;
+    job.fsPath = fsPath;
+    job.defines = defines;
+    job.state = LCOMPILE_QUEUED;
+    job.program = NULL;
+    job.fence = 0;
+    job.discarded = false;
+
+    SDL_LockMutex( mLock );
+    int id = (int)mJobs.size();
+    mJobs.push_back( job );
+    if( mThread != NULL )
+    {
+        mQueue.push_back( id );
+        SDL_CondSignal( mQueued );
+    }
+    SDL_UnlockMutex( mLock );
+
+    //No worker, compile right here
+    if( mThread == NULL )
+    {
+        compile( mJobs[ id ] );
+    }
+
+    return id;
+}
+
+void LShaderCompiler::compile( LCompileJob& job )
+{
+    //Program binary cache lookups work here too, its driver string was
+    //read by the first program the GL thread loaded
+    LShaderProgram* program = new LShaderProgram();
+    bool linked = program->loadProgram( job.vsPath, job.fsPath, job.defines );
+
+    //Objects changed on one context are only safe to use on another after
+    //the changes completed, the GL thread waits for this fence
+    GLsync fence = 0;
+    if( linked && mThread != NULL )
+    {
+        fence = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+        glFlush();
+    }
+    if( !linked )
+    {
+        delete program;
+        program = NULL;
+    }
+
+    SDL_LockMutex( mLock );
+    if( job.discarded )
+    {
+        delete program;
+        program = NULL;
+        if( fence != 0 )
+        {
+            glDeleteSync( fence );
+            fence = 0;
+        }
+    }
+    job.program = program;
+    job.fence = fence;
+    if( !linked || job.discarded )
+    {
+        job.state = LCOMPILE_FAILED;
+    }
+    else if( fence == 0 )
+    {
+        job.state = LCOMPILE_READY;
+    }
+    SDL_UnlockMutex( mLock );
+}
+
+int LShaderCompiler::state( int id )
+{
+    if( id < 0 || id >= (int)mJobs.size() )
+    {
+        return LCOMPILE_FAILED;
+    }
+
+    SDL_LockMutex( mLock );
+    LCompileJob& job = mJobs[ id ];
+    if( job.state == LCOMPILE_QUEUED && job.fence != 0 )
+    {
+        //Zero timeout, only asks
+        GLenum result = glClientWaitSync( job.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0 );
+        if( result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED )
+        {
+            job.state = LCOMPILE_READY;
+        }
+        else if( result == GL_WAIT_FAILED )
+        {
+            delete job.program;
+            job.program = NULL;
+            job.state = LCOMPILE_FAILED;
+        }
+
+        if( job.state != LCOMPILE_QUEUED )
+        {
+            glDeleteSync( job.fence );
+            job.fence = 0;
+        }
+    }
+    int state = job.state;
+    SDL_UnlockMutex( mLock );
+
+    return state;
+}
+
+LShaderProgram* LShaderCompiler::take( int id )
+{
+    if( state( id ) != LCOMPILE_READY )
+    {
+        return NULL;
+    }
+
+    SDL_LockMutex( mLock );
+    LShaderProgram* program = mJobs[ id ].program;
+    mJobs[ id ].program = NULL;
+    SDL_UnlockMutex( mLock );
+
+    return program;
+}
+
+void LShaderCompiler::discard( int id )
+{
+    if( id < 0 || id >= (int)mJobs.size() )
+    {
+        return;
+    }
+
+    SDL_LockMutex( mLock );
+    LCompileJob& job = mJobs[ id ];
+    job.discarded = true;
+
+    std::deque<int>::iterator queued = std::find( mQueue.begin(), mQueue.end(), id );
+    if( queued != mQueue.end() )
+    {
+        mQueue.erase( queued );
+        job.state = LCOMPILE_FAILED;
+    }
+
+    //Done already, otherwise the worker drops it when it is
+    if( job.state != LCOMPILE_QUEUED || job.fence != 0 )
+    {
+        delete job.program;
+        job.program = NULL;
+        if( job.fence != 0 )
+        {
+            glDeleteSync( job.fence );
+            job.fence = 0;
+        }
+        job.state = LCOMPILE_FAILED;
+    }
+    SDL_UnlockMutex( mLock );
+}
+
+int LShaderCompiler::workerMain( void* data )
+{
+    LShaderCompiler* compiler = (LShaderCompiler*)data;
+    SDL_GL_MakeCurrent( compiler->mWindow, compiler->mContext );
+
+    SDL_LockMutex( compiler->mLock );
+    for( ;; )
+    {
+        while( !compiler->mQuit && compiler->mQueue.empty() )
+        {
+            SDL_CondWait( compiler->mQueued, compiler->mLock );
+        }
+        if( compiler->mQuit )
+        {
+            break;
+        }
+
+        int id = compiler->mQueue.front();
+        compiler->mQueue.pop_front();
+        LCompileJob& job = compiler->mJobs[ id ];
+
+        SDL_UnlockMutex( compiler->mLock );
+        compiler->compile( job );
+        SDL_LockMutex( compiler->mLock );
+    }
+    SDL_UnlockMutex( compiler->mLock );
+
+    SDL_GL_MakeCurrent( compiler->mWindow, NULL );
+
+    return 0;
+}
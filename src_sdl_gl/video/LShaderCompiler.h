@@ -0,0 +1,75 @@
+// Shader program compilation on a worker thread with a shared GL context
+#ifndef LSHADER_COMPILER_H
+#define LSHADER_COMPILER_H
+
+#include "LOpenGL.h"
+#include "LShaderProgram.h"
+#include <stdio.h>
+#include <string>
+#include <deque>
+#include <SDL.h>
+
+//Job states
+#define LCOMPILE_QUEUED 0
+#define LCOMPILE_READY  1
+#define LCOMPILE_FAILED 2
+
+struct LCompileJob
+{
+    std::string vsPath;
+    std::string fsPath;
+    std::string defines;
+    int state;
+
+    //Linked by the worker, handed over once its fence has signalled
+    LShaderProgram* program;
+    GLsync fence;
+    bool discarded;
+};
+
+class LShaderCompiler
+{
+    public:
+        LShaderCompiler();
+        ~LShaderCompiler();
+
+        //Creates a context sharing objects with the current one, on a hidden
+        //window of its own, and the thread that compiles on it. GL thread
+        //only. Without it submit() compiles on the calling thread.
+        bool init();
+        void freeCompiler();
+        bool enabled();
+
+        //Queues a program of the files with 'defines' injected, see
+        //LShaderProgram::loadProgram(), and returns its id
+        int submit( const std::string& vsPath, const std::string& fsPath, const std::string& defines );
+
+        //LCOMPILE_QUEUED until the program is linked and visible to this
+        //context. Never blocks. GL thread only.
+        int state( int id );
+
+        //Program of a ready job, owned by the caller from now on. Its
+        //vertex arrays do not exist yet, init() must follow on this context.
+        LShaderProgram* take( int id );
+
+        //Drops a job whose program is no longer wanted
+        void discard( int id );
+
+    private:
+        static int workerMain( void* data );
+        void compile( LCompileJob& job );
+
+        SDL_Window* mWindow;
+        SDL_GLContext mContext;
+        SDL_Thread* mThread;
+
+        //By id; a deque so jobs stay put while the worker writes to them
+        std::deque<LCompileJob> mJobs;
+        std::deque<int> mQueue;
+        bool mQuit;
+
+        SDL_mutex* mLock;
+        SDL_cond* mQueued;
+};
+
+#endif
@@ -0,0 +1,1040 @@
+// Multi-pass shader pipeline built on LShaderProgram
+#include "LShaderPipeline.h"
+#include "LShaderPreset.h"
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+LShaderPipeline::LShaderPipeline()
+{
+    mSamplerNearest = 0;
+    mSamplerLinear = 0;
+    mPaletteResolve = false;
+    mOutputFramebuffer = 0;
+    mProfiler = NULL;
+    mParameterBuffer = 0;
+    mParametersDirty = false;
+    mLookupTablesDirty = true;
+    mCompiler = NULL;
+    mStaging = false;
+
+    mSourceWidth = 0;
+    mSourceHeight = 0;
+    mViewportWidth = 0;
+    mViewportHeight = 0;
+}
+
+LShaderPipeline::~LShaderPipeline()
+{
+    //Free passes if they exist
+    freePipeline();
+}
+
+LPassDesc LShaderPipeline::passDesc( std::string vsPath, std::string fsPath )
+{
+    LPassDesc desc;
+    desc.vsPath = vsPath;
+    desc.fsPath = fsPath;
+    desc.scaleTypeX = LSCALE_VIEWPORT;
+    desc.scaleTypeY = LSCALE_VIEWPORT;
+    desc.scaleX = 1.0f;
+    desc.scaleY = 1.0f;
+    desc.filterLinear = true;
+    desc.format = GL_RGBA8;
+    desc.defines = "";
+
+    return desc;
+}
+
+bool LShaderPipeline::addPass( const LPassDesc& desc )
+{
+    //Create samplers with the first pass
+    if( mSamplerNearest == 0 )
+    {
+        glGenSamplers( 1, &mSamplerNearest );
+        glSamplerParameteri( mSamplerNearest, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+        glSamplerParameteri( mSamplerNearest, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+        glSamplerParameteri( mSamplerNearest, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+        glSamplerParameteri( mSamplerNearest, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+
+        glGenSamplers( 1, &mSamplerLinear );
+        glSamplerParameteri( mSamplerLinear, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+        glSamplerParameteri( mSamplerLinear, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+        glSamplerParameteri( mSamplerLinear, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+        glSamplerParameteri( mSamplerLinear, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+    }
+
+    LPass pass;
+    pass.desc = desc;
+    pass.target = NULL;
+    pass.width = 0;
+    pass.height = 0;
+    pass.lastUse = -1;
+    pass.profileStage = -1;
+    pass.program = NULL;
+    pass.compileJob = -1;
+
+    if( !addParameters( desc, pass.parameters ) )
+    {
+        return false;
+    }
+
+    pass.variantDefines = passDefines( mPasses.size(), desc, pass.parameters );
+    if( mStaging )
+    {
+        //Programs of a reload are found or compiled once all passes exist
+        mPasses.push_back( pass );
+        return true;
+    }
+
+    pass.program = mVariants.acquire( desc.vsPath, desc.fsPath, pass.variantDefines );
+    if( pass.program == NULL )
+    {
+        printf( "Unable to load pass %d: %s, %s\n", (int)mPasses.size(), desc.vsPath.c_str(), desc.fsPath.c_str() );
+        return false;
+    }
+
+    mPasses.push_back( pass );
+    mLookupTablesDirty = true;
+    if( mProfiler != NULL )
+    {
+        setProfiler( mProfiler );
+    }
+
+    //Pass graph changed, lay out targets again on next render
+    releaseTargets();
+
+    return true;
+}
+
+bool LShaderPipeline::addParameters( const LPassDesc& desc, std::vector<int>& parameters )
+{
+    std::vector<LShaderParameter> declared;
+    if( !LShaderProgram::readParameters( desc.vsPath, declared ) )
+    {
+        return false;
+    }
+    if( desc.fsPath != desc.vsPath && !LShaderProgram::readParameters( desc.fsPath, declared ) )
+    {
+        return false;
+    }
+
+    for( size_t i = 0; i < declared.size(); ++i )
+    {
+        //Same name in an earlier pass, share its slot
+        int index = -1;
+        for( size_t j = 0; j < mParameters.size(); ++j )
+        {
+            if( mParameters[ j ].info.name == declared[ i ].name )
+            {
+                index = (int)j;
+            }
+        }
+
+        if( index < 0 )
+        {
+            if( mParameters.size() >= LMAX_PARAMETERS )
+            {
+                printf( "Too many shader parameters, %s uses its initial value\n", declared[ i ].name.c_str() );
+                continue;
+            }
+
+            LPipelineParameter parameter;
+            parameter.info = declared[ i ];
+            parameter.value = declared[ i ].initial;
+            std::map<std::string, GLfloat>::iterator set = mParameterValues.find( declared[ i ].name );
+            if( set != mParameterValues.end() )
+            {
+                parameter.value = set->second;
+            }
+
+            index = (int)mParameters.size();
+            mParameters.push_back( parameter );
+            mParametersDirty = true;
+        }
+
+        parameters.push_back( index );
+    }
+
+    return true;
+}
+
+std::string LShaderPipeline::passDefines( size_t index, const LPassDesc& desc, const std::vector<int>& parameters )
+{
+    //Tell the shaders which ends of the pass are sRGB encoded by hardware;
+    //history inputs are expected to share the encoding of source[0]
+    std::string defines;
+    if( index > 0 && isSrgbFormat( mPasses[ index - 1 ].desc.format ) )
+    {
+        defines += "#define SOURCE_SRGB\n";
+    }
+    if( isSrgbFormat( desc.format ) )
+    {
+        defines += "#define TARGET_SRGB\n";
+    }
+
+    std::string defineSet = mDefines + " " + desc.defines;
+    defines += LShaderVariantCache::defineBlock( defineSet );
+
+    std::map<std::string, std::string> pinned;
+    LShaderVariantCache::parseDefines( defineSet, pinned );
+
+    //Blur passes get linear sampling taps for the sigma they ask for
+    std::map<std::string, std::string>::iterator sigma = pinned.find( "BLUR_SIGMA" );
+    if( sigma != pinned.end() && pinned.find( "BLUR_TAPS" ) == pinned.end() )
+    {
+        defines += LGaussian::defineBlock( (float)atof( sigma->second.c_str() ) );
+    }
+
+    //Rows of the baked gamma curves and the function sampling them
+    defines += LLookupTables::defineBlock();
+
+    //Parameters read from the shared block, in the same std140 layout for
+    //every pass so one buffer serves the whole pipeline
+    std::string block;
+    for( size_t i = 0; i < parameters.size(); ++i )
+    {
+        const std::string& name = mParameters[ parameters[ i ] ].info.name;
+        if( pinned.find( name ) != pinned.end() )
+        {
+            continue;
+        }
+
+        char slot[ 48 ];
+        sprintf( slot, " parameterValues[%d].%c\n", parameters[ i ] / 4, "xyzw"[ parameters[ i ] % 4 ] );
+        block += "#define " + name + slot;
+    }
+    if( !block.empty() )
+    {
+        char declaration[ 128 ];
+        sprintf( declaration, "layout(std140) uniform Parameters\n{\n    vec4 parameterValues[%d];\n};\n", LMAX_PARAMETERS / 4 );
+        defines += declaration + block;
+    }
+
+    return defines;
+}
+
+int LShaderPipeline::parameterCount()
+{
+    return (int)mParameters.size();
+}
+
+const LPipelineParameter& LShaderPipeline::parameter( int index )
+{
+    return mParameters[ index ];
+}
+
+bool LShaderPipeline::setParameter( std::string name, GLfloat value )
+{
+    bool found = false;
+    for( size_t i = 0; i < mParameters.size(); ++i )
+    {
+        LPipelineParameter& parameter = mParameters[ i ];
+        if( parameter.info.name == name )
+        {
+            if( value < parameter.info.minimum )
+            {
+                value = parameter.info.minimum;
+            }
+            if( value > parameter.info.maximum )
+            {
+                value = parameter.info.maximum;
+            }
+            parameter.value = value;
+            mParametersDirty = true;
+            mLookupTablesDirty = true;
+            found = true;
+        }
+    }
+
+    mParameterValues[ name ] = value;
+
+    return found;
+}
+
+GLfloat LShaderPipeline::parameterValue( const std::string& name, GLfloat fallback )
+{
+    //A parameter pinned by the define set is compiled in with that value
+    std::map<std::string, std::string> pinned;
+    LShaderVariantCache::parseDefines( mDefines, pinned );
+    std::map<std::string, std::string>::iterator define = pinned.find( name );
+    if( define != pinned.end() && !define->second.empty() )
+    {
+        return (GLfloat)atof( define->second.c_str() );
+    }
+
+    for( size_t i = 0; i < mParameters.size(); ++i )
+    {
+        if( mParameters[ i ].info.name == name )
+        {
+            return mParameters[ i ].value;
+        }
+    }
+
+    //Set before a load, or for a CPU filter no pass runs
+    std::map<std::string, GLfloat>::iterator value = mParameterValues.find( name );
+    if( value != mParameterValues.end() )
+    {
+        return value->second;
+    }
+
+    return fallback;
+}
+
+void LShaderPipeline::updateLookupTables()
+{
+    if( !mLookupTablesDirty )
+    {
+        return;
+    }
+    mLookupTablesDirty = false;
+
+    //Bake only for pipelines that sample a table
+    bool used = false;
+    for( size_t i = 0; i < mPasses.size(); ++i )
+    {
+        LShaderProgram* program = mPasses[ i ].program;
+        used = used || program->uniformHandle( LLUT_GAMMA_SAMPLER ) >= 0 || program->uniformHandle( LLUT_BEAM_SAMPLER ) >= 0 || program->uniformHandle( LLUT_MASK_SAMPLER ) >= 0;
+    }
+    if( !used )
+    {
+        return;
+    }
+
+    LLutInputs inputs = LLookupTables::defaultInputs();
+    inputs.crtGamma = parameterValue( "CRTgamma", inputs.crtGamma );
+    inputs.monitorGamma = parameterValue( "monitorgamma", inputs.monitorGamma );
+    inputs.srgbGamma = parameterValue( "CRT_GAMMA", inputs.srgbGamma );
+    inputs.mask = parameterValue( "MASK", inputs.mask );
+    inputs.maskIntensity = parameterValue( "MASK_INTENSITY", inputs.maskIntensity );
+    if( !mLookupTables.update( inputs ) )
+    {
+        printf( "Unable to bake shader lookup tables\n" );
+    }
+
+    setTexture( LLUT_GAMMA_SAMPLER, mLookupTables.gammaTexture() );
+    setTexture( LLUT_BEAM_SAMPLER, mLookupTables.beamTexture() );
+    setTexture( LLUT_MASK_SAMPLER, mLookupTables.maskTexture() );
+}
+
+void LShaderPipeline::updateParameters()
+{
+    if( mParameters.empty() )
+    {
+        return;
+    }
+
+    if( mParameterBuffer == 0 )
+    {
+        glGenBuffers( 1, &mParameterBuffer );
+        glBindBuffer( GL_UNIFORM_BUFFER, mParameterBuffer );
+        glBufferData( GL_UNIFORM_BUFFER, LMAX_PARAMETERS * sizeof( GLfloat ), NULL, GL_DYNAMIC_DRAW );
+        mParametersDirty = true;
+    }
+
+    if( mParametersDirty )
+    {
+        GLfloat values[ LMAX_PARAMETERS ];
+        memset( values, 0, sizeof( values ) );
+        for( size_t i = 0; i < mParameters.size(); ++i )
+        {
+            values[ i ] = mParameters[ i ].value;
+        }
+
+        glBindBuffer( GL_UNIFORM_BUFFER, mParameterBuffer );
+        glBufferSubData( GL_UNIFORM_BUFFER, 0, sizeof( values ), values );
+        glBindBuffer( GL_UNIFORM_BUFFER, 0 );
+        mParametersDirty = false;
+    }
+
+    //One binding serves every pass
+    glBindBufferBase( GL_UNIFORM_BUFFER, LSP_PARAMETER_BINDING, mParameterBuffer );
+}
+
+bool LShaderPipeline::setDefines( std::string defineSet )
+{
+    std::string previous = mDefines;
+    mDefines = defineSet;
+
+    //Acquire every new variant before releasing the old ones, so a failed
+    //compile leaves the pipeline as it was
+    std::vector<LShaderProgram*> programs;
+    std::vector<std::string> variantDefines;
+    for( size_t i = 0; i < mPasses.size(); ++i )
+    {
+        LPassDesc& desc = mPasses[ i ].desc;
+        variantDefines.push_back( passDefines( i, desc, mPasses[ i ].parameters ) );
+        LShaderProgram* program = mVariants.acquire( desc.vsPath, desc.fsPath, variantDefines[ i ] );
+        if( program == NULL )
+        {
+            printf( "Unable to apply defines \"%s\" to pass %d: %s\n", defineSet.c_str(), (int)i, desc.fsPath.c_str() );
+            for( size_t j = 0; j < programs.size(); ++j )
+            {
+                mVariants.release( programs[ j ] );
+            }
+            mDefines = previous;
+            return false;
+        }
+        programs.push_back( program );
+    }
+
+    for( size_t i = 0; i < mPasses.size(); ++i )
+    {
+        mVariants.release( mPasses[ i ].program );
+        mPasses[ i ].program = programs[ i ];
+        mPasses[ i ].variantDefines = variantDefines[ i ];
+    }
+
+    //Variants may declare different source[] inputs and tables
+    releaseTargets();
+    mLookupTablesDirty = true;
+
+    //A reload under way was built with the old set
+    if( reloadPending() )
+    {
+        stageReload();
+    }
+
+    return true;
+}
+
+std::string LShaderPipeline::defines()
+{
+    return mDefines;
+}
+
+LShaderVariantCache& LShaderPipeline::variants()
+{
+    return mVariants;
+}
+
+void LShaderPipeline::setPaletteResolve( bool enable )
+{
+    mPaletteResolve = enable;
+}
+
+void LShaderPipeline::setTexture( std::string name, GLuint texID )
+{
+    if( texID == 0 )
+    {
+        mTextures.erase( name );
+    }
+    else
+    {
+        mTextures[ name ] = texID;
+    }
+}
+
+void LShaderPipeline::setOutputFramebuffer( GLuint framebufferID )
+{
+    mOutputFramebuffer = framebufferID;
+}
+
+void LShaderPipeline::setProfiler( LProfiler* profiler )
+{
+    mProfiler = profiler;
+    for( size_t i = 0; i < mPasses.size(); ++i )
+    {
+        LPass& pass = mPasses[ i ];
+        pass.profileStage = -1;
+        if( profiler != NULL )
+        {
+            //Named after the fragment shader without its directory
+            std::string name = pass.desc.fsPath;
+            size_t slash = name.find_last_of( "/\\" );
+            if( slash != std::string::npos )
+            {
+                name = name.substr( slash + 1 );
+            }
+
+            char prefix[ 32 ];
+            sprintf( prefix, "pass %d ", (int)i );
+            pass.profileStage = profiler->addStage( prefix + name, true );
+        }
+    }
+}
+
+bool LShaderPipeline::addPaletteResolvePass()
+{
+    if( !mPaletteResolve )
+    {
+        return true;
+    }
+
+    //Indices must not be filtered, the resolved image keeps the source size
+    LPassDesc desc = passDesc( LPALETTE_RESOLVE_VS, LPALETTE_RESOLVE_FS );
+    desc.scaleTypeX = LSCALE_SOURCE;
+    desc.scaleTypeY = LSCALE_SOURCE;
+    desc.filterLinear = false;
+
+    return addPass( desc );
+}
+
+bool LShaderPipeline::loadProgram( std::string vsPath, std::string fsPath )
+{
+    releasePasses();
+    mPresetPath.clear();
+
+    return addPaletteResolvePass() && addPass( passDesc( vsPath, fsPath ) );
+}
+
+bool LShaderPipeline::loadProgram5( std::string vsPath, std::string fsPath1, std::string fsPath2, std::string fsPath3, std::string fsPath4 )
+{
+    releasePasses();
+    mPresetPath.clear();
+    if( !addPaletteResolvePass() )
+    {
+        return false;
+    }
+
+    //CRT pass, horizontal and vertical blur, then combine with the CRT
+    //pass output through source[2]
+    std::string fsPaths[] = { fsPath1, fsPath2, fsPath3, fsPath4 };
+    for( int i = 0; i < 4; ++i )
+    {
+        if( !addPass( passDesc( vsPath, fsPaths[ i ] ) ) )
+        {
+            releasePasses();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool LShaderPipeline::loadPreset( std::string path )
+{
+    releasePasses();
+    mPresetPath = path;
+
+    LShaderPreset preset;
+    if( !preset.loadPresetFromFile( path ) || !addPaletteResolvePass() )
+    {
+        return false;
+    }
+
+    std::vector<LPassDesc>& passes = preset.passes();
+    for( size_t i = 0; i < passes.size(); ++i )
+    {
+        //The last pass draws into the viewport, which has its own format
+        if( i == passes.size() - 1 )
+        {
+            passes[ i ].format = GL_RGBA8;
+        }
+
+        if( !addPass( passes[ i ] ) )
+        {
+            printf( "Unable to build pipeline from preset %s\n", path.c_str() );
+            releasePasses();
+            return false;
+        }
+    }
+
+    //Presets tune parameters with NAME = value lines
+    for( size_t i = 0; i < mParameters.size(); ++i )
+    {
+        std::string value = preset.value( mParameters[ i ].info.name, "" );
+        if( !value.empty() )
+        {
+            setParameter( mParameters[ i ].info.name, (GLfloat)atof( value.c_str() ) );
+        }
+    }
+
+    printf( "Shader preset loaded: %s (%d passes)\n", path.c_str(), passCount() );
+
+    return true;
+}
+
+bool LShaderPipeline::isSrgbFormat( GLenum format )
+{
+    return format == GL_SRGB8_ALPHA8 || format == GL_SRGB8;
+}
+
+void LShaderPipeline::releasePasses()
+{
+    if( !mStaging )
+    {
+        cancelReload();
+    }
+    releaseTargets();
+
+    //Programs stay compiled in the variant cache
+    for( size_t i = 0; i < mPasses.size(); ++i )
+    {
+        mVariants.release( mPasses[ i ].program );
+    }
+    mPasses.clear();
+    mParameters.clear();
+}
+
+void LShaderPipeline::freePipeline()
+{
+    releasePasses();
+    mCompiler = NULL;
+    mPool.freePool();
+    mVariants.freeCache();
+
+    if( mParameterBuffer != 0 )
+    {
+        glDeleteBuffers( 1, &mParameterBuffer );
+        mParameterBuffer = 0;
+    }
+
+    setTexture( LLUT_GAMMA_SAMPLER, 0 );
+    setTexture( LLUT_BEAM_SAMPLER, 0 );
+    setTexture( LLUT_MASK_SAMPLER, 0 );
+    mLookupTables.freeTables();
+    mLookupTablesDirty = true;
+
+    if( mSamplerNearest != 0 )
+    {
+        glDeleteSamplers( 1, &mSamplerNearest );
+        glDeleteSamplers( 1, &mSamplerLinear );
+        mSamplerNearest = 0;
+        mSamplerLinear = 0;
+    }
+}
+
+int LShaderPipeline::bindTextures( LPass& pass, int firstUnit )
+{
+    //Named textures follow the source[] units
+    int unit = firstUnit;
+    for( std::map<std::string, GLuint>::iterator it = mTextures.begin(); it != mTextures.end(); ++it )
+    {
+        int handle = pass.program->uniformHandle( it->first );
+        if( handle < 0 )
+        {
+            continue;
+        }
+
+        //Sampler objects left on this unit by source[] inputs would
+        //override the texture's own filter
+        glActiveTexture( GL_TEXTURE0 + unit );
+        glBindTexture( GL_TEXTURE_2D, it->second );
+        glBindSampler( unit, 0 );
+        pass.program->setUniform1i( handle, unit );
+        ++unit;
+    }
+    glActiveTexture( GL_TEXTURE0 );
+
+    return unit;
+}
+
+void LShaderPipeline::setCompiler( LShaderCompiler* compiler )
+{
+    cancelReload();
+    mCompiler = compiler;
+}
+
+void LShaderPipeline::sourceFiles( std::vector<std::string>& paths )
+{
+    paths.clear();
+    if( !mPresetPath.empty() )
+    {
+        paths.push_back( mPresetPath );
+    }
+
+    for( size_t i = 0; i < mPasses.size(); ++i )
+    {
+        const LPassDesc& desc = mPasses[ i ].desc;
+        if( std::find( paths.begin(), paths.end(), desc.vsPath ) == paths.end() )
+        {
+            paths.push_back( desc.vsPath );
+        }
+        if( std::find( paths.begin(), paths.end(), desc.fsPath ) == paths.end() )
+        {
+            paths.push_back( desc.fsPath );
+        }
+    }
+}
+
+bool LShaderPipeline::reload( const std::vector<std::string>& changed )
+{
+    std::vector<std::string> used;
+    sourceFiles( used );
+
+    bool relevant = false;
+    for( size_t i = 0; i < changed.size(); ++i )
+    {
+        if( std::find( used.begin(), used.end(), changed[ i ] ) != used.end() )
+        {
+            //Later define sets compile from the new file too
+            mVariants.invalidate( changed[ i ] );
+            relevant = true;
+        }
+    }
+
+    return relevant && stageReload();
+}
+
+bool LShaderPipeline::stageReload()
+{
+    cancelReload();
+
+    //Build the new passes the way they were loaded, in place of the running
+    //ones, then put those back; reading the files here is cheap, compiling
+    //is left to the compiler
+    std::vector<LPass> running;
+    std::vector<LPipelineParameter> runningParameters;
+    running.swap( mPasses );
+    runningParameters.swap( mParameters );
+    GLint sizes[] = { mSourceWidth, mSourceHeight, mViewportWidth, mViewportHeight };
+
+    mStaging = true;
+    bool built = true;
+    if( !mPresetPath.empty() )
+    {
+        built = loadPreset( mPresetPath );
+    }
+    else
+    {
+        for( size_t i = 0; built && i < running.size(); ++i )
+        {
+            built = addPass( running[ i ].desc );
+        }
+    }
+    mStaging = false;
+
+    mStaged.swap( mPasses );
+    mStagedParameters.swap( mParameters );
+    mPasses.swap( running );
+    mParameters.swap( runningParameters );
+    mSourceWidth = sizes[ 0 ];
+    mSourceHeight = sizes[ 1 ];
+    mViewportWidth = sizes[ 2 ];
+    mViewportHeight = sizes[ 3 ];
+
+    if( !built || mStaged.empty() )
+    {
+        printf( "Unable to rebuild shader pipeline, the running passes stay\n" );
+        cancelReload();
+        return false;
+    }
+
+    for( size_t i = 0; i < mStaged.size(); ++i )
+    {
+        LPass& pass = mStaged[ i ];
+        pass.program = mVariants.find( pass.desc.vsPath, pass.desc.fsPath, pass.variantDefines );
+        if( pass.program != NULL )
+        {
+            continue;
+        }
+
+        if( mCompiler != NULL )
+        {
+            pass.compileJob = mCompiler->submit( pass.desc.vsPath, pass.desc.fsPath, pass.variantDefines );
+        }
+        else
+        {
+            pass.program = mVariants.acquire( pass.desc.vsPath, pass.desc.fsPath, pass.variantDefines );
+            if( pass.program == NULL )
+            {
+                printf( "Unable to reload pass %d: %s, the running passes stay\n", (int)i, pass.desc.fsPath.c_str() );
+                cancelReload();
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool LShaderPipeline::reloadPending()
+{
+    return !mStaged.empty();
+}
+
+void LShaderPipeline::cancelReload()
+{
+    for( size_t i = 0; i < mStaged.size(); ++i )
+    {
+        if( mStaged[ i ].program != NULL )
+        {
+            mVariants.release( mStaged[ i ].program );
+        }
+        if( mStaged[ i ].compileJob >= 0 && mCompiler != NULL )
+        {
+            mCompiler->discard( mStaged[ i ].compileJob );
+        }
+    }
+    mStaged.clear();
+    mStagedParameters.clear();
+}
+
+bool LShaderPipeline::updateReload()
+{
+    if( mStaged.empty() )
+    {
+        return false;
+    }
+
+    bool failed = false;
+    for( size_t i = 0; i < mStaged.size(); ++i )
+    {
+        if( mStaged[ i ].compileJob < 0 )
+        {
+            continue;
+        }
+
+        int state = mCompiler->state( mStaged[ i ].compileJob );
+        if( state == LCOMPILE_QUEUED )
+        {
+            return false;
+        }
+        if( state == LCOMPILE_FAILED )
+        {
+            printf( "Unable to reload pass %d: %s\n", (int)i, mStaged[ i ].desc.fsPath.c_str() );
+            failed = true;
+        }
+    }
+
+    if( failed )
+    {
+        printf( "Shader reload failed, the running passes stay\n" );
+        cancelReload();
+        return false;
+    }
+
+    //Vertex arrays are not shared between contexts, they are made here
+    for( size_t i = 0; i < mStaged.size(); ++i )
+    {
+        LPass& pass = mStaged[ i ];
+        if( pass.compileJob >= 0 )
+        {
+            pass.program = mCompiler->take( pass.compileJob );
+            pass.program->init();
+            mVariants.adopt( pass.desc.vsPath, pass.desc.fsPath, pass.variantDefines, pass.program );
+            pass.compileJob = -1;
+        }
+    }
+
+    std::vector<LPass> staged;
+    std::vector<LPipelineParameter> parameters;
+    staged.swap( mStaged );
+    parameters.swap( mStagedParameters );
+
+    releasePasses();
+    mPasses.swap( staged );
+    mParameters.swap( parameters );
+    mParametersDirty = true;
+    mLookupTablesDirty = true;
+    if( mProfiler != NULL )
+    {
+        setProfiler( mProfiler );
+    }
+
+    printf( "Shader pipeline reloaded: %d passes\n", passCount() );
+
+    return true;
+}
+
+int LShaderPipeline::passCount()
+{
+    return (int)mPasses.size();
+}
+
+LShaderProgram* LShaderPipeline::passProgram( int index )
+{
+    if( index < 0 || index >= (int)mPasses.size() )
+    {
+        return NULL;
+    }
+
+    return mPasses[ index ].program;
+}
+
+GLint LShaderPipeline::scaledSize( int scaleType, GLfloat scale, GLint inputSize, GLint viewportSize )
+{
+    GLint size;
+    switch( scaleType )
+    {
+        case LSCALE_SOURCE:
+            size = (GLint)( inputSize * scale + 0.5f );
+            break;
+        case LSCALE_ABSOLUTE:
+            size = (GLint)scale;
+            break;
+        default:
+            size = (GLint)( viewportSize * scale + 0.5f );
+            break;
+    }
+
+    return size < 1 ? 1 : size;
+}
+
+void LShaderPipeline::releaseTargets()
+{
+    for( size_t i = 0; i < mPasses.size(); ++i )
+    {
+        mPool.release( mPasses[ i ].target );
+        mPasses[ i ].target = NULL;
+    }
+
+    mSourceWidth = 0;
+    mSourceHeight = 0;
+    mViewportWidth = 0;
+    mViewportHeight = 0;
+}
+
+void LShaderPipeline::allocateTargets( GLint sourceWidth, GLint sourceHeight, GLint viewportWidth, GLint viewportHeight )
+{
+    releaseTargets();
+
+    int count = (int)mPasses.size();
+
+    //Pass j is read through source[i - 1 - j] by pass i, find the last reader
+    for( int j = 0; j < count; ++j )
+    {
+        mPasses[ j ].lastUse = -1;
+        for( int i = j + 1; i < count; ++i )
+        {
+            if( i - 1 - j < mPasses[ i ].program->sourceCount() )
+            {
+                mPasses[ j ].lastUse = i;
+            }
+        }
+    }
+
+    //Walk the chain, handing targets of dead passes on to later ones
+    GLint inputWidth = sourceWidth;
+    GLint inputHeight = sourceHeight;
+    for( int i = 0; i < count; ++i )
+    {
+        LPass& pass = mPasses[ i ];
+
+        //The last pass draws straight into the viewport
+        if( i == count - 1 )
+        {
+            pass.width = viewportWidth;
+            pass.height = viewportHeight;
+            break;
+        }
+
+        pass.width = scaledSize( pass.desc.scaleTypeX, pass.desc.scaleX, inputWidth, viewportWidth );
+        pass.height = scaledSize( pass.desc.scaleTypeY, pass.desc.scaleY, inputHeight, viewportHeight );
+
+        for( int j = 0; j < i; ++j )
+        {
+            if( mPasses[ j ].target != NULL && mPasses[ j ].lastUse < i )
+            {
+                mPool.release( mPasses[ j ].target );
+                mPasses[ j ].target = NULL;
+            }
+        }
+        pass.target = mPool.acquire( pass.width, pass.height, pass.desc.format );
+
+        inputWidth = pass.width;
+        inputHeight = pass.height;
+    }
+
+    //Targets of sizes no longer used go away
+    mPool.trim();
+
+    mSourceWidth = sourceWidth;
+    mSourceHeight = sourceHeight;
+    mViewportWidth = viewportWidth;
+    mViewportHeight = viewportHeight;
+
+    printf( "Shader pipeline: %d passes using %d render targets\n", count, mPool.targetCount() );
+}
+
+void LShaderPipeline::render( GLint sourceWidth, GLint sourceHeight, GLint targetX, GLint targetY, GLint targetWidth, GLint targetHeight, GLint texID )
+{
+    int count = (int)mPasses.size();
+    if( count == 0 )
+    {
+        return;
+    }
+
+    //Lay out intermediate targets when input or viewport size changes
+    if( sourceWidth != mSourceWidth || sourceHeight != mSourceHeight || targetWidth != mViewportWidth || targetHeight != mViewportHeight )
+    {
+        allocateTargets( sourceWidth, sourceHeight, targetWidth, targetHeight );
+    }
+    updateLookupTables();
+    updateParameters();
+
+    GLuint texIDs[ LSP_MAX_SOURCES ];
+    GLint sourceSizes[ LSP_MAX_SOURCES * 2 ];
+
+    for( int i = 0; i < count; ++i )
+    {
+        LPass& pass = mPasses[ i ];
+        int sources = pass.program->sourceCount();
+        if( sources < 1 )
+        {
+            sources = 1;
+        }
+
+        //source[0] is the previous pass, source[n] the one n passes before,
+        //down to the original image
+        for( int n = 0; n < sources; ++n )
+        {
+            int input = i - 1 - n;
+
+            //With palette input the resolve pass stands in for the original
+            if( mPaletteResolve && i > 0 && input < 0 )
+            {
+                input = 0;
+            }
+            if( input >= 0 && mPasses[ input ].target != NULL )
+            {
+                texIDs[ n ] = mPasses[ input ].target->textureID;
+                sourceSizes[ n * 2 ] = mPasses[ input ].width;
+                sourceSizes[ n * 2 + 1 ] = mPasses[ input ].height;
+            }
+            else
+            {
+                texIDs[ n ] = texID;
+                sourceSizes[ n * 2 ] = sourceWidth;
+                sourceSizes[ n * 2 + 1 ] = sourceHeight;
+            }
+            glBindSampler( n, pass.desc.filterLinear ? mSamplerLinear : mSamplerNearest );
+        }
+        int units = bindTextures( pass, sources );
+
+        if( mProfiler != NULL )
+        {
+            mProfiler->begin( pass.profileStage );
+        }
+
+        if( pass.target != NULL )
+        {
+            //sRGB targets encode on write, no pow() needed in the shader
+            bool srgb = isSrgbFormat( pass.target->format );
+            if( srgb )
+            {
+                glEnable( GL_FRAMEBUFFER_SRGB );
+            }
+
+            glBindFramebuffer( GL_FRAMEBUFFER, pass.target->framebufferID );
+            pass.program->render( sources, texIDs, sourceSizes, 0, 0, pass.width, pass.height, targetWidth, targetHeight, true );
+
+            if( srgb )
+            {
+                glDisable( GL_FRAMEBUFFER_SRGB );
+            }
+        }
+        else
+        {
+            glBindFramebuffer( GL_FRAMEBUFFER, mOutputFramebuffer );
+            pass.program->render( sources, texIDs, sourceSizes, targetX, targetY, targetWidth, targetHeight, targetWidth, targetHeight, false );
+        }
+
+        if( mProfiler != NULL )
+        {
+            mProfiler->end( pass.profileStage );
+        }
+
+        for( int n = 0; n < sources; ++n )
+        {
+            glBindSampler( n, 0 );
+        }
+        for( int n = sources; n < units; ++n )
+        {
+            glActiveTexture( GL_TEXTURE0 + n );
+            glBindTexture( GL_TEXTURE_2D, 0 );
+        }
+        glActiveTexture( GL_TEXTURE0 );
+    }
+}
@@ -0,0 +1,198 @@
+// Multi-pass shader pipeline built on LShaderProgram
+#ifndef LSHADER_PIPELINE_H
+#define LSHADER_PIPELINE_H
+
+#include "LOpenGL.h"
+#include "LShaderProgram.h"
+#include "LShaderVariantCache.h"
+#include "LShaderCompiler.h"
+#include "LLookupTables.h"
+#include "LGaussian.h"
+#include "LRenderTarget.h"
+#include "LProfiler.h"
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+
+//Pass size relative to...
+#define LSCALE_SOURCE   0   //...the pass input
+#define LSCALE_VIEWPORT 1   //...the final viewport
+#define LSCALE_ABSOLUTE 2   //...nothing, scale is in pixels
+
+//Floats in the shared "Parameters" uniform block
+#define LMAX_PARAMETERS 64
+
+//Pass prepended to turn 8-bit palette indices into RGBA
+#define LPALETTE_RESOLVE_VS "default2.vs"
+#define LPALETTE_RESOLVE_FS "palette.fs"
+
+struct LPassDesc
+{
+    std::string vsPath;
+    std::string fsPath;
+    int scaleTypeX;
+    int scaleTypeY;
+    GLfloat scaleX;
+    GLfloat scaleY;
+    bool filterLinear;
+    GLenum format;
+
+    //Define set of this pass, see LShaderVariantCache::defineBlock().
+    //BLUR_SIGMA=s adds the taps of LGaussian::defineBlock( s ).
+    std::string defines;
+};
+
+struct LPass
+{
+    LPassDesc desc;
+    LShaderProgram* program;
+    LRenderTarget* target;
+    GLint width;
+    GLint height;
+    int lastUse;
+    int profileStage;
+
+    //Define block the program was built with
+    std::string variantDefines;
+
+    //Compiler job of a pass being reloaded, -1 once it has its program
+    int compileJob;
+
+    //Indices into the pipeline parameters declared by this pass' shaders
+    std::vector<int> parameters;
+};
+
+//Parameter of the loaded passes with its current value
+struct LPipelineParameter
+{
+    LShaderParameter info;
+    GLfloat value;
+};
+
+class LShaderPipeline
+{
+    public:
+        LShaderPipeline();
+        ~LShaderPipeline();
+        static LPassDesc passDesc( std::string vsPath, std::string fsPath );
+        bool addPass( const LPassDesc& desc );
+        bool loadProgram( std::string vsPath, std::string fsPath );
+        bool loadProgram5( std::string vsPath, std::string fsPath1, std::string fsPath2, std::string fsPath3, std::string fsPath4 );
+        bool loadPreset( std::string path );
+        void freePipeline();
+
+        //Define set applied to every pass on top of its own, e.g.
+        //"OVERSAMPLE=0 CRTS_2_TAP=1". Rebuilds the loaded passes from the
+        //variant cache and keeps the old ones if a variant fails to compile.
+        bool setDefines( std::string defineSet );
+        std::string defines();
+        LShaderVariantCache& variants();
+
+        //#pragma parameter values of the loaded passes. Passes declaring the
+        //same name share the value; changes reach the GPU on the next render
+        //through one uniform buffer, without relinking. Values set before a
+        //load, or named in a preset, apply to the passes declaring them. A
+        //parameter named in the define set is compiled in as a constant.
+        int parameterCount();
+        const LPipelineParameter& parameter( int index );
+        bool setParameter( std::string name, GLfloat value );
+
+        //Current value of 'name': pinned by the define set, else of the
+        //loaded passes, else as last set by name, else 'fallback'
+        GLfloat parameterValue( const std::string& name, GLfloat fallback );
+
+        int passCount();
+        LShaderProgram* passProgram( int index );
+
+        //Hot reload. Programs missing from the variant cache are built by
+        //'compiler', off this thread when it has a worker; NULL compiles
+        //them here.
+        void setCompiler( LShaderCompiler* compiler );
+
+        //Shader and preset files the loaded passes were built from
+        void sourceFiles( std::vector<std::string>& paths );
+
+        //Starts rebuilding the passes after 'changed' files were written,
+        //the running passes stay until updateReload() swaps. False if none
+        //of the files is used or the new passes cannot be set up.
+        bool reload( const std::vector<std::string>& changed );
+        bool reloadPending();
+
+        //Swaps the rebuilt passes in once all their programs are ready, or
+        //drops them and keeps the running ones if a program failed. Never
+        //waits for the compiler, call between frames. True on a swap.
+        bool updateReload();
+
+        //Input is palette indexed, takes effect on the next load
+        void setPaletteResolve( bool enable );
+
+        //Extra texture bound to every pass that declares sampler 'name'
+        void setTexture( std::string name, GLuint texID );
+
+        //Framebuffer the last pass draws into, 0 for the window
+        void setOutputFramebuffer( GLuint framebufferID );
+
+        //Time every pass as a GPU stage of 'profiler', NULL to stop
+        void setProfiler( LProfiler* profiler );
+        void render( GLint sourceWidth, GLint sourceHeight, GLint targetX, GLint targetY, GLint targetWidth, GLint targetHeight, GLint texID );
+
+    protected:
+        void allocateTargets( GLint sourceWidth, GLint sourceHeight, GLint viewportWidth, GLint viewportHeight );
+        void releaseTargets();
+        void releasePasses();
+        std::string passDefines( size_t index, const LPassDesc& desc, const std::vector<int>& parameters );
+        bool addParameters( const LPassDesc& desc, std::vector<int>& parameters );
+        void updateParameters();
+        void updateLookupTables();
+        GLint scaledSize( int scaleType, GLfloat scale, GLint inputSize, GLint viewportSize );
+        static bool isSrgbFormat( GLenum format );
+        bool addPaletteResolvePass();
+        bool stageReload();
+        void cancelReload();
+        int bindTextures( LPass& pass, int firstUnit );
+
+        std::vector<LPass> mPasses;
+        LRenderTargetPool mPool;
+
+        //Preset the passes came from, empty for loadProgram()
+        std::string mPresetPath;
+
+        //Passes and parameters of a reload waiting for their programs.
+        //addPass() builds into mPasses without programs while staging.
+        LShaderCompiler* mCompiler;
+        std::vector<LPass> mStaged;
+        std::vector<LPipelineParameter> mStagedParameters;
+        bool mStaging;
+
+        //Compiled programs of current and recent define sets
+        LShaderVariantCache mVariants;
+        std::string mDefines;
+
+        //Parameters of the loaded passes, values set by name survive reloads
+        std::vector<LPipelineParameter> mParameters;
+        std::map<std::string, GLfloat> mParameterValues;
+        GLuint mParameterBuffer;
+        bool mParametersDirty;
+
+        //Tables baked from the parameters, bound as named textures
+        LLookupTables mLookupTables;
+        bool mLookupTablesDirty;
+
+        bool mPaletteResolve;
+        std::map<std::string, GLuint> mTextures;
+        GLuint mOutputFramebuffer;
+        LProfiler* mProfiler;
+
+        //Sampler objects selected by each pass' filter setting
+        GLuint mSamplerNearest;
+        GLuint mSamplerLinear;
+
+        //Sizes the intermediate targets were allocated for
+        GLint mSourceWidth;
+        GLint mSourceHeight;
+        GLint mViewportWidth;
+        GLint mViewportHeight;
+};
+
+#endif
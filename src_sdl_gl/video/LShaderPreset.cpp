@@ -0,0 +1,223 @@
+// .glslp shader preset reader
+#include "LShaderPreset.h"
+#include <fstream>
+#include <stdlib.h>
+
+LShaderPreset::LShaderPreset()
+{
+}
+
+std::vector<LPassDesc>& LShaderPreset::passes()
+{
+    return mPasses;
+}
+
+std::string LShaderPreset::value( const std::string& key, const std::string& fallback )
+{
+    std::map<std::string, std::string>::iterator it = mValues.find( key );
+    if( it == mValues.end() )
+    {
+        return fallback;
+    }
+
+    return it->second;
+}
+
+bool LShaderPreset::loadPresetFromFile( std::string path )
+{
+    mPath = path;
+    mValues.clear();
+    mPasses.clear();
+
+    //Shader paths are relative to the preset
+    size_t slash = path.find_last_of( "/\\" );
+    mDirectory = slash == std::string::npos ? "" : path.substr( 0, slash + 1 );
+
+    std::ifstream presetFile( path.c_str() );
+    if( !presetFile )
+    {
+        printf( "Unable to open preset %s\n", path.c_str() );
+        return false;
+    }
+
+    std::string line;
+    int lineNo = 0;
+    while( std::getline( presetFile, line ) )
+    {
+        ++lineNo;
+        if( !parseLine( line, lineNo ) )
+        {
+            return false;
+        }
+    }
+
+    return buildPasses();
+}
+
+static std::string trim( const std::string& text )
+{
+    size_t begin = text.find_first_not_of( " \t\r\n" );
+    if( begin == std::string::npos )
+    {
+        return "";
+    }
+    size_t end = text.find_last_not_of( " \t\r\n" );
+
+    return text.substr( begin, end - begin + 1 );
+}
+
+bool LShaderPreset::parseLine( const std::string& line, int lineNo )
+{
+    //Strip comments
+    std::string text = line;
+    size_t comment = text.find( '#' );
+    if( comment != std::string::npos )
+    {
+        text = text.substr( 0, comment );
+    }
+    text = trim( text );
+    if( text.empty() )
+    {
+        return true;
+    }
+
+    size_t equals = text.find( '=' );
+    if( equals == std::string::npos )
+    {
+        printf( "%s:%d: expected key = value\n", mPath.c_str(), lineNo );
+        return false;
+    }
+
+    std::string key = trim( text.substr( 0, equals ) );
+    std::string value = trim( text.substr( equals + 1 ) );
+
+    //Values may be quoted
+    if( value.size() >= 2 && value[ 0 ] == '"' && value[ value.size() - 1 ] == '"' )
+    {
+        value = value.substr( 1, value.size() - 2 );
+    }
+
+    mValues[ key ] = value;
+
+    return true;
+}
+
+std::string LShaderPreset::resolvePath( const std::string& path )
+{
+    if( path.empty() || path[ 0 ] == '/' || path[ 0 ] == '\\' || path.find( ':' ) != std::string::npos )
+    {
+        return path;
+    }
+
+    return mDirectory + path;
+}
+
+int LShaderPreset::scaleType( const std::string& name, int fallback )
+{
+    if( name == "source" )
+    {
+        return LSCALE_SOURCE;
+    }
+    if( name == "viewport" )
+    {
+        return LSCALE_VIEWPORT;
+    }
+    if( name == "absolute" )
+    {
+        return LSCALE_ABSOLUTE;
+    }
+    if( !name.empty() )
+    {
+        printf( "%s: unknown scale type '%s'\n", mPath.c_str(), name.c_str() );
+    }
+
+    return fallback;
+}
+
+bool LShaderPreset::boolValue( const std::string& key, bool fallback )
+{
+    std::string text = value( key, "" );
+    if( text.empty() )
+    {
+        return fallback;
+    }
+
+    return text == "true" || text == "1";
+}
+
+GLfloat LShaderPreset::floatValue( const std::string& key, GLfloat fallback )
+{
+    std::string text = value( key, "" );
+    if( text.empty() )
+    {
+        return fallback;
+    }
+
+    return (GLfloat)atof( text.c_str() );
+}
+
+bool LShaderPreset::buildPasses()
+{
+    int count = atoi( value( "shaders", "0" ).c_str() );
+    if( count < 1 )
+    {
+        printf( "%s: no shaders in preset\n", mPath.c_str() );
+        return false;
+    }
+
+    for( int i = 0; i < count; ++i )
+    {
+        char suffix[ 16 ];
+        sprintf( suffix, "%d", i );
+        std::string n = suffix;
+
+        std::string shader = value( "shader" + n, "" );
+        if( shader.empty() )
+        {
+            printf( "%s: shader%d missing\n", mPath.c_str(), i );
+            return false;
+        }
+
+        //A .glsl file holds both stages, otherwise shaderN is the fragment
+        //shader and vertexN names its vertex shader
+        std::string fsPath = resolvePath( shader );
+        std::string vsPath;
+        if( shader.size() > 5 && shader.substr( shader.size() - 5 ) == ".glsl" )
+        {
+            vsPath = fsPath;
+        }
+        else
+        {
+            vsPath = resolvePath( value( "vertex" + n, LPRESET_DEFAULT_VS ) );
+        }
+
+        LPassDesc desc = LShaderPipeline::passDesc( vsPath, fsPath );
+
+        //Passes are source sized unless told otherwise
+        int type = scaleType( value( "scale_type" + n, "" ), LSCALE_SOURCE );
+        desc.scaleTypeX = scaleType( value( "scale_type_x" + n, "" ), type );
+        desc.scaleTypeY = scaleType( value( "scale_type_y" + n, "" ), type );
+
+        GLfloat scale = floatValue( "scale" + n, 1.0f );
+        desc.scaleX = floatValue( "scale_x" + n, scale );
+        desc.scaleY = floatValue( "scale_y" + n, scale );
+
+        desc.filterLinear = boolValue( "filter_linear" + n, true );
+
+        if( boolValue( "float_framebuffer" + n, false ) )
+        {
+            desc.format = GL_RGBA16F;
+        }
+        else if( boolValue( "srgb_framebuffer" + n, false ) )
+        {
+            desc.format = GL_SRGB8_ALPHA8;
+        }
+
+        //Shader toggles, e.g. defines0 = "GEOM_CURVATURE=0 OVERSAMPLE=0"
+        desc.defines = value( "defines" + n, "" );
+
+        mPasses.push_back( desc );
+    }
+
+    return true;
+}
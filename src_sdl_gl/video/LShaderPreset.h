@@ -0,0 +1,36 @@
+// .glslp shader preset reader
+#ifndef LSHADER_PRESET_H
+#define LSHADER_PRESET_H
+
+#include "LShaderPipeline.h"
+#include <stdio.h>
+#include <string>
+#include <map>
+#include <vector>
+
+//Vertex shader used by passes that only name a fragment shader
+#define LPRESET_DEFAULT_VS "default2.vs"
+
+class LShaderPreset
+{
+    public:
+        LShaderPreset();
+        bool loadPresetFromFile( std::string path );
+        std::vector<LPassDesc>& passes();
+        std::string value( const std::string& key, const std::string& fallback );
+
+    private:
+        bool parseLine( const std::string& line, int lineNo );
+        bool buildPasses();
+        std::string resolvePath( const std::string& path );
+        int scaleType( const std::string& name, int fallback );
+        bool boolValue( const std::string& key, bool fallback );
+        GLfloat floatValue( const std::string& key, GLfloat fallback );
+
+        std::string mPath;
+        std::string mDirectory;
+        std::map<std::string, std::string> mValues;
+        std::vector<LPassDesc> mPasses;
+};
+
+#endif
@@ -1,10 +1,29 @@
 // Modified version of source code from Lazy Foo' Productions (2004-2013)
 #include "LShaderProgram.h"
-#include <fstream>
+#include "LProgramCache.h"
+#include <string.h>
 
 LShaderProgram::LShaderProgram()
 {
     mProgramID = 0; //NULL;
+    vao = 0;
+    vbo[0] = vbo[1] = vbo[2] = 0;
+
+    for( int i = 0; i < LSP_MAX_SOURCES; ++i )
+    {
+        mSourceHandles[ i ] = -1;
+        mSourceSizeHandles[ i ] = -1;
+    }
+    mSourceCount = 0;
+    mTargetSizeHandle = -1;
+    mOutputSizeHandle = -1;
+    mModelViewHandle = -1;
+    mProjectionHandle = -1;
+    mModelViewProjectionHandle = -1;
+
+    mGeometryWidth = 0;
+    mGeometryHeight = 0;
+    mGeometryFlipY = false;
 }
 
 LShaderProgram::~LShaderProgram()
@@ -17,6 +36,7 @@ void LShaderProgram::freeProgram()
 {
     if(vbo[0]) {
         glDeleteBuffers(3, &vbo[0]);
+        vbo[0] = vbo[1] = vbo[2] = 0;
     }
     if(vao) {
         glDeleteVertexArrays(1, &vao);
@@ -24,8 +44,15 @@ void LShaderProgram::freeProgram()
     }
 
     //Delete program
-    if (mProgramID != 0)
+    if (mProgramID != 0) {
         glDeleteProgram( mProgramID );
+        mProgramID = 0;
+    }
+
+    mUniforms.clear();
+    mAttributes.clear();
+    mGeometryWidth = 0;
+    mGeometryHeight = 0;
 }
 
 void LShaderProgram::init()
@@ -33,6 +60,11 @@ void LShaderProgram::init()
     glGenVertexArrays(1, &vao);
     glBindVertexArray(vao);
     glGenBuffers(3, &vbo[0]);
+    glBindVertexArray(0);
+
+    //Force geometry upload on next render
+    mGeometryWidth = 0;
+    mGeometryHeight = 0;
 }
 
 bool LShaderProgram::bind()
@@ -127,55 +159,187 @@ void LShaderProgram::printShaderLog( GLuint shader )
     }
 }
 
-GLuint LShaderProgram::loadShaderFromFile( std::string path, GLenum shaderType )
+std::string LShaderProgram::injectDefines( const std::string& source, const std::string& defines )
 {
-    //Open file
-    GLuint shaderID = 0;
-    std::string shaderString;
-    std::ifstream sourceFile( path.c_str() );
+    //Defines must follow #version, which has to stay the first directive
+    size_t insertAt = 0;
+    size_t version = source.find( "#version" );
+    if( version != std::string::npos )
+    {
+        size_t lineEnd = source.find( '\n', version );
+        insertAt = lineEnd == std::string::npos ? source.size() : lineEnd + 1;
+    }
+
+    std::string result = source.substr( 0, insertAt );
+    if( insertAt > 0 && result[ insertAt - 1 ] != '\n' )
+    {
+        result += '\n';
+    }
+    result += defines;
+    result += source.substr( insertAt );
+
+    return result;
+}
+
+bool LShaderProgram::readShaderFile( const std::string& path, std::string& source )
+{
+    //Read whole file in one go
+    FILE* file = fopen( path.c_str(), "rb" );
+    if( file == NULL )
+    {
+        printf( "Unable to open file %s\n", path.c_str() );
+        return false;
+    }
+
+    fseek( file, 0, SEEK_END );
+    long size = ftell( file );
+    fseek( file, 0, SEEK_SET );
+
+    source.resize( size > 0 ? size : 0 );
+    bool success = size <= 0 || fread( &source[ 0 ], size, 1, file ) == 1;
+    fclose( file );
+
+    if( !success )
+    {
+        printf( "Unable to read file %s\n", path.c_str() );
+    }
 
-    //Source file loaded
-    if( sourceFile )
+    return success;
+}
+
+bool LShaderProgram::readParameters( const std::string& path, std::vector<LShaderParameter>& parameters )
+{
+    std::string source;
+    if( !readShaderFile( path, source ) )
     {
-        //Get shader source
-        shaderString.assign( ( std::istreambuf_iterator< char >( sourceFile ) ), std::istreambuf_iterator< char >() );
+        return false;
+    }
 
-        //Create shader ID
-        shaderID = glCreateShader( shaderType );
+    size_t lineStart = 0;
+    while( lineStart < source.size() )
+    {
+        size_t lineEnd = source.find( '\n', lineStart );
+        if( lineEnd == std::string::npos )
+        {
+            lineEnd = source.size();
+        }
+        std::string line = source.substr( lineStart, lineEnd - lineStart );
+        lineStart = lineEnd + 1;
 
-        //Set shader source
-        const GLchar* shaderSource = shaderString.c_str();
-        glShaderSource( shaderID, 1, (const GLchar**)&shaderSource, NULL );
+        size_t pragma = line.find_first_not_of( " \t" );
+        if( pragma == std::string::npos || line.compare( pragma, 7, "#pragma" ) != 0 )
+        {
+            continue;
+        }
 
-        //Compile shader source
-        glCompileShader( shaderID );
+        //#pragma parameter NAME "Label" initial minimum maximum [step]
+        char name[ 64 ];
+        char label[ 128 ];
+        LShaderParameter parameter;
+        parameter.step = 0.0f;
+        int fields = sscanf( line.c_str() + pragma, "#pragma parameter %63s \"%127[^\"]\" %f %f %f %f", name, label, &parameter.initial, &parameter.minimum, &parameter.maximum, &parameter.step );
+        if( fields < 5 )
+        {
+            continue;
+        }
+        parameter.name = name;
+        parameter.label = label;
 
-        //Check shader for errors
-        GLint shaderCompiled = GL_FALSE;
-        glGetShaderiv( shaderID, GL_COMPILE_STATUS, &shaderCompiled );
-        if( shaderCompiled != GL_TRUE )
+        //A .glsl file read for both stages declares everything twice
+        bool known = false;
+        for( size_t i = 0; i < parameters.size(); ++i )
+        {
+            known = known || parameters[ i ].name == parameter.name;
+        }
+        if( !known )
         {
-            printf( "Unable to compile shader %d!\n\nSource:\n%s\n", shaderID, shaderSource );
-            printShaderLog( shaderID );
-            glDeleteShader( shaderID );
-            shaderID = 0;
+            parameters.push_back( parameter );
         }
     }
-    else
+
+    return true;
+}
+
+std::string LShaderProgram::stageSource( const std::string& source, GLenum shaderType, const std::string& defines )
+{
+    //Stage define lets one .glsl file hold both stages
+    std::string stageDefine = shaderType == GL_VERTEX_SHADER ? "#define VERTEX\n" : "#define FRAGMENT\n";
+
+    return injectDefines( source, stageDefine + defines );
+}
+
+GLuint LShaderProgram::compileShader( const std::string& source, GLenum shaderType )
+{
+    //Create shader ID
+    GLuint shaderID = glCreateShader( shaderType );
+
+    //Set shader source
+    const GLchar* shaderSource = source.c_str();
+    glShaderSource( shaderID, 1, (const GLchar**)&shaderSource, NULL );
+
+    //Compile shader source
+    glCompileShader( shaderID );
+
+    //Check shader for errors
+    GLint shaderCompiled = GL_FALSE;
+    glGetShaderiv( shaderID, GL_COMPILE_STATUS, &shaderCompiled );
+    if( shaderCompiled != GL_TRUE )
     {
-        printf( "Unable to open file %s\n", path.c_str() );
+        printf( "Unable to compile shader %d!\n\nSource:\n%s\n", shaderID, shaderSource );
+        printShaderLog( shaderID );
+        glDeleteShader( shaderID );
+        shaderID = 0;
     }
 
     return shaderID;
 }
 
-bool LShaderProgram::loadProgram(std::string vsPath, std::string fsPath)
+GLuint LShaderProgram::loadShaderFromFile( std::string path, GLenum shaderType, const std::string& defines )
+{
+    std::string shaderString;
+    if( !readShaderFile( path, shaderString ) )
+    {
+        return 0;
+    }
+
+    return compileShader( stageSource( shaderString, shaderType, defines ), shaderType );
+}
+
+bool LShaderProgram::loadProgram(std::string vsPath, std::string fsPath, std::string defines)
+{
+    //Get shader sources
+    std::string vsSource, fsSource;
+    if( !readShaderFile( vsPath, vsSource ) || !readShaderFile( fsPath, fsSource ) )
+    {
+        return false;
+    }
+
+    return loadProgramFromSource( stageSource( vsSource, GL_VERTEX_SHADER, defines ), stageSource( fsSource, GL_FRAGMENT_SHADER, defines ) );
+}
+
+bool LShaderProgram::loadProgramFromSource( const std::string& vsSource, const std::string& fsSource )
 {
     //Generate program
     mProgramID = glCreateProgram();
 
+    //Skip compile and link when the driver accepts a cached binary
+    Uint64 cacheKey = 0;
+    if( LProgramCache::enabled() )
+    {
+        cacheKey = LProgramCache::programKey( vsSource, fsSource );
+        if( LProgramCache::loadProgramBinary( mProgramID, cacheKey ) )
+        {
+            reflectProgram();
+            return true;
+        }
+
+        //A rejected binary can leave the program unusable, start over
+        glDeleteProgram( mProgramID );
+        mProgramID = glCreateProgram();
+    }
+
     //Load vertex shader
-    GLuint vertexShader = loadShaderFromFile( vsPath.c_str(), GL_VERTEX_SHADER );
+    GLuint vertexShader = compileShader( vsSource, GL_VERTEX_SHADER );
 
     //Check for errors
     if( vertexShader == 0 )
@@ -189,7 +353,7 @@ bool LShaderProgram::loadProgram(std::string vsPath, std::string fsPath)
     glAttachShader( mProgramID, vertexShader );
 
     //Create fragment shader
-    GLuint fragmentShader = loadShaderFromFile( fsPath.c_str(), GL_FRAGMENT_SHADER );
+    GLuint fragmentShader = compileShader( fsSource, GL_FRAGMENT_SHADER );
 
     //Check for errors
     if( fragmentShader == 0 )
@@ -203,6 +367,15 @@ bool LShaderProgram::loadProgram(std::string vsPath, std::string fsPath)
     //Attach fragment shader to program
     glAttachShader( mProgramID, fragmentShader );
 
+    //Output binding only takes effect at link time
+    glBindFragDataLocation( mProgramID, 0, "fragColor" );
+
+    //Ask the driver to keep a binary we can store
+    if( LProgramCache::enabled() )
+    {
+        glProgramParameteri( mProgramID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
+    }
+
     //Link program
     glLinkProgram( mProgramID );
 
@@ -224,9 +397,238 @@ bool LShaderProgram::loadProgram(std::string vsPath, std::string fsPath)
     glDeleteShader( vertexShader );
     glDeleteShader( fragmentShader );
 
+    if( LProgramCache::enabled() )
+    {
+        LProgramCache::saveProgramBinary( mProgramID, cacheKey );
+    }
+
+    //Cache uniform and attribute locations
+    reflectProgram();
+
     return true;
 }
 
+void LShaderProgram::reflectProgram()
+{
+    mUniforms.clear();
+    mAttributes.clear();
+
+    GLint count = 0;
+    GLint maxLength = 0;
+    GLchar* name;
+
+    //Uniforms, arrays are expanded into one entry per element
+    glGetProgramiv( mProgramID, GL_ACTIVE_UNIFORMS, &count );
+    glGetProgramiv( mProgramID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength );
+    name = new GLchar[ maxLength + 1 ];
+    for( GLint i = 0; i < count; ++i )
+    {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform( mProgramID, i, maxLength + 1, &length, &size, &type, name );
+
+        //Skip members of uniform blocks
+        GLint location = glGetUniformLocation( mProgramID, name );
+        if( location < 0 )
+        {
+            continue;
+        }
+
+        std::string baseName( name, length );
+        if( size > 1 || baseName.find( '[' ) != std::string::npos )
+        {
+            baseName = baseName.substr( 0, baseName.find( '[' ) );
+        }
+
+        for( GLint element = 0; element < size; ++element )
+        {
+            LUniformInfo info;
+            info.name = baseName;
+            if( size > 1 || info.name != std::string( name, length ) )
+            {
+                char index[ 16 ];
+                sprintf( index, "[%d]", element );
+                info.name += index;
+            }
+            info.location = glGetUniformLocation( mProgramID, info.name.c_str() );
+            info.type = type;
+            info.dirty = false;
+            info.valid = false;
+            info.intValue = 0;
+            memset( info.value, 0, sizeof( info.value ) );
+            mUniforms.push_back( info );
+        }
+    }
+    delete[] name;
+
+    //Attributes
+    glGetProgramiv( mProgramID, GL_ACTIVE_ATTRIBUTES, &count );
+    glGetProgramiv( mProgramID, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength );
+    name = new GLchar[ maxLength + 1 ];
+    for( GLint i = 0; i < count; ++i )
+    {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveAttrib( mProgramID, i, maxLength + 1, &length, &size, &type, name );
+
+        LAttributeInfo info;
+        info.name.assign( name, length );
+        info.location = glGetAttribLocation( mProgramID, name );
+        mAttributes.push_back( info );
+    }
+    delete[] name;
+
+    //Resolve the handles render() needs every frame
+    mSourceCount = 0;
+    for( int i = 0; i < LSP_MAX_SOURCES; ++i )
+    {
+        char uniformName[ 32 ];
+        sprintf( uniformName, "source[%d]", i );
+        mSourceHandles[ i ] = uniformHandle( uniformName );
+        sprintf( uniformName, "sourceSize[%d]", i );
+        mSourceSizeHandles[ i ] = uniformHandle( uniformName );
+
+        if( mSourceHandles[ i ] >= 0 )
+        {
+            mSourceCount = i + 1;
+        }
+    }
+    mTargetSizeHandle = uniformHandle( "targetSize" );
+    mOutputSizeHandle = uniformHandle( "outputSize" );
+    mModelViewHandle = uniformHandle( "modelView" );
+    mProjectionHandle = uniformHandle( "projection" );
+    mModelViewProjectionHandle = uniformHandle( "modelViewProjection" );
+
+    //Block bindings are program state, set them after every link or binary load
+    GLuint parameterBlock = glGetUniformBlockIndex( mProgramID, "Parameters" );
+    if( parameterBlock != GL_INVALID_INDEX )
+    {
+        glUniformBlockBinding( mProgramID, parameterBlock, LSP_PARAMETER_BINDING );
+    }
+
+    //Attribute bindings changed, rebuild vertex state
+    mGeometryWidth = 0;
+    mGeometryHeight = 0;
+}
+
+int LShaderProgram::uniformHandle( const std::string& name )
+{
+    for( size_t i = 0; i < mUniforms.size(); ++i )
+    {
+        if( mUniforms[ i ].name == name )
+        {
+            return (int)i;
+        }
+    }
+
+    return -1;
+}
+
+int LShaderProgram::sourceCount()
+{
+    return mSourceCount;
+}
+
+GLint LShaderProgram::attributeLocation( const std::string& name )
+{
+    for( size_t i = 0; i < mAttributes.size(); ++i )
+    {
+        if( mAttributes[ i ].name == name )
+        {
+            return mAttributes[ i ].location;
+        }
+    }
+
+    return -1;
+}
+
+void LShaderProgram::setUniform1i( int handle, GLint value )
+{
+    if( handle < 0 )
+    {
+        return;
+    }
+
+    LUniformInfo& info = mUniforms[ handle ];
+    if( !info.valid || info.intValue != value )
+    {
+        info.intValue = value;
+        info.valid = true;
+        info.dirty = true;
+    }
+}
+
+void LShaderProgram::setUniform4f( int handle, GLfloat value0, GLfloat value1, GLfloat value2, GLfloat value3 )
+{
+    if( handle < 0 )
+    {
+        return;
+    }
+
+    LUniformInfo& info = mUniforms[ handle ];
+    GLfloat values[ 4 ] = { value0, value1, value2, value3 };
+    if( !info.valid || memcmp( info.value, values, sizeof( values ) ) != 0 )
+    {
+        memcpy( info.value, values, sizeof( values ) );
+        info.valid = true;
+        info.dirty = true;
+    }
+}
+
+void LShaderProgram::setUniformMatrix4fv( int handle, const GLfloat* values )
+{
+    if( handle < 0 )
+    {
+        return;
+    }
+
+    LUniformInfo& info = mUniforms[ handle ];
+    if( !info.valid || memcmp( info.value, values, sizeof( info.value ) ) != 0 )
+    {
+        memcpy( info.value, values, sizeof( info.value ) );
+        info.valid = true;
+        info.dirty = true;
+    }
+}
+
+void LShaderProgram::flushUniforms()
+{
+    //Upload changed values only, program must be bound
+    for( size_t i = 0; i < mUniforms.size(); ++i )
+    {
+        LUniformInfo& info = mUniforms[ i ];
+        if( !info.dirty )
+        {
+            continue;
+        }
+
+        switch( info.type )
+        {
+            case GL_FLOAT_MAT4:
+                glUniformMatrix4fv( info.location, 1, GL_FALSE, info.value );
+                break;
+            case GL_FLOAT_VEC4:
+                glUniform4fv( info.location, 1, info.value );
+                break;
+            case GL_FLOAT_VEC3:
+                glUniform3fv( info.location, 1, info.value );
+                break;
+            case GL_FLOAT_VEC2:
+                glUniform2fv( info.location, 1, info.value );
+                break;
+            case GL_FLOAT:
+                glUniform1fv( info.location, 1, info.value );
+                break;
+            default:
+                glUniform1i( info.location, info.intValue );
+                break;
+        }
+        info.dirty = false;
+    }
+}
+
 void glrMatrixMultiply(
     GLfloat* output,
     const GLfloat* xdata, GLint xrows, GLint xcols,
@@ -246,42 +648,10 @@ void glrMatrixMultiply(
   }
 }
 
-void glrUniformMatrix4fv(GLint shaderProgramID, const std::string name, GLfloat* values)
-{
-  GLint location = glGetUniformLocation(shaderProgramID, name.c_str());
-  glUniformMatrix4fv(location, 1, GL_FALSE, values);
-}
-
-void glrUniform1i(GLint shaderProgramID, const std::string name, GLint value)
-{
-  GLint location = glGetUniformLocation(shaderProgramID, name.c_str());
-  glUniform1i(location, value);
-}
-
-void glrUniform4f(GLint shaderProgramID, const std::string name, GLfloat value0, GLfloat value1, GLfloat value2, GLfloat value3)
+void LShaderProgram::updateGeometry(GLint targetWidth, GLint targetHeight, bool flipY)
 {
-  GLint location = glGetUniformLocation(shaderProgramID, name.c_str());
-  glUniform4f(location, value0, value1, value2, value3);
-}
-
-void LShaderProgram::render(GLint sourceWidth, GLint sourceHeight, GLint targetX, GLint targetY, GLint targetWidth, GLint targetHeight, GLint texID)
-{
-  // Set parameters
-  // -- source[0]
-  mTextureLocationID = glGetUniformLocation(mProgramID, "source[0]");
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, texID);
-
-  // -- targetSize, outputSize, sourceSize[0]
-  glrUniform4f(mProgramID, "targetSize", targetWidth, targetHeight, 1.0 / targetWidth, 1.0 / targetHeight);
-  glrUniform4f(mProgramID, "outputSize", targetWidth, targetHeight, 1.0 / targetWidth, 1.0 / targetHeight);
-  glrUniform4f(mProgramID, "sourceSize[0]", sourceWidth, sourceHeight, 1.0 / sourceWidth, 1.0 / sourceHeight);
-
-  // Actual main
-  glViewport(targetX, targetY, targetWidth, targetHeight);
-
-  float w = (float)sourceWidth / (float)sourceWidth;
-  float h = (float)sourceHeight / (float)sourceHeight;
+  float w = 1.0f;
+  float h = 1.0f;
 
   float u = (float)targetWidth;
   float v = (float)targetHeight;
@@ -293,11 +663,15 @@ void LShaderProgram::render(GLint sourceWidth, GLint sourceHeight, GLint targetX
     0, 0, 0, 1,
   };
 
+  // Offscreen targets cancel the vertex shader's Y flip so every pass
+  // keeps the orientation of its source texture
+  float sy = flipY ? -1.0f : 1.0f;
+
   GLfloat projection[] = {
-     2.0f/u,  0.0f,    0.0f, 0.0f,
-     0.0f,    2.0f/v,  0.0f, 0.0f,
-     0.0f,    0.0f,   -1.0f, 0.0f,
-    -1.0f,   -1.0f,    0.0f, 1.0f,
+     2.0f/u,  0.0f,       0.0f, 0.0f,
+     0.0f,    2.0f/v*sy,  0.0f, 0.0f,
+     0.0f,    0.0f,      -1.0f, 0.0f,
+    -1.0f,   -1.0f*sy,    0.0f, 1.0f,
   };
 
   GLfloat modelViewProjection[4 * 4];
@@ -322,36 +696,87 @@ void LShaderProgram::render(GLint sourceWidth, GLint sourceHeight, GLint targetX
     w, h,
   };
 
-  glrUniformMatrix4fv(mProgramID, "modelView", modelView);
-  glrUniformMatrix4fv(mProgramID, "projection", projection);
-  glrUniformMatrix4fv(mProgramID, "modelViewProjection", modelViewProjection);
+  setUniformMatrix4fv(mModelViewHandle, modelView);
+  setUniformMatrix4fv(mProjectionHandle, projection);
+  setUniformMatrix4fv(mModelViewProjectionHandle, modelViewProjection);
 
+  // Upload quad once and record attribute layout in the VAO
   glBindVertexArray(vao);
 
+  GLint locationVertex = attributeLocation("vertex");
   glBindBuffer(GL_ARRAY_BUFFER, vbo[0]);
   glBufferData(GL_ARRAY_BUFFER, 16 * sizeof(GLfloat), vertices, GL_STATIC_DRAW);
-  GLint locationVertex = glGetAttribLocation(mProgramID, "vertex");
-  glEnableVertexAttribArray(locationVertex);
-  glVertexAttribPointer(locationVertex, 4, GL_FLOAT, GL_FALSE, 0, 0);
+  if(locationVertex >= 0) {
+    glEnableVertexAttribArray(locationVertex);
+    glVertexAttribPointer(locationVertex, 4, GL_FLOAT, GL_FALSE, 0, 0);
+  }
 
+  GLint locationPosition = attributeLocation("position");
   glBindBuffer(GL_ARRAY_BUFFER, vbo[1]);
   glBufferData(GL_ARRAY_BUFFER, 16 * sizeof(GLfloat), positions, GL_STATIC_DRAW);
-  GLint locationPosition = glGetAttribLocation(mProgramID, "position");
-  glEnableVertexAttribArray(locationPosition);
-  glVertexAttribPointer(locationPosition, 4, GL_FLOAT, GL_FALSE, 0, 0);
+  if(locationPosition >= 0) {
+    glEnableVertexAttribArray(locationPosition);
+    glVertexAttribPointer(locationPosition, 4, GL_FLOAT, GL_FALSE, 0, 0);
+  }
 
+  GLint locationTexCoord = attributeLocation("texCoord");
   glBindBuffer(GL_ARRAY_BUFFER, vbo[2]);
   glBufferData(GL_ARRAY_BUFFER, 8 * sizeof(GLfloat), texCoords, GL_STATIC_DRAW);
-  GLint locationTexCoord = glGetAttribLocation(mProgramID, "texCoord");
-  glEnableVertexAttribArray(locationTexCoord);
-  glVertexAttribPointer(locationTexCoord, 2, GL_FLOAT, GL_FALSE, 0, 0);
+  if(locationTexCoord >= 0) {
+    glEnableVertexAttribArray(locationTexCoord);
+    glVertexAttribPointer(locationTexCoord, 2, GL_FLOAT, GL_FALSE, 0, 0);
+  }
 
-  glBindFragDataLocation(mProgramID, 0, "fragColor");
-  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindVertexArray(0);
 
-  glDisableVertexAttribArray(locationVertex);
-  glDisableVertexAttribArray(locationPosition);
-  glDisableVertexAttribArray(locationTexCoord);
+  mGeometryWidth = targetWidth;
+  mGeometryHeight = targetHeight;
+  mGeometryFlipY = flipY;
+}
 
+void LShaderProgram::render(GLint sourceWidth, GLint sourceHeight, GLint targetX, GLint targetY, GLint targetWidth, GLint targetHeight, GLint texID)
+{
+  GLuint texIDs[] = { (GLuint)texID };
+  GLint sourceSizes[] = { sourceWidth, sourceHeight };
+
+  render(1, texIDs, sourceSizes, targetX, targetY, targetWidth, targetHeight, targetWidth, targetHeight, false);
+}
+
+void LShaderProgram::render(GLint sourceCount, const GLuint* texIDs, const GLint* sourceSizes, GLint targetX, GLint targetY, GLint targetWidth, GLint targetHeight, GLint outputWidth, GLint outputHeight, bool flipY)
+{
+  glUseProgram(mProgramID);
+
+  // Rebuild quad and matrices only when the target changes
+  if(targetWidth != mGeometryWidth || targetHeight != mGeometryHeight || flipY != mGeometryFlipY) {
+    updateGeometry(targetWidth, targetHeight, flipY);
+  }
+
+  // Set parameters
+  // -- source[n], sourceSize[n]; texture unit n holds source n
+  if(sourceCount > LSP_MAX_SOURCES) {
+    sourceCount = LSP_MAX_SOURCES;
+  }
+  for(GLint n = 0; n < sourceCount; n++) {
+    GLfloat sourceWidth = sourceSizes[n * 2];
+    GLfloat sourceHeight = sourceSizes[n * 2 + 1];
+
+    setUniform1i(mSourceHandles[n], n);
+    setUniform4f(mSourceSizeHandles[n], sourceWidth, sourceHeight, 1.0 / sourceWidth, 1.0 / sourceHeight);
+    glActiveTexture(GL_TEXTURE0 + n);
+    glBindTexture(GL_TEXTURE_2D, texIDs[n]);
+  }
+  glActiveTexture(GL_TEXTURE0);
+
+  // -- targetSize, outputSize
+  setUniform4f(mTargetSizeHandle, targetWidth, targetHeight, 1.0 / targetWidth, 1.0 / targetHeight);
+  setUniform4f(mOutputSizeHandle, outputWidth, outputHeight, 1.0 / outputWidth, 1.0 / outputHeight);
+  flushUniforms();
+
+  // Actual main
+  glViewport(targetX, targetY, targetWidth, targetHeight);
+
+  glBindVertexArray(vao);
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
   glBindVertexArray(0);
 }
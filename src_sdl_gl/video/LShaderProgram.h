@@ -5,29 +5,105 @@
 #include "LOpenGL.h"
 #include <stdio.h>
 #include <string>
+#include <vector>
+
+//Maximum number of source[] history inputs bound per pass
+#define LSP_MAX_SOURCES 8
+
+//Uniform block "Parameters" is bound to this point in every program
+#define LSP_PARAMETER_BINDING 0
+
+//Runtime value declared in a shader with
+//#pragma parameter NAME "Label" initial minimum maximum [step]
+struct LShaderParameter
+{
+    std::string name;
+    std::string label;
+    GLfloat initial;
+    GLfloat minimum;
+    GLfloat maximum;
+    GLfloat step;
+};
+
+//Active uniform with its cached location and last value
+struct LUniformInfo
+{
+    std::string name;
+    GLint location;
+    GLenum type;
+    bool dirty;
+    bool valid;
+    GLint intValue;
+    GLfloat value[ 16 ];
+};
+
+//Active vertex attribute
+struct LAttributeInfo
+{
+    std::string name;
+    GLint location;
+};
 
 class LShaderProgram
 {
     public:
         LShaderProgram();
         virtual ~LShaderProgram();
-        bool loadProgram(std::string vsPath, std::string fsPath);
+        bool loadProgram(std::string vsPath, std::string fsPath, std::string defines = "");
+        bool loadProgramFromSource( const std::string& vsSource, const std::string& fsSource );
         virtual void freeProgram();
         void init();
         bool bind();
         void unbind();
         GLuint getProgramID();
         void render(GLint sourceWidth, GLint sourceHeight, GLint targetX, GLint targetY, GLint targetWidth, GLint targetHeight, GLint texID);
+        void render(GLint sourceCount, const GLuint* texIDs, const GLint* sourceSizes, GLint targetX, GLint targetY, GLint targetWidth, GLint targetHeight, GLint outputWidth, GLint outputHeight, bool flipY);
+        int sourceCount();
+
+        //Appends the #pragma parameter declarations of a shader file
+        static bool readParameters( const std::string& path, std::vector<LShaderParameter>& parameters );
+
+        //Reflection
+        int uniformHandle( const std::string& name );
+        GLint attributeLocation( const std::string& name );
+        void setUniform1i( int handle, GLint value );
+        void setUniform4f( int handle, GLfloat value0, GLfloat value1, GLfloat value2, GLfloat value3 );
+        void setUniformMatrix4fv( int handle, const GLfloat* values );
+        void flushUniforms();
 
     protected:
         void printProgramLog( GLuint program );
         void printShaderLog( GLuint shader );
-        GLuint loadShaderFromFile( std::string path, GLenum shaderType );
+        GLuint loadShaderFromFile( std::string path, GLenum shaderType, const std::string& defines );
+        GLuint compileShader( const std::string& source, GLenum shaderType );
+        static bool readShaderFile( const std::string& path, std::string& source );
+        static std::string stageSource( const std::string& source, GLenum shaderType, const std::string& defines );
+        static std::string injectDefines( const std::string& source, const std::string& defines );
+        void reflectProgram();
+        void updateGeometry( GLint targetWidth, GLint targetHeight, bool flipY );
         GLuint mProgramID;
 
         unsigned int vao;
         unsigned int vbo[3];
-        GLint mTextureLocationID;
+
+        //Reflection tables, filled once after link
+        std::vector<LUniformInfo> mUniforms;
+        std::vector<LAttributeInfo> mAttributes;
+
+        //Handles of the uniforms set by render()
+        int mSourceHandles[ LSP_MAX_SOURCES ];
+        int mSourceSizeHandles[ LSP_MAX_SOURCES ];
+        int mSourceCount;
+        int mTargetSizeHandle;
+        int mOutputSizeHandle;
+        int mModelViewHandle;
+        int mProjectionHandle;
+        int mModelViewProjectionHandle;
+
+        //Target size and orientation the quad geometry was last built for
+        GLint mGeometryWidth;
+        GLint mGeometryHeight;
+        bool mGeometryFlipY;
 };
 
 #endif
@@ -0,0 +1,431 @@
+// Reference image and GPU time checks of shaders, rendered offscreen
+#include "LShaderSuite.h"
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+LShaderSuite::LShaderSuite()
+{
+    mUpdate = false;
+    mThreshold = LSUITE_TIME_THRESHOLD;
+}
+
+LShaderSuite::~LShaderSuite()
+{
+    mPool.freePool();
+}
+
+void LShaderSuite::addShader( const std::string& name, const std::string& vsPath, const std::string& fsPath )
+{
+    LSuiteShader shader;
+    shader.name = name;
+    shader.vsPath = vsPath;
+    shader.fsPath = fsPath;
+    mShaders.push_back( shader );
+}
+
+void LShaderSuite::addPreset( const std::string& name, const std::string& presetPath )
+{
+    LSuiteShader shader;
+    shader.name = name;
+    shader.presetPath = presetPath;
+    mShaders.push_back( shader );
+}
+
+void LShaderSuite::addSize( GLint sourceWidth, GLint sourceHeight, GLint targetWidth, GLint targetHeight )
+{
+    LSuiteSize size = { sourceWidth, sourceHeight, targetWidth, targetHeight };
+    mSizes.push_back( size );
+}
+
+void LShaderSuite::setReferenceDirectory( const std::string& directory, bool update )
+{
+    mDirectory = directory;
+    mUpdate = update;
+}
+
+void LShaderSuite::setTimeThreshold( double percent )
+{
+    mThreshold = percent;
+}
+
+std::string LShaderSuite::caseName( const LSuiteShader& shader, const LSuiteSize& size )
+{
+    char sizes[ 64 ];
+    sprintf( sizes, "-%dx%d-%dx%d", size.sourceWidth, size.sourceHeight, size.targetWidth, size.targetHeight );
+    return shader.name + sizes;
+}
+
+bool LShaderSuite::run()
+{
+    mResults.clear();
+    mBaseline.clear();
+    if( !mUpdate && !loadTimings( mDirectory + "/" + LSUITE_TIMINGS, mBaseline ) )
+    {
+        printf( "No baseline timings in %s, GPU times are not checked\n", mDirectory.c_str() );
+    }
+
+    bool passed = true;
+    for( size_t i = 0; i < mShaders.size(); ++i )
+    {
+        for( size_t j = 0; j < mSizes.size(); ++j )
+        {
+            LSuiteResult result;
+            runCase( mShaders[ i ], mSizes[ j ], result );
+            passed = passed && result.passed;
+            mResults.push_back( result );
+        }
+    }
+    mPool.freePool();
+
+    //Last run's times sit beside the baseline for trend tracking, an
+    //update makes them the baseline
+    saveTimings( mDirectory + "/" + LSUITE_TIMINGS_LAST );
+    if( mUpdate )
+    {
+        saveTimings( mDirectory + "/" + LSUITE_TIMINGS );
+    }
+
+    return passed;
+}
+
+void LShaderSuite::runCase( const LSuiteShader& shader, const LSuiteSize& size, LSuiteResult& result )
+{
+    result.name = caseName( shader, size );
+    result.status = "ok";
+    result.passed = false;
+    result.gpuMs = 0.0;
+    result.baselineMs = 0.0;
+    result.largest = 0;
+    result.mean = 0.0;
+    result.differing = 0.0;
+
+    //Every case starts from a pipeline of its own, nothing carries over
+    LShaderPipeline pipeline;
+    bool loaded = shader.presetPath.empty() ? pipeline.loadProgram( shader.vsPath, shader.fsPath ) : pipeline.loadPreset( shader.presetPath );
+    if( !loaded )
+    {
+        result.status = "compile failed";
+        return;
+    }
+
+    std::vector<Uint32> pixels;
+    if( !render( pipeline, size, pixels, &result.gpuMs ) )
+    {
+        result.status = "render failed";
+        pipeline.freePipeline();
+        return;
+    }
+    pipeline.freePipeline();
+
+    std::string path = mDirectory + "/" + result.name + ".ppm";
+    if( mUpdate )
+    {
+        result.passed = savePPM( path, size.targetWidth, size.targetHeight, pixels );
+        result.status = result.passed ? "updated" : "not written";
+        return;
+    }
+
+    std::vector<Uint32> reference;
+    if( !loadPPM( path, size.targetWidth, size.targetHeight, reference ) )
+    {
+        result.status = "no reference";
+        return;
+    }
+
+    compare( pixels, reference, result );
+    result.passed = result.status == "ok";
+
+    std::map<std::string, double>::iterator baseline = mBaseline.find( result.name );
+    if( baseline != mBaseline.end() )
+    {
+        result.baselineMs = baseline->second;
+        double limit = result.baselineMs * ( 1.0 + mThreshold / 100.0 );
+        if( result.gpuMs > limit && result.gpuMs - result.baselineMs > LSUITE_TIME_FLOOR_MS )
+        {
+            result.status = result.passed ? "slower" : result.status + ", slower";
+            result.passed = false;
+        }
+    }
+}
+
+bool LShaderSuite::render( LShaderPipeline& pipeline, const LSuiteSize& size, std::vector<Uint32>& pixels, double* gpuMs )
+{
+    std::vector<Uint32> pattern( size.sourceWidth * size.sourceHeight );
+    testPattern( &pattern[ 0 ], size.sourceWidth, size.sourceHeight );
+
+    LTexture source;
+    LRenderTarget* target = mPool.acquire( size.targetWidth, size.targetHeight, GL_RGBA8 );
+    if( target == NULL || !source.loadTextureFromPixels32( &pattern[ 0 ], size.sourceWidth, size.sourceHeight ) )
+    {
+        mPool.release( target );
+        return false;
+    }
+    pipeline.setOutputFramebuffer( target->framebufferID );
+
+    //Timer queries measure the GPU alone, without them each frame is timed
+    //on the CPU up to glFinish()
+    bool queries = GLEW_ARB_timer_query;
+    GLuint query = 0;
+    if( queries )
+    {
+        glGenQueries( 1, &query );
+    }
+
+    std::vector<double> times;
+    for( int frame = 0; frame < LSUITE_WARMUP_FRAMES + LSUITE_TIMED_FRAMES; ++frame )
+    {
+        Uint64 start = SDL_GetPerformanceCounter();
+        if( queries )
+        {
+            glBeginQuery( GL_TIME_ELAPSED, query );
+        }
+
+        glBindFramebuffer( GL_FRAMEBUFFER, target->framebufferID );
+        glClear( GL_COLOR_BUFFER_BIT );
+        pipeline.render( size.sourceWidth, size.sourceHeight, 0, 0, size.targetWidth, size.targetHeight, source.getTextureID() );
+
+        //Tiled and software rasterizers draw at the flush, finishing inside
+        //the query keeps their drawing in it
+        glFinish();
+        if( queries )
+        {
+            glEndQuery( GL_TIME_ELAPSED );
+        }
+
+        double ms = ( SDL_GetPerformanceCounter() - start ) * 1000.0 / SDL_GetPerformanceFrequency();
+        if( queries )
+        {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v( query, GL_QUERY_RESULT, &elapsed );
+            ms = elapsed / 1000000.0;
+        }
+        if( frame >= LSUITE_WARMUP_FRAMES )
+        {
+            times.push_back( ms );
+        }
+    }
+    if( queries )
+    {
+        glDeleteQueries( 1, &query );
+    }
+
+    std::sort( times.begin(), times.end() );
+    *gpuMs = times[ times.size() / 2 ];
+
+    //OpenGL rows start at the bottom
+    pixels.resize( size.targetWidth * size.targetHeight );
+    glBindFramebuffer( GL_FRAMEBUFFER, target->framebufferID );
+    glReadPixels( 0, 0, size.targetWidth, size.targetHeight, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[ 0 ] );
+    glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+    for( GLint y = 0; y < size.targetHeight / 2; ++y )
+    {
+        std::swap_ranges( pixels.begin() + y * size.targetWidth, pixels.begin() + ( y + 1 ) * size.targetWidth,
+                          pixels.begin() + ( size.targetHeight - 1 - y ) * size.targetWidth );
+    }
+
+    mPool.release( target );
+    source.freeTexture();
+
+    GLenum error = glGetError();
+    if( error != GL_NO_ERROR )
+    {
+        printf( "Error rendering shader suite case! %s\n", gluErrorString( error ) );
+        return false;
+    }
+
+    return true;
+}
+
+void LShaderSuite::compare( const std::vector<Uint32>& pixels, const std::vector<Uint32>& reference, LSuiteResult& result )
+{
+    size_t differing = 0;
+    double total = 0.0;
+    int largest = 0;
+    for( size_t i = 0; i < pixels.size(); ++i )
+    {
+        int distance = colourDistance( pixels[ i ], reference[ i ] );
+        total += distance;
+        if( distance > largest )
+        {
+            largest = distance;
+        }
+        if( distance > LSUITE_PIXEL_TOLERANCE )
+        {
+            ++differing;
+        }
+    }
+
+    result.largest = largest;
+    result.mean = total / pixels.size();
+    result.differing = (double)differing / pixels.size();
+    if( result.differing > LSUITE_PIXEL_FRACTION || result.mean > LSUITE_MEAN_TOLERANCE )
+    {
+        result.status = "differs";
+    }
+}
+
+int LShaderSuite::colourDistance( Uint32 a, Uint32 b )
+{
+    //Euclidean distance weighted by the mean red ("redmean"), tracks
+    //perceived difference far better than plain RGB at the same cost
+    int r1 = a & 255, g1 = ( a >> 8 ) & 255, b1 = ( a >> 16 ) & 255;
+    int r2 = b & 255, g2 = ( b >> 8 ) & 255, b2 = ( b >> 16 ) & 255;
+    int redMean = ( r1 + r2 ) / 2;
+    int dr = r1 - r2, dg = g1 - g2, db = b1 - b2;
+    int squared = ( ( ( 512 + redMean ) * dr * dr ) >> 8 ) + 4 * dg * dg + ( ( ( 767 - redMean ) * db * db ) >> 8 );
+
+    return (int)sqrt( (double)squared );
+}
+
+void LShaderSuite::testPattern( Uint32* pixels, GLint width, GLint height )
+{
+    //Colour bars on top, a grey ramp, then checkerboards of one and four
+    //pixels: saturated edges, gradients and detail at the source's limit
+    static const Uint32 bars[ 8 ] =
+    {
+        0xFFFFFFFF, 0xFF00FFFF, 0xFFFFFF00, 0xFF00FF00,
+        0xFFFF00FF, 0xFF0000FF, 0xFFFF0000, 0xFF000000
+    };
+    for( GLint y = 0; y < height; ++y )
+    {
+        int band = y * 4 / height;
+        for( GLint x = 0; x < width; ++x )
+        {
+            Uint32 pixel;
+            if( band == 0 )
+            {
+                pixel = bars[ x * 8 / width ];
+            }
+            else if( band == 1 )
+            {
+                Uint32 grey = x * 255 / ( width > 1 ? width - 1 : 1 );
+                pixel = 0xFF000000 | grey << 16 | grey << 8 | grey;
+            }
+            else if( band == 2 )
+            {
+                pixel = ( ( x ^ y ) & 1 ) ? 0xFFFFFFFF : 0xFF000000;
+            }
+            else
+            {
+                pixel = ( ( ( x >> 2 ) ^ ( y >> 2 ) ) & 1 ) ? 0xFF2080E0 : 0xFFE08020;
+            }
+            pixels[ y * width + x ] = pixel;
+        }
+    }
+}
+
+bool LShaderSuite::loadPPM( const std::string& path, GLint width, GLint height, std::vector<Uint32>& pixels )
+{
+    FILE* file = fopen( path.c_str(), "rb" );
+    if( file == NULL )
+    {
+        return false;
+    }
+
+    int fileWidth = 0, fileHeight = 0, maximum = 0;
+    bool valid = fscanf( file, "P6 %d %d %d", &fileWidth, &fileHeight, &maximum ) == 3 && fgetc( file ) != EOF;
+    valid = valid && fileWidth == width && fileHeight == height && maximum == 255;
+
+    std::vector<Uint8> rgb( width * height * 3 );
+    valid = valid && fread( &rgb[ 0 ], rgb.size(), 1, file ) == 1;
+    fclose( file );
+    if( !valid )
+    {
+        printf( "Reference %s is not a %dx%d binary PPM\n", path.c_str(), width, height );
+        return false;
+    }
+
+    pixels.resize( width * height );
+    for( size_t i = 0; i < pixels.size(); ++i )
+    {
+        pixels[ i ] = 0xFF000000 | rgb[ i * 3 + 2 ] << 16 | rgb[ i * 3 + 1 ] << 8 | rgb[ i * 3 ];
+    }
+
+    return true;
+}
+
+bool LShaderSuite::savePPM( const std::string& path, GLint width, GLint height, const std::vector<Uint32>& pixels )
+{
+    std::vector<Uint8> rgb( width * height * 3 );
+    for( size_t i = 0; i < pixels.size(); ++i )
+    {
+        rgb[ i * 3 ] = pixels[ i ] & 255;
+        rgb[ i * 3 + 1 ] = ( pixels[ i ] >> 8 ) & 255;
+        rgb[ i * 3 + 2 ] = ( pixels[ i ] >> 16 ) & 255;
+    }
+
+    FILE* file = fopen( path.c_str(), "wb" );
+    if( file == NULL )
+    {
+        printf( "Unable to write reference %s!\n", path.c_str() );
+        return false;
+    }
+    fprintf( file, "P6\n%d %d\n255\n", width, height );
+    bool success = fwrite( &rgb[ 0 ], rgb.size(), 1, file ) == 1;
+    success = fclose( file ) == 0 && success;
+
+    return success;
+}
+
+bool LShaderSuite::loadTimings( const std::string& path, std::map<std::string, double>& timings )
+{
+    FILE* file = fopen( path.c_str(), "r" );
+    if( file == NULL )
+    {
+        return false;
+    }
+
+    //One "case milliseconds" pair per line
+    char name[ 256 ];
+    double ms;
+    while( fscanf( file, "%255s %lf", name, &ms ) == 2 )
+    {
+        timings[ name ] = ms;
+    }
+    fclose( file );
+
+    return true;
+}
+
+bool LShaderSuite::saveTimings( const std::string& path )
+{
+    FILE* file = fopen( path.c_str(), "w" );
+    if( file == NULL )
+    {
+        printf( "Unable to write timings %s!\n", path.c_str() );
+        return false;
+    }
+
+    for( size_t i = 0; i < mResults.size(); ++i )
+    {
+        if( mResults[ i ].gpuMs > 0.0 )
+        {
+            fprintf( file, "%s %.4f\n", mResults[ i ].name.c_str(), mResults[ i ].gpuMs );
+        }
+    }
+
+    return fclose( file ) == 0;
+}
+
+void LShaderSuite::report()
+{
+    int failed = 0;
+    printf( "%-42s %9s %9s %7s %8s %8s  %s\n", "case", "gpu ms", "baseline", "largest", "mean", "differ%", "result" );
+    for( size_t i = 0; i < mResults.size(); ++i )
+    {
+        const LSuiteResult& r = mResults[ i ];
+        printf( "%-42s %9.3f %9.3f %7d %8.3f %8.3f  %s\n", r.name.c_str(), r.gpuMs, r.baselineMs, r.largest, r.mean, r.differing * 100.0, r.status.c_str() );
+        if( !r.passed )
+        {
+            ++failed;
+        }
+    }
+
+    printf( "Shader suite: %d of %d cases passed", (int)mResults.size() - failed, (int)mResults.size() );
+    if( !mUpdate && !mBaseline.empty() )
+    {
+        printf( ", GPU time threshold %.0f%%", mThreshold );
+    }
+    printf( "\n" );
+}
@@ -0,0 +1,116 @@
+// Reference image and GPU time checks of shaders, rendered offscreen
+#ifndef LSHADER_SUITE_H
+#define LSHADER_SUITE_H
+
+#include "LOpenGL.h"
+#include "LShaderPipeline.h"
+#include "LRenderTarget.h"
+#include "LTexture.h"
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <SDL.h>
+
+//Frames rendered before timing starts, and frames timed; the median counts
+#define LSUITE_WARMUP_FRAMES 3
+#define LSUITE_TIMED_FRAMES  15
+
+//A pixel differs from its reference once its weighted colour distance,
+//0..764, is above LSUITE_PIXEL_TOLERANCE. An image fails when more than
+//LSUITE_PIXEL_FRACTION of its pixels differ or the mean distance is above
+//LSUITE_MEAN_TOLERANCE, so rounding along edges passes and changed
+//features do not.
+#define LSUITE_PIXEL_TOLERANCE 24
+#define LSUITE_PIXEL_FRACTION  0.001
+#define LSUITE_MEAN_TOLERANCE  1.0
+
+//Percent a median GPU time may grow over its baseline, and the smallest
+//growth in milliseconds that counts, below it timer noise dominates
+#define LSUITE_TIME_THRESHOLD 20.0
+#define LSUITE_TIME_FLOOR_MS  0.05
+
+//Baseline and last run GPU times in the reference directory
+#define LSUITE_TIMINGS      "timings.txt"
+#define LSUITE_TIMINGS_LAST "timings-last.txt"
+
+//Shader of the suite, a vertex and fragment shader pair or a preset
+struct LSuiteShader
+{
+    std::string name;
+    std::string vsPath;
+    std::string fsPath;
+    std::string presetPath;
+};
+
+//Test pattern size and the output size it is drawn at
+struct LSuiteSize
+{
+    GLint sourceWidth;
+    GLint sourceHeight;
+    GLint targetWidth;
+    GLint targetHeight;
+};
+
+struct LSuiteResult
+{
+    std::string name;
+    std::string status;
+    bool passed;
+
+    //Median GPU time and its baseline, 0 without one
+    double gpuMs;
+    double baselineMs;
+
+    //Differences from the reference image
+    int largest;
+    double mean;
+    double differing;
+};
+
+class LShaderSuite
+{
+    public:
+        LShaderSuite();
+        ~LShaderSuite();
+
+        void addShader( const std::string& name, const std::string& vsPath, const std::string& fsPath );
+        void addPreset( const std::string& name, const std::string& presetPath );
+        void addSize( GLint sourceWidth, GLint sourceHeight, GLint targetWidth, GLint targetHeight );
+
+        //Reference images and baseline timings are read from 'directory';
+        //with 'update' this run's images and timings replace them instead
+        void setReferenceDirectory( const std::string& directory, bool update );
+        void setTimeThreshold( double percent );
+
+        //Renders every shader at every size on the current context, which
+        //should be a software one so references match across machines.
+        //True if every case passed.
+        bool run();
+        void report();
+
+    private:
+        void runCase( const LSuiteShader& shader, const LSuiteSize& size, LSuiteResult& result );
+        bool render( LShaderPipeline& pipeline, const LSuiteSize& size, std::vector<Uint32>& pixels, double* gpuMs );
+        void compare( const std::vector<Uint32>& pixels, const std::vector<Uint32>& reference, LSuiteResult& result );
+        static std::string caseName( const LSuiteShader& shader, const LSuiteSize& size );
+        static void testPattern( Uint32* pixels, GLint width, GLint height );
+        static int colourDistance( Uint32 a, Uint32 b );
+        static bool loadPPM( const std::string& path, GLint width, GLint height, std::vector<Uint32>& pixels );
+        static bool savePPM( const std::string& path, GLint width, GLint height, const std::vector<Uint32>& pixels );
+        bool loadTimings( const std::string& path, std::map<std::string, double>& timings );
+        bool saveTimings( const std::string& path );
+
+        std::vector<LSuiteShader> mShaders;
+        std::vector<LSuiteSize> mSizes;
+        std::vector<LSuiteResult> mResults;
+        std::map<std::string, double> mBaseline;
+
+        std::string mDirectory;
+        bool mUpdate;
+        double mThreshold;
+
+        LRenderTargetPool mPool;
+};
+
+#endif
@@ -0,0 +1,209 @@
+// LRU cache of shader programs compiled with different #define sets
+#include "LShaderVariantCache.h"
+
+LShaderVariantCache::LShaderVariantCache()
+{
+    mHits = 0;
+    mMisses = 0;
+}
+
+LShaderVariantCache::~LShaderVariantCache()
+{
+    freeCache();
+}
+
+std::string LShaderVariantCache::variantKey( const std::string& vsPath, const std::string& fsPath, const std::string& defines )
+{
+    //Paths cannot contain newlines, so the key cannot be ambiguous
+    return vsPath + "\n" + fsPath + "\n" + defines;
+}
+
+LShaderProgram* LShaderVariantCache::find( const std::string& vsPath, const std::string& fsPath, const std::string& defines )
+{
+    std::map<std::string, std::list<LShaderVariant>::iterator>::iterator found = mIndex.find( variantKey( vsPath, fsPath, defines ) );
+    if( found == mIndex.end() )
+    {
+        return NULL;
+    }
+
+    //Move to the front
+    mVariants.splice( mVariants.begin(), mVariants, found->second );
+    mVariants.front().users++;
+    mHits++;
+
+    return mVariants.front().program;
+}
+
+LShaderProgram* LShaderVariantCache::acquire( const std::string& vsPath, const std::string& fsPath, const std::string& defines )
+{
+    LShaderProgram* program = find( vsPath, fsPath, defines );
+    if( program != NULL )
+    {
+        return program;
+    }
+
+    mMisses++;
+    program = new LShaderProgram();
+    program->init();
+    if( !program->loadProgram( vsPath, fsPath, defines ) )
+    {
+        delete program;
+        return NULL;
+    }
+
+    adopt( vsPath, fsPath, defines, program );
+
+    return program;
+}
+
+void LShaderVariantCache::adopt( const std::string& vsPath, const std::string& fsPath, const std::string& defines, LShaderProgram* program )
+{
+    std::string key = variantKey( vsPath, fsPath, defines );
+
+    //An older program of these inputs is left to its users
+    std::map<std::string, std::list<LShaderVariant>::iterator>::iterator found = mIndex.find( key );
+    if( found != mIndex.end() )
+    {
+        found->second->stale = true;
+        mIndex.erase( found );
+    }
+
+    LShaderVariant variant;
+    variant.key = key;
+    variant.program = program;
+    variant.users = 1;
+    variant.stale = false;
+    mVariants.push_front( variant );
+    mIndex[ key ] = mVariants.begin();
+
+    evict();
+}
+
+void LShaderVariantCache::release( LShaderProgram* program )
+{
+    for( std::list<LShaderVariant>::iterator it = mVariants.begin(); it != mVariants.end(); ++it )
+    {
+        if( it->program == program )
+        {
+            if( it->users > 0 )
+            {
+                it->users--;
+            }
+            break;
+        }
+    }
+
+    evict();
+}
+
+void LShaderVariantCache::invalidate( const std::string& path )
+{
+    for( std::list<LShaderVariant>::iterator it = mVariants.begin(); it != mVariants.end(); ++it )
+    {
+        size_t vsEnd = it->key.find( '\n' );
+        size_t fsEnd = it->key.find( '\n', vsEnd + 1 );
+        bool built = it->key.compare( 0, vsEnd, path ) == 0 || it->key.compare( vsEnd + 1, fsEnd - vsEnd - 1, path ) == 0;
+        if( built && !it->stale )
+        {
+            it->stale = true;
+            mIndex.erase( it->key );
+        }
+    }
+
+    evict();
+}
+
+void LShaderVariantCache::evict()
+{
+    //Walk from the least recently used end, variants in use are never
+    //deleted; stale ones go as soon as they are idle
+    std::list<LShaderVariant>::iterator it = mVariants.end();
+    while( it != mVariants.begin() )
+    {
+        --it;
+        bool over = (int)mVariants.size() > LSHADER_VARIANT_CAPACITY;
+        if( it->users == 0 && ( over || it->stale ) )
+        {
+            delete it->program;
+            if( !it->stale )
+            {
+                mIndex.erase( it->key );
+            }
+            it = mVariants.erase( it );
+        }
+    }
+}
+
+void LShaderVariantCache::freeCache()
+{
+    for( std::list<LShaderVariant>::iterator it = mVariants.begin(); it != mVariants.end(); ++it )
+    {
+        delete it->program;
+    }
+    mVariants.clear();
+    mIndex.clear();
+}
+
+int LShaderVariantCache::variantCount()
+{
+    return (int)mVariants.size();
+}
+
+int LShaderVariantCache::hits()
+{
+    return mHits;
+}
+
+int LShaderVariantCache::misses()
+{
+    return mMisses;
+}
+
+void LShaderVariantCache::parseDefines( const std::string& defineSet, std::map<std::string, std::string>& values )
+{
+    size_t pos = 0;
+    while( pos < defineSet.size() )
+    {
+        size_t begin = defineSet.find_first_not_of( " \t\r\n,", pos );
+        if( begin == std::string::npos )
+        {
+            break;
+        }
+        size_t end = defineSet.find_first_of( " \t\r\n,", begin );
+        if( end == std::string::npos )
+        {
+            end = defineSet.size();
+        }
+        pos = end;
+
+        std::string item = defineSet.substr( begin, end - begin );
+        size_t equals = item.find( '=' );
+        if( equals == std::string::npos )
+        {
+            values[ item ] = "";
+        }
+        else if( equals > 0 )
+        {
+            values[ item.substr( 0, equals ) ] = item.substr( equals + 1 );
+        }
+    }
+}
+
+std::string LShaderVariantCache::defineBlock( const std::string& defineSet )
+{
+    std::map<std::string, std::string> values;
+    parseDefines( defineSet, values );
+
+    std::string block;
+    for( std::map<std::string, std::string>::iterator it = values.begin(); it != values.end(); ++it )
+    {
+        block += "#define " + it->first;
+        if( !it->second.empty() )
+        {
+            block += " " + it->second;
+        }
+        block += "\n";
+    }
+
+    return block;
+}
@@ -0,0 +1,70 @@
+// LRU cache of shader programs compiled with different #define sets
+#ifndef LSHADER_VARIANT_CACHE_H
+#define LSHADER_VARIANT_CACHE_H
+
+#include "LShaderProgram.h"
+#include <stdio.h>
+#include <string>
+#include <list>
+#include <map>
+
+//Idle variants kept compiled before the least recently used is deleted
+#define LSHADER_VARIANT_CAPACITY 16
+
+struct LShaderVariant
+{
+    std::string key;
+    LShaderProgram* program;
+    int users;
+
+    //Built from a file changed since, deleted once no longer used
+    bool stale;
+};
+
+class LShaderVariantCache
+{
+    public:
+        LShaderVariantCache();
+        ~LShaderVariantCache();
+
+        //Program built from the files with 'defines' (#define lines) injected
+        //after #version, compiled on a miss. NULL if it does not compile.
+        LShaderProgram* acquire( const std::string& vsPath, const std::string& fsPath, const std::string& defines );
+
+        //acquire() that never compiles, NULL on a miss
+        LShaderProgram* find( const std::string& vsPath, const std::string& fsPath, const std::string& defines );
+
+        //Takes a program compiled elsewhere as acquired with these inputs
+        void adopt( const std::string& vsPath, const std::string& fsPath, const std::string& defines, LShaderProgram* program );
+
+        //Hands back a program from acquire(), it stays cached while idle
+        void release( LShaderProgram* program );
+
+        //Forgets the variants built from a changed file; programs in use
+        //keep working until released
+        void invalidate( const std::string& path );
+
+        void freeCache();
+
+        int variantCount();
+        int hits();
+        int misses();
+
+        //Turns a define set "NAME=value NAME ..." into #define lines. Names
+        //are sorted and a later duplicate wins, so equal sets give equal keys.
+        static std::string defineBlock( const std::string& defineSet );
+        static void parseDefines( const std::string& defineSet, std::map<std::string, std::string>& values );
+
+    private:
+        static std::string variantKey( const std::string& vsPath, const std::string& fsPath, const std::string& defines );
+        void evict();
+
+        //Most recently used first
+        std::list<LShaderVariant> mVariants;
+        std::map<std::string, std::list<LShaderVariant>::iterator> mIndex;
+
+        int mHits;
+        int mMisses;
+};
+
+#endif
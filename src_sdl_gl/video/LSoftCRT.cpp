@@ -0,0 +1,1022 @@
+// CPU implementation of the lottes and crt-geom shaders for SWOS 2020 rendering engine
+#include "LSoftCRT.h"
+#include "LLookupTables.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define LSOFTCRT_X86 1
+#include <immintrin.h>
+#define LSOFTCRT_TARGET_SSE2 __attribute__((target("sse2"), flatten))
+#define LSOFTCRT_TARGET_AVX2 __attribute__((target("avx2"), flatten))
+//Kernels are templates over a lane type. The per ISA row functions are
+//flattened, so the lane operations are inlined under their target. Lane
+//values go by reference and the generic instances are never called, so
+//the vector ABI warning about them is moot.
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+//crt-geom.fs tilt, not a parameter
+#define GEOM_ANGLE_X 0.0
+#define GEOM_ANGLE_Y 0.0
+
+#define LSOFTCRT_PI 3.14159265358979323846
+
+//Everything a row kernel reads, indexed by output pixel
+struct LSoftCRTFrame
+{
+    const float* planes[ 3 ];
+    const int* cols[ 4 ];
+    const int* rows[ 2 ];
+    const float* weights[ 4 ];
+    const float* values[ 2 ];
+    const float* mask[ 3 ];
+    float consts[ 4 ];
+    Uint32* dst;
+    int width;
+};
+
+typedef void (*LSoftCRTRowFunc)( const LSoftCRTFrame& frame, int y );
+
+//-- Lanes: the shaders' float type, 1, 4 or 8 pixels wide
+
+struct LaneScalar
+{
+    typedef float V;
+    typedef Sint32 I;
+    typedef bool M;
+    enum { N = 1 };
+
+    static inline V set1( float a ) { return a; }
+    static inline I seti( Sint32 a ) { return a; }
+    static inline V load( const float* p ) { return *p; }
+    static inline I loadi( const int* p ) { return *p; }
+    static inline void storei( Uint32* p, I a ) { *p = (Uint32)a; }
+    static inline V gather( const float* base, I index ) { return base[ index ]; }
+
+    static inline V add( V a, V b ) { return a + b; }
+    static inline V sub( V a, V b ) { return a - b; }
+    static inline V mul( V a, V b ) { return a * b; }
+    static inline V div( V a, V b ) { return a / b; }
+    //Same operand order and NaN behaviour as minps/maxps
+    static inline V min( V a, V b ) { return a < b ? a : b; }
+    static inline V max( V a, V b ) { return a > b ? a : b; }
+    static inline V sqrt( V a ) { return sqrtf( a ); }
+    static inline M less( V a, V b ) { return a < b; }
+    static inline V select( M m, V a, V b ) { return m ? a : b; }
+
+    static inline I addi( I a, I b ) { return (I)( (Uint32)a + (Uint32)b ); }
+    static inline I andi( I a, I b ) { return a & b; }
+    static inline I ori( I a, I b ) { return a | b; }
+    static inline I shl( I a, int n ) { return (I)( (Uint32)a << n ); }
+    static inline I shr( I a, int n ) { return a >> n; }
+    static inline I cvtt( V a ) { return (I)a; }
+    static inline V cvtf( I a ) { return (V)a; }
+    static inline V asFloat( I a ) { V v; memcpy( &v, &a, sizeof( v ) ); return v; }
+    static inline I asInt( V a ) { I i; memcpy( &i, &a, sizeof( i ) ); return i; }
+};
+
+#ifdef LSOFTCRT_X86
+struct LaneSSE2
+{
+    typedef __m128 V;
+    typedef __m128i I;
+    typedef __m128 M;
+    enum { N = 4 };
+
+    LSOFTCRT_TARGET_SSE2 static inline V set1( float a ) { return _mm_set1_ps( a ); }
+    LSOFTCRT_TARGET_SSE2 static inline I seti( Sint32 a ) { return _mm_set1_epi32( a ); }
+    LSOFTCRT_TARGET_SSE2 static inline V load( const float* p ) { return _mm_loadu_ps( p ); }
+    LSOFTCRT_TARGET_SSE2 static inline I loadi( const int* p ) { return _mm_loadu_si128( (const __m128i*)p ); }
+    LSOFTCRT_TARGET_SSE2 static inline void storei( Uint32* p, I a ) { _mm_storeu_si128( (__m128i*)p, a ); }
+
+    //No gather before AVX2
+    LSOFTCRT_TARGET_SSE2 static inline V gather( const float* base, I index )
+    {
+        int i[ 4 ];
+        _mm_storeu_si128( (__m128i*)i, index );
+        return _mm_set_ps( base[ i[ 3 ] ], base[ i[ 2 ] ], base[ i[ 1 ] ], base[ i[ 0 ] ] );
+    }
+
+    LSOFTCRT_TARGET_SSE2 static inline V add( V a, V b ) { return _mm_add_ps( a, b ); }
+    LSOFTCRT_TARGET_SSE2 static inline V sub( V a, V b ) { return _mm_sub_ps( a, b ); }
+    LSOFTCRT_TARGET_SSE2 static inline V mul( V a, V b ) { return _mm_mul_ps( a, b ); }
+    LSOFTCRT_TARGET_SSE2 static inline V div( V a, V b ) { return _mm_div_ps( a, b ); }
+    LSOFTCRT_TARGET_SSE2 static inline V min( V a, V b ) { return _mm_min_ps( a, b ); }
+    LSOFTCRT_TARGET_SSE2 static inline V max( V a, V b ) { return _mm_max_ps( a, b ); }
+    LSOFTCRT_TARGET_SSE2 static inline V sqrt( V a ) { return _mm_sqrt_ps( a ); }
+    LSOFTCRT_TARGET_SSE2 static inline M less( V a, V b ) { return _mm_cmplt_ps( a, b ); }
+    LSOFTCRT_TARGET_SSE2 static inline V select( M m, V a, V b ) { return _mm_or_ps( _mm_and_ps( m, a ), _mm_andnot_ps( m, b ) ); }
+
+    LSOFTCRT_TARGET_SSE2 static inline I addi( I a, I b ) { return _mm_add_epi32( a, b ); }
+    LSOFTCRT_TARGET_SSE2 static inline I andi( I a, I b ) { return _mm_and_si128( a, b ); }
+    LSOFTCRT_TARGET_SSE2 static inline I ori( I a, I b ) { return _mm_or_si128( a, b ); }
+    LSOFTCRT_TARGET_SSE2 static inline I shl( I a, int n ) { return _mm_slli_epi32( a, n ); }
+    LSOFTCRT_TARGET_SSE2 static inline I shr( I a, int n ) { return _mm_srai_epi32( a, n ); }
+    LSOFTCRT_TARGET_SSE2 static inline I cvtt( V a ) { return _mm_cvttps_epi32( a ); }
+    LSOFTCRT_TARGET_SSE2 static inline V cvtf( I a ) { return _mm_cvtepi32_ps( a ); }
+    LSOFTCRT_TARGET_SSE2 static inline V asFloat( I a ) { return _mm_castsi128_ps( a ); }
+    LSOFTCRT_TARGET_SSE2 static inline I asInt( V a ) { return _mm_castps_si128( a ); }
+};
+
+struct LaneAVX2
+{
+    typedef __m256 V;
+    typedef __m256i I;
+    typedef __m256 M;
+    enum { N = 8 };
+
+    LSOFTCRT_TARGET_AVX2 static inline V set1( float a ) { return _mm256_set1_ps( a ); }
+    LSOFTCRT_TARGET_AVX2 static inline I seti( Sint32 a ) { return _mm256_set1_epi32( a ); }
+    LSOFTCRT_TARGET_AVX2 static inline V load( const float* p ) { return _mm256_loadu_ps( p ); }
+    LSOFTCRT_TARGET_AVX2 static inline I loadi( const int* p ) { return _mm256_loadu_si256( (const __m256i*)p ); }
+    LSOFTCRT_TARGET_AVX2 static inline void storei( Uint32* p, I a ) { _mm256_storeu_si256( (__m256i*)p, a ); }
+    LSOFTCRT_TARGET_AVX2 static inline V gather( const float* base, I index ) { return _mm256_i32gather_ps( base, index, 4 ); }
+
+    LSOFTCRT_TARGET_AVX2 static inline V add( V a, V b ) { return _mm256_add_ps( a, b ); }
+    LSOFTCRT_TARGET_AVX2 static inline V sub( V a, V b ) { return _mm256_sub_ps( a, b ); }
+    LSOFTCRT_TARGET_AVX2 static inline V mul( V a, V b ) { return _mm256_mul_ps( a, b ); }
+    LSOFTCRT_TARGET_AVX2 static inline V div( V a, V b ) { return _mm256_div_ps( a, b ); }
+    LSOFTCRT_TARGET_AVX2 static inline V min( V a, V b ) { return _mm256_min_ps( a, b ); }
+    LSOFTCRT_TARGET_AVX2 static inline V max( V a, V b ) { return _mm256_max_ps( a, b ); }
+    LSOFTCRT_TARGET_AVX2 static inline V sqrt( V a ) { return _mm256_sqrt_ps( a ); }
+    LSOFTCRT_TARGET_AVX2 static inline M less( V a, V b ) { return _mm256_cmp_ps( a, b, _CMP_LT_OQ ); }
+    LSOFTCRT_TARGET_AVX2 static inline V select( M m, V a, V b ) { return _mm256_blendv_ps( b, a, m ); }
+
+    LSOFTCRT_TARGET_AVX2 static inline I addi( I a, I b ) { return _mm256_add_epi32( a, b ); }
+    LSOFTCRT_TARGET_AVX2 static inline I andi( I a, I b ) { return _mm256_and_si256( a, b ); }
+    LSOFTCRT_TARGET_AVX2 static inline I ori( I a, I b ) { return _mm256_or_si256( a, b ); }
+    LSOFTCRT_TARGET_AVX2 static inline I shl( I a, int n ) { return _mm256_slli_epi32( a, n ); }
+    LSOFTCRT_TARGET_AVX2 static inline I shr( I a, int n ) { return _mm256_srai_epi32( a, n ); }
+    LSOFTCRT_TARGET_AVX2 static inline I cvtt( V a ) { return _mm256_cvttps_epi32( a ); }
+    LSOFTCRT_TARGET_AVX2 static inline V cvtf( I a ) { return _mm256_cvtepi32_ps( a ); }
+    LSOFTCRT_TARGET_AVX2 static inline V asFloat( I a ) { return _mm256_castsi256_ps( a ); }
+    LSOFTCRT_TARGET_AVX2 static inline I asInt( V a ) { return _mm256_castps_si256( a ); }
+};
+#endif // LSOFTCRT_X86
+
+//-- Lane math. Every lane type runs the same operations in the same order,
+//so scalar, SSE2 and AVX2 output is bit-identical.
+
+//2^x, Cephes polynomial on the fraction around the nearest integer
+template<class L>
+static inline typename L::V crtExp2( const typename L::V& value )
+{
+    typedef typename L::V V;
+
+    V x = L::min( L::max( value, L::set1( -126.0f ) ), L::set1( 126.0f ) );
+
+    //floor( x + 0.5 ) without SSE4.1
+    V t = L::add( x, L::set1( 0.5f ) );
+    V n = L::cvtf( L::cvtt( t ) );
+    n = L::select( L::less( t, n ), L::sub( n, L::set1( 1.0f ) ), n );
+    V f = L::sub( x, n );
+
+    V p = L::set1( 1.535336188319500e-4f );
+    p = L::add( L::mul( p, f ), L::set1( 1.339887440266574e-3f ) );
+    p = L::add( L::mul( p, f ), L::set1( 9.618437357674640e-3f ) );
+    p = L::add( L::mul( p, f ), L::set1( 5.550332471162809e-2f ) );
+    p = L::add( L::mul( p, f ), L::set1( 2.402264791363012e-1f ) );
+    p = L::add( L::mul( p, f ), L::set1( 6.931472028550421e-1f ) );
+    p = L::add( L::mul( p, f ), L::set1( 1.0f ) );
+
+    V scale = L::asFloat( L::shl( L::addi( L::cvtt( n ), L::seti( 127 ) ), 23 ) );
+    return L::mul( p, scale );
+}
+
+//log2(x) for normal x > 0, mantissa in [sqrt(1/2), sqrt(2)) and atanh series
+template<class L>
+static inline typename L::V crtLog2( const typename L::V& x )
+{
+    typedef typename L::V V;
+    typedef typename L::I I;
+
+    I bits = L::asInt( x );
+    V e = L::cvtf( L::addi( L::shr( bits, 23 ), L::seti( -127 ) ) );
+    V m = L::asFloat( L::ori( L::andi( bits, L::seti( 0x007FFFFF ) ), L::seti( 0x3F800000 ) ) );
+
+    typename L::M big = L::less( L::set1( 1.41421356f ), m );
+    m = L::select( big, L::mul( m, L::set1( 0.5f ) ), m );
+    e = L::select( big, L::add( e, L::set1( 1.0f ) ), e );
+
+    V t = L::div( L::sub( m, L::set1( 1.0f ) ), L::add( m, L::set1( 1.0f ) ) );
+    V t2 = L::mul( t, t );
+    V p = L::set1( 1.0f / 9.0f );
+    p = L::add( L::mul( p, t2 ), L::set1( 1.0f / 7.0f ) );
+    p = L::add( L::mul( p, t2 ), L::set1( 1.0f / 5.0f ) );
+    p = L::add( L::mul( p, t2 ), L::set1( 1.0f / 3.0f ) );
+    p = L::add( L::mul( p, t2 ), L::set1( 1.0f ) );
+
+    //2 / ln(2)
+    return L::add( e, L::mul( L::mul( t, p ), L::set1( 2.88539008f ) ) );
+}
+
+//pow(x, y) for x >= 0; pow(0, y > 0) comes out as 0 after rounding
+template<class L>
+static inline typename L::V crtPow( const typename L::V& x, const typename L::V& y )
+{
+    return crtExp2<L>( L::mul( y, crtLog2<L>( L::max( x, L::set1( 1e-30f ) ) ) ) );
+}
+
+template<class L>
+static inline typename L::V crtAbs( const typename L::V& x )
+{
+    return L::max( x, L::sub( L::set1( 0.0f ), x ) );
+}
+
+template<class L>
+static inline typename L::V crtSat( const typename L::V& x )
+{
+    return L::min( L::max( x, L::set1( 0.0f ) ), L::set1( 1.0f ) );
+}
+
+//Like a RGBA8 render target: round( saturate( c ) * 255 ), alpha 255
+template<class L>
+static inline typename L::I crtPack( const typename L::V& r, const typename L::V& g, const typename L::V& b )
+{
+    typename L::V scale = L::set1( 255.0f );
+    typename L::V half = L::set1( 0.5f );
+    typename L::I ir = L::cvtt( L::add( L::mul( crtSat<L>( r ), scale ), half ) );
+    typename L::I ig = L::cvtt( L::add( L::mul( crtSat<L>( g ), scale ), half ) );
+    typename L::I ib = L::cvtt( L::add( L::mul( crtSat<L>( b ), scale ), half ) );
+
+    return L::ori( L::ori( ir, L::shl( ig, 8 ) ), L::ori( L::shl( ib, 16 ), L::seti( (Sint32)0xFF000000 ) ) );
+}
+
+//-- lottes.fs per frame: 4x2 taps, scanlines, mask, tone and sRGB
+
+template<class L>
+static inline typename L::V lottesToSrgb( const typename L::V& c )
+{
+    typename L::V curve = L::sub( L::mul( crtPow<L>( c, L::set1( 0.41666f ) ), L::set1( 1.055f ) ), L::set1( 0.055f ) );
+    return L::select( L::less( c, L::set1( 0.0031308f ) ), L::mul( c, L::set1( 12.92f ) ), curve );
+}
+
+template<class L>
+static void lottesSpan( const LSoftCRTFrame& f, int y, int x0, int x1 )
+{
+    typedef typename L::V V;
+    typedef typename L::I I;
+
+    const float* mask[ 3 ];
+    for( int c = 0; c < 3; ++c )
+    {
+        mask[ c ] = f.mask[ c ] + ( y & 1 ) * f.width;
+    }
+
+    for( int x = x0; x + L::N <= x1; x += L::N )
+    {
+        int i = y * f.width + x;
+
+        I rowA = L::loadi( f.rows[ 0 ] + i );
+        I rowB = L::loadi( f.rows[ 1 ] + i );
+        V colA[ 3 ], colB[ 3 ];
+        for( int c = 0; c < 3; ++c )
+        {
+            colA[ c ] = L::set1( 0.0f );
+            colB[ c ] = L::set1( 0.0f );
+        }
+
+        //Horizontal gaussian, weights already normalised and vignetted
+        for( int k = 0; k < 4; ++k )
+        {
+            I col = L::loadi( f.cols[ k ] + i );
+            I a = L::addi( rowA, col );
+            I b = L::addi( rowB, col );
+            V w = L::load( f.weights[ k ] + i );
+            for( int c = 0; c < 3; ++c )
+            {
+                colA[ c ] = L::add( colA[ c ], L::mul( L::gather( f.planes[ c ], a ), w ) );
+                colB[ c ] = L::add( colB[ c ], L::mul( L::gather( f.planes[ c ], b ), w ) );
+            }
+        }
+
+        //Vertical scanline filter and phosphor mask
+        V scanA = L::load( f.values[ 0 ] + i );
+        V scanB = L::load( f.values[ 1 ] + i );
+        V color[ 3 ];
+        for( int c = 0; c < 3; ++c )
+        {
+            color[ c ] = L::add( L::mul( colA[ c ], scanA ), L::mul( colB[ c ], scanB ) );
+            color[ c ] = L::mul( color[ c ], L::load( mask[ c ] + x ) );
+        }
+
+        //CRTS_TONE; contrast 1 and saturation 0 make both pow() identities
+        V peak = L::max( L::set1( 1.0f / ( 256.0f * 65536.0f ) ), L::max( color[ 0 ], L::max( color[ 1 ], color[ 2 ] ) ) );
+        V rcp = L::div( L::set1( 1.0f ), peak );
+        peak = L::mul( peak, L::div( L::set1( 1.0f ), L::add( L::mul( peak, L::set1( f.consts[ 0 ] ) ), L::set1( f.consts[ 1 ] ) ) ) );
+        for( int c = 0; c < 3; ++c )
+        {
+            color[ c ] = lottesToSrgb<L>( L::mul( L::mul( color[ c ], rcp ), peak ) );
+        }
+
+        L::storei( f.dst + i, crtPack<L>( color[ 0 ], color[ 1 ], color[ 2 ] ) );
+    }
+}
+
+//-- crt-geom.fs per frame: Lanczos2 taps, beam profile, dot mask
+
+//scanlineWeights() without USEGAUSSIAN
+template<class L>
+static inline typename L::V geomBeam( const typename L::V& distance, const typename L::V& color )
+{
+    typedef typename L::V V;
+
+    V c2 = L::mul( color, color );
+    V wid = L::add( L::set1( 2.0f ), L::mul( L::set1( 2.0f ), L::mul( c2, c2 ) ) );
+    V weights = L::div( distance, L::set1( 0.3f ) );
+    V base = L::mul( weights, L::div( L::set1( 1.0f ), L::sqrt( L::mul( L::set1( 0.5f ), wid ) ) ) );
+    //exp(-x) as exp2(-x * log2(e))
+    V beam = crtExp2<L>( L::mul( crtPow<L>( base, wid ), L::set1( -1.44269504f ) ) );
+
+    return L::div( L::mul( L::set1( 1.4f ), beam ), L::add( L::set1( 0.6f ), L::mul( L::set1( 0.2f ), wid ) ) );
+}
+
+template<class L>
+static void geomSpan( const LSoftCRTFrame& f, int y, int x0, int x1 )
+{
+    typedef typename L::V V;
+    typedef typename L::I I;
+
+    V one = L::set1( 1.0f );
+    V third = L::set1( 1.0f / 3.0f );
+    V filter = L::set1( f.consts[ 0 ] );
+    V crtGamma = L::set1( f.consts[ 1 ] );
+    V monitorGamma = L::set1( f.consts[ 2 ] );
+
+    for( int x = x0; x + L::N <= x1; x += L::N )
+    {
+        int i = y * f.width + x;
+
+        I rowA = L::loadi( f.rows[ 0 ] + i );
+        I rowB = L::loadi( f.rows[ 1 ] + i );
+        V col[ 3 ], col2[ 3 ];
+        for( int c = 0; c < 3; ++c )
+        {
+            col[ c ] = L::set1( 0.0f );
+            col2[ c ] = L::set1( 0.0f );
+        }
+
+        //Lanczos2 across the current and next scanline
+        for( int k = 0; k < 4; ++k )
+        {
+            I tap = L::loadi( f.cols[ k ] + i );
+            I a = L::addi( rowA, tap );
+            I b = L::addi( rowB, tap );
+            V w = L::load( f.weights[ k ] + i );
+            for( int c = 0; c < 3; ++c )
+            {
+                col[ c ] = L::add( col[ c ], L::mul( L::gather( f.planes[ c ], a ), w ) );
+                col2[ c ] = L::add( col2[ c ], L::mul( L::gather( f.planes[ c ], b ), w ) );
+            }
+        }
+
+        //OVERSAMPLE distances, as the shader steps uv_ratio.y
+        V uv = L::load( f.values[ 0 ] + i );
+        V cval = L::load( f.values[ 1 ] + i );
+        V uv2 = L::add( uv, L::mul( third, filter ) );
+        V uv3 = L::sub( uv2, L::mul( L::set1( 2.0f / 3.0f ), filter ) );
+
+        V res[ 3 ];
+        for( int c = 0; c < 3; ++c )
+        {
+            V c1 = crtPow<L>( crtSat<L>( col[ c ] ), crtGamma );
+            V c2 = crtPow<L>( crtSat<L>( col2[ c ] ), crtGamma );
+
+            V w1 = geomBeam<L>( uv, c1 );
+            V w2 = geomBeam<L>( L::sub( one, uv ), c2 );
+            w1 = L::div( L::add( w1, geomBeam<L>( uv2, c1 ) ), L::set1( 3.0f ) );
+            w2 = L::div( L::add( w2, geomBeam<L>( crtAbs<L>( L::sub( one, uv2 ) ), c2 ) ), L::set1( 3.0f ) );
+            w1 = L::add( w1, L::div( geomBeam<L>( crtAbs<L>( uv3 ), c1 ), L::set1( 3.0f ) ) );
+            w2 = L::add( w2, L::div( geomBeam<L>( crtAbs<L>( L::sub( one, uv3 ) ), c2 ), L::set1( 3.0f ) ) );
+
+            res[ c ] = L::mul( L::add( L::mul( c1, w1 ), L::mul( c2, w2 ) ), cval );
+            res[ c ] = L::mul( res[ c ], L::load( f.mask[ c ] + x ) );
+            res[ c ] = crtPow<L>( res[ c ], monitorGamma );
+        }
+
+        L::storei( f.dst + i, crtPack<L>( res[ 0 ], res[ 1 ], res[ 2 ] ) );
+    }
+}
+
+//-- Row entry points, SIMD body and scalar tail
+
+static void lottesRowScalar( const LSoftCRTFrame& f, int y )
+{
+    lottesSpan<LaneScalar>( f, y, 0, f.width );
+}
+
+static void geomRowScalar( const LSoftCRTFrame& f, int y )
+{
+    geomSpan<LaneScalar>( f, y, 0, f.width );
+}
+
+#ifdef LSOFTCRT_X86
+LSOFTCRT_TARGET_SSE2
+static void lottesRowSSE2( const LSoftCRTFrame& f, int y )
+{
+    int body = f.width - f.width % LaneSSE2::N;
+    lottesSpan<LaneSSE2>( f, y, 0, body );
+    lottesSpan<LaneScalar>( f, y, body, f.width );
+}
+
+LSOFTCRT_TARGET_SSE2
+static void geomRowSSE2( const LSoftCRTFrame& f, int y )
+{
+    int body = f.width - f.width % LaneSSE2::N;
+    geomSpan<LaneSSE2>( f, y, 0, body );
+    geomSpan<LaneScalar>( f, y, body, f.width );
+}
+
+LSOFTCRT_TARGET_AVX2
+static void lottesRowAVX2( const LSoftCRTFrame& f, int y )
+{
+    int body = f.width - f.width % LaneAVX2::N;
+    lottesSpan<LaneAVX2>( f, y, 0, body );
+    lottesSpan<LaneScalar>( f, y, body, f.width );
+}
+
+LSOFTCRT_TARGET_AVX2
+static void geomRowAVX2( const LSoftCRTFrame& f, int y )
+{
+    int body = f.width - f.width % LaneAVX2::N;
+    geomSpan<LaneAVX2>( f, y, 0, body );
+    geomSpan<LaneScalar>( f, y, body, f.width );
+}
+#endif // LSOFTCRT_X86
+
+static LSoftCRTRowFunc rowFunction( int filter )
+{
+    bool geom = filter == LSOFTCRT_GEOM;
+
+    switch( pxImplementation() )
+    {
+#ifdef LSOFTCRT_X86
+        case PX_IMPL_AVX2:
+            return geom ? geomRowAVX2 : lottesRowAVX2;
+        case PX_IMPL_SSE2:
+            return geom ? geomRowSSE2 : lottesRowSSE2;
+#endif
+        default:
+            return geom ? geomRowScalar : lottesRowScalar;
+    }
+}
+
+//-- crt-geom.fs screen curvature, run once per pixel at setup in double
+
+struct GeomVec2
+{
+    double x;
+    double y;
+};
+
+static GeomVec2 geomVec2( double x, double y )
+{
+    GeomVec2 v = { x, y };
+    return v;
+}
+
+static const double gGeomSinX = sin( GEOM_ANGLE_X );
+static const double gGeomSinY = sin( GEOM_ANGLE_Y );
+static const double gGeomCosX = cos( GEOM_ANGLE_X );
+static const double gGeomCosY = cos( GEOM_ANGLE_Y );
+
+static double geomIntersect( GeomVec2 xy, const LSoftCRTParams& p )
+{
+    double A = xy.x * xy.x + xy.y * xy.y + p.geomD * p.geomD;
+    double B = 2.0 * ( p.geomR * ( xy.x * gGeomSinX + xy.y * gGeomSinY - p.geomD * gGeomCosX * gGeomCosY ) - p.geomD * p.geomD );
+    double C = p.geomD * p.geomD + 2.0 * p.geomR * p.geomD * gGeomCosX * gGeomCosY;
+    return ( -B - sqrt( B * B - 4.0 * A * C ) ) / ( 2.0 * A );
+}
+
+static GeomVec2 geomBkwtrans( GeomVec2 xy, const LSoftCRTParams& p )
+{
+    double c = geomIntersect( xy, p );
+    GeomVec2 point = geomVec2( ( c * xy.x + p.geomR * gGeomSinX ) / p.geomR, ( c * xy.y + p.geomR * gGeomSinY ) / p.geomR );
+    GeomVec2 tang = geomVec2( gGeomSinX / gGeomCosX, gGeomSinY / gGeomCosY );
+    GeomVec2 poc = geomVec2( point.x / gGeomCosX, point.y / gGeomCosY );
+    double A = tang.x * tang.x + tang.y * tang.y + 1.0;
+    double B = -2.0 * ( poc.x * tang.x + poc.y * tang.y );
+    double C = poc.x * poc.x + poc.y * poc.y - 1.0;
+    double a = ( -B + sqrt( B * B - 4.0 * A * C ) ) / ( 2.0 * A );
+    GeomVec2 uv = geomVec2( ( point.x - a * gGeomSinX ) / gGeomCosX, ( point.y - a * gGeomSinY ) / gGeomCosY );
+    double r = p.geomR * acos( a < 1.0 ? a : 1.0 );
+
+    //The shader divides 0 by 0 at the centre, take the limit
+    double scale = r > 1e-12 ? r / sin( r / p.geomR ) : p.geomR;
+    return geomVec2( uv.x * scale, uv.y * scale );
+}
+
+static GeomVec2 geomFwtrans( GeomVec2 uv, const LSoftCRTParams& p )
+{
+    double r = sqrt( uv.x * uv.x + uv.y * uv.y );
+    if( r < 1e-5 )
+    {
+        r = 1e-5;
+    }
+    uv.x *= sin( r / p.geomR ) / r;
+    uv.y *= sin( r / p.geomR ) / r;
+    double x = 1.0 - cos( r / p.geomR );
+    double D = p.geomD / p.geomR + x * gGeomCosX * gGeomCosY + uv.x * gGeomSinX + uv.y * gGeomSinY;
+    return geomVec2( p.geomD * ( uv.x * gGeomCosX - x * gGeomSinX ) / D, p.geomD * ( uv.y * gGeomCosY - x * gGeomSinY ) / D );
+}
+
+//maxscale(): centre in xy, zoom in z
+static void geomMaxscale( const LSoftCRTParams& p, double stretch[ 3 ] )
+{
+    double k = -p.geomR / ( 1.0 + p.geomR / p.geomD * gGeomCosX * gGeomCosY );
+    GeomVec2 c = geomBkwtrans( geomVec2( k * gGeomSinX, k * gGeomSinY ), p );
+    GeomVec2 a = geomVec2( 0.5 * p.geomAspectX, 0.5 * p.geomAspectY );
+    GeomVec2 lo = geomVec2( geomFwtrans( geomVec2( -a.x, c.y ), p ).x / p.geomAspectX, geomFwtrans( geomVec2( c.x, -a.y ), p ).y / p.geomAspectY );
+    GeomVec2 hi = geomVec2( geomFwtrans( geomVec2( a.x, c.y ), p ).x / p.geomAspectX, geomFwtrans( geomVec2( c.x, a.y ), p ).y / p.geomAspectY );
+
+    stretch[ 0 ] = ( hi.x + lo.x ) * p.geomAspectX * 0.5;
+    stretch[ 1 ] = ( hi.y + lo.y ) * p.geomAspectY * 0.5;
+    stretch[ 2 ] = hi.x - lo.x > hi.y - lo.y ? hi.x - lo.x : hi.y - lo.y;
+}
+
+static GeomVec2 geomTransform( GeomVec2 coord, const double stretch[ 3 ], const LSoftCRTParams& p )
+{
+    coord.x = ( coord.x - 0.5 ) * p.geomAspectX * stretch[ 2 ] + stretch[ 0 ];
+    coord.y = ( coord.y - 0.5 ) * p.geomAspectY * stretch[ 2 ] + stretch[ 1 ];
+    GeomVec2 xy = geomBkwtrans( coord, p );
+    return geomVec2( xy.x / p.geomOverscanX / p.geomAspectX + 0.5, xy.y / p.geomOverscanY / p.geomAspectY + 0.5 );
+}
+
+static double geomCorner( GeomVec2 coord, const LSoftCRTParams& p )
+{
+    coord.x = ( coord.x - 0.5 ) * p.geomOverscanX + 0.5;
+    coord.y = ( coord.y - 0.5 ) * p.geomOverscanY + 0.5;
+    coord.x = ( coord.x < 1.0 - coord.x ? coord.x : 1.0 - coord.x ) * p.geomAspectX;
+    coord.y = ( coord.y < 1.0 - coord.y ? coord.y : 1.0 - coord.y ) * p.geomAspectY;
+    coord.x = p.geomCornerSize - ( coord.x < p.geomCornerSize ? coord.x : p.geomCornerSize );
+    coord.y = p.geomCornerSize - ( coord.y < p.geomCornerSize ? coord.y : p.geomCornerSize );
+    double corner = ( p.geomCornerSize - sqrt( coord.x * coord.x + coord.y * coord.y ) ) * p.geomCornerSmooth;
+    return corner < 0.0 ? 0.0 : ( corner > 1.0 ? 1.0 : corner );
+}
+
+static int clampIndex( double i, int size )
+{
+    if( i < 0.0 )
+    {
+        return 0;
+    }
+    if( i > size - 1 )
+    {
+        return size - 1;
+    }
+    return (int)i;
+}
+
+LSoftCRT::LSoftCRT()
+{
+    mFilter = LSOFTCRT_LOTTES;
+    mPool = NULL;
+    mParams = defaultParams();
+    mHalation = 0;
+    mSetupFilter = -1;
+    mSrcWidth = 0;
+    mSrcHeight = 0;
+    mDstWidth = 0;
+    mDstHeight = 0;
+    memset( mInputLUT, 0, sizeof( mInputLUT ) );
+    memset( mConsts, 0, sizeof( mConsts ) );
+    mSrc = NULL;
+    mDst = NULL;
+}
+
+LSoftCRT::~LSoftCRT()
+{
+    freeFilter();
+}
+
+void LSoftCRT::setFilter( int filter )
+{
+    mFilter = filter == LSOFTCRT_GEOM ? LSOFTCRT_GEOM : LSOFTCRT_LOTTES;
+}
+
+int LSoftCRT::filter()
+{
+    return mFilter;
+}
+
+void LSoftCRT::setThreadPool( LThreadPool* pool )
+{
+    mPool = pool;
+    mGaussian.setThreadPool( pool );
+}
+
+void LSoftCRT::setHalation( int percent )
+{
+    mHalation = percent < 0 ? 0 : ( percent > 100 ? 100 : percent );
+}
+
+int LSoftCRT::halation()
+{
+    return mHalation;
+}
+
+LSoftCRTParams LSoftCRT::defaultParams()
+{
+    //Initial values of the #pragma parameter declarations
+    LSoftCRTParams params;
+    params.mask = 1.0f;
+    params.maskIntensity = 0.5f;
+    params.scanlineThinness = 0.5f;
+    params.scanBlur = 2.5f;
+    params.curvature = 0.002f;
+    params.trinitronCurve = 0.0f;
+    params.corner = 3.0f;
+    params.crtGamma = 2.4f;
+
+    params.geomCrtGamma = 2.4f;
+    params.geomMonitorGamma = 2.2f;
+    params.geomOverscanX = 1.0f;
+    params.geomOverscanY = 1.0f;
+    params.geomAspectX = 1.0f;
+    params.geomAspectY = 0.75f;
+    params.geomD = 2.0f;
+    params.geomR = 4.0f;
+    params.geomCornerSize = 0.02f;
+    params.geomCornerSmooth = 80.0f;
+
+    return params;
+}
+
+void LSoftCRT::setParams( const LSoftCRTParams& params )
+{
+    if( memcmp( &params, &mParams, sizeof( mParams ) ) != 0 )
+    {
+        mParams = params;
+        mSetupFilter = -1;
+    }
+}
+
+const LSoftCRTParams& LSoftCRT::params()
+{
+    return mParams;
+}
+
+const char* LSoftCRT::filterName()
+{
+    return mFilter == LSOFTCRT_GEOM ? "crt-geom" : "lottes";
+}
+
+const char* LSoftCRT::lanesName()
+{
+    switch( pxImplementation() )
+    {
+#ifdef LSOFTCRT_X86
+        case PX_IMPL_AVX2:
+            return "AVX2";
+        case PX_IMPL_SSE2:
+            return "SSE2";
+#endif
+        default:
+            return "scalar";
+    }
+}
+
+void LSoftCRT::freeFilter()
+{
+    for( int i = 0; i < 3; ++i )
+    {
+        std::vector<float>().swap( mPlanes[ i ] );
+        std::vector<float>().swap( mMask[ i ] );
+    }
+    for( int i = 0; i < 4; ++i )
+    {
+        std::vector<int>().swap( mCols[ i ] );
+        std::vector<float>().swap( mWeights[ i ] );
+    }
+    for( int i = 0; i < 2; ++i )
+    {
+        std::vector<int>().swap( mRows[ i ] );
+        std::vector<float>().swap( mValues[ i ] );
+    }
+    mGaussian.freeBuffers();
+    mSetupFilter = -1;
+}
+
+void LSoftCRT::render( const Uint32* src, int srcWidth, int srcHeight, Uint32* dst, int dstWidth, int dstHeight )
+{
+    if( srcWidth <= 0 || srcHeight <= 0 || dstWidth <= 0 || dstHeight <= 0 )
+    {
+        return;
+    }
+
+    if( mSetupFilter != mFilter || srcWidth != mSrcWidth || srcHeight != mSrcHeight || dstWidth != mDstWidth || dstHeight != mDstHeight )
+    {
+        setup( srcWidth, srcHeight, dstWidth, dstHeight );
+    }
+
+    mSrc = src;
+    mDst = dst;
+
+    //Taps cross band borders, so the whole source is converted first
+    run( mSrcHeight, convertRows );
+    run( mDstHeight, filterRows );
+
+    //Mixed in 8-bit gamma space, the shader combines in linear light
+    if( mHalation > 0 )
+    {
+        mGaussian.halation( dst, dst, mDstWidth, mDstHeight, LSOFTCRT_HALATION_SIGMA, LSOFTCRT_HALATION_DOWNSCALE, mHalation );
+    }
+
+    mSrc = NULL;
+    mDst = NULL;
+}
+
+void LSoftCRT::run( int count, LTaskFunc func )
+{
+    if( mPool != NULL )
+    {
+        mPool->parallelFor( count, LSOFTCRT_BAND_ROWS, func, this );
+    }
+    else
+    {
+        func( this, 0, count );
+    }
+}
+
+void LSoftCRT::convertRows( void* data, int begin, int end )
+{
+    LSoftCRT* crt = (LSoftCRT*)data;
+    for( int i = begin * crt->mSrcWidth; i < end * crt->mSrcWidth; ++i )
+    {
+        Uint32 p = crt->mSrc[ i ];
+        crt->mPlanes[ 0 ][ i ] = crt->mInputLUT[ p & 255 ];
+        crt->mPlanes[ 1 ][ i ] = crt->mInputLUT[ ( p >> 8 ) & 255 ];
+        crt->mPlanes[ 2 ][ i ] = crt->mInputLUT[ ( p >> 16 ) & 255 ];
+    }
+}
+
+void LSoftCRT::filterRows( void* data, int begin, int end )
+{
+    LSoftCRT* crt = (LSoftCRT*)data;
+
+    LSoftCRTFrame frame;
+    for( int i = 0; i < 3; ++i )
+    {
+        frame.planes[ i ] = &crt->mPlanes[ i ][ 0 ];
+        frame.mask[ i ] = &crt->mMask[ i ][ 0 ];
+    }
+    for( int i = 0; i < 4; ++i )
+    {
+        frame.cols[ i ] = &crt->mCols[ i ][ 0 ];
+        frame.weights[ i ] = &crt->mWeights[ i ][ 0 ];
+        frame.consts[ i ] = crt->mConsts[ i ];
+    }
+    for( int i = 0; i < 2; ++i )
+    {
+        frame.rows[ i ] = &crt->mRows[ i ][ 0 ];
+        frame.values[ i ] = &crt->mValues[ i ][ 0 ];
+    }
+    frame.dst = crt->mDst;
+    frame.width = crt->mDstWidth;
+
+    LSoftCRTRowFunc row = rowFunction( crt->mFilter );
+    for( int y = begin; y < end; ++y )
+    {
+        row( frame, y );
+    }
+}
+
+void LSoftCRT::setup( int srcWidth, int srcHeight, int dstWidth, int dstHeight )
+{
+    mSrcWidth = srcWidth;
+    mSrcHeight = srcHeight;
+    mDstWidth = dstWidth;
+    mDstHeight = dstHeight;
+    mSetupFilter = mFilter;
+
+    size_t count = (size_t)dstWidth * dstHeight;
+    for( int i = 0; i < 3; ++i )
+    {
+        mPlanes[ i ].assign( (size_t)srcWidth * srcHeight, 0.0f );
+        mMask[ i ].assign( (size_t)dstWidth * 2, 1.0f );
+    }
+    for( int i = 0; i < 4; ++i )
+    {
+        mCols[ i ].assign( count, 0 );
+        mWeights[ i ].assign( count, 0.0f );
+        mConsts[ i ] = 0.0f;
+    }
+    for( int i = 0; i < 2; ++i )
+    {
+        mRows[ i ].assign( count, 0 );
+        mValues[ i ].assign( count, 0.0f );
+    }
+
+    if( mFilter == LSOFTCRT_GEOM )
+    {
+        setupGeom();
+    }
+    else
+    {
+        setupLottes();
+    }
+}
+
+void LSoftCRT::setupLottes()
+{
+    //FromSrgb1() of every 8-bit input
+    for( int i = 0; i < 256; ++i )
+    {
+        double c = i / 255.0;
+        mInputLUT[ i ] = (float)( c <= 0.04045 ? c * ( 1.0 / 12.92 ) : pow( c * ( 1.0 / 1.055 ) + ( 0.055 / 1.055 ), (double)mParams.crtGamma ) );
+    }
+
+    //CrtsTone( 1.0, 0.0, INPUT_THIN, INPUT_MASK )
+    int type = (int)( mParams.mask + 0.5f );
+    double thin = 0.5 + 0.5 * mParams.scanlineThinness;
+    double dark = 1.0 - mParams.maskIntensity;
+    double mask = type == 0 ? 1.0 : ( type == 1 ? 0.5 + dark * 0.5 : dark );
+    double midOut = 0.18 / ( ( 1.5 - thin ) * ( 0.5 * mask + 0.5 ) );
+    double pMidIn = 0.18;
+    mConsts[ 0 ] = (float)( ( -pMidIn + midOut ) / ( ( 1.0 - pMidIn ) * midOut ) );
+    mConsts[ 1 ] = (float)( ( -pMidIn * midOut + pMidIn ) / ( midOut * -pMidIn + midOut ) );
+
+    //CrtsMask(), every mask type repeats over the tile of the mask table
+    for( int y = 0; y < 2; ++y )
+    {
+        for( int x = 0; x < mDstWidth; ++x )
+        {
+            float rgb[ 3 ];
+            LLookupTables::maskColor( x % LLUT_MASK_WIDTH, y, mParams.mask, (float)dark, rgb );
+            for( int channel = 0; channel < 3; ++channel )
+            {
+                mMask[ channel ][ y * mDstWidth + x ] = rgb[ channel ];
+            }
+        }
+    }
+
+    double warpX = mParams.curvature * ( 1.0 - mParams.trinitronCurve );
+    double warpY = ( 3.0 / 4.0 ) * mParams.curvature;
+    double blur = -2.5 * mParams.scanBlur;
+    double inputWidth = mSrcWidth;
+    double inputHeight = mSrcHeight;
+
+    for( int y = 0; y < mDstHeight; ++y )
+    {
+        for( int x = 0; x < mDstWidth; ++x )
+        {
+            size_t i = (size_t)y * mDstWidth + x;
+
+            //CRTS_WARP
+            double posX = ( x + 0.5 ) * 2.0 / mDstWidth - 1.0;
+            double posY = ( y + 0.5 ) * 2.0 / mDstHeight - 1.0;
+            double warpedX = posX * ( 1.0 + posY * posY * warpX );
+            double warpedY = posY * ( 1.0 + posX * posX * warpY );
+            double satX = warpedX * warpedX > 1.0 ? 1.0 : warpedX * warpedX;
+            double satY = warpedY * warpedY > 1.0 ? 1.0 : warpedY * warpedY;
+            double vin = ( 1.0 - ( 1.0 - satX ) * ( 1.0 - satY ) ) * ( 0.998 + ( 0.001 * mParams.corner ) );
+            vin = -vin * inputHeight + inputHeight;
+            vin = vin < 0.0 ? 0.0 : ( vin > 1.0 ? 1.0 : vin );
+            posX = warpedX * inputWidth * 0.5 + inputWidth * 0.5;
+            posY = warpedY * inputHeight * 0.5 + inputHeight * 0.5;
+
+            //Centres of the 4 nearest texels on the 2 nearest scanlines
+            double y0 = floor( posY - 0.5 ) + 0.5;
+            double x0 = floor( posX - 1.5 ) + 0.5;
+            for( int k = 0; k < 4; ++k )
+            {
+                mCols[ k ][ i ] = clampIndex( x0 - 0.5 + k, mSrcWidth );
+            }
+            mRows[ 0 ][ i ] = clampIndex( y0 - 0.5, mSrcHeight ) * mSrcWidth;
+            mRows[ 1 ][ i ] = clampIndex( y0 + 0.5, mSrcHeight ) * mSrcWidth;
+
+            //Scanlines as windowed cosine
+            double off = posY - y0;
+            double pi2 = 2.0 * LSOFTCRT_PI;
+            double scanA = cos( ( off * thin < 0.5 ? off * thin : 0.5 ) * pi2 ) * 0.5 + 0.5;
+            double scanB = cos( ( ( 1.0 - off ) * thin < 0.5 ? ( 1.0 - off ) * thin : 0.5 ) * pi2 ) * 0.5 + 0.5;
+            mValues[ 0 ][ i ] = (float)scanA;
+            mValues[ 1 ][ i ] = (float)scanB;
+
+            //Horizontal gaussian, normalised, vignette folded in
+            double pix[ 4 ];
+            double total = 0.0;
+            for( int k = 0; k < 4; ++k )
+            {
+                double offK = posX - x0 - k;
+                pix[ k ] = pow( 2.0, blur * offK * offK );
+                total += pix[ k ];
+            }
+            for( int k = 0; k < 4; ++k )
+            {
+                mWeights[ k ][ i ] = (float)( pix[ k ] / total * vin );
+            }
+        }
+    }
+}
+
+void LSoftCRT::setupGeom()
+{
+    //No LINEAR_PROCESSING, gamma is applied after filtering
+    for( int i = 0; i < 256; ++i )
+    {
+        mInputLUT[ i ] = (float)( i / 255.0 );
+    }
+
+    //OVERSAMPLE step, sourceSize.y / targetSize.y, and the gammas
+    mConsts[ 0 ] = (float)mSrcHeight / mDstHeight;
+    mConsts[ 1 ] = mParams.geomCrtGamma;
+    mConsts[ 2 ] = 1.0f / mParams.geomMonitorGamma;
+
+    //Dot mask alternates green and magenta per output column
+    for( int x = 0; x < mDstWidth; ++x )
+    {
+        bool odd = x & 1;
+        mMask[ 0 ][ x ] = odd ? 0.7f : 1.0f;
+        mMask[ 1 ][ x ] = odd ? 1.0f : 0.7f;
+        mMask[ 2 ][ x ] = odd ? 0.7f : 1.0f;
+    }
+
+    double stretch[ 3 ];
+    geomMaxscale( mParams, stretch );
+
+    //Not INTERLACED; sources under 200 lines would divide by 0 in the shader
+    double ilfacY = floor( mSrcHeight / 200.0 );
+    if( ilfacY < 1.0 )
+    {
+        ilfacY = 1.0;
+    }
+
+    for( int y = 0; y < mDstHeight; ++y )
+    {
+        for( int x = 0; x < mDstWidth; ++x )
+        {
+            size_t i = (size_t)y * mDstWidth + x;
+
+            GeomVec2 xy = geomTransform( geomVec2( ( x + 0.5 ) / mDstWidth, ( y + 0.5 ) / mDstHeight ), stretch, mParams );
+            double cval = geomCorner( xy, mParams );
+
+            double ratioX = xy.x * mSrcWidth - 0.5;
+            double ratioY = ( xy.y * mSrcHeight - 0.5 + ilfacY ) / ilfacY;
+            double uvX = ratioX - floor( ratioX );
+            double uvY = ratioY - floor( ratioY );
+
+            //Texel of the snapped coordinate, taps at -1..+2 and one line below
+            double column = floor( ratioX );
+            double row = floor( ratioY ) * ilfacY - ilfacY;
+            for( int k = 0; k < 4; ++k )
+            {
+                mCols[ k ][ i ] = clampIndex( column - 1.0 + k, mSrcWidth );
+            }
+            mRows[ 0 ][ i ] = clampIndex( row, mSrcHeight ) * mSrcWidth;
+            mRows[ 1 ][ i ] = clampIndex( row + ilfacY, mSrcHeight ) * mSrcWidth;
+
+            //Lanczos2 coefficients
+            double coeffs[ 4 ] = { 1.0 + uvX, uvX, 1.0 - uvX, 2.0 - uvX };
+            double total = 0.0;
+            for( int k = 0; k < 4; ++k )
+            {
+                double c = fabs( LSOFTCRT_PI * coeffs[ k ] );
+                if( c < 1e-5 )
+                {
+                    c = 1e-5;
+                }
+                coeffs[ k ] = 2.0 * sin( c ) * sin( c / 2.0 ) / ( c * c );
+                total += coeffs[ k ];
+            }
+            for( int k = 0; k < 4; ++k )
+            {
+                mWeights[ k ][ i ] = (float)( coeffs[ k ] / total );
+            }
+
+            mValues[ 0 ][ i ] = (float)uvY;
+            mValues[ 1 ][ i ] = (float)cval;
+        }
+    }
+}
+
+int LSoftCRT::compare( const Uint32* a, const Uint32* b, int count, double* mean )
+{
+    int largest = 0;
+    double total = 0.0;
+
+    for( int i = 0; i < count; ++i )
+    {
+        for( int shift = 0; shift < 24; shift += 8 )
+        {
+            int diff = (int)( ( a[ i ] >> shift ) & 255 ) - (int)( ( b[ i ] >> shift ) & 255 );
+            if( diff < 0 )
+            {
+                diff = -diff;
+            }
+            if( diff > largest )
+            {
+                largest = diff;
+            }
+            total += diff;
+        }
+    }
+
+    if( mean != NULL )
+    {
+        *mean = count > 0 ? total / ( count * 3.0 ) : 0.0;
+    }
+
+    return largest;
+}
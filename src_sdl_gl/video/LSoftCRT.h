@@ -0,0 +1,136 @@
+// CPU implementation of the lottes and crt-geom shaders for SWOS 2020 rendering engine
+#ifndef LSOFT_CRT_H
+#define LSOFT_CRT_H
+
+#include "LPixelOps.h"
+#include "LThreadPool.h"
+#include "LGaussian.h"
+#include <stdio.h>
+#include <vector>
+#include <SDL.h>
+
+//Filters, with the constants of lottes.fs and crt-geom.fs
+#define LSOFTCRT_LOTTES 0
+#define LSOFTCRT_GEOM   1
+
+//Output rows per pool task
+#define LSOFTCRT_BAND_ROWS 8
+
+//Largest difference per channel to the GLSL output that still counts as
+//a match, in 8-bit steps
+#define LSOFTCRT_TOLERANCE 3
+
+//Halation blur of crt-geom-halation.glslp: sigma in output pixels, blurred
+//at a quarter of the output size
+#define LSOFTCRT_HALATION_SIGMA     4.24f
+#define LSOFTCRT_HALATION_DOWNSCALE 4
+
+//Values of the shader parameters the filter follows, named after their
+//#pragma parameter declarations
+struct LSoftCRTParams
+{
+    //lottes.fs
+    float mask;
+    float maskIntensity;
+    float scanlineThinness;
+    float scanBlur;
+    float curvature;
+    float trinitronCurve;
+    float corner;
+    float crtGamma;
+
+    //crt-geom.fs
+    float geomCrtGamma;
+    float geomMonitorGamma;
+    float geomOverscanX;
+    float geomOverscanY;
+    float geomAspectX;
+    float geomAspectY;
+    float geomD;
+    float geomR;
+    float geomCornerSize;
+    float geomCornerSmooth;
+};
+
+class LSoftCRT
+{
+    public:
+        LSoftCRT();
+        ~LSoftCRT();
+
+        //Filter to run, and the pool to run it on (NULL for the calling thread)
+        void setFilter( int filter );
+        int filter();
+        void setThreadPool( LThreadPool* pool );
+
+        //Percent of a blurred copy mixed into the output, 0 for none
+        void setHalation( int percent );
+        int halation();
+
+        //Parameter values to filter with, the geometry is recomputed on the
+        //next render when they change
+        static LSoftCRTParams defaultParams();
+        void setParams( const LSoftCRTParams& params );
+        const LSoftCRTParams& params();
+
+        //Filters an RGBA frame (LPixelOps layout, top row first) into 'dst'.
+        //Per pixel geometry is computed once per filter and size; the SIMD
+        //lanes follow pxImplementation(), NEON falls back to scalar lanes.
+        void render( const Uint32* src, int srcWidth, int srcHeight, Uint32* dst, int dstWidth, int dstHeight );
+
+        void freeFilter();
+
+        const char* filterName();
+        static const char* lanesName();
+
+        //Largest channel difference of two frames, optional mean difference
+        static int compare( const Uint32* a, const Uint32* b, int count, double* mean );
+
+    private:
+        void setup( int srcWidth, int srcHeight, int dstWidth, int dstHeight );
+        void setupLottes();
+        void setupGeom();
+        void run( int count, LTaskFunc func );
+
+        static void convertRows( void* data, int begin, int end );
+        static void filterRows( void* data, int begin, int end );
+
+        int mFilter;
+        LThreadPool* mPool;
+        LSoftCRTParams mParams;
+
+        //Sizes the geometry below was computed for
+        int mSetupFilter;
+        int mSrcWidth;
+        int mSrcHeight;
+        int mDstWidth;
+        int mDstHeight;
+
+        //Source converted to float planes, through mInputLUT
+        float mInputLUT[ 256 ];
+        std::vector<float> mPlanes[ 3 ];
+
+        //Per output pixel: 4 source columns, 2 source row offsets,
+        //horizontal weights and two filter specific values
+        std::vector<int> mCols[ 4 ];
+        std::vector<int> mRows[ 2 ];
+        std::vector<float> mWeights[ 4 ];
+        std::vector<float> mValues[ 2 ];
+
+        //Phosphor mask of an even and an odd output row, crt-geom only
+        //reads the first
+        std::vector<float> mMask[ 3 ];
+
+        //Filter constants
+        float mConsts[ 4 ];
+
+        //Halation blur of the output
+        int mHalation;
+        LGaussian mGaussian;
+
+        //Frame being rendered
+        const Uint32* mSrc;
+        Uint32* mDst;
+};
+
+#endif
@@ -2,12 +2,32 @@
 #include <stdio.h>
 #include <string>
 #include "LTexture.h"
+#include "LImage.h"
 
 LTexture::LTexture()
 {
     //Initialize texture ID
     mTextureID = 0;
     mPixels = NULL;
+    mPixels8 = NULL;
+    mLocked = false;
+    mPixelFormat = GL_RGBA;
+
+    //Initialize streaming state
+    mStreamMode = LSTREAM_NONE;
+    mPBOCount = 0;
+    mPBOIndex = 0;
+    for( int i = 0; i < LTEXTURE_MAX_PBOS; ++i )
+    {
+        mPBOs[ i ] = 0;
+        mPBOPointers[ i ] = NULL;
+        mFences[ i ] = 0;
+    }
+
+    //Initialize dirty tracking
+    mDirtyTiles = NULL;
+    mTilesX = 0;
+    mTilesY = 0;
 
     //Initialize texture dimensions
     mTextureWidth = 0;
@@ -28,6 +48,7 @@ bool LTexture::loadTextureFromPixels32( GLuint* pixels, GLuint width, GLuint hei
     //Get texture dimensions
     mTextureWidth = width;
     mTextureHeight = height;
+    mPixelFormat = GL_RGBA;
 
     //Generate texture ID
     glGenTextures( 1, &mTextureID );
@@ -35,8 +56,8 @@ bool LTexture::loadTextureFromPixels32( GLuint* pixels, GLuint width, GLuint hei
     //Bind texture ID
     glBindTexture( GL_TEXTURE_2D, mTextureID );
 
-    //Generate texture
-    glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_ABGR_EXT, GL_UNSIGNED_BYTE, pixels );
+    //Generate texture, same byte order as lock()/unlock()
+    glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels );
 
     //Set texture parameters
     glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
@@ -56,46 +77,249 @@ bool LTexture::loadTextureFromPixels32( GLuint* pixels, GLuint width, GLuint hei
     return true;
 }
 
+bool LTexture::loadTextureFromPixels8( GLubyte* pixels, GLuint width, GLuint height )
+{
+    //Free texture if it exists
+    freeTexture();
+
+    //Get texture dimensions
+    mTextureWidth = width;
+    mTextureHeight = height;
+    mPixelFormat = GL_RED;
+
+    //Generate texture ID
+    glGenTextures( 1, &mTextureID );
+
+    //Bind texture ID
+    glBindTexture( GL_TEXTURE_2D, mTextureID );
+
+    //Generate texture, one palette index per texel
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+    glTexImage2D( GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, pixels );
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+
+    //Indices must never be interpolated
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+
+    //Unbind texture
+    glBindTexture( GL_TEXTURE_2D, 0 );
+
+    //Check for error
+    GLenum error = glGetError();
+    if( error != GL_NO_ERROR )
+    {
+        printf( "Error loading texture from 8-bit pixels!\n" );
+        return false;
+    }
+
+    return true;
+}
+
 bool LTexture::loadTextureFromBitmapFile( std::string path, GLuint width, GLuint height )
 {
-    //Free texture if it exists
-    freeTexture();
-
-    //Get texture dimensions
-    mTextureWidth = width;
-    mTextureHeight = height;
-
-    SDL_Surface* Surface = SDL_LoadBMP(path.c_str());
-
-    //Generate texture ID
-    glGenTextures( 1, &mTextureID );
-
-    //Bind texture ID
-    glBindTexture( GL_TEXTURE_2D, mTextureID );
-
-    //Generate texture
-    glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, Surface->pixels );
-
-    //Set texture parameters
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
-
-    //Unbind texture
-    glBindTexture( GL_TEXTURE_2D, 0 );
-
-    //Check for error
-    GLenum error = glGetError();
-    if( error != GL_NO_ERROR )
+    //Decode the mapped file at its own size and row pitch
+    LImage image;
+    if( !LBitmap::load( path, image ) )
     {
-        printf( "Error loading texture from pixels of bitmap file!\n" );
         return false;
     }
 
-    return true;
+    //Caller's expected size, 0 accepts any
+    if( ( width != 0 && image.width != width ) || ( height != 0 && image.height != height ) )
+    {
+        printf( "Bitmap %s is %ux%u, expected %ux%u!\n", path.c_str(), image.width, image.height, width, height );
+        return false;
+    }
+
+    return loadTextureFromPixels32( &image.pixels[ 0 ], image.width, image.height );
 }
 
+bool LTexture::enableStreaming( int mode, GLuint ringSize )
+{
+    //Texture must exist and streaming must not be set up yet
+    if( mTextureID == 0 || mStreamMode != LSTREAM_NONE || mLocked || mode == LSTREAM_NONE )
+    {
+        return false;
+    }
+
+    if( ringSize < 1 )
+    {
+        ringSize = 1;
+    }
+    if( ringSize > LTEXTURE_MAX_PBOS )
+    {
+        ringSize = LTEXTURE_MAX_PBOS;
+    }
+
+    //Persistent mapping needs ARB_buffer_storage, fall back to orphaning
+    if( mode == LSTREAM_PERSISTENT && !GLEW_ARB_buffer_storage )
+    {
+        printf( "ARB_buffer_storage not supported, streaming texture %d with orphaned buffers\n", mTextureID );
+        mode = LSTREAM_ORPHAN;
+    }
+
+    GLsizeiptr bytes = mTextureWidth * mTextureHeight * bytesPerPixel();
+
+    //Seed the shadow copy once, it is authoritative from now on
+    allocatePixels();
+    glBindTexture( GL_TEXTURE_2D, mTextureID );
+    glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+    glGetTexImage( GL_TEXTURE_2D, 0, mPixelFormat, GL_UNSIGNED_BYTE, pixelStorage() );
+    glPixelStorei( GL_PACK_ALIGNMENT, 4 );
+    glBindTexture( GL_TEXTURE_2D, 0 );
+
+    //Create buffer ring
+    mPBOCount = ringSize;
+    mPBOIndex = 0;
+    glGenBuffers( mPBOCount, mPBOs );
+    for( GLuint i = 0; i < mPBOCount; ++i )
+    {
+        glBindBuffer( GL_PIXEL_UNPACK_BUFFER, mPBOs[ i ] );
+        if( mode == LSTREAM_PERSISTENT )
+        {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage( GL_PIXEL_UNPACK_BUFFER, bytes, NULL, flags );
+            mPBOPointers[ i ] = glMapBufferRange( GL_PIXEL_UNPACK_BUFFER, 0, bytes, flags );
+        }
+        else
+        {
+            glBufferData( GL_PIXEL_UNPACK_BUFFER, bytes, NULL, GL_STREAM_DRAW );
+        }
+    }
+    glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+
+    mStreamMode = mode;
+
+    //Check for error
+    GLenum error = glGetError();
+    if( error != GL_NO_ERROR )
+    {
+        printf( "Error enabling streaming for texture %d! %s\n", mTextureID, gluErrorString( error ) );
+        freeStream();
+        deletePixels();
+        return false;
+    }
+
+    return true;
+}
+
+void LTexture::freeStream()
+{
+    //Release buffer ring without waiting, GL keeps the buffers alive until
+    //uploads still in flight from them finish
+    for( GLuint i = 0; i < mPBOCount; ++i )
+    {
+        if( mFences[ i ] != 0 )
+        {
+            glDeleteSync( mFences[ i ] );
+            mFences[ i ] = 0;
+        }
+        if( mPBOPointers[ i ] != NULL )
+        {
+            glBindBuffer( GL_PIXEL_UNPACK_BUFFER, mPBOs[ i ] );
+            glUnmapBuffer( GL_PIXEL_UNPACK_BUFFER );
+            mPBOPointers[ i ] = NULL;
+        }
+    }
+    glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+
+    if( mPBOCount > 0 )
+    {
+        glDeleteBuffers( mPBOCount, mPBOs );
+        for( GLuint i = 0; i < mPBOCount; ++i )
+        {
+            mPBOs[ i ] = 0;
+        }
+    }
+
+    mPBOCount = 0;
+    mPBOIndex = 0;
+    mStreamMode = LSTREAM_NONE;
+}
+
+void LTexture::uploadStream()
+{
+    GLsizeiptr bytes = mTextureWidth * mTextureHeight * bytesPerPixel();
+
+    //Nothing changed, leave the ring alone
+    std::vector<LDirtyRect> rects;
+    getUploadRects( rects );
+    if( rects.empty() )
+    {
+        return;
+    }
+
+    //Advance ring so the buffer still read by the previous draw is left alone
+    GLuint slot = mPBOIndex;
+    mPBOIndex = ( mPBOIndex + 1 ) % mPBOCount;
+
+    glBindBuffer( GL_PIXEL_UNPACK_BUFFER, mPBOs[ slot ] );
+
+    void* dst;
+    if( mStreamMode == LSTREAM_PERSISTENT )
+    {
+        //Wait until the GPU has consumed this slot
+        if( mFences[ slot ] != 0 )
+        {
+            glClientWaitSync( mFences[ slot ], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED );
+            glDeleteSync( mFences[ slot ] );
+            mFences[ slot ] = 0;
+        }
+        dst = mPBOPointers[ slot ];
+    }
+    else
+    {
+        //Orphan old storage so the driver never has to synchronize
+        glBufferData( GL_PIXEL_UNPACK_BUFFER, bytes, NULL, GL_STREAM_DRAW );
+        dst = glMapBufferRange( GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT );
+    }
+
+    if( dst != NULL )
+    {
+        //Only changed rows are copied, the buffer mirrors the shadow layout
+        GLuint bpp = bytesPerPixel();
+        GLuint pitch = mTextureWidth * bpp;
+        for( size_t i = 0; i < rects.size(); ++i )
+        {
+            const LDirtyRect& rect = rects[ i ];
+            for( GLuint y = rect.y; y < rect.y + rect.h; ++y )
+            {
+                GLuint offset = y * pitch + rect.x * bpp;
+                memcpy( (GLubyte*)dst + offset, (GLubyte*)pixelStorage() + offset, rect.w * bpp );
+            }
+        }
+        if( mStreamMode != LSTREAM_PERSISTENT )
+        {
+            glUnmapBuffer( GL_PIXEL_UNPACK_BUFFER );
+        }
+
+        //Update texture from buffer offset 0
+        glBindTexture( GL_TEXTURE_2D, mTextureID );
+        uploadRects( rects, NULL );
+        glBindTexture( GL_TEXTURE_2D, 0 );
+
+        if( mStreamMode == LSTREAM_PERSISTENT )
+        {
+            mFences[ slot ] = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+        }
+    }
+    else
+    {
+        printf( "Unable to map pixel buffer of texture %d!\n", mTextureID );
+    }
+
+    glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+}
+
 void LTexture::freeTexture()
 {
+    //Release streaming buffers
+    if( mStreamMode != LSTREAM_NONE )
+    {
+        freeStream();
+    }
+
     //Delete texture
     if( mTextureID != 0 )
     {
@@ -104,11 +328,10 @@ void LTexture::freeTexture()
     }
 
     //Delete pixels
-    if( mPixels != NULL )
-    {
-        delete[] mPixels;
-        mPixels = NULL;
-    }
+    deletePixels();
+    mLocked = false;
+
+    enableDirtyTracking( false );
 
     mTextureWidth = 0;
     mTextureHeight = 0;
@@ -153,24 +376,101 @@ GLuint LTexture::textureHeight()
     return mTextureHeight;
 }
 
+int LTexture::streamMode()
+{
+    return mStreamMode;
+}
+
+GLuint LTexture::pixelFormat()
+{
+    return mPixelFormat;
+}
+
+void LTexture::setFilter( GLint filter )
+{
+    if( mTextureID != 0 )
+    {
+        glBindTexture( GL_TEXTURE_2D, mTextureID );
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter );
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter );
+        glBindTexture( GL_TEXTURE_2D, 0 );
+    }
+}
+
+GLuint LTexture::bytesPerPixel()
+{
+    return mPixelFormat == GL_RED ? 1 : 4;
+}
+
+GLvoid* LTexture::pixelStorage()
+{
+    if( mPixelFormat == GL_RED )
+    {
+        return mPixels8;
+    }
+
+    return mPixels;
+}
+
+void LTexture::allocatePixels()
+{
+    GLuint size = mTextureWidth * mTextureHeight;
+    if( mPixelFormat == GL_RED )
+    {
+        mPixels8 = new GLubyte[ size ];
+    }
+    else
+    {
+        mPixels = new GLuint[ size ];
+    }
+}
+
+void LTexture::deletePixels()
+{
+    if( mPixels != NULL )
+    {
+        delete[] mPixels;
+        mPixels = NULL;
+    }
+    if( mPixels8 != NULL )
+    {
+        delete[] mPixels8;
+        mPixels8 = NULL;
+    }
+}
+
 bool LTexture::lock()
 {
+    //Shadow copy is always current in streaming mode, no readback needed
+    if( mStreamMode != LSTREAM_NONE )
+    {
+        if( !mLocked )
+        {
+            mLocked = true;
+            return true;
+        }
+
+        return false;
+    }
+
     //If texture is not locked and a texture exists
-    if( mPixels == NULL && mTextureID != 0 )
+    if( !mLocked && mTextureID != 0 )
     {
         //Allocate memory for texture data
-        GLuint size = mTextureWidth * mTextureHeight;
-        mPixels = new GLuint[ size ];
+        allocatePixels();
 
         //Set current texture
         glBindTexture( GL_TEXTURE_2D, mTextureID );
 
         //Get pixels
-        glGetTexImage( GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, mPixels );
+        glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+        glGetTexImage( GL_TEXTURE_2D, 0, mPixelFormat, GL_UNSIGNED_BYTE, pixelStorage() );
+        glPixelStorei( GL_PACK_ALIGNMENT, 4 );
 
         //Unbind texture
         glBindTexture( GL_TEXTURE_2D, 0 );
 
+        mLocked = true;
         return true;
     }
 
@@ -179,18 +479,33 @@ bool LTexture::lock()
 
 bool LTexture::unlock()
 {
+    //Upload shadow copy through the buffer ring
+    if( mStreamMode != LSTREAM_NONE )
+    {
+        if( mLocked )
+        {
+            uploadStream();
+            mLocked = false;
+            return true;
+        }
+
+        return false;
+    }
+
     //If texture is locked and a texture exists
-    if( mPixels != NULL && mTextureID != 0 )
+    if( mLocked && mTextureID != 0 )
     {
         //Set current texture
         glBindTexture( GL_TEXTURE_2D, mTextureID );
 
         //Update texture
-        glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, mTextureWidth, mTextureHeight, GL_RGBA, GL_UNSIGNED_BYTE, mPixels );
+        std::vector<LDirtyRect> rects;
+        getUploadRects( rects );
+        uploadRects( rects, (const GLubyte*)pixelStorage() );
 
         //Delete pixels
-        delete[] mPixels;
-        mPixels = NULL;
+        deletePixels();
+        mLocked = false;
 
         //Unbind texture
         glBindTexture( GL_TEXTURE_2D, 0 );
@@ -214,4 +529,198 @@ GLuint LTexture::getPixel32( GLuint x, GLuint y )
 void LTexture::setPixel32( GLuint x, GLuint y, GLuint pixel )
 {
     mPixels[ y * mTextureWidth + x ] = pixel;
+    if( mDirtyTiles != NULL )
+    {
+        mDirtyTiles[ ( y / LTEXTURE_TILE_SIZE ) * mTilesX + x / LTEXTURE_TILE_SIZE ] = 1;
+    }
+}
+
+GLubyte* LTexture::getPixelData8()
+{
+    return mPixels8;
+}
+
+GLubyte LTexture::getPixel8( GLuint x, GLuint y )
+{
+    return mPixels8[ y * mTextureWidth + x ];
+}
+
+void LTexture::setPixel8( GLuint x, GLuint y, GLubyte pixel )
+{
+    mPixels8[ y * mTextureWidth + x ] = pixel;
+    if( mDirtyTiles != NULL )
+    {
+        mDirtyTiles[ ( y / LTEXTURE_TILE_SIZE ) * mTilesX + x / LTEXTURE_TILE_SIZE ] = 1;
+    }
+}
+
+void LTexture::enableDirtyTracking( bool enable )
+{
+    if( mDirtyTiles != NULL )
+    {
+        delete[] mDirtyTiles;
+        mDirtyTiles = NULL;
+        mTilesX = 0;
+        mTilesY = 0;
+    }
+
+    if( enable && mTextureID != 0 )
+    {
+        mTilesX = ( mTextureWidth + LTEXTURE_TILE_SIZE - 1 ) / LTEXTURE_TILE_SIZE;
+        mTilesY = ( mTextureHeight + LTEXTURE_TILE_SIZE - 1 ) / LTEXTURE_TILE_SIZE;
+        mDirtyTiles = new GLubyte[ mTilesX * mTilesY ];
+
+        //Contents are unknown to the caller, first upload is a full one
+        invalidate();
+    }
+}
+
+bool LTexture::dirtyTracking()
+{
+    return mDirtyTiles != NULL;
+}
+
+void LTexture::invalidate()
+{
+    if( mDirtyTiles != NULL )
+    {
+        memset( mDirtyTiles, 1, mTilesX * mTilesY );
+    }
+}
+
+void LTexture::invalidateRect( GLuint x, GLuint y, GLuint w, GLuint h )
+{
+    if( mDirtyTiles == NULL || w == 0 || h == 0 || x >= mTextureWidth || y >= mTextureHeight )
+    {
+        return;
+    }
+
+    //Clip to texture
+    GLuint right = x + w > mTextureWidth ? mTextureWidth : x + w;
+    GLuint bottom = y + h > mTextureHeight ? mTextureHeight : y + h;
+
+    for( GLuint ty = y / LTEXTURE_TILE_SIZE; ty <= ( bottom - 1 ) / LTEXTURE_TILE_SIZE; ++ty )
+    {
+        for( GLuint tx = x / LTEXTURE_TILE_SIZE; tx <= ( right - 1 ) / LTEXTURE_TILE_SIZE; ++tx )
+        {
+            mDirtyTiles[ ty * mTilesX + tx ] = 1;
+        }
+    }
+}
+
+bool LTexture::isDirty()
+{
+    if( mDirtyTiles == NULL )
+    {
+        return true;
+    }
+
+    for( GLuint i = 0; i < mTilesX * mTilesY; ++i )
+    {
+        if( mDirtyTiles[ i ] )
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void LTexture::getDirtyRects( std::vector<LDirtyRect>& rects )
+{
+    rects.clear();
+    if( mDirtyTiles == NULL )
+    {
+        return;
+    }
+
+    //Runs of dirty tiles per tile row, grown downwards while the run below
+    //covers exactly the same columns
+    std::vector<LDirtyRect> open;
+    std::vector<LDirtyRect> row;
+    for( GLuint ty = 0; ty < mTilesY; ++ty )
+    {
+        row.clear();
+
+        GLuint tx = 0;
+        while( tx < mTilesX )
+        {
+            if( !mDirtyTiles[ ty * mTilesX + tx ] )
+            {
+                ++tx;
+                continue;
+            }
+
+            GLuint first = tx;
+            while( tx < mTilesX && mDirtyTiles[ ty * mTilesX + tx ] )
+            {
+                ++tx;
+            }
+
+            LDirtyRect rect;
+            rect.x = first * LTEXTURE_TILE_SIZE;
+            rect.y = ty * LTEXTURE_TILE_SIZE;
+            rect.w = ( tx * LTEXTURE_TILE_SIZE > mTextureWidth ? mTextureWidth : tx * LTEXTURE_TILE_SIZE ) - rect.x;
+            rect.h = ( rect.y + LTEXTURE_TILE_SIZE > mTextureHeight ? mTextureHeight : rect.y + LTEXTURE_TILE_SIZE ) - rect.y;
+
+            for( size_t i = 0; i < open.size(); ++i )
+            {
+                if( open[ i ].x == rect.x && open[ i ].w == rect.w )
+                {
+                    rect.y = open[ i ].y;
+                    rect.h += open[ i ].h;
+                    open.erase( open.begin() + i );
+                    break;
+                }
+            }
+            row.push_back( rect );
+        }
+
+        //Runs not continued in this row are finished
+        rects.insert( rects.end(), open.begin(), open.end() );
+        open.swap( row );
+    }
+    rects.insert( rects.end(), open.begin(), open.end() );
+}
+
+void LTexture::clearDirty()
+{
+    if( mDirtyTiles != NULL )
+    {
+        memset( mDirtyTiles, 0, mTilesX * mTilesY );
+    }
+}
+
+void LTexture::getUploadRects( std::vector<LDirtyRect>& rects )
+{
+    //Untracked textures are always uploaded whole
+    if( mDirtyTiles == NULL )
+    {
+        LDirtyRect rect;
+        rect.x = 0;
+        rect.y = 0;
+        rect.w = mTextureWidth;
+        rect.h = mTextureHeight;
+        rects.assign( 1, rect );
+        return;
+    }
+
+    getDirtyRects( rects );
+    clearDirty();
+}
+
+void LTexture::uploadRects( const std::vector<LDirtyRect>& rects, const GLubyte* pixels )
+{
+    //Rectangles are addressed inside the full width rows of the shadow copy
+    GLuint bpp = bytesPerPixel();
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+    glPixelStorei( GL_UNPACK_ROW_LENGTH, mTextureWidth );
+    for( size_t i = 0; i < rects.size(); ++i )
+    {
+        const LDirtyRect& rect = rects[ i ];
+        const GLubyte* data = pixels + ( rect.y * mTextureWidth + rect.x ) * bpp;
+        glTexSubImage2D( GL_TEXTURE_2D, 0, rect.x, rect.y, rect.w, rect.h, mPixelFormat, GL_UNSIGNED_BYTE, data );
+    }
+    glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
 }
@@ -6,15 +6,38 @@
 #include <stdio.h>
 #include <string.h>
 #include <fstream>
+#include <vector>
 #include <SDL.h>
 
+//Streaming upload modes
+#define LSTREAM_NONE       0
+#define LSTREAM_ORPHAN     1
+#define LSTREAM_PERSISTENT 2
+
+//Maximum number of pixel unpack buffers in the streaming ring
+#define LTEXTURE_MAX_PBOS 4
+
+//Dirty region tracking granularity in pixels
+#define LTEXTURE_TILE_SIZE 32
+
+//Rectangle of changed pixels
+struct LDirtyRect
+{
+    GLuint x;
+    GLuint y;
+    GLuint w;
+    GLuint h;
+};
+
 class LTexture
 {
     public:
         LTexture();
         ~LTexture();
         bool loadTextureFromPixels32( GLuint* pixels, GLuint width, GLuint height );
+        bool loadTextureFromPixels8( GLubyte* pixels, GLuint width, GLuint height );
         bool loadTextureFromBitmapFile( std::string path, GLuint width, GLuint height );
+        bool enableStreaming( int mode, GLuint ringSize );
         void freeTexture();
         void render();
         bool lock();
@@ -22,10 +45,34 @@ class LTexture
         GLuint* getPixelData32();
         GLuint getPixel32( GLuint x, GLuint y );
         void setPixel32( GLuint x, GLuint y, GLuint pixel );
+        GLubyte* getPixelData8();
+        GLubyte getPixel8( GLuint x, GLuint y );
+        void setPixel8( GLuint x, GLuint y, GLubyte pixel );
+        void setFilter( GLint filter );
+        GLuint pixelFormat();
         GLuint getTextureID();
         GLuint textureWidth();
         GLuint textureHeight();
+        int streamMode();
+
+        //With tracking on, unlock() only uploads tiles marked dirty
+        void enableDirtyTracking( bool enable );
+        bool dirtyTracking();
+        void invalidate();
+        void invalidateRect( GLuint x, GLuint y, GLuint w, GLuint h );
+        bool isDirty();
+        void getDirtyRects( std::vector<LDirtyRect>& rects );
+        void clearDirty();
     private:
+        void uploadStream();
+        void freeStream();
+        GLuint bytesPerPixel();
+        GLvoid* pixelStorage();
+        void allocatePixels();
+        void deletePixels();
+        void getUploadRects( std::vector<LDirtyRect>& rects );
+        void uploadRects( const std::vector<LDirtyRect>& rects, const GLubyte* pixels );
+
         //Texture name
         GLuint mTextureID;
 
@@ -33,8 +80,26 @@ class LTexture
         GLuint mTextureWidth;
         GLuint mTextureHeight;
 
-        //Current pixels
+        //Current pixels (persistent shadow copy in streaming mode)
         GLuint* mPixels;
+        GLubyte* mPixels8;
+        bool mLocked;
+
+        //GL_RGBA, or GL_RED for 8-bit palette indices
+        GLuint mPixelFormat;
+
+        //Pixel unpack buffer ring
+        int mStreamMode;
+        GLuint mPBOCount;
+        GLuint mPBOIndex;
+        GLuint mPBOs[ LTEXTURE_MAX_PBOS ];
+        void* mPBOPointers[ LTEXTURE_MAX_PBOS ];
+        GLsync mFences[ LTEXTURE_MAX_PBOS ];
+
+        //One byte per tile, non-zero when changed since the last upload
+        GLubyte* mDirtyTiles;
+        GLuint mTilesX;
+        GLuint mTilesY;
 };
 
 #endif
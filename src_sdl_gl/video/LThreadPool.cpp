@@ -0,0 +1,253 @@
+// Persistent worker threads with work stealing for CPU composition
+#include "LThreadPool.h"
+
+LThreadPool::LThreadPool()
+{
+    mFunc = NULL;
+    mData = NULL;
+    SDL_AtomicSet( &mQueued, 0 );
+    SDL_AtomicSet( &mRemaining, 0 );
+    SDL_AtomicSet( &mQuit, 0 );
+    mWakeLock = NULL;
+    mWake = NULL;
+    mDoneLock = NULL;
+    mDone = NULL;
+}
+
+LThreadPool::~LThreadPool()
+{
+    //Stop workers if they exist
+    freePool();
+}
+
+bool LThreadPool::init( int threads )
+{
+    freePool();
+
+    if( threads <= 0 )
+    {
+        threads = SDL_GetCPUCount();
+    }
+    if( threads > LTHREAD_POOL_MAX_THREADS )
+    {
+        threads = LTHREAD_POOL_MAX_THREADS;
+    }
+
+    //The caller is one of the threads
+    int workers = threads - 1;
+
+    mWakeLock = SDL_CreateMutex();
+    mWake = SDL_CreateCond();
+    mDoneLock = SDL_CreateMutex();
+    mDone = SDL_CreateCond();
+    SDL_AtomicSet( &mQuit, 0 );
+
+    mQueues.resize( workers + 1 );
+    for( size_t i = 0; i < mQueues.size(); ++i )
+    {
+        mQueues[ i ].lock = SDL_CreateMutex();
+    }
+
+    //Arguments must not move once threads see them
+    mArgs.resize( workers );
+    for( int i = 0; i < workers; ++i )
+    {
+        mArgs[ i ].pool = this;
+        mArgs[ i ].index = i;
+
+        char name[ 32 ];
+        sprintf( name, "compositor %d", i );
+        SDL_Thread* thread = SDL_CreateThread( workerMain, name, &mArgs[ i ] );
+        if( thread == NULL )
+        {
+            printf( "Unable to create worker thread! SDL Error: %s\n", SDL_GetError() );
+            break;
+        }
+        mThreads.push_back( thread );
+    }
+
+    printf( "Thread pool: %d threads\n", (int)mThreads.size() + 1 );
+
+    return mThreads.size() == (size_t)workers;
+}
+
+void LThreadPool::freePool()
+{
+    if( mQueues.empty() )
+    {
+        return;
+    }
+
+    SDL_LockMutex( mWakeLock );
+    SDL_AtomicSet( &mQuit, 1 );
+    SDL_CondBroadcast( mWake );
+    SDL_UnlockMutex( mWakeLock );
+
+    for( size_t i = 0; i < mThreads.size(); ++i )
+    {
+        SDL_WaitThread( mThreads[ i ], NULL );
+    }
+    mThreads.clear();
+    mArgs.clear();
+
+    for( size_t i = 0; i < mQueues.size(); ++i )
+    {
+        SDL_DestroyMutex( mQueues[ i ].lock );
+    }
+    mQueues.clear();
+
+    SDL_DestroyCond( mWake );
+    SDL_DestroyMutex( mWakeLock );
+    SDL_DestroyCond( mDone );
+    SDL_DestroyMutex( mDoneLock );
+    mWake = NULL;
+    mWakeLock = NULL;
+    mDone = NULL;
+    mDoneLock = NULL;
+}
+
+int LThreadPool::threadCount()
+{
+    return (int)mThreads.size() + 1;
+}
+
+bool LThreadPool::takeTask( int queue, LTask& task )
+{
+    int count = (int)mQueues.size();
+
+    //Own queue first, newest task is the one most likely in cache
+    LWorkQueue& own = mQueues[ queue ];
+    SDL_LockMutex( own.lock );
+    if( !own.tasks.empty() )
+    {
+        task = own.tasks.back();
+        own.tasks.pop_back();
+        SDL_UnlockMutex( own.lock );
+        SDL_AtomicAdd( &mQueued, -1 );
+        return true;
+    }
+    SDL_UnlockMutex( own.lock );
+
+    //Steal the oldest task of another thread
+    for( int i = 1; i < count; ++i )
+    {
+        LWorkQueue& victim = mQueues[ ( queue + i ) % count ];
+        SDL_LockMutex( victim.lock );
+        if( !victim.tasks.empty() )
+        {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            SDL_UnlockMutex( victim.lock );
+            SDL_AtomicAdd( &mQueued, -1 );
+            return true;
+        }
+        SDL_UnlockMutex( victim.lock );
+    }
+
+    return false;
+}
+
+void LThreadPool::runTask( const LTask& task )
+{
+    mFunc( mData, task.begin, task.end );
+
+    //Last one wakes the caller
+    if( SDL_AtomicAdd( &mRemaining, -1 ) == 1 )
+    {
+        SDL_LockMutex( mDoneLock );
+        SDL_CondSignal( mDone );
+        SDL_UnlockMutex( mDoneLock );
+    }
+}
+
+int LThreadPool::workerMain( void* data )
+{
+    LWorkerArgs* args = (LWorkerArgs*)data;
+    LThreadPool* pool = args->pool;
+
+    while( true )
+    {
+        LTask task;
+        if( pool->takeTask( args->index, task ) )
+        {
+            pool->runTask( task );
+            continue;
+        }
+
+        //Sleep until tasks are queued; checked under the lock the
+        //producer signals with, so no wakeup is lost
+        SDL_LockMutex( pool->mWakeLock );
+        while( SDL_AtomicGet( &pool->mQueued ) == 0 && SDL_AtomicGet( &pool->mQuit ) == 0 )
+        {
+            SDL_CondWait( pool->mWake, pool->mWakeLock );
+        }
+        bool quit = SDL_AtomicGet( &pool->mQuit ) != 0;
+        SDL_UnlockMutex( pool->mWakeLock );
+
+        if( quit )
+        {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+void LThreadPool::parallelFor( int count, int grain, LTaskFunc func, void* data )
+{
+    if( count <= 0 )
+    {
+        return;
+    }
+    if( grain < 1 )
+    {
+        grain = 1;
+    }
+
+    //Nothing to share, run inline
+    if( mThreads.empty() || count <= grain )
+    {
+        func( data, 0, count );
+        return;
+    }
+
+    mFunc = func;
+    mData = data;
+
+    //Deal chunks round-robin, idle threads steal to even out the rest
+    int queues = (int)mQueues.size();
+    int tasks = ( count + grain - 1 ) / grain;
+    SDL_AtomicSet( &mRemaining, tasks );
+    SDL_AtomicAdd( &mQueued, tasks );
+    for( int i = 0; i < tasks; ++i )
+    {
+        LTask task;
+        task.begin = i * grain;
+        task.end = task.begin + grain < count ? task.begin + grain : count;
+
+        LWorkQueue& queue = mQueues[ i % queues ];
+        SDL_LockMutex( queue.lock );
+        queue.tasks.push_back( task );
+        SDL_UnlockMutex( queue.lock );
+    }
+
+    SDL_LockMutex( mWakeLock );
+    SDL_CondBroadcast( mWake );
+    SDL_UnlockMutex( mWakeLock );
+
+    //Help until everything is taken
+    int own = queues - 1;
+    LTask task;
+    while( takeTask( own, task ) )
+    {
+        runTask( task );
+    }
+
+    //Then wait for tasks still running elsewhere
+    SDL_LockMutex( mDoneLock );
+    while( SDL_AtomicGet( &mRemaining ) > 0 )
+    {
+        SDL_CondWait( mDone, mDoneLock );
+    }
+    SDL_UnlockMutex( mDoneLock );
+}
@@ -0,0 +1,81 @@
+// Persistent worker threads with work stealing for CPU composition
+#ifndef LTHREAD_POOL_H
+#define LTHREAD_POOL_H
+
+#include <stdio.h>
+#include <deque>
+#include <vector>
+#include <SDL.h>
+
+//Upper bound of worker threads
+#define LTHREAD_POOL_MAX_THREADS 64
+
+//Runs items [begin, end) of a parallelFor
+typedef void (*LTaskFunc)( void* data, int begin, int end );
+
+struct LTask
+{
+    int begin;
+    int end;
+};
+
+class LThreadPool;
+
+//Task queue of one thread; the owner takes from the back, thieves from the front
+struct LWorkQueue
+{
+    SDL_mutex* lock;
+    std::deque<LTask> tasks;
+};
+
+struct LWorkerArgs
+{
+    LThreadPool* pool;
+    int index;
+};
+
+class LThreadPool
+{
+    public:
+        LThreadPool();
+        ~LThreadPool();
+
+        //0 threads picks one per CPU; the calling thread always works too
+        bool init( int threads );
+        void freePool();
+        int threadCount();
+
+        //Runs func over [0, count) in chunks of 'grain' items and returns
+        //when all are done. Chunks must write disjoint data, then results
+        //do not depend on which thread ran what. Not reentrant.
+        void parallelFor( int count, int grain, LTaskFunc func, void* data );
+
+    private:
+        static int workerMain( void* data );
+        bool takeTask( int queue, LTask& task );
+        void runTask( const LTask& task );
+
+        std::vector<SDL_Thread*> mThreads;
+        std::vector<LWorkerArgs> mArgs;
+
+        //One queue per worker, the last one belongs to the caller
+        std::vector<LWorkQueue> mQueues;
+
+        //Current parallelFor
+        LTaskFunc mFunc;
+        void* mData;
+
+        //Tasks not yet taken, guards sleeping
+        SDL_atomic_t mQueued;
+        SDL_mutex* mWakeLock;
+        SDL_cond* mWake;
+
+        //Tasks not yet finished
+        SDL_atomic_t mRemaining;
+        SDL_mutex* mDoneLock;
+        SDL_cond* mDone;
+
+        SDL_atomic_t mQuit;
+};
+
+#endif
@@ -1,5 +1,18 @@
 #version 150
-#define halation 0.35
+#pragma parameter halation "Halation strength" 0.35 0.0 1.0 0.05
+
+// Decode and encode through the display curves baked by LLookupTables
+// instead of pow() per pixel, with the pipeline's lutCurve().
+#ifndef LUT_SAMPLING
+#define LUT_SAMPLING 1
+#endif
+
+// Pass whose output is combined with the blur in source[0], counted back
+// from this one. The blur may be smaller than the target; linear filtering
+// scales it up, smooth as it is.
+#ifndef IMAGE_SOURCE
+#define IMAGE_SOURCE 2
+#endif
 
 uniform sampler2D source[];
 uniform vec4 sourceSize[];
@@ -13,9 +26,21 @@ out vec4 fragColor;
 
 void main() {
 
-vec4 image = pow(texture2D(source[2], texCoord).rgba, vec4(2.2));
+#if defined(SOURCE_SRGB)
+vec4 image = texture2D(source[IMAGE_SOURCE], texCoord).rgba;
+vec4 previous = texture2D(source[0], texCoord).rgba;
+#elif LUT_SAMPLING
+vec4 image = lutCurve(texture2D(source[IMAGE_SOURCE], texCoord).rgba, LUT_DISPLAY_DECODE);
+vec4 previous = lutCurve(texture2D(source[0], texCoord).rgba, LUT_DISPLAY_DECODE);
+#else
+vec4 image = pow(texture2D(source[IMAGE_SOURCE], texCoord).rgba, vec4(2.2));
 vec4 previous = pow(texture2D(source[0], texCoord).rgba, vec4(2.2));
+#endif
 vec4 combined = mix(previous, image, 1.0 - halation);
 
+#if LUT_SAMPLING
+fragColor = lutCurve(vec4(sqrt(combined.rgb), combined.a), LUT_DISPLAY_ENCODE);
+#else
 fragColor = pow(combined, vec4(1.0 / 2.2));
-}
+#endif
+}
\ No newline at end of file
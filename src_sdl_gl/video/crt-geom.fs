@@ -1,6 +1,12 @@
 #version 150
 
-//#define INTERLACED
+// Toggles are 0 or 1 and may be overridden by defines injected after
+// #version (pass defines in presets, LShaderPipeline::setDefines()).
+
+// Alternate the scanline phase every frame on interlaced sources.
+#ifndef INTERLACED
+#define INTERLACED 0
+#endif
 
 uniform sampler2D source[];
 uniform vec4 sourceSize[];
@@ -14,41 +20,57 @@ in Vertex {
 out vec4 fragColor;
 
 
-// Comment the next line to disable interpolation in linear gamma (and gain speed).
-//#define LINEAR_PROCESSING
+// Interpolate in linear gamma (slower).
+#ifndef LINEAR_PROCESSING
+#define LINEAR_PROCESSING 0
+#endif
 
 // Enable screen curvature.
-#define CURVATURE
+#ifndef GEOM_CURVATURE
+#define GEOM_CURVATURE 1
+#endif
 
 // Enable 3x oversampling of the beam profile
-#define OVERSAMPLE
+#ifndef OVERSAMPLE
+#define OVERSAMPLE 1
+#endif
 
 // Use the older, purely gaussian beam profile
-//#define USEGAUSSIAN
+#ifndef USEGAUSSIAN
+#define USEGAUSSIAN 0
+#endif
+
+// Sample gamma curves, through the pipeline's lutCurve(), and the beam
+// profile from tables baked by LLookupTables instead of evaluating pow()
+// and exp() per pixel.
+#ifndef LUT_SAMPLING
+#define LUT_SAMPLING 1
+#endif
+
+#if LUT_SAMPLING
+uniform sampler2D beamLUT;
+#endif
 
 // vertex params //
 
-  // gamma of simulated CRT
-#define CRTgamma 2.4
-  // gamma of display monitor (typically 2.2 is correct)
-#define monitorgamma 2.2
-  // overscan (e.g. 1.02 for 2% overscan)
-#define overscan vec2(1.0 , 1.0)//(0.93 , 0.915)
-  // aspect ratio
-#define aspect vec2(1.0, 0.75)
-  // lengths are measured in units of (approximately) the width of the monitor
-  // simulated distance from viewer to monitor
-#define d 2.0
-  // radius of curvature (Normal: Approx. 4.0)
-#define R 4.0
+// Tuning values live in the pipeline's parameter buffer and can change
+// without recompiling; defining one of them pins it to a constant.
+#pragma parameter CRTgamma "Gamma of simulated CRT" 2.4 0.1 5.0 0.1
+#pragma parameter monitorgamma "Gamma of display monitor" 2.2 0.1 5.0 0.1
+#pragma parameter overscan_x "Overscan X (1.02 for 2%)" 1.0 0.5 1.5 0.01
+#pragma parameter overscan_y "Overscan Y (1.02 for 2%)" 1.0 0.5 1.5 0.01
+#pragma parameter aspect_x "Aspect ratio X" 1.0 0.5 2.0 0.01
+#pragma parameter aspect_y "Aspect ratio Y" 0.75 0.5 2.0 0.01
+#pragma parameter d "Distance from viewer, in screen widths" 2.0 0.1 3.0 0.1
+#pragma parameter R "Radius of curvature" 4.0 0.1 10.0 0.1
+#pragma parameter cornersize "Size of curved corners" 0.02 0.001 1.0 0.005
+#pragma parameter cornersmooth "Border smoothness, lower if aliased" 80.0 80.0 2000.0 100.0
+
+#define overscan vec2(overscan_x, overscan_y)
+#define aspect vec2(aspect_x, aspect_y)
   // tilt angle in radians
   // (behavior might be a bit wrong if both components are nonzero)
 #define angle vec2(0.0,-0.0)
-  // size of curved corners
-#define cornersize 0.02
-  // border smoothness parameter
-  // decrease if borders are too aliased
-#define cornersmooth 80.0
 
 #define sinangle sin(angle)
 #define cosangle cos(angle)
@@ -63,7 +85,9 @@ out vec4 fragColor;
 #define FIX(c) max(abs(c), 1e-5);
 #define PI 3.141592653589
 
-#ifdef LINEAR_PROCESSING
+#if LINEAR_PROCESSING && LUT_SAMPLING
+#       define TEX2D(c) lutCurve(texture(source[0], (c)), LUT_CRT_DECODE)
+#elif LINEAR_PROCESSING
 #       define TEX2D(c) pow(texture(source[0], (c)), vec4(CRTgamma))
 #else
 #       define TEX2D(c) texture(source[0], (c))
@@ -92,7 +116,8 @@ vec2 bkwtrans(vec2 xy)
   float C = dot(poc,poc)-1.0;
   float a = (-B+sqrt(B*B-4.0*A*C))/(2.0*A);
   vec2 uv = (point-a*sinangle)/cosangle;
-  float r = R*acos(a);
+  // Clamped like fwtrans(), the centre would divide 0 by 0
+  float r = FIX(R*acos(min(a,1.0)));
   return uv*r/sin(r/R);
 }
 
@@ -150,7 +175,18 @@ vec4 scanlineWeights(float distance, vec4 color)
   // independent of its width. That is, for a narrower beam
   // "weights" should have a higher peak at the center of the
   // scanline than for a wider beam.
-#ifdef USEGAUSSIAN
+#if LUT_SAMPLING
+  // Both profiles baked by LLookupTables: distance 0..2 across, colour
+  // down, gaussian rows first. The caller does not use alpha.
+  vec2 size = vec2(textureSize(beamLUT, 0));
+  float x = clamp(abs(distance) / 2.0, 0.0, 1.0) * ((size.x - 1.0) / size.x) + 0.5 / size.x;
+  float profile = USEGAUSSIAN != 0 ? 0.0 : size.y * 0.5;
+  vec3 y = (clamp(color.rgb, 0.0, 1.0) * (size.y * 0.5 - 1.0) + 0.5 + profile) / size.y;
+  return vec4(texture(beamLUT, vec2(x, y.r)).r,
+              texture(beamLUT, vec2(x, y.g)).r,
+              texture(beamLUT, vec2(x, y.b)).r,
+              0.0);
+#elif USEGAUSSIAN
   vec4 wid = 0.3 + 0.1 * pow(color, vec4(3.0));
   vec4 weights = vec4(distance / wid);
   return 0.4 * exp(-weights * weights) / wid;
@@ -186,7 +222,7 @@ void main()
   // edges of the texels of the underlying texture.
 
   // Texture coordinates of the texel containing the active pixel.
-#ifdef CURVATURE
+#if GEOM_CURVATURE
   vec2 xy = transform(texCoord);
 #else
   vec2 xy = texCoord;
@@ -195,13 +231,13 @@ void main()
 
   // Of all the pixels that are mapped onto the texel we are
   // currently rendering, which pixel are we currently rendering?
-#ifdef INTERLACED
+#if INTERLACED
   vec2 ilvec = vec2(0.0,ilfac.y > 1.5 ? mod(float(phase),2.0) : 0.0);
 #else
   vec2 ilvec = vec2(0.0,ilfac.y);
 #endif
   vec2 ratio_scale = (xy * sourceSize[0].xy - vec2(0.5) + ilvec)/ilfac;
-#ifdef OVERSAMPLE
+#if OVERSAMPLE
   float filter_ = sourceSize[0].y / targetSize.y;
 #endif
   vec2 uv_ratio = fract(ratio_scale);
@@ -239,7 +275,10 @@ void main()
 			 TEX2D(xy + vec2(2.0 * one.x, one.y))) * coeffs,
 		    0.0, 1.0);
 
-#ifndef LINEAR_PROCESSING
+#if !LINEAR_PROCESSING && LUT_SAMPLING
+  col  = lutCurve(col , LUT_CRT_DECODE);
+  col2 = lutCurve(col2, LUT_CRT_DECODE);
+#elif !LINEAR_PROCESSING
   col  = pow(col , vec4(CRTgamma));
   col2 = pow(col2, vec4(CRTgamma));
 #endif
@@ -248,7 +287,7 @@ void main()
   // the current pixel.
   vec4 weights  = scanlineWeights(uv_ratio.y, col);
   vec4 weights2 = scanlineWeights(1.0 - uv_ratio.y, col2);
-#ifdef OVERSAMPLE
+#if OVERSAMPLE
   uv_ratio.y =uv_ratio.y+1.0/3.0*filter_;
   weights = (weights+scanlineWeights(uv_ratio.y, col))/3.0;
   weights2=(weights2+scanlineWeights(abs(1.0-uv_ratio.y), col2))/3.0;
@@ -269,7 +308,12 @@ void main()
   mul_res *= dotMaskWeights;
 
   // Convert the image gamma for display on our output device.
+  // sRGB targets do the conversion in hardware.
+#if !defined(TARGET_SRGB) && LUT_SAMPLING
+  mul_res = lutCurve(vec4(sqrt(mul_res), 1.0), LUT_DISPLAY_ENCODE).rgb;
+#elif !defined(TARGET_SRGB)
   mul_res = pow(mul_res, vec3(1.0 / monitorgamma));
+#endif
 
   // Color the texel.
   fragColor = vec4(mul_res, 1.0);
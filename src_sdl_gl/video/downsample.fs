@@ -0,0 +1,27 @@
+#version 150
+
+uniform sampler2D source[];
+uniform vec4 targetSize;
+uniform vec4 sourceSize[];
+
+in Vertex {
+  vec2 texCoord;
+};
+
+out vec4 fragColor;
+
+// Box filter for a 2x or 4x smaller target. Four linear fetches a quarter
+// target texel off the centre land on source texel centres (2x) or between
+// source texel pairs (4x), so they average the whole block. Needs
+// filter_linear; with sRGB framebuffers the average is in linear light.
+void main()
+{
+  vec2 offset = 0.25 * targetSize.zw;
+
+  vec4 sum = texture(source[0], texCoord + vec2(-offset.x, -offset.y));
+  sum += texture(source[0], texCoord + vec2(offset.x, -offset.y));
+  sum += texture(source[0], texCoord + vec2(-offset.x, offset.y));
+  sum += texture(source[0], texCoord + vec2(offset.x, offset.y));
+
+  fragColor = sum * 0.25;
+}
@@ -11,16 +11,18 @@ uniform vec4 sourceSize[];
 uniform vec4 targetSize;
 uniform int phase;
 
+in Vertex {
+  vec2 texCoord;
+  vec2 one;
+  float mod_factor;
+};
+
 #define DISPLAY_GAMMA 2.1
 #define CRT_GAMMA 2.5
 #define one (sourceSize[0]) //this is set to 1.0 / sourceSize[0] in the original version, but I think this looks better
 #define pix_no texCoord.y * sourceSize[0]
 #define TEX(off) pow(texture(source[0], texCoord - vec2(0.0, (off) * one.y)).rgb, vec3(CRT_GAMMA))
 
-in Vertex {
-  vec2 texCoord;
-};
-
 out vec4 fragColor;
 
 void main() {
@@ -10,35 +10,51 @@ in Vertex {
 
 out vec4 fragColor;
 
+// Decode and encode through the display curves baked by LLookupTables
+// instead of pow() on every tap, with the pipeline's lutCurve().
+#ifndef LUT_SAMPLING
+#define LUT_SAMPLING 1
+#endif
+
 #define CRTgamma 2.5
 #define display_gamma 2.2
+
+#if defined(SOURCE_SRGB)
+#define TEX2D(c) texture2D(source[0],(c))
+#elif LUT_SAMPLING
+#define TEX2D(c) lutCurve(texture2D(source[0],(c)),LUT_DISPLAY_DECODE)
+#else
 #define TEX2D(c) pow(texture2D(source[0],(c)),vec4(CRTgamma))
-#define BLURFACTOR 1.0
+#endif
+
+// Taps of one side of the kernel, tap 0 at the centre. Each other tap sits
+// between two texels so one linear fetch returns both at their weights; the
+// pipeline generates them from BLUR_SIGMA (see LGaussian). The default is
+// the former 9 tap kernel exp(-n*n/9), n = -4..4, in 5 fetches. Needs
+// filter_linear; sRGB sources are decoded before filtering, as they should.
+#ifndef BLUR_TAPS
+#define BLUR_TAPS 3
+#define BLUR_OFFSETS float[3](0.0, 1.4174298, 3.3147990)
+#define BLUR_WEIGHTS float[3](0.1943323, 0.2984982, 0.1043356)
+#endif
 
 void main()
 {
-  vec2 xy = texCoord;
-  float oney = 1.0 / sourceSize[0].y;
-
-  float wid = 3.0;
+  const float offsets[BLUR_TAPS] = BLUR_OFFSETS;
+  const float weights[BLUR_TAPS] = BLUR_WEIGHTS;
 
-  float c1 = exp(-1.0/wid/wid);
-  float c2 = exp(-4.0/wid/wid);
-  float c3 = exp(-9.0/wid/wid);
-  float c4 = exp(-16.0/wid/wid);
-  float norm = 1.0 / (1.0 + 2.0*(c1+c2+c3+c4));
-
-  vec4 sum = vec4(0.0);
-
-  sum += TEX2D(xy + vec2(-4.0 * BLURFACTOR * oney, 0.0)) * vec4(c4);
-  sum += TEX2D(xy + vec2(-3.0 * BLURFACTOR * oney, 0.0)) * vec4(c3);
-  sum += TEX2D(xy + vec2(-2.0 * BLURFACTOR * oney, 0.0)) * vec4(c2);
-  sum += TEX2D(xy + vec2(-1.0 * BLURFACTOR * oney, 0.0)) * vec4(c1);
-  sum += TEX2D(xy);
-  sum += TEX2D(xy + vec2(+1.0 * BLURFACTOR * oney, 0.0)) * vec4(c1);
-  sum += TEX2D(xy + vec2(+2.0 * BLURFACTOR * oney, 0.0)) * vec4(c2);
-  sum += TEX2D(xy + vec2(+3.0 * BLURFACTOR * oney, 0.0)) * vec4(c3);
-  sum += TEX2D(xy + vec2(+4.0 * BLURFACTOR * oney, 0.0)) * vec4(c4);
-
-  fragColor = pow(sum*vec4(norm),vec4(1.0/display_gamma));
+  vec2 xy = texCoord;
+  vec4 sum = TEX2D(xy) * weights[0];
+  for (int i = 1; i < BLUR_TAPS; i++) {
+    vec2 offset = vec2(0.0, offsets[i] * sourceSize[0].w);
+    sum += (TEX2D(xy + offset) + TEX2D(xy - offset)) * weights[i];
+  }
+
+#if defined(TARGET_SRGB)
+  fragColor = sum;
+#elif LUT_SAMPLING
+  fragColor = lutCurve(vec4(sqrt(sum.rgb), sum.a), LUT_DISPLAY_ENCODE);
+#else
+  fragColor = pow(sum,vec4(1.0/display_gamma));
+#endif
 }
@@ -96,18 +96,29 @@
 ////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////
 
-#define MASK 1.0
-#define MASK_INTENSITY 0.5
-#define SCANLINE_THINNESS 0.5
-#define SCAN_BLUR 2.5
-#define CURVATURE 0.002
-#define TRINITRON_CURVE 0.0
-#define CORNER 3.0
-#define CRT_GAMMA 2.4
+// Tuning values live in the pipeline's parameter buffer and can change
+// without recompiling; defining one of them pins it to a constant.
+#pragma parameter MASK "Mask: 0 none, 1 grille, 2 grille lite, 3 shadow" 1.0 0.0 3.0 1.0
+#pragma parameter MASK_INTENSITY "Mask intensity" 0.5 0.0 1.0 0.05
+#pragma parameter SCANLINE_THINNESS "Scanline thinness" 0.5 0.0 1.0 0.05
+#pragma parameter SCAN_BLUR "Horizontal scan blur" 2.5 1.0 3.0 0.1
+#pragma parameter CURVATURE "Curvature" 0.002 0.0 0.01 0.001
+#pragma parameter TRINITRON_CURVE "Trinitron-style curve" 0.0 0.0 1.0 1.0
+#pragma parameter CORNER "Corner round" 3.0 0.0 11.0 1.0
+#pragma parameter CRT_GAMMA "CRT gamma" 2.4 0.0 51.0 0.1
+
+// Sample the gamma curves and the phosphor mask from tables baked by
+// LLookupTables instead of evaluating them per pixel.
+#ifndef LUT_SAMPLING
+#define LUT_SAMPLING 1
+#endif
 
 uniform sampler2D source[];
 uniform vec4 sourceSize[];
 uniform vec4 outputSize;
+#if LUT_SAMPLING
+uniform sampler2D maskLUT;
+#endif
 
 in Vertex {
    vec2 vTexCoord;
@@ -125,6 +136,11 @@ out vec4 FragColor;
 // Since shadertoy doesn't have sRGB textures
 // And we need linear input into shader
 // Don't do this in your code
+#if LUT_SAMPLING
+// Curves baked by LLookupTables, through the pipeline's lutCurve()
+vec3 FromSrgb(vec3 c){return lutCurve(vec4(c,1.0),LUT_SRGB_DECODE).rgb;}
+vec3 ToSrgb(vec3 c){return lutCurve(vec4(sqrt(max(c,0.0)),1.0),LUT_SRGB_ENCODE).rgb;}
+#else
 	float FromSrgb1(float c){
 		return (c<=0.04045)?c*(1.0/12.92):
 			pow(c*(1.0/1.055)+(0.055/1.055),CRT_GAMMA);}
@@ -140,6 +156,7 @@ float ToSrgb1(float c){
 vec3 ToSrgb(vec3 c){return vec3(
  ToSrgb1(c.r),ToSrgb1(c.g),ToSrgb1(c.b));}
 //--------------------------------------------------------------
+#endif
 
 //_____________________________/\_______________________________
 //==============================================================
@@ -180,17 +197,25 @@ vec3 ToSrgb(vec3 c){return vec3(
 //                      SETUP FOR CRTS
 //--------------------------------------------------------------
 //==============================================================
-//#define CRTS_DEBUG 1
+#ifndef CRTS_DEBUG
+#define CRTS_DEBUG 0
+#endif
 #define CRTS_GPU 1
 #define CRTS_GLSL 1
 //--------------------------------------------------------------
-//#define CRTS_2_TAP 1
+#ifndef CRTS_2_TAP
+#define CRTS_2_TAP 0
+#endif
 //--------------------------------------------------------------
+#ifndef CRTS_TONE
 #define CRTS_TONE 1
+#endif
 #define CRTS_CONTRAST 0
 #define CRTS_SATURATION 0
 //--------------------------------------------------------------
+#ifndef CRTS_WARP
 #define CRTS_WARP 1
+#endif
 //--------------------------------------------------------------
 // Try different masks -> moved to runtime parameters
 //#define CRTS_MASK_GRILLE 1
@@ -327,6 +352,11 @@ vec3 CrtsFetch(vec2 uv){
 //          0.0=fully off, 1.0=no effect
 //==============================================================
  CrtsF3 CrtsMask(CrtsF2 pos,CrtsF1 dark){
+  #if LUT_SAMPLING
+   // One tile of the mask baked for MASK and MASK_INTENSITY
+   return texelFetch(maskLUT,ivec2(mod(floor(pos),vec2(textureSize(maskLUT,0)))),0).rgb;
+  #else
+//--------------------------------------------------------------
   if(MASK == 2.0){
    CrtsF3 m=CrtsF3(dark,dark,dark);
    CrtsF1 x=CrtsFractF1(pos.x*(1.0/3.0));
@@ -358,6 +388,7 @@ vec3 CrtsFetch(vec2 uv){
    else m.b=1.0;
    return m;
   }
+  #endif
  }
 //_____________________________/\_______________________________
 //==============================================================
@@ -449,7 +480,7 @@ vec3 CrtsFetch(vec2 uv){
 //--------------------------------------------------------------
  ){
 //--------------------------------------------------------------
-  #ifdef CRTS_DEBUG
+  #if CRTS_DEBUG
    CrtsF2 uv=ipos*rcpOutputSize;
    // Show second half processed, and first half un-processed
    if(uv.x<0.5){
@@ -463,7 +494,7 @@ vec3 CrtsFetch(vec2 uv){
 //--------------------------------------------------------------
   // Optional apply warp
   CrtsF2 pos;
-  #ifdef CRTS_WARP
+  #if CRTS_WARP
    // Convert to {-1 to 1} range
    pos=ipos*twoDivOutputSize-CrtsF2(1.0,1.0);
    // Distort pushes image outside {-1 to 1} range
@@ -482,7 +513,7 @@ vec3 CrtsFetch(vec2 uv){
 //--------------------------------------------------------------
   // Snap to center of first scanline
   CrtsF1 y0=floor(pos.y-0.5)+0.5;
-  #ifdef CRTS_2_TAP
+  #if CRTS_2_TAP
    // Using Inigo's "Improved Texture Interpolation"
    // http://iquilezles.org/www/articles/texture/texture.htm
    pos.x+=0.5;
@@ -527,8 +558,8 @@ vec3 CrtsFetch(vec2 uv){
   CrtsF1 scanA=cos(min(0.5,  off *thin     )*pi2)*hlf+hlf;
   CrtsF1 scanB=cos(min(0.5,(-off)*thin+thin)*pi2)*hlf+hlf;
 //--------------------------------------------------------------
-  #ifdef CRTS_2_TAP
-   #ifdef CRTS_WARP
+  #if CRTS_2_TAP
+   #if CRTS_WARP
     // Get rid of wrong pixels on edge
     scanA*=vin;
     scanB*=vin;
@@ -546,7 +577,7 @@ vec3 CrtsFetch(vec2 uv){
    CrtsF1 pix2=exp2(blur*off2*off2);
    CrtsF1 pix3=exp2(blur*off3*off3);
    CrtsF1 pixT=CrtsRcpF1(pix0+pix1+pix2+pix3);
-   #ifdef CRTS_WARP
+   #if CRTS_WARP
     // Get rid of wrong pixels on edge
     pixT*=vin;
    #endif
@@ -562,7 +593,7 @@ vec3 CrtsFetch(vec2 uv){
   color*=CrtsMask(ipos,mask);
 //--------------------------------------------------------------
   // Optional color processing
-  #ifdef CRTS_TONE
+  #if CRTS_TONE
    // Tonal control, start by protecting from /0
    CrtsF1 peak=max(1.0/(256.0*65536.0),
     CrtsMax3F1(color.r,color.g,color.b));
@@ -14,29 +14,95 @@ SDL_Texture *m_textureTarget;
 LTexture m_glTextureBackground;
 LTexture m_glTextureMenu;
 LTexture m_glTextureTarget;
+LTexture m_glTexturePalette;
 
-// Basic shader
-LShaderProgram m_ShaderProgram;
+// Palette indexed layers, composed on the CPU into the 8-bit target
+Uint8 *m_pixelsBackground8 = NULL;
+Uint8 *m_pixelsMenu8 = NULL;
+Uint32 m_palette[256];
+int m_paletteBrightness = -1;
+
+// Shader pipeline
+LShaderPipeline m_ShaderPipeline;
 
 // OpenGL context
 SDL_GLContext m_context;
 
+// Offscreen context and framebuffer of the headless mode
+LHeadless m_headless;
+
+// Frames composed on a worker thread ahead of the GL thread
+LFrameQueue m_frameQueue;
+SDL_Thread *m_composeThread = NULL;
+
+// CPU version of the lottes/crt-geom shaders and its window sized output
+LSoftCRT m_softCRT;
+LTexture m_glTextureSoftCRT;
+// Its own workers: parallelFor is not reentrant and with --queue the
+// compositor thread uses m_threadPool while the GL thread filters
+LThreadPool m_softCRTPool;
+
+// Menu backgrounds, decoded from mapped files on the asset threads and
+// cycled with B once ready
+LAssetLoader m_assets;
+const char* gBackgrounds[] = {
+    "play1.bmp",
+    "swtitle-bg-amiga-small.bmp",
+    "swtitle-bg-pc-small.bmp",
+    "swtitle-bg-amiga.bmp",
+    "swtitle-bg-pc.bmp"
+};
+#define BACKGROUND_COUNT 5
+int gBackground = 0;
+
+// Optional asset bundle from swpack; backgrounds found in it are copied
+// from the mapping instead of being decoded
+LBundle m_bundle;
+std::string gBundleFn;
+
+// Frame stage timing, see swosInitProfiler()
+LProfiler m_profiler;
+int m_psEvents = -1;
+int m_psMenu = -1;
+int m_psBlend = -1;
+int m_psLock = -1;
+int m_psUnlock = -1;
+int m_psRender = -1;
+int m_psSwap = -1;
+int m_psWait = -1;
+int m_psSoftCRT = -1;
+int m_psPace = -1;
+int m_psCapture = -1;
+
+// Game logic ticks per second
+#define TICK_RATE 60
+
+// Frame pacing (--pace), composition starts just in time for the vblank.
+// Fixed rate pacing runs at the game logic's tick rate unless --fps says
+// otherwise.
+LFramePacer m_pacer;
+int gPaceMode = LPACE_VSYNC;
+double gPaceRate = TICK_RATE;
+double gLatencyTarget = 0.0;
+
 // Define window size
-// -- logical
-int kVgaWidth = 480;
-int kVgaHeight = 270;
+// -- logical: kVgaWidth, kVgaHeight in LCompositor.h
 // -- physical
 int m_windowWidth = kVgaWidth * 2;
 int m_windowHeight = kVgaHeight * 2;
 
 int useShader = 0;
 
-#define RM_SDL    0
-#define RM_OPENGL 1
+#define RM_SDL      0
+#define RM_OPENGL   1
+#define RM_HEADLESS 2
 
 #define GP_DISABLED 0
 #define GP_ENABLED  1
 
+#define PM_RGBA32   0
+#define PM_INDEXED8 1
+
 #if (0)
 int gRenderMode = RM_SDL;
 #else
@@ -49,6 +115,108 @@ int gGPMode = GP_ENABLED;
 int gGPMode = GP_DISABLED;
 #endif
 
+#if (1)
+int gPixelMode = PM_RGBA32;
+#else
+int gPixelMode = PM_INDEXED8;
+#endif
+
+// Shader preset (.glslp) given on the command line, overrides loadGP() selection
+std::string gPresetFn;
+
+// Headless runs: frame count and optional PPM of the last frame
+int gHeadlessFrames = 300;
+std::string gOutputFn;
+int m_frameCount = 0;
+
+// Compositor threads, 0 for one per CPU
+int gThreads = 0;
+
+// Frames composed ahead by the compositor thread, 0 composes in the main
+// loop; deeper queues trade latency for throughput
+int gQueueDepth = 0;
+
+// Hot shader reload (--hot-reload): saved shader and preset files are
+// compiled on a shared context and swapped in between frames
+bool gHotReload = false;
+LShaderCompiler m_shaderCompiler;
+LFileWatcher m_shaderWatcher;
+
+// Frame recording: the shader's output (--record) is read back without
+// stalling the loop, the 480x270 composite (--record-composite) copied
+// before any shader. A .y4m name writes Y4M, anything else the raw delta
+// container, see LFrameRecorder.h.
+LFrameRecorder m_recordOutput;
+LFrameRecorder m_recordComposite;
+std::string gRecordFn;
+std::string gRecordCompositeFn;
+
+// Replays: layer pixels and their changes per frame, recorded from a
+// session (--record-replay) and played back as fast as frames can be made
+// (--replay), so builds are compared on identical input
+LReplayWriter m_replayWriter;
+LReplay m_replay;
+std::string gRecordReplayFn;
+std::string gReplayFn;
+
+// Shader suite (--shader-suite DIR): every shipped shader rendered
+// offscreen at each size below and checked against the reference images
+// and GPU times in DIR; --suite-update writes them from the run instead.
+// The shipped ones are in suite/, rendered by Mesa's llvmpipe.
+std::string gSuiteDir;
+bool gSuiteUpdate = false;
+double gSuiteThreshold = LSUITE_TIME_THRESHOLD;
+const char* gSuiteShaders[][3] = {
+    // name, vertex shader, fragment shader or empty after a preset
+    { "default",            "default2.vs",    "default.fs" },
+    { "stock",              "stock.vs",       "stock.fs" },
+    { "advanced-aa",        "advanced-aa.vs", "advanced-aa.fs" },
+    { "aperture",           "default2.vs",    "aperture.fs" },
+    { "crt-simple",         "crt-simple.vs",  "crt-simple.fs" },
+    { "phosphor-21x",       "default2.vs",    "phosphor-21x.fs" },
+    { "lottes",             "lottes.vs",      "lottes.fs" },
+    { "crt-geom",           "crt-geom.vs",    "crt-geom.fs" },
+    { "phosphorish",        "default2.vs",    "phosphorish.fs" },
+    { "gaussian-scanlines", "default2.vs",    "gaussian-scanlines.fs" },
+    { "crt-geom-halation",  "crt-geom-halation.glslp", "" }
+};
+#define SUITE_SHADER_COUNT 11
+const int gSuiteSizes[][4] = {
+    // source and target width and height
+    { 480, 270,  960,  540 },
+    { 480, 270, 1920, 1080 },
+    { 480, 270, 1366,  768 },
+    { 320, 200, 1280,  800 }
+};
+#define SUITE_SIZE_COUNT 4
+
+// Profiling: report percentiles at exit, optional Chrome trace file
+bool gProfile = false;
+std::string gTraceFn;
+
+// Shader defines applied to every pass (--defines "GEOM_CURVATURE=0 OVERSAMPLE=0"),
+// and quality levels cycled with Q; variants stay compiled once used
+std::string gDefines;
+const char* gQualityDefines[] = {
+    "",
+    "OVERSAMPLE=0 CRTS_2_TAP=1",
+    "OVERSAMPLE=0 GEOM_CURVATURE=0 CRTS_2_TAP=1 CRTS_WARP=0 CRTS_TONE=0"
+};
+#define QUALITY_LEVELS 3
+int gQuality = 0;
+
+// Shader parameter selected for tweaking with [ ] and - =
+int gParameter = 0;
+
+// Software CRT filter: shown instead of the shader (--soft-crt), or checked
+// against the shader's output at the end of a headless run (--compare-soft-crt)
+bool gSoftCRT = false;
+bool gSoftCRTCompare = false;
+int gSoftCRTFilter = LSOFTCRT_LOTTES;
+// Percent of halation the software filter mixes in (--soft-halation), not
+// used when comparing since the compared shaders have none
+int gSoftHalation = 0;
+
 // Create window
 bool swosCreateWindow()
 {
@@ -56,9 +224,20 @@ bool swosCreateWindow()
 
     if (gRenderMode == RM_SDL)
         printf("SDL rendering mode started.\n");
+    else if (gRenderMode == RM_HEADLESS)
+        printf("Headless rendering mode started.\n");
     else
         printf("OpenGL rendering mode started.\n");
 
+    // No window and no display needed, draws into an offscreen framebuffer
+    if (gRenderMode == RM_HEADLESS) {
+        if (!m_headless.init(m_windowWidth, m_windowHeight)) {
+            printf("Headless context could not be created!\n");
+            return false;
+        }
+        return true;
+    }
+
     SDL_Init(SDL_INIT_EVERYTHING);
 
     if (gRenderMode == RM_SDL) {
@@ -114,6 +293,34 @@ bool swosCreateWindow()
 
 bool loadGP()
 {
+    m_ShaderPipeline.setDefines(gDefines);
+
+    if (gGPMode == GP_ENABLED && (gSoftCRT || gSoftCRTCompare)) {
+        // Frames filtered on the CPU only need scaling to the window,
+        // comparisons run the shader the CPU filter was ported from
+        std::string vsFn = "default2.vs";
+        std::string fsFn = "default.fs";
+        if (gSoftCRTCompare) {
+            vsFn = gSoftCRTFilter == LSOFTCRT_GEOM ? "crt-geom.vs" : "lottes.vs";
+            fsFn = gSoftCRTFilter == LSOFTCRT_GEOM ? "crt-geom.fs" : "lottes.fs";
+        }
+
+        if (!m_ShaderPipeline.loadProgram(vsFn, fsFn)) {
+            printf("Unable to load basic shader: %s, %s\n", vsFn.c_str(), fsFn.c_str());
+            return false;
+        }
+        printf("OpenGL shader programs loaded: %s, %s\n", vsFn.c_str(), fsFn.c_str());
+        return true;
+    }
+
+    if (gGPMode == GP_ENABLED && !gPresetFn.empty()) {
+        if (!m_ShaderPipeline.loadPreset(gPresetFn)) {
+            printf("Unable to load shader preset: %s\n", gPresetFn.c_str());
+            return false;
+        }
+        return true;
+    }
+
     if (gGPMode == GP_ENABLED) {
         // Bind basic shader program
         std::string vsFn, fsFn, fsFn1, fsFn2, fsFn3, fsFn4;
@@ -156,134 +363,180 @@ bool loadGP()
         fsFn4 = "combine.fs";
 #endif
 
-        m_ShaderProgram.init();
-#if (1)
         // Load shader programs
-        if( !m_ShaderProgram.loadProgram(vsFn, fsFn) ) {
-            printf( "Unable to load basic shader: %s, %s\n", vsFn.c_str(), fsFn.c_str() );
-            return false;
+        if (fsFn1.empty()) {
+            if( !m_ShaderPipeline.loadProgram(vsFn, fsFn) ) {
+                printf( "Unable to load basic shader: %s, %s\n", vsFn.c_str(), fsFn.c_str() );
+                return false;
+            }
+            printf("OpenGL shader programs loaded: %s, %s\n", vsFn.c_str(), fsFn.c_str());
         }
-#else
-        // Load shader programs
-        if( !m_ShaderProgram.loadProgram5(vsFn, fsFn1, fsFn2, fsFn3, fsFn4) ) {
+        else {
+            if( !m_ShaderPipeline.loadProgram5(vsFn, fsFn1, fsFn2, fsFn3, fsFn4) ) {
+                printf(
+                    "Unable to load basic shader: %s, %s, %s, %s, %s\n",
+                    vsFn.c_str(), fsFn1.c_str(), fsFn2.c_str(), fsFn3.c_str(), fsFn4.c_str()
+                );
+                return false;
+            }
             printf(
-                "Unable to load basic shader: %s, %s, %s, %s, %s\n",
+                "OpenGL shader programs loaded: %s, %s, %s, %s, %s\n",
                 vsFn.c_str(), fsFn1.c_str(), fsFn2.c_str(), fsFn3.c_str(), fsFn4.c_str()
             );
-            return false;
         }
-#endif
-        m_ShaderProgram.bind();
-        printf("OpenGL shader programs loaded: %s, %s\n", vsFn.c_str(), fsFn.c_str());
     }
     return true;
 }
 
-// Create renderer
-void swosCreateRenderer()
+// Watch the files the passes were built from, a preset may name others
+// after each reload
+void swosWatchShaders()
 {
-    if (gRenderMode == RM_SDL) {
-        m_renderer = SDL_CreateRenderer(
-            m_window, -1, SDL_RENDERER_ACCELERATED
-        );
-        SDL_RenderSetLogicalSize(m_renderer, kVgaWidth, kVgaHeight);
-        printf("SDL renderer created.\n");
-    }
-    else {
-        if (gGPMode == GP_ENABLED) {
-            loadGP();
-        }
-    }
+    std::vector<std::string> paths;
+    m_ShaderPipeline.sourceFiles(paths);
+    m_shaderWatcher.clear();
+    for (size_t i = 0; i < paths.size(); i++)
+        m_shaderWatcher.watch(paths[i]);
+    printf("Watching %d shader files for changes.\n", (int)paths.size());
 }
 
-Uint32 setRGBA(Uint8 r, Uint8 g, Uint8 b, Uint8 a)
+void swosInitHotReload()
 {
-    return (a << 24) + (b << 16) + (g << 8) + r;
+    if (!m_shaderWatcher.init())
+        return;
+
+    // Without the worker reloads still work, they just compile in the frame
+    if (!m_shaderCompiler.init())
+        printf("Shader reloads compile on the render thread.\n");
+    m_ShaderPipeline.setCompiler(&m_shaderCompiler);
+    swosWatchShaders();
 }
 
-void getRGBA(Uint32 color, Uint8 *r, Uint8 *g, Uint8 *b, Uint8 *a)
+// Between frames: start a rebuild after a save, swap it in once compiled
+void swosHotReload()
 {
-    *a = (color >> 24) & 255;
-    *b = (color >> 16) & 255;
-    *g = (color >>  8) & 255;
-    *r = (color      ) & 255;
+    std::vector<std::string> changed;
+    if (m_shaderWatcher.poll(changed))
+        m_ShaderPipeline.reload(changed);
+
+    if (m_ShaderPipeline.updateReload())
+        swosWatchShaders();
 }
 
-void initMenuPixels(Uint32 *pixels)
+// Register frame stages, needs the GL context for timer queries
+void swosInitProfiler()
 {
-    for (register int y = 0; y < kVgaHeight; y++) {
-        for (register int x = 0; x < kVgaWidth; x++) {
-            pixels[y * kVgaWidth + x] = setRGBA(0, 0, 0, 0);
-        }
-    }
+    if (!gProfile && gTraceFn.empty())
+        return;
+
+    m_profiler.setEnabled(true);
+    m_psEvents = m_profiler.addStage("events", false);
+    m_psLock = m_profiler.addStage("lock", false);
+    m_psMenu = m_profiler.addStage("updateTestMenuPixels", false);
+    m_psBlend = m_profiler.addStage("alphablendPixels", false);
+    m_psUnlock = m_profiler.addStage("unlock", false);
+    m_psRender = m_profiler.addStage("render", false);
+    m_psSwap = m_profiler.addStage("SDL_GL_SwapWindow", false);
+    m_psWait = m_profiler.addStage("frame queue wait", false);
+    m_psSoftCRT = m_profiler.addStage("soft CRT", false);
+    m_psPace = m_profiler.addStage("pacing wait", false);
+    m_psCapture = m_profiler.addStage("capture", false);
+    m_ShaderPipeline.setProfiler(&m_profiler);
+
+    if (!gTraceFn.empty() && m_profiler.startTrace(gTraceFn))
+        printf("Writing frame trace to %s\n", gTraceFn.c_str());
 }
 
-void updateTestMenuPixels(Uint32 *pixels)
+// Create renderer
+void swosCreateRenderer()
 {
-    for (register int y = 0; y < kVgaHeight; y++) {
-        for (register int x = 0; x < kVgaWidth; x++) {
-            if (x >= 150/2 && x <= kVgaWidth - 150/2 && y >= 200/2 && y <= kVgaHeight - 200/2) {
-#if (0)
-                int randNo[3];
-                for (int i = 0; i <= 2; i++) {
-                    randNo[i] = 1 + (rand() % 255);
-                }
-                pixels[y * kVgaWidth + x] = setRGBA(randNo[0], randNo[1], randNo[2], 255);
-#else
-                pixels[y * kVgaWidth + x] = setRGBA(0, 0, 0, 0);
-#endif
-            }
-            else {
-                pixels[y * kVgaWidth + x] = setRGBA(0, 0, 0, 0);
-            }
+    if (gRenderMode == RM_SDL) {
+        Uint32 flags = SDL_RENDERER_ACCELERATED;
+        if (gPaceMode == LPACE_VSYNC || gPaceMode == LPACE_ADAPTIVE)
+            flags |= SDL_RENDERER_PRESENTVSYNC;
+        m_renderer = SDL_CreateRenderer(m_window, -1, flags);
+        SDL_RenderSetLogicalSize(m_renderer, kVgaWidth, kVgaHeight);
+        printf("SDL renderer created.\n");
+    }
+    else {
+        swosInitProfiler();
+
+        if (gPixelMode != PM_RGBA32 && (gSoftCRT || gSoftCRTCompare)) {
+            printf("Software CRT filter only supports RGBA composition, disabled.\n");
+            gSoftCRT = false;
+            gSoftCRTCompare = false;
+        }
+
+        if (gGPMode == GP_ENABLED) {
+            // Reuse linked program binaries from previous runs
+            LProgramCache::setDirectory("shadercache");
+            // Indexed frames are turned into RGBA by a palette pass first
+            m_ShaderPipeline.setPaletteResolve(gPixelMode == PM_INDEXED8);
+            if (gRenderMode == RM_HEADLESS)
+                m_ShaderPipeline.setOutputFramebuffer(m_headless.framebufferID());
+            loadGP();
+            if (gHotReload && gRenderMode == RM_OPENGL)
+                swosInitHotReload();
         }
     }
 }
 
-void alphablendPixels(Uint32 *src1, Uint32 *src2, Uint32 *tar, int opacity)
+// Pixels of a menu background at the logical size, into 'pixels' or, for
+// the indexed renderer, into 'pixels8'. Bundle entries are copied from the
+// mapping, other files come from the asset threads; without 'wait' a file
+// not decoded yet gives false.
+bool swosBackgroundPixels(const char *name, bool wait, Uint32 *pixels, Uint8 *pixels8)
 {
-    Uint8 r1, g1, b1, a1;
-    Uint8 r2, g2, b2, a2;
-    Uint8 r3, g3, b3;
-    Uint32 p1, p2, p3;
-    int actualOpacity;
-
-    for (register int y = 0; y < kVgaHeight; y++) {
-        for (register int x = 0; x < kVgaWidth; x++) {
-            p1 = src1[y * kVgaWidth + x];
-            p2 = src2[y * kVgaWidth + x];
-
-            getRGBA(p1, &r1, &g1, &b1, &a1);
-            getRGBA(p2, &r2, &g2, &b2, &a2);
-
-            if (a2 == 0) {
-                actualOpacity = 0;
-            }
-            else {
-                actualOpacity = opacity;
+    int count = kVgaWidth * kVgaHeight;
+    int entry = m_bundle.find(name);
+    const LBundleEntry *found = m_bundle.entry(entry);
+    if (found && found->width == (GLuint)kVgaWidth && found->height == (GLuint)kVgaHeight) {
+        if (pixels8 && m_bundle.entryPixels8(entry, pixels8))
+            return true;
+        if (pixels && m_bundle.entryPixels32(entry, pixels))
+            return true;
+        if (pixels8) {
+            std::vector<Uint32> rgba(count);
+            if (m_bundle.entryPixels32(entry, &rgba[0])) {
+                quantizePixels(&rgba[0], pixels8, count);
+                return true;
             }
-
-            r3 = r1 * (100 - actualOpacity) / 100. + r2 * actualOpacity / 100.;
-            g3 = g1 * (100 - actualOpacity) / 100. + g2 * actualOpacity / 100.;
-            b3 = b1 * (100 - actualOpacity) / 100. + b2 * actualOpacity / 100.;
-
-            p3 = setRGBA(r3, g3, b3, 255);
-            tar[y * kVgaWidth + x] = p3;
         }
+        // Indices cannot give back the RGBA pixels, use the file
+    }
+
+    int id = m_assets.request(name);
+    LImage *image = wait ? m_assets.wait(id) : m_assets.image(id);
+    if (!image)
+        return false;
+    if (image->width != (GLuint)kVgaWidth || image->height != (GLuint)kVgaHeight) {
+        if (wait)
+            printf("Background %s is %ux%u, expected %dx%d.\n", name, image->width, image->height, kVgaWidth, kVgaHeight);
+        return false;
     }
+
+    if (pixels8)
+        quantizePixels(&image->pixels[0], pixels8, count);
+    else
+        memcpy(pixels, &image->pixels[0], count * sizeof(Uint32));
+    return true;
 }
 
-void clearPixels(Uint32 *pixels)
+// Queue every menu background missing from the bundle for decoding and
+// wait for the one shown first only
+bool swosLoadBackgrounds(const char *first, Uint32 *pixels, Uint8 *pixels8)
 {
-    for (register int y = 0; y < kVgaHeight; y++) {
-        for (register int x = 0; x < kVgaWidth; x++) {
-#if (1)
-            pixels[y * kVgaWidth + x] = setRGBA(0, 0, 0, 255);
-#else
-            pixels[y * kVgaWidth + x] = setRGBA(112, 144, 0, 255);
-#endif
-        }
+    if (!gBundleFn.empty() && m_bundle.open(gBundleFn))
+        printf("Bundle %s: %d entries on %d pages\n", gBundleFn.c_str(), m_bundle.entryCount(), m_bundle.pageCount());
+
+    for (int i = 0; i < BACKGROUND_COUNT; i++) {
+        if (strcmp(gBackgrounds[i], first) == 0)
+            gBackground = i;
+        if (m_bundle.find(gBackgrounds[i]) < 0)
+            m_assets.request(gBackgrounds[i]);
     }
+
+    return swosBackgroundPixels(first, true, pixels, pixels8);
 }
 
 // Create textures
@@ -303,6 +556,8 @@ void swosCreateTextures()
     if (gRenderMode == RM_SDL) {
         m_surfaceBackground = SDL_LoadBMP(bmpFilename);
         m_textureBackground = SDL_CreateTextureFromSurface(m_renderer, m_surfaceBackground);
+        SDL_FreeSurface(m_surfaceBackground);
+        m_surfaceBackground = NULL;
         printf("SDL BackgroundTexture created.\n");
 
         m_textureMenu = SDL_CreateTexture(
@@ -319,49 +574,359 @@ void swosCreateTextures()
         SDL_SetTextureBlendMode(m_textureTarget, SDL_BLENDMODE_BLEND);
         printf("SDL TargetTexture created.\n");
     }
-    else {
-        m_glTextureBackground.loadTextureFromBitmapFile(bmpFilename, kVgaWidth, kVgaHeight);
-        printf("OpenGL BackgroundTexture created.\n");
+    else if (gPixelMode == PM_INDEXED8) {
+        int count = kVgaWidth * kVgaHeight;
+
+        // Background is quantized once, then only kept on the CPU
+        m_pixelsBackground8 = new Uint8[ count ];
+        if (!swosLoadBackgrounds(bmpFilename, NULL, m_pixelsBackground8)) {
+            std::vector<Uint32> fallback(count);
+            clearPixels(&fallback[0]);
+            quantizePixels(&fallback[0], m_pixelsBackground8, count);
+        }
+        printf("Indexed background created.\n");
+
+        m_pixelsMenu8 = new Uint8[ count ];
+        pxClear8(m_pixelsMenu8, count, INDEX_TRANSPARENT);
 
+        m_glTextureTarget.loadTextureFromPixels8(m_pixelsBackground8, kVgaWidth, kVgaHeight);
+        m_glTextureTarget.enableStreaming(LSTREAM_PERSISTENT, 3);
+        m_glTextureTarget.enableDirtyTracking(true);
+        printf("OpenGL indexed TargetTexture created.\n");
+
+        // Palette changes are a 1 KB upload
+        m_paletteBrightness = 0;
+        initPalette(m_palette, m_paletteBrightness);
+        m_glTexturePalette.loadTextureFromPixels32(m_palette, 256, 1);
+        m_glTexturePalette.setFilter(GL_NEAREST);
+        m_glTexturePalette.enableStreaming(LSTREAM_ORPHAN, 2);
+        m_ShaderPipeline.setTexture("palette", m_glTexturePalette.getTextureID());
+        printf("OpenGL PaletteTexture created.\n");
+    }
+    else {
         Uint32 *pixels;
         pixels = new Uint32[ kVgaHeight * kVgaWidth ];
 
+        std::vector<Uint32> background(kVgaHeight * kVgaWidth);
         clearPixels(pixels);
+        if (!swosLoadBackgrounds(bmpFilename, &background[0], NULL))
+            clearPixels(&background[0]);
+        m_glTextureBackground.loadTextureFromPixels32(&background[0], kVgaWidth, kVgaHeight);
+        printf("OpenGL BackgroundTexture created.\n");
+
         m_glTextureMenu.loadTextureFromPixels32(pixels, kVgaWidth, kVgaHeight);
         printf("OpenGL MenuTexture created.\n");
         m_glTextureTarget.loadTextureFromPixels32(pixels, kVgaWidth, kVgaHeight);
         printf("OpenGL TargetTexture created.\n");
+
+        delete[] pixels;
+
+        // Keep CPU shadow copies and stream uploads through a PBO ring
+        m_glTextureBackground.enableStreaming(LSTREAM_PERSISTENT, 3);
+        m_glTextureMenu.enableStreaming(LSTREAM_PERSISTENT, 3);
+        m_glTextureTarget.enableStreaming(LSTREAM_PERSISTENT, 3);
+        printf("OpenGL texture streaming enabled.\n");
+
+        // Menu starts transparent, afterwards only changed tiles are
+        // blended and uploaded
+        m_glTextureMenu.lock();
+        initMenuPixels(m_glTextureMenu.getPixelData32());
+        m_glTextureMenu.unlock();
+        m_glTextureMenu.enableDirtyTracking(true);
+        m_glTextureTarget.enableDirtyTracking(true);
+
+        if (gSoftCRT || gSoftCRTCompare) {
+            m_softCRT.setFilter(gSoftCRTFilter);
+            m_softCRTPool.init(gThreads);
+            m_softCRT.setThreadPool(&m_softCRTPool);
+            m_softCRT.setHalation(gSoftCRTCompare ? 0 : gSoftHalation);
+            printf("Software CRT filter: %s, %s lanes\n", m_softCRT.filterName(), LSoftCRT::lanesName());
+        }
     }
 }
 
+// Milliseconds since start, paced by frame count when headless so runs
+// are reproducible
+Uint32 swosTicks()
+{
+    // Replays run on the clock they were recorded with
+    if (m_replay.frameCount() > 0)
+        return m_replay.ticks(m_frameCount);
+
+    if (gRenderMode == RM_HEADLESS)
+        return m_frameCount * 1000 / TICK_RATE;
+
+    return SDL_GetTicks();
+}
+
+// Layer changes of one frame: played back when a replay runs, otherwise the
+// test menu, which goes into the replay being recorded if there is one.
+// Changed areas are reported to 'layer'.
+void swosUpdateLayers(Uint8 *background, Uint8 *menu, LTexture *layer, int frame)
+{
+    std::vector<LDirtyRect> rects;
+    if (m_replay.frameCount() > 0) {
+        m_replay.applyFrame(frame, background, menu, rects);
+        for (size_t i = 0; i < rects.size(); i++)
+            layer->invalidateRect(rects[i].x, rects[i].y, rects[i].w, rects[i].h);
+        return;
+    }
+
+    if (gPixelMode == PM_INDEXED8)
+        updateTestMenuPixels8(menu, layer);
+    else
+        updateTestMenuPixels((Uint32*)menu, layer, frame);
+
+    if (m_replayWriter.isOpen()) {
+        layer->getDirtyRects(rects);
+        for (size_t i = 0; i < rects.size(); i++)
+            m_replayWriter.addChange(LREPLAY_MENU, menu, rects[i]);
+        m_replayWriter.endFrame(swosTicks());
+    }
+}
+
+// Compositor thread: menu and target composition of the next frames. Owns
+// the menu layer, touches no GL state and no profiler stages.
+int swosComposeThread(void *data)
+{
+    Uint32 *pixelsBackground = (Uint32*) m_glTextureBackground.getPixelData32();
+    Uint32 *pixelsMenu = (Uint32*) m_glTextureMenu.getPixelData32();
+    std::vector<LDirtyRect> changed;
+    int frame = 0;
+
+    while (LFrameSlot *slot = m_frameQueue.acquireFree()) {
+        swosUpdateLayers((Uint8*)pixelsBackground, (Uint8*)pixelsMenu, &m_glTextureMenu, frame);
+        m_glTextureMenu.getDirtyRects(changed);
+        m_glTextureMenu.clearDirty();
+
+        // Each buffer catches up on everything changed since its last use
+        m_frameQueue.invalidate(changed);
+        alphablendPixels(pixelsBackground, pixelsMenu, (Uint32*)slot->pixels, 50, slot->pending);
+        slot->pending.clear();
+
+        m_frameQueue.submit(slot, changed);
+        frame++;
+    }
+
+    return 0;
+}
+
+void swosStartFrameQueue()
+{
+    if (gQueueDepth <= 0 || gRenderMode == RM_SDL)
+        return;
+
+    if (gPixelMode != PM_RGBA32) {
+        printf("Frame queue only supports RGBA composition, composing in main loop.\n");
+        return;
+    }
+
+    if (!m_frameQueue.init(gQueueDepth, kVgaWidth, kVgaHeight, 4))
+        return;
+
+    m_composeThread = SDL_CreateThread(swosComposeThread, "compose", NULL);
+    if (m_composeThread == NULL) {
+        printf("Unable to create compositor thread! SDL Error: %s\n", SDL_GetError());
+        m_frameQueue.freeQueue();
+    }
+}
+
+void swosStopFrameQueue()
+{
+    if (m_composeThread) {
+        m_frameQueue.stop();
+        SDL_WaitThread(m_composeThread, NULL);
+        m_composeThread = NULL;
+    }
+    m_frameQueue.freeQueue();
+}
+
+// GL thread side of the frame queue: upload the oldest composed frame.
+// The buffer is free again as soon as its changes are in the texture's
+// shadow copy; the PBO ring fences keep the GPU side from being overwritten.
+void swosUploadQueuedFrame()
+{
+    m_profiler.begin(m_psWait);
+    LFrameSlot *slot = m_frameQueue.acquireReady();
+    m_profiler.end(m_psWait);
+    if (!slot)
+        return;
+
+    m_profiler.begin(m_psLock);
+    m_glTextureTarget.lock();
+    m_profiler.end(m_psLock);
+
+    Uint32 *pixelsFrame = (Uint32*) slot->pixels;
+    Uint32 *pixelsTarget = (Uint32*) m_glTextureTarget.getPixelData32();
+    for (size_t i = 0; i < slot->changed.size(); i++) {
+        const LDirtyRect &r = slot->changed[i];
+        for (Uint32 y = r.y; y < r.y + r.h; y++) {
+            memcpy(pixelsTarget + y * kVgaWidth + r.x, pixelsFrame + y * kVgaWidth + r.x, r.w * sizeof(Uint32));
+        }
+        m_glTextureTarget.invalidateRect(r.x, r.y, r.w, r.h);
+    }
+    m_frameQueue.release(slot);
+
+    m_profiler.begin(m_psUnlock);
+    m_glTextureTarget.unlock();
+    m_profiler.end(m_psUnlock);
+}
+
 void swosUpdateTexture()
 {
+    if (m_frameQueue.depth() > 0) {
+        swosUploadQueuedFrame();
+        return;
+    }
+
     if (gRenderMode == RM_SDL) {
         Uint32 *pixels;
         int pitch;
 
         SDL_LockTexture(m_textureMenu, NULL, (void**)&pixels, &pitch);
-        updateTestMenuPixels(pixels);
+        initMenuPixels(pixels);
+        updateTestMenuPixels(pixels, NULL, m_frameCount);
         SDL_UnlockTexture(m_textureMenu);
 
         delete pixels;
     }
+    else if (gPixelMode == PM_INDEXED8) {
+        // Fade in during the first second
+        Uint32 ticks = swosTicks();
+        int brightness = ticks >= 1000 ? 255 : ticks * 255 / 1000;
+        if (brightness != m_paletteBrightness) {
+            m_paletteBrightness = brightness;
+            m_glTexturePalette.lock();
+            initPalette(m_glTexturePalette.getPixelData32(), brightness);
+            m_glTexturePalette.unlock();
+        }
+
+        std::vector<LDirtyRect> rects;
+
+        m_profiler.begin(m_psLock);
+        m_glTextureTarget.lock();
+        m_profiler.end(m_psLock);
+
+        m_profiler.begin(m_psMenu);
+        swosUpdateLayers(m_pixelsBackground8, m_pixelsMenu8, &m_glTextureTarget, m_frameCount);
+        m_profiler.end(m_psMenu);
+
+        m_profiler.begin(m_psBlend);
+        m_glTextureTarget.getDirtyRects(rects);
+        composePixels8(m_pixelsBackground8, m_pixelsMenu8, m_glTextureTarget.getPixelData8(), rects);
+        m_profiler.end(m_psBlend);
+
+        m_profiler.begin(m_psUnlock);
+        m_glTextureTarget.unlock();
+        m_profiler.end(m_psUnlock);
+    }
     else {
-        m_glTextureBackground.lock();
+        // Background is only read, its shadow copy stays valid without lock()
+        m_profiler.begin(m_psLock);
         m_glTextureMenu.lock();
         m_glTextureTarget.lock();
+        m_profiler.end(m_psLock);
 
         Uint32 *pixelsBackground = (Uint32*) m_glTextureBackground.getPixelData32();
         Uint32 *pixelsMenu = (Uint32*) m_glTextureMenu.getPixelData32();
         Uint32 *pixelsTarget = (Uint32*) m_glTextureTarget.getPixelData32();
 
-        updateTestMenuPixels(pixelsMenu);
-        alphablendPixels(pixelsBackground, pixelsMenu, pixelsTarget, 50);
+        m_profiler.begin(m_psMenu);
+        swosUpdateLayers((Uint8*)pixelsBackground, (Uint8*)pixelsMenu, &m_glTextureMenu, m_frameCount);
+        m_profiler.end(m_psMenu);
 
+        // Target changes wherever the menu did
+        m_profiler.begin(m_psBlend);
+        std::vector<LDirtyRect> rects;
+        m_glTextureMenu.getDirtyRects(rects);
+        for (size_t i = 0; i < rects.size(); i++) {
+            m_glTextureTarget.invalidateRect(rects[i].x, rects[i].y, rects[i].w, rects[i].h);
+        }
+        m_glTextureTarget.getDirtyRects(rects);
+        alphablendPixels(pixelsBackground, pixelsMenu, pixelsTarget, 50, rects);
+        m_profiler.end(m_psBlend);
+
+        m_profiler.begin(m_psUnlock);
         m_glTextureTarget.unlock();
         m_glTextureMenu.unlock();
-        m_glTextureBackground.unlock();
+        m_profiler.end(m_psUnlock);
+    }
+}
+
+// Hand the CPU filter the shader parameters as the pipeline resolves them,
+// from --param, the keys or values pinned by --defines
+void swosSetSoftCRTParams()
+{
+    LSoftCRTParams params = LSoftCRT::defaultParams();
+    params.mask = m_ShaderPipeline.parameterValue("MASK", params.mask);
+    params.maskIntensity = m_ShaderPipeline.parameterValue("MASK_INTENSITY", params.maskIntensity);
+    params.scanlineThinness = m_ShaderPipeline.parameterValue("SCANLINE_THINNESS", params.scanlineThinness);
+    params.scanBlur = m_ShaderPipeline.parameterValue("SCAN_BLUR", params.scanBlur);
+    params.curvature = m_ShaderPipeline.parameterValue("CURVATURE", params.curvature);
+    params.trinitronCurve = m_ShaderPipeline.parameterValue("TRINITRON_CURVE", params.trinitronCurve);
+    params.corner = m_ShaderPipeline.parameterValue("CORNER", params.corner);
+    params.crtGamma = m_ShaderPipeline.parameterValue("CRT_GAMMA", params.crtGamma);
+    params.geomCrtGamma = m_ShaderPipeline.parameterValue("CRTgamma", params.geomCrtGamma);
+    params.geomMonitorGamma = m_ShaderPipeline.parameterValue("monitorgamma", params.geomMonitorGamma);
+    params.geomOverscanX = m_ShaderPipeline.parameterValue("overscan_x", params.geomOverscanX);
+    params.geomOverscanY = m_ShaderPipeline.parameterValue("overscan_y", params.geomOverscanY);
+    params.geomAspectX = m_ShaderPipeline.parameterValue("aspect_x", params.geomAspectX);
+    params.geomAspectY = m_ShaderPipeline.parameterValue("aspect_y", params.geomAspectY);
+    params.geomD = m_ShaderPipeline.parameterValue("d", params.geomD);
+    params.geomR = m_ShaderPipeline.parameterValue("R", params.geomR);
+    params.geomCornerSize = m_ShaderPipeline.parameterValue("cornersize", params.geomCornerSize);
+    params.geomCornerSmooth = m_ShaderPipeline.parameterValue("cornersmooth", params.geomCornerSmooth);
+    m_softCRT.setParams(params);
+}
+
+// Filter the target on the CPU into a texture of window size
+void swosApplySoftCRT()
+{
+    if (m_glTextureSoftCRT.textureWidth() != (GLuint)m_windowWidth || m_glTextureSoftCRT.textureHeight() != (GLuint)m_windowHeight) {
+        std::vector<Uint32> pixels(m_windowWidth * m_windowHeight, 0);
+        m_glTextureSoftCRT.loadTextureFromPixels32(&pixels[0], m_windowWidth, m_windowHeight);
+        m_glTextureSoftCRT.enableStreaming(LSTREAM_PERSISTENT, 3);
+    }
+
+    swosSetSoftCRTParams();
+    m_profiler.begin(m_psSoftCRT);
+    m_glTextureSoftCRT.lock();
+    m_softCRT.render(
+        m_glTextureTarget.getPixelData32(), kVgaWidth, kVgaHeight,
+        m_glTextureSoftCRT.getPixelData32(), m_windowWidth, m_windowHeight
+    );
+    m_glTextureSoftCRT.unlock();
+    m_profiler.end(m_psSoftCRT);
+}
+
+// Copy the composite the shaders are about to read, indexed frames through
+// the palette they are shown with
+void swosRecordComposite()
+{
+    m_profiler.begin(m_psCapture);
+    if (gPixelMode == PM_INDEXED8)
+        m_recordComposite.capturePixels8(m_glTextureTarget.getPixelData8(), m_glTexturePalette.getPixelData32());
+    else
+        m_recordComposite.capturePixels32(m_glTextureTarget.getPixelData32());
+    m_profiler.end(m_psCapture);
+}
+
+// Queue a read back of the frame just rendered, before the swap leaves the
+// back buffer undefined
+void swosRecordOutput()
+{
+    // A resized window no longer fits the recording
+    if (m_windowWidth != m_recordOutput.width() || m_windowHeight != m_recordOutput.height()) {
+        static bool warned = false;
+        if (!warned)
+            printf("Window is no longer %dx%d, frames are not recorded.\n", m_recordOutput.width(), m_recordOutput.height());
+        warned = true;
+        return;
     }
+
+    m_profiler.begin(m_psCapture);
+    m_recordOutput.captureFramebuffer(gRenderMode == RM_HEADLESS ? m_headless.framebufferID() : 0);
+    m_profiler.end(m_psCapture);
 }
 
 // Update screen
@@ -372,20 +937,62 @@ void swosDoRendering()
         SDL_RenderCopy(m_renderer, m_textureBackground, NULL, NULL);
         SDL_RenderCopy(m_renderer, m_textureMenu, NULL, NULL);
         SDL_SetRenderTarget(m_renderer, NULL);
+        m_pacer.beginSwap();
         SDL_RenderPresent(m_renderer);
+        m_pacer.endSwap();
     }
     else {
+        GLint sourceWidth = kVgaWidth;
+        GLint sourceHeight = kVgaHeight;
+        GLuint texID = m_glTextureTarget.getTextureID();
+        if (gSoftCRT) {
+            swosApplySoftCRT();
+            sourceWidth = m_windowWidth;
+            sourceHeight = m_windowHeight;
+            texID = m_glTextureSoftCRT.getTextureID();
+        }
+
+        if (m_recordComposite.recording())
+            swosRecordComposite();
+
+        if (gRenderMode == RM_HEADLESS)
+            glBindFramebuffer(GL_FRAMEBUFFER, m_headless.framebufferID());
+        m_profiler.begin(m_psRender);
         glClear( GL_COLOR_BUFFER_BIT );
-        m_ShaderProgram.render(
-            kVgaWidth, kVgaHeight, 0, 0, m_windowWidth, m_windowHeight,
-            m_glTextureTarget.getTextureID()
+        m_ShaderPipeline.render(
+            sourceWidth, sourceHeight, 0, 0, m_windowWidth, m_windowHeight,
+            texID
         );
-        SDL_GL_SwapWindow(m_window);
+        m_profiler.end(m_psRender);
+
+        if (m_recordOutput.recording())
+            swosRecordOutput();
+
+        if (gRenderMode == RM_OPENGL) {
+            m_pacer.beginSwap();
+            m_profiler.begin(m_psSwap);
+            SDL_GL_SwapWindow(m_window);
+            m_profiler.end(m_psSwap);
+            m_pacer.endSwap();
+        }
     }
+    m_frameCount++;
 }
 
 void finishRendering()
 {
+    swosStopFrameQueue();
+    m_threadPool.freePool();
+    m_assets.freeLoader();
+    m_bundle.close();
+    if (m_replayWriter.isOpen()) {
+        printf("Replay of %d frames written to %s\n", m_replayWriter.frameCount(), gRecordReplayFn.c_str());
+        m_replayWriter.close();
+    }
+    m_replay.close();
+    if (gRenderMode != RM_HEADLESS)
+        m_pacer.report();
+
     if (gRenderMode == RM_SDL) {
         if (m_textureBackground)
             SDL_DestroyTexture(m_textureBackground);
@@ -403,9 +1010,33 @@ void finishRendering()
         printf("SDL rendering mode terminated.\n");
     }
     else {
-        m_ShaderProgram.freeProgram();
+        // Frames still in flight are written before the context goes
+        m_recordOutput.stop();
+        m_recordComposite.stop();
+        m_recordOutput.report();
+        m_recordComposite.report();
+
+        if (m_profiler.enabled()) {
+            m_profiler.report();
+            m_profiler.freeProfiler();
+        }
+
+        m_ShaderPipeline.setProfiler(NULL);
+        m_ShaderPipeline.freePipeline();
+        m_shaderCompiler.freeCompiler();
+        m_shaderWatcher.freeWatcher();
         glUseProgram(0);
 
+        m_softCRT.freeFilter();
+        m_softCRTPool.freePool();
+
+        m_headless.freeHeadless();
+
+        delete[] m_pixelsBackground8;
+        delete[] m_pixelsMenu8;
+        m_pixelsBackground8 = NULL;
+        m_pixelsMenu8 = NULL;
+
         if (m_window)
             SDL_DestroyWindow(m_window);
 
@@ -414,20 +1045,541 @@ void finishRendering()
     }
 }
 
+// Parse command line
+void swosParseArgs(int argc, char* args[])
+{
+    for (int i = 1; i < argc; i++) {
+        std::string arg = args[i];
+
+        if (arg.size() > 6 && arg.substr(arg.size() - 6) == ".glslp") {
+            gPresetFn = arg;
+        }
+        else if (arg == "--indexed") {
+            gPixelMode = PM_INDEXED8;
+        }
+        else if (arg == "--menu-noise") {
+            gMenuNoise = true;
+        }
+        else if (arg == "--hot-reload") {
+            gHotReload = true;
+        }
+        else if (arg == "--profile") {
+            gProfile = true;
+        }
+        else if (arg == "--trace" && i + 1 < argc) {
+            gTraceFn = args[++i];
+        }
+        else if (arg == "--threads" && i + 1 < argc) {
+            gThreads = atoi(args[++i]);
+        }
+        else if (arg == "--queue" && i + 1 < argc) {
+            gQueueDepth = atoi(args[++i]);
+        }
+        else if (arg == "--soft-crt" && i + 1 < argc) {
+            gSoftCRT = true;
+            gSoftCRTFilter = std::string(args[++i]) == "geom" ? LSOFTCRT_GEOM : LSOFTCRT_LOTTES;
+        }
+        else if (arg == "--soft-halation" && i + 1 < argc) {
+            gSoftHalation = atoi(args[++i]);
+        }
+        else if (arg == "--compare-soft-crt" && i + 1 < argc) {
+            gSoftCRTCompare = true;
+            gSoftCRTFilter = std::string(args[++i]) == "geom" ? LSOFTCRT_GEOM : LSOFTCRT_LOTTES;
+            gRenderMode = RM_HEADLESS;
+        }
+        else if (arg == "--defines" && i + 1 < argc) {
+            gDefines = args[++i];
+        }
+        else if (arg == "--param" && i + 1 < argc) {
+            // NAME=VALUE, applied to the passes declaring NAME once loaded
+            std::string param = args[++i];
+            size_t equals = param.find('=');
+            if (equals != std::string::npos)
+                m_ShaderPipeline.setParameter(param.substr(0, equals), (GLfloat)atof(param.c_str() + equals + 1));
+        }
+        else if (arg == "--headless") {
+            gRenderMode = RM_HEADLESS;
+        }
+        else if (arg == "--frames" && i + 1 < argc) {
+            gHeadlessFrames = atoi(args[++i]);
+        }
+        else if (arg == "--output" && i + 1 < argc) {
+            gOutputFn = args[++i];
+        }
+        else if (arg == "--record" && i + 1 < argc) {
+            gRecordFn = args[++i];
+        }
+        else if (arg == "--record-composite" && i + 1 < argc) {
+            gRecordCompositeFn = args[++i];
+        }
+        else if (arg == "--record-replay" && i + 1 < argc) {
+            gRecordReplayFn = args[++i];
+        }
+        else if (arg == "--replay" && i + 1 < argc) {
+            gReplayFn = args[++i];
+            // As fast as frames can be made
+            gPaceMode = LPACE_UNCAPPED;
+        }
+        else if (arg == "--shader-suite" && i + 1 < argc) {
+            gSuiteDir = args[++i];
+            gRenderMode = RM_HEADLESS;
+            // References are made with Mesa's software rasterizer unless
+            // the environment asks for something else
+            SDL_setenv("LIBGL_ALWAYS_SOFTWARE", "1", 0);
+        }
+        else if (arg == "--suite-update") {
+            gSuiteUpdate = true;
+        }
+        else if (arg == "--suite-threshold" && i + 1 < argc) {
+            gSuiteThreshold = atof(args[++i]);
+        }
+        else if (arg == "--bundle" && i + 1 < argc) {
+            gBundleFn = args[++i];
+        }
+        else if (arg == "--pace" && i + 1 < argc) {
+            std::string mode = args[++i];
+            if (mode == "vsync")
+                gPaceMode = LPACE_VSYNC;
+            else if (mode == "adaptive")
+                gPaceMode = LPACE_ADAPTIVE;
+            else if (mode == "fixed")
+                gPaceMode = LPACE_FIXED;
+            else if (mode == "uncapped")
+                gPaceMode = LPACE_UNCAPPED;
+            else
+                printf("Unknown pacing mode: %s\n", mode.c_str());
+        }
+        else if (arg == "--fps" && i + 1 < argc) {
+            gPaceMode = LPACE_FIXED;
+            gPaceRate = atof(args[++i]);
+        }
+        else if (arg == "--latency" && i + 1 < argc) {
+            gLatencyTarget = atof(args[++i]);
+        }
+        else if (arg == "--size" && i + 1 < argc) {
+            int w, h;
+            if (sscanf(args[++i], "%dx%d", &w, &h) == 2 && w > 0 && h > 0) {
+                m_windowWidth = w;
+                m_windowHeight = h;
+            }
+        }
+        else {
+            printf("Unknown argument: %s\n", arg.c_str());
+        }
+    }
+}
+
+// Check the CPU filter against its shader's output of the last frame
+bool swosCompareSoftCRT()
+{
+    // The shader ran alone, and the CPU filter follows its parameters but
+    // not its structural defines (CRTS_*, OVERSAMPLE, GEOM_CURVATURE...)
+    if (!gPresetFn.empty()) {
+        printf("Software CRT comparison runs %s alone, remove preset %s\n", m_softCRT.filterName(), gPresetFn.c_str());
+        return false;
+    }
+    std::map<std::string, std::string> defines;
+    LShaderVariantCache::parseDefines(m_ShaderPipeline.defines(), defines);
+    for (std::map<std::string, std::string>::iterator define = defines.begin(); define != defines.end(); ++define) {
+        bool parameter = false;
+        for (int i = 0; i < m_ShaderPipeline.parameterCount(); i++) {
+            if (m_ShaderPipeline.parameter(i).info.name == define->first)
+                parameter = true;
+        }
+        if (!parameter) {
+            printf("Software CRT filter does not implement define %s, only pinned parameters can be compared\n", define->first.c_str());
+            return false;
+        }
+    }
+
+    int count = m_windowWidth * m_windowHeight;
+    std::vector<Uint32> gpu(count), cpu(count);
+    if (!m_headless.readFrame(&gpu[0]))
+        return false;
+
+    // First call computes the per pixel geometry, time the second
+    swosSetSoftCRTParams();
+    Uint32 *target = m_glTextureTarget.getPixelData32();
+    m_softCRT.render(target, kVgaWidth, kVgaHeight, &cpu[0], m_windowWidth, m_windowHeight);
+    Uint64 start = SDL_GetPerformanceCounter();
+    m_softCRT.render(target, kVgaWidth, kVgaHeight, &cpu[0], m_windowWidth, m_windowHeight);
+    double ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+
+    double mean;
+    int largest = LSoftCRT::compare(&gpu[0], &cpu[0], count, &mean);
+    printf(
+        "Software CRT %s (%s lanes, %d threads, %.3f ms): largest difference %d, mean %.4f\n",
+        m_softCRT.filterName(), LSoftCRT::lanesName(), m_softCRTPool.threadCount(), ms, largest, mean
+    );
+
+    if (largest > LSOFTCRT_TOLERANCE) {
+        printf("Software CRT output differs from the shader by more than %d!\n", LSOFTCRT_TOLERANCE);
+        return false;
+    }
+    return true;
+}
+
+// Render a fixed number of frames offscreen and report frame times
+int swosRunHeadless()
+{
+    double freq = (double)SDL_GetPerformanceFrequency();
+    double total = 0.0, minMs = 1e9, maxMs = 0.0;
+
+    for (int frame = 0; frame < gHeadlessFrames; frame++) {
+        Uint64 start = SDL_GetPerformanceCounter();
+
+        m_profiler.beginFrame();
+        swosUpdateTexture();
+        swosDoRendering();
+        // Without a swap nothing bounds the frame, wait for the GPU
+        glFinish();
+        m_profiler.endFrame();
+
+        double ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / freq;
+        total += ms;
+        if (ms < minMs)
+            minMs = ms;
+        if (ms > maxMs)
+            maxMs = ms;
+    }
+
+    if (gHeadlessFrames > 0) {
+        double avg = total / gHeadlessFrames;
+        printf(
+            "Headless: %d frames at %dx%d, avg %.3f ms (%.1f fps), min %.3f ms, max %.3f ms\n",
+            gHeadlessFrames, m_windowWidth, m_windowHeight, avg, 1000.0 / avg, minMs, maxMs
+        );
+    }
+
+    if (!gOutputFn.empty()) {
+        if (!m_headless.saveFramePPM(gOutputFn))
+            return 1;
+        printf("Last frame written to %s\n", gOutputFn.c_str());
+    }
+
+    if (gSoftCRTCompare && !swosCompareSoftCRT())
+        return 1;
+
+    return 0;
+}
+
+// Load a replay's layers over the test ones, or start recording a replay
+// of this session
+bool swosStartReplay()
+{
+    if (gReplayFn.empty() && gRecordReplayFn.empty())
+        return true;
+
+    if (gRenderMode == RM_SDL) {
+        printf("Replays need OpenGL rendering, disabled.\n");
+        return gReplayFn.empty();
+    }
+
+    bool indexed = gPixelMode == PM_INDEXED8;
+    GLuint bpp = indexed ? 1 : 4;
+    size_t bytes = kVgaWidth * kVgaHeight * bpp;
+
+    if (!gReplayFn.empty()) {
+        if (!m_replay.open(gReplayFn))
+            return false;
+        if (m_replay.frameCount() == 0) {
+            printf("Replay %s has no frames.\n", gReplayFn.c_str());
+            m_replay.close();
+            return false;
+        }
+        if (m_replay.width() != (GLuint)kVgaWidth || m_replay.height() != (GLuint)kVgaHeight || m_replay.bytesPerPixel() != bpp) {
+            printf("Replay %s has %ux%u layers of %u bytes per pixel, this run composes %dx%d of %u.\n",
+                   gReplayFn.c_str(), m_replay.width(), m_replay.height(), m_replay.bytesPerPixel(), kVgaWidth, kVgaHeight, bpp);
+            m_replay.close();
+            return false;
+        }
+
+        if (indexed) {
+            memcpy(m_pixelsBackground8, m_replay.layer(LREPLAY_BACKGROUND), bytes);
+            memcpy(m_pixelsMenu8, m_replay.layer(LREPLAY_MENU), bytes);
+        }
+        else {
+            m_glTextureBackground.lock();
+            memcpy(m_glTextureBackground.getPixelData32(), m_replay.layer(LREPLAY_BACKGROUND), bytes);
+            m_glTextureBackground.unlock();
+            m_glTextureMenu.lock();
+            memcpy(m_glTextureMenu.getPixelData32(), m_replay.layer(LREPLAY_MENU), bytes);
+            m_glTextureMenu.invalidate();
+            m_glTextureMenu.unlock();
+        }
+        m_glTextureTarget.invalidate();
+        printf("Replay %s: %d frames\n", gReplayFn.c_str(), m_replay.frameCount());
+        return true;
+    }
+
+    // Frames composed ahead would be recorded out of step with the ones shown
+    if (gQueueDepth > 0) {
+        printf("Replays are recorded composing in the main loop, frame queue disabled.\n");
+        gQueueDepth = 0;
+    }
+
+    const void *background = indexed ? (void*)m_pixelsBackground8 : (void*)m_glTextureBackground.getPixelData32();
+    const void *menu = indexed ? (void*)m_pixelsMenu8 : (void*)m_glTextureMenu.getPixelData32();
+    if (m_replayWriter.open(gRecordReplayFn, kVgaWidth, kVgaHeight, bpp, background, menu))
+        printf("Recording replay to %s\n", gRecordReplayFn.c_str());
+    return true;
+}
+
+// Play the replay as fast as frames can be made, each one finished by the
+// GPU before the next starts, and report throughput and frame latency
+int swosRunReplay()
+{
+    double freq = (double)SDL_GetPerformanceFrequency();
+    std::vector<double> times;
+    times.reserve(m_replay.frameCount());
+
+    Uint64 begin = SDL_GetPerformanceCounter();
+    for (int frame = 0; frame < m_replay.frameCount(); frame++) {
+        Uint64 start = SDL_GetPerformanceCounter();
+
+        // Only quitting is handled, keys would change the workload
+        SDL_Event e;
+        bool quit = false;
+        while (gRenderMode == RM_OPENGL && SDL_PollEvent(&e) != 0) {
+            if (e.type == SDL_QUIT)
+                quit = true;
+        }
+        if (quit)
+            break;
+
+        m_profiler.beginFrame();
+        swosUpdateTexture();
+        swosDoRendering();
+        glFinish();
+        m_profiler.endFrame();
+
+        times.push_back((SDL_GetPerformanceCounter() - start) * 1000.0 / freq);
+    }
+    double seconds = (SDL_GetPerformanceCounter() - begin) / freq;
+
+    if (times.empty())
+        return 1;
+
+    // Nearest rank percentiles, as the profiler reports them
+    double total = 0.0;
+    for (size_t i = 0; i < times.size(); i++)
+        total += times[i];
+    std::vector<double> sorted(times);
+    std::sort(sorted.begin(), sorted.end());
+    const double ranks[] = { 50.0, 90.0, 95.0, 99.0 };
+    double at[4];
+    for (int i = 0; i < 4; i++)
+        at[i] = sorted[(size_t)(ranks[i] / 100.0 * (sorted.size() - 1) + 0.5)];
+
+    printf("Replay: %d frames at %dx%d in %.3f s, %.1f fps\n",
+           (int)times.size(), m_windowWidth, m_windowHeight, seconds, times.size() / seconds);
+    printf("Frame latency: mean %.3f ms, min %.3f, p50 %.3f, p90 %.3f, p95 %.3f, p99 %.3f, max %.3f\n",
+           total / times.size(), sorted.front(), at[0], at[1], at[2], at[3], sorted.back());
+
+    // Identical for the same replay and settings in any build
+    int count = kVgaWidth * kVgaHeight;
+    const Uint8 *composite = gPixelMode == PM_INDEXED8 ? m_glTextureTarget.getPixelData8() : (const Uint8*)m_glTextureTarget.getPixelData32();
+    size_t bytes = count * (gPixelMode == PM_INDEXED8 ? 1 : 4);
+    Uint32 hash = 2166136261u;
+    for (size_t i = 0; i < bytes; i++)
+        hash = (hash ^ composite[i]) * 16777619u;
+    printf("Composite checksum: %08x\n", hash);
+
+    if (!gOutputFn.empty() && gRenderMode == RM_HEADLESS) {
+        if (!m_headless.saveFramePPM(gOutputFn))
+            return 1;
+        printf("Last frame written to %s\n", gOutputFn.c_str());
+    }
+
+    return 0;
+}
+
+// Check every shipped shader against its references, see LShaderSuite.h
+int swosRunShaderSuite()
+{
+    LShaderSuite suite;
+    for (int i = 0; i < SUITE_SHADER_COUNT; i++) {
+        if (gSuiteShaders[i][2][0] == '\0')
+            suite.addPreset(gSuiteShaders[i][0], gSuiteShaders[i][1]);
+        else
+            suite.addShader(gSuiteShaders[i][0], gSuiteShaders[i][1], gSuiteShaders[i][2]);
+    }
+    for (int i = 0; i < SUITE_SIZE_COUNT; i++)
+        suite.addSize(gSuiteSizes[i][0], gSuiteSizes[i][1], gSuiteSizes[i][2], gSuiteSizes[i][3]);
+
+    suite.setReferenceDirectory(gSuiteDir, gSuiteUpdate);
+    suite.setTimeThreshold(gSuiteThreshold);
+    bool passed = suite.run();
+    suite.report();
+
+    return passed ? 0 : 1;
+}
+
+// Swap interval and frame rate of the window's display
+void swosInitPacer()
+{
+    SDL_DisplayMode mode;
+    double refresh = 0.0;
+    if (SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(m_window), &mode) == 0)
+        refresh = mode.refresh_rate;
+
+    m_pacer.init(gPaceMode, gPaceRate, refresh);
+    m_pacer.setLatencyTarget(gLatencyTarget);
+    printf("Frame pacing: %s at %.2f Hz\n", m_pacer.modeName(), m_pacer.rate());
+}
+
+// Start the recorders asked for, stamped with the rate frames are made at
+void swosStartRecording()
+{
+    if (gRecordFn.empty() && gRecordCompositeFn.empty())
+        return;
+
+    if (gRenderMode == RM_SDL) {
+        printf("Recording needs OpenGL rendering, disabled.\n");
+        return;
+    }
+
+    double rate = gRenderMode == RM_HEADLESS ? TICK_RATE : m_pacer.rate();
+    if (!gRecordFn.empty())
+        m_recordOutput.start(gRecordFn, m_windowWidth, m_windowHeight, rate);
+    if (!gRecordCompositeFn.empty())
+        m_recordComposite.start(gRecordCompositeFn, kVgaWidth, kVgaHeight, rate);
+}
+
+// Show the next menu background that has finished decoding. The frame
+// queue is restarted around the swap, so every buffer is composed again.
+void swosCycleBackground()
+{
+    for (int n = 1; n < BACKGROUND_COUNT; n++) {
+        int index = (gBackground + n) % BACKGROUND_COUNT;
+        // Staged first, the layers stay untouched until it is there
+        int count = kVgaWidth * kVgaHeight;
+        bool indexed = gPixelMode == PM_INDEXED8;
+        std::vector<Uint32> pixels(indexed ? 0 : count);
+        std::vector<Uint8> pixels8(indexed ? count : 0);
+        if (!swosBackgroundPixels(gBackgrounds[index], false, indexed ? NULL : &pixels[0], indexed ? &pixels8[0] : NULL))
+            continue;
+
+        bool queued = m_composeThread != NULL;
+        swosStopFrameQueue();
+
+        if (indexed) {
+            memcpy(m_pixelsBackground8, &pixels8[0], count);
+        }
+        else {
+            m_glTextureBackground.lock();
+            memcpy(m_glTextureBackground.getPixelData32(), &pixels[0], count * sizeof(Uint32));
+            m_glTextureBackground.unlock();
+        }
+        if (m_replayWriter.isOpen()) {
+            LDirtyRect all = { 0, 0, (GLuint)kVgaWidth, (GLuint)kVgaHeight };
+            m_replayWriter.addChange(LREPLAY_BACKGROUND, indexed ? (void*)&pixels8[0] : (void*)&pixels[0], all);
+        }
+        // The compositor thread takes what changed from the menu layer
+        m_glTextureTarget.invalidate();
+        m_glTextureMenu.invalidate();
+
+        if (queued)
+            swosStartFrameQueue();
+
+        gBackground = index;
+        printf("Background %s\n", gBackgrounds[index]);
+        return;
+    }
+
+    printf("No other background at %dx%d decoded, %d pending.\n", kVgaWidth, kVgaHeight, m_assets.pending());
+}
+
+// Switch every pass to the next quality level's shader variants
+void swosCycleQuality()
+{
+    int quality = (gQuality + 1) % QUALITY_LEVELS;
+    std::string defines = gDefines + " " + gQualityDefines[quality];
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    if (!m_ShaderPipeline.setDefines(defines))
+        return;
+    double ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+
+    gQuality = quality;
+    LShaderVariantCache &variants = m_ShaderPipeline.variants();
+    printf("Shader quality %d (%s): %.2f ms, %d variants cached, %d hits, %d misses\n",
+           gQuality, gQualityDefines[gQuality], ms, variants.variantCount(), variants.hits(), variants.misses());
+}
+
+// Select a shader parameter or step its value, applied on the next frame
+void swosTweakParameter(int key)
+{
+    int count = m_ShaderPipeline.parameterCount();
+    if (count == 0)
+        return;
+
+    float direction = 0.0f;
+    if (key == SDLK_LEFTBRACKET)
+        gParameter = (gParameter + count - 1) % count;
+    else if (key == SDLK_RIGHTBRACKET)
+        gParameter = (gParameter + 1) % count;
+    else if (key == SDLK_MINUS)
+        direction = -1.0f;
+    else if (key == SDLK_EQUALS)
+        direction = 1.0f;
+    else
+        return;
+
+    gParameter %= count;
+    const LPipelineParameter &param = m_ShaderPipeline.parameter(gParameter);
+    float step = param.info.step > 0.0f ? param.info.step : (param.info.maximum - param.info.minimum) / 100.0f;
+    if (direction != 0.0f)
+        m_ShaderPipeline.setParameter(param.info.name, param.value + direction * step);
+
+    printf("%s (%s) = %g\n", param.info.name.c_str(), param.info.label.c_str(), param.value);
+}
+
 // Universal version of main
 int main(int argc, char* args[])
 {
+    swosParseArgs(argc, args);
+
     atexit(finishRendering);
 
-    swosCreateWindow();
+    pxInit();
+    printf("Pixel kernels: %s\n", pxImplementationName());
+    m_threadPool.init(gThreads);
+    m_assets.init(0);
+
+    if (!swosCreateWindow() && gRenderMode == RM_HEADLESS)
+        return 1;
+    if (!gSuiteDir.empty())
+        return swosRunShaderSuite();
     swosCreateRenderer();
     swosCreateTextures();
+    if (!swosStartReplay())
+        return 1;
+    swosStartFrameQueue();
+
+    if (gRenderMode == RM_HEADLESS) {
+        swosStartRecording();
+        return m_replay.frameCount() > 0 ? swosRunReplay() : swosRunHeadless();
+    }
+
+    swosInitPacer();
+    swosStartRecording();
+    if (m_replay.frameCount() > 0)
+        return swosRunReplay();
 
     // While application is running
     bool quit = false;
     SDL_Event e;
     while(!quit) {
+        m_profiler.beginFrame();
+
+        // Input is read after the wait, as close to the vblank as it can be
+        m_profiler.begin(m_psPace);
+        m_pacer.waitForFrame();
+        m_profiler.end(m_psPace);
+
         // Handle events on queue
+        m_profiler.begin(m_psEvents);
         while(SDL_PollEvent(&e) != 0) {
             // User requests quit
             if (e.type == SDL_QUIT) {
@@ -441,11 +1593,23 @@ int main(int argc, char* args[])
                         m_windowHeight = e.window.data2;
                     }
                 }
+                if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_q)
+                    swosCycleQuality();
+                if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_b)
+                    swosCycleBackground();
+                if (e.type == SDL_KEYDOWN)
+                    swosTweakParameter(e.key.keysym.sym);
             }
         }
+        m_profiler.end(m_psEvents);
+
+        if (gHotReload)
+            swosHotReload();
 
         swosUpdateTexture();
         swosDoRendering();
+
+        m_profiler.endFrame();
     }
 
     return 0;
@@ -2,13 +2,33 @@
 #define MAIN_H_INCLUDED
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <string>
 #include <fstream>
 #include <streambuf>
+#include <vector>
+#include <algorithm>
 #include <SDL.h>
 
 #include "LTexture.h"
-#include "LShaderProgram.h"
+#include "LPixelOps.h"
+#include "LCompositor.h"
+#include "LShaderPipeline.h"
+#include "LProgramCache.h"
+#include "LHeadless.h"
+#include "LProfiler.h"
+#include "LThreadPool.h"
+#include "LFrameQueue.h"
+#include "LSoftCRT.h"
+#include "LAssetLoader.h"
+#include "LBundle.h"
+#include "LFramePacer.h"
+#include "LShaderCompiler.h"
+#include "LFileWatcher.h"
+#include "LFrameRecorder.h"
+#include "LReplay.h"
+#include "LShaderSuite.h"
 
 using namespace std;
 
@@ -0,0 +1,21 @@
+#version 150
+
+// Resolves an 8-bit palette indexed frame to RGBA.
+// source[0] holds one index per texel in the red channel,
+// palette is a 256x1 RGBA texture.
+
+uniform sampler2D source[];
+uniform sampler2D palette;
+
+in Vertex {
+  vec2 texCoord;
+  vec2 one;
+  float mod_factor;
+};
+
+out vec4 fragColor;
+
+void main() {
+  float index = texture(source[0], texCoord).r;
+  fragColor = texture(palette, vec2((index * 255.0 + 0.5) / 256.0, 0.5));
+}
@@ -13,6 +13,8 @@ uniform vec4 targetSize;
 
 in Vertex {
   vec2 texCoord;
+  vec2 one;
+  float mod_factor;
 };
 
 out vec4 fragColor;
@@ -0,0 +1,441 @@
+// swbench: times the CPU compositor kernels, a baseline to judge rewrites by
+//
+//   swbench [--quick] [--threads N] [--impl NAME] [--no-texture] [--output FILE]
+//
+// Each kernel runs as the renderer calls it over every size below, and the
+// blend over several layer counts and opacities too. The median call gives
+// ns/pixel and GB/s; cycles/pixel come from the CPU cycle counter where
+// perf_event_open is allowed. Results go to a JSON file for trend tracking.
+#include "LCompositor.h"
+#include "LHeadless.h"
+#include <stdlib.h>
+#include <string>
+#include <algorithm>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Calls are repeated until this much time has passed and at least
+// BENCH_MIN_RUNS calls were timed
+#define BENCH_MIN_MS     200.0
+#define BENCH_QUICK_MS   20.0
+#define BENCH_MIN_RUNS   5
+#define BENCH_MAX_RUNS   10000
+
+const int gSizes[][2] = {
+    {  480,  270 },
+    {  960,  540 },
+    { 1280,  720 },
+    { 1920, 1080 },
+    { 2560, 1440 },
+    { 3840, 2160 }
+};
+#define SIZE_COUNT 6
+
+const int gLayerCounts[] = { 1, 2, 4 };
+#define LAYER_COUNT_COUNT 3
+
+const int gOpacities[] = { 0, 50, 100 };
+#define OPACITY_COUNT 3
+
+#define MAX_LAYERS 4
+
+struct BenchResult
+{
+    std::string kernel;
+    std::string variant;
+    int width, height;
+    int layers;
+    int opacity;
+    int runs;
+    double nsPerPixel;
+    double gbPerSecond;
+    double cyclesPerPixel;
+};
+
+std::vector<BenchResult> gResults;
+double gMinMs = BENCH_MIN_MS;
+int gThreads = 1;
+
+// Layers of the size being measured
+std::vector<Uint32> m_background;
+std::vector<Uint32> m_target;
+std::vector<Uint32> m_menus[MAX_LAYERS];
+
+// Keeps getRGBA results alive
+volatile Uint32 m_sink;
+
+// User space CPU cycles of the calling thread, -1 without a counter. Pool
+// workers are not counted, so cycles are only reported for one thread.
+int m_cycleCounter = -1;
+
+void benchOpenCycleCounter()
+{
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    m_cycleCounter = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+}
+
+void benchStartCycles()
+{
+#ifdef __linux__
+    if (m_cycleCounter >= 0) {
+        ioctl(m_cycleCounter, PERF_EVENT_IOC_RESET, 0);
+        ioctl(m_cycleCounter, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+// Cycles since benchStartCycles(), -1 without a counter
+double benchStopCycles()
+{
+#ifdef __linux__
+    if (m_cycleCounter >= 0) {
+        ioctl(m_cycleCounter, PERF_EVENT_IOC_DISABLE, 0);
+        long long cycles = 0;
+        if (read(m_cycleCounter, &cycles, sizeof(cycles)) == sizeof(cycles))
+            return (double)cycles;
+    }
+#endif
+    return -1.0;
+}
+
+// One call of the kernel being measured
+typedef void (*BenchFunc)(void *data);
+
+// Times 'func' and records it; 'pixels' and 'bytes' are what one call
+// covers and moves
+void benchRun(BenchResult result, BenchFunc func, void *data, double pixels, double bytes)
+{
+    // Once to fault in pages and warm caches
+    func(data);
+
+    std::vector<double> times;
+    double total = 0.0;
+    benchStartCycles();
+    while ((total < gMinMs || (int)times.size() < BENCH_MIN_RUNS) && (int)times.size() < BENCH_MAX_RUNS) {
+        Uint64 start = SDL_GetPerformanceCounter();
+        func(data);
+        double ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+        times.push_back(ms);
+        total += ms;
+    }
+    double cycles = benchStopCycles();
+
+    std::sort(times.begin(), times.end());
+    double median = times[times.size() / 2];
+    result.runs = (int)times.size();
+    result.nsPerPixel = median * 1000000.0 / pixels;
+    result.gbPerSecond = median > 0.0 ? bytes / (median * 1000000.0) : 0.0;
+    result.cyclesPerPixel = cycles >= 0.0 && gThreads == 1 ? cycles / (pixels * times.size()) : -1.0;
+    gResults.push_back(result);
+
+    printf("%-22s %-10s %4dx%-4d %6d %7d %6d %9.3f %8.2f",
+           result.kernel.c_str(), result.variant.c_str(), result.width, result.height,
+           result.layers, result.opacity, result.runs, result.nsPerPixel, result.gbPerSecond);
+    if (result.cyclesPerPixel >= 0.0)
+        printf(" %9.2f\n", result.cyclesPerPixel);
+    else
+        printf(" %9s\n", "-");
+}
+
+BenchResult benchCase(const char *kernel, const char *variant, int layers, int opacity)
+{
+    BenchResult result;
+    result.kernel = kernel;
+    result.variant = variant;
+    result.width = kVgaWidth;
+    result.height = kVgaHeight;
+    result.layers = layers;
+    result.opacity = opacity;
+    result.runs = 0;
+    result.nsPerPixel = 0.0;
+    result.gbPerSecond = 0.0;
+    result.cyclesPerPixel = -1.0;
+    return result;
+}
+
+// Opaque noise, the same for every run
+void benchNoise(Uint32 *pixels, int count, Uint32 seed)
+{
+    for (int i = 0; i < count; i++) {
+        Uint32 h = i * 2654435761u ^ seed;
+        h ^= h >> 15;
+        h *= 2246822519u;
+        h ^= h >> 13;
+        pixels[i] = h | 0xFF000000;
+    }
+}
+
+// Menu layers are see-through around an opaque box, as the renderer's are
+void benchMenuLayer(Uint32 *pixels, Uint32 seed)
+{
+    initMenuPixels(pixels);
+    std::vector<Uint32> row(kVgaWidth);
+    for (int y = kVgaHeight / 4; y < kVgaHeight * 3 / 4; y++) {
+        benchNoise(&row[0], kVgaWidth, seed + y);
+        memcpy(&pixels[y * kVgaWidth + kVgaWidth / 4], &row[0], kVgaWidth / 2 * sizeof(Uint32));
+    }
+}
+
+void benchClear(void *data)
+{
+    clearPixels(&m_target[0]);
+}
+
+void benchInitMenu(void *data)
+{
+    initMenuPixels(&m_target[0]);
+}
+
+void benchUpdateMenu(void *data)
+{
+    static int frame = 0;
+    updateTestMenuPixels(&m_target[0], NULL, frame++);
+}
+
+struct BlendArgs
+{
+    int layers;
+    int opacity;
+    std::vector<LDirtyRect> rects;
+};
+
+// The background and first menu layer into the target, then each further
+// menu layer over the result
+void benchBlend(void *data)
+{
+    BlendArgs *args = (BlendArgs*)data;
+    alphablendPixels(&m_background[0], &m_menus[0][0], &m_target[0], args->opacity, args->rects);
+    for (int i = 1; i < args->layers; i++)
+        alphablendPixels(&m_target[0], &m_menus[i][0], &m_target[0], args->opacity, args->rects);
+}
+
+void benchSetRGBA(void *data)
+{
+    Uint32 *pixels = &m_target[0];
+    for (int y = 0; y < kVgaHeight; y++) {
+        for (int x = 0; x < kVgaWidth; x++)
+            pixels[y * kVgaWidth + x] = setRGBA(x, y, x ^ y, 255);
+    }
+}
+
+void benchGetRGBA(void *data)
+{
+    const Uint32 *pixels = &m_background[0];
+    int count = kVgaWidth * kVgaHeight;
+    Uint32 sum = 0;
+    for (int i = 0; i < count; i++) {
+        Uint8 r, g, b, a;
+        getRGBA(pixels[i], &r, &g, &b, &a);
+        sum += r + g + b + a;
+    }
+    m_sink = sum;
+}
+
+// Locks, marks every pixel changed and unlocks, finished so the upload
+// is in the time
+void benchTexture(void *data)
+{
+    LTexture *texture = (LTexture*)data;
+    texture->lock();
+    texture->invalidate();
+    texture->unlock();
+    glFinish();
+}
+
+void benchSize(int width, int height, bool textures)
+{
+    kVgaWidth = width;
+    kVgaHeight = height;
+    int count = width * height;
+    double pixels = count;
+
+    m_background.assign(count, 0);
+    m_target.assign(count, 0);
+    benchNoise(&m_background[0], count, 1);
+    for (int i = 0; i < MAX_LAYERS; i++) {
+        m_menus[i].assign(count, 0);
+        benchMenuLayer(&m_menus[i][0], 100 + i);
+    }
+
+    benchRun(benchCase("clearPixels", "", 1, -1), benchClear, NULL, pixels, pixels * 4);
+    benchRun(benchCase("initMenuPixels", "", 1, -1), benchInitMenu, NULL, pixels, pixels * 4);
+    // Noise over the menu box, which is all the kernel writes
+    double box = (double)(width - 150 + 1) * (height - 200 + 1);
+    benchRun(benchCase("updateTestMenuPixels", "", 1, -1), benchUpdateMenu, NULL, box, box * 4);
+
+    // Two layers read and one written per blend
+    BlendArgs blend;
+    LDirtyRect all = { 0, 0, (GLuint)width, (GLuint)height };
+    blend.rects.push_back(all);
+    for (int l = 0; l < LAYER_COUNT_COUNT; l++) {
+        for (int o = 0; o < OPACITY_COUNT; o++) {
+            blend.layers = gLayerCounts[l];
+            blend.opacity = gOpacities[o];
+            benchRun(benchCase("alphablendPixels", "", blend.layers, blend.opacity), benchBlend, &blend,
+                     pixels * blend.layers, pixels * blend.layers * 12);
+        }
+    }
+
+    benchRun(benchCase("setRGBA", "", 1, -1), benchSetRGBA, NULL, pixels, pixels * 4);
+    benchRun(benchCase("getRGBA", "", 1, -1), benchGetRGBA, NULL, pixels, pixels * 4);
+
+    if (!textures)
+        return;
+
+    // Without streaming lock() reads the texture back before the upload
+    const int modes[] = { LSTREAM_NONE, LSTREAM_ORPHAN, LSTREAM_PERSISTENT };
+    const char *modeNames[] = { "readback", "orphan", "persistent" };
+    for (int i = 0; i < 3; i++) {
+        LTexture texture;
+        if (!texture.loadTextureFromPixels32(&m_background[0], width, height))
+            continue;
+        if (modes[i] != LSTREAM_NONE && (!texture.enableStreaming(modes[i], 3) || texture.streamMode() != modes[i]))
+            continue;
+        double bytes = pixels * 4 * (modes[i] == LSTREAM_NONE ? 2 : 1);
+        benchRun(benchCase("textureLockUnlock", modeNames[i], 1, -1), benchTexture, &texture, pixels, bytes);
+    }
+}
+
+// Opacity and cycles are null where they do not apply or were not measured
+bool benchWriteJSON(const std::string &path)
+{
+    FILE *file = fopen(path.c_str(), "w");
+    if (file == NULL) {
+        printf("Unable to open %s!\n", path.c_str());
+        return false;
+    }
+
+    fprintf(file, "{\n\"implementation\":\"%s\",\"threads\":%d,\"cpus\":%d,\"perf_counters\":%s,\n\"results\":[",
+            pxImplementationName(), m_threadPool.threadCount(), SDL_GetCPUCount(), m_cycleCounter >= 0 ? "true" : "false");
+    for (size_t i = 0; i < gResults.size(); i++) {
+        const BenchResult &r = gResults[i];
+        fprintf(file, "%s\n{\"kernel\":\"%s\",\"variant\":\"%s\",\"width\":%d,\"height\":%d,\"layers\":%d,",
+                i ? "," : "", r.kernel.c_str(), r.variant.c_str(), r.width, r.height, r.layers);
+        if (r.opacity >= 0)
+            fprintf(file, "\"opacity\":%d,", r.opacity);
+        else
+            fprintf(file, "\"opacity\":null,");
+        fprintf(file, "\"runs\":%d,\"ns_per_pixel\":%.4f,\"gb_per_s\":%.3f,", r.runs, r.nsPerPixel, r.gbPerSecond);
+        if (r.cyclesPerPixel >= 0.0)
+            fprintf(file, "\"cycles_per_pixel\":%.3f}", r.cyclesPerPixel);
+        else
+            fprintf(file, "\"cycles_per_pixel\":null}");
+    }
+    fprintf(file, "\n]}\n");
+
+    bool written = ferror(file) == 0;
+    fclose(file);
+    if (!written)
+        printf("Unable to write %s!\n", path.c_str());
+    return written;
+}
+
+int usage()
+{
+    printf("Usage: swbench [--quick] [--threads N] [--impl NAME] [--no-texture] [--output FILE]\n");
+    printf("  --quick       time each case for %.0f ms instead of %.0f ms\n", BENCH_QUICK_MS, BENCH_MIN_MS);
+    printf("  --threads N   compositor threads, 0 for one per CPU, default 1\n");
+    printf("  --impl NAME   pixel kernels: scalar, sse2, avx2 or neon\n");
+    printf("  --no-texture  skip the texture lock/unlock cases, no GL context\n");
+    printf("  --output FILE JSON results, default swbench.json\n");
+    return 1;
+}
+
+int main(int argc, char* args[])
+{
+    std::string outputFn = "swbench.json";
+    std::string impl;
+    bool textures = true;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = args[i];
+
+        if (arg == "--quick") {
+            gMinMs = BENCH_QUICK_MS;
+        }
+        else if (arg == "--threads" && i + 1 < argc) {
+            gThreads = atoi(args[++i]);
+        }
+        else if (arg == "--impl" && i + 1 < argc) {
+            impl = args[++i];
+        }
+        else if (arg == "--no-texture") {
+            textures = false;
+        }
+        else if (arg == "--output" && i + 1 < argc) {
+            outputFn = args[++i];
+        }
+        else {
+            printf("Unknown argument: %s\n", arg.c_str());
+            return usage();
+        }
+    }
+
+    // The menu box is only drawn with --menu-noise in the renderer
+    gMenuNoise = true;
+    pxInit();
+    if (!impl.empty()) {
+        const char *names[] = { "scalar", "sse2", "avx2", "neon" };
+        const int impls[] = { PX_IMPL_SCALAR, PX_IMPL_SSE2, PX_IMPL_AVX2, PX_IMPL_NEON };
+        bool found = false;
+        for (int i = 0; i < 4; i++) {
+            if (impl == names[i]) {
+                found = true;
+                if (!pxSetImplementation(impls[i])) {
+                    printf("This CPU cannot run the %s kernels.\n", impl.c_str());
+                    return 1;
+                }
+            }
+        }
+        if (!found)
+            return usage();
+    }
+
+    m_threadPool.init(gThreads);
+    gThreads = m_threadPool.threadCount();
+    benchOpenCycleCounter();
+
+    // Texture cases upload from the calling thread, a 1x1 framebuffer will do
+    LHeadless headless;
+    if (textures && !headless.init(1, 1)) {
+        printf("No GL context, texture cases skipped.\n");
+        textures = false;
+    }
+
+    printf("Pixel kernels: %s, %d thread(s), cycle counter %s\n",
+           pxImplementationName(), gThreads, m_cycleCounter >= 0 ? "on" : "unavailable");
+    if (m_cycleCounter >= 0 && gThreads != 1)
+        printf("Cycles are only counted with one thread.\n");
+    printf("%-22s %-10s %-9s %6s %7s %6s %9s %8s %9s\n",
+           "kernel", "variant", "size", "layers", "opacity", "runs", "ns/pixel", "GB/s", "cyc/pixel");
+
+    for (int i = 0; i < SIZE_COUNT; i++)
+        benchSize(gSizes[i][0], gSizes[i][1], textures);
+
+    if (textures)
+        headless.freeHeadless();
+    m_threadPool.freePool();
+#ifdef __linux__
+    if (m_cycleCounter >= 0)
+        close(m_cycleCounter);
+#endif
+
+    if (!benchWriteJSON(outputFn))
+        return 1;
+    printf("Wrote %s: %d results\n", outputFn.c_str(), (int)gResults.size());
+    return 0;
+}
@@ -0,0 +1,70 @@
+// swpack: packs BMP files into an asset bundle for --bundle
+//
+//   swpack [--indexed] [--page N] output.swb image.bmp...
+//
+// Entries are named after the file name without its directory, so the
+// renderer finds "play1.bmp" whether it was packed from here or elsewhere.
+#include "LBundleWriter.h"
+#include <stdlib.h>
+
+static std::string baseName(const std::string &path)
+{
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+static int usage()
+{
+    printf("Usage: swpack [--indexed] [--page N] output.swb image.bmp...\n");
+    printf("  --indexed  store 3-3-2 palette indices instead of RGBA\n");
+    printf("  --page N   largest atlas page side, default %d\n", LBUNDLE_PAGE_SIZE);
+    return 1;
+}
+
+int main(int argc, char* args[])
+{
+    int format = LBUNDLE_RGBA;
+    int pageSize = LBUNDLE_PAGE_SIZE;
+    std::string outputFn;
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = args[i];
+
+        if (arg == "--indexed") {
+            format = LBUNDLE_INDEXED;
+        }
+        else if (arg == "--page" && i + 1 < argc) {
+            pageSize = atoi(args[++i]);
+        }
+        else if (arg.size() > 2 && arg.substr(0, 2) == "--") {
+            printf("Unknown argument: %s\n", arg.c_str());
+            return usage();
+        }
+        else if (outputFn.empty()) {
+            outputFn = arg;
+        }
+        else {
+            inputs.push_back(arg);
+        }
+    }
+
+    if (outputFn.empty() || inputs.empty() || pageSize <= 2 * LBUNDLE_GUTTER)
+        return usage();
+
+    LBundleWriter writer;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        LImage image;
+        if (!LBitmap::load(inputs[i], image))
+            return 1;
+        if (!writer.add(baseName(inputs[i]), image, format))
+            return 1;
+        printf("%s: %ux%u\n", inputs[i].c_str(), image.width, image.height);
+    }
+
+    if (!writer.write(outputFn, pageSize))
+        return 1;
+
+    printf("Wrote %s: %d entries on %d pages\n", outputFn.c_str(), writer.entryCount(), writer.pageCount());
+    return 0;
+}